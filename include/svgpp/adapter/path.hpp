@@ -11,7 +11,8 @@
 #include <boost/utility/enable_if.hpp>
 #include <boost/static_assert.hpp>
 #include <boost/mpl/if.hpp>
-#include <boost/type_traits/is_floating_point.hpp>
+#include <boost/type_traits/is_integral.hpp>
+#include <svgpp/number_type.hpp>
 #include <svgpp/policy/path.hpp>
 #include <svgpp/definitions.hpp>
 #include <svgpp/detail/adapt_context.hpp>
@@ -125,6 +126,7 @@ class path_adapter:
 {
 public:
   typedef Coordinate coordinate_type;
+  typedef typename calculation_number_type<Coordinate>::type calculation_type;
 
   explicit path_adapter(OutputContext & original_context_)
     : output_context(original_context_)
@@ -454,14 +456,16 @@ public:
     coordinate_type y, 
     tag::coordinate::absolute tag)
   {
-    BOOST_STATIC_ASSERT(boost::is_floating_point<coordinate_type>::value);
-    const coordinate_type k1 = 1./3.;
-    const coordinate_type k2 = 2./3.;
-    coordinate_type xk = k2 * x1;
-    coordinate_type yk = k2 * y1;
+    BOOST_STATIC_ASSERT(!boost::is_integral<coordinate_type>::value);
+    const calculation_type k1 = 1./3.;
+    const calculation_type k2 = 2./3.;
+    calculation_type xk = k2 * static_cast<calculation_type>(x1);
+    calculation_type yk = k2 * static_cast<calculation_type>(y1);
     path_cubic_bezier_to<Policy>(
-      current_x * k1 + xk, current_y * k1 + yk,
-      x * k1 + xk, y * k1 + yk,
+      static_cast<coordinate_type>(static_cast<calculation_type>(current_x) * k1 + xk), 
+      static_cast<coordinate_type>(static_cast<calculation_type>(current_y) * k1 + yk),
+      static_cast<coordinate_type>(static_cast<calculation_type>(x) * k1 + xk), 
+      static_cast<coordinate_type>(static_cast<calculation_type>(y) * k1 + yk),
       x, y, tag, false);
     set_quadratic_cp(x1, y1);
   }
@@ -475,16 +479,17 @@ public:
     coordinate_type y, 
     tag::coordinate::relative tag)
   {
-    BOOST_STATIC_ASSERT(boost::is_floating_point<coordinate_type>::value);
-    const coordinate_type k1 = 1./3.;
-    const coordinate_type k2 = 2./3.;
-    coordinate_type xk = k2 * x1;
-    coordinate_type yk = k2 * y1;
+    BOOST_STATIC_ASSERT(!boost::is_integral<coordinate_type>::value);
+    const calculation_type k1 = 1./3.;
+    const calculation_type k2 = 2./3.;
+    calculation_type xk = k2 * static_cast<calculation_type>(x1);
+    calculation_type yk = k2 * static_cast<calculation_type>(y1);
     const coordinate_type x1_absolute = x1 + current_x;
     const coordinate_type y1_absolute = y1 + current_y;
     path_cubic_bezier_to<Policy>(
-      xk, yk,
-      x * k1 + xk, y * k1 + yk,
+      static_cast<coordinate_type>(xk), static_cast<coordinate_type>(yk),
+      static_cast<coordinate_type>(static_cast<calculation_type>(x) * k1 + xk), 
+      static_cast<coordinate_type>(static_cast<calculation_type>(y) * k1 + yk),
       x, y, tag, false);
     set_quadratic_cp(x1_absolute, y1_absolute);
   }
@@ -627,33 +632,43 @@ public:
     coordinate_type y, 
     tag::coordinate::absolute tag)
   { 
-    x_axis_rotation *= boost::math::constants::degree<coordinate_type>();
-    coordinate_type cx, cy, theta1, theta2;
-    arc_endpoint_to_center(current_x, current_y, x, y,
-      rx, ry, x_axis_rotation, large_arc_flag, sweep_flag,
+    calculation_type phi = static_cast<calculation_type>(x_axis_rotation) 
+      * boost::math::constants::degree<calculation_type>();
+    calculation_type arc_rx = static_cast<calculation_type>(rx), arc_ry = static_cast<calculation_type>(ry);
+    calculation_type cx, cy, theta1, theta2;
+    arc_endpoint_to_center(
+      static_cast<calculation_type>(current_x), static_cast<calculation_type>(current_y), 
+      static_cast<calculation_type>(x), static_cast<calculation_type>(y),
+      arc_rx, arc_ry, phi, large_arc_flag, sweep_flag,
       cx, cy, theta1, theta2);
     if (sweep_flag)
     {
       if (theta2 < theta1)
-        theta2 += boost::math::constants::two_pi<coordinate_type>();
+        theta2 += boost::math::constants::two_pi<calculation_type>();
     }
     else
     {
       if (theta2 > theta1)
-        theta2 -= boost::math::constants::two_pi<coordinate_type>();
+        theta2 -= boost::math::constants::two_pi<calculation_type>();
     }
 
-    typedef arc_to_bezier<coordinate_type> arc_to_bezier_t;
-    arc_to_bezier_t a2b(cx, cy, rx, ry, x_axis_rotation, 
+    typedef arc_to_bezier<calculation_type> arc_to_bezier_t;
+    arc_to_bezier_t a2b(cx, cy, arc_rx, arc_ry, phi, 
       typename arc_to_bezier_t::circle_angle_tag(), theta1, theta2, 
-      typename arc_to_bezier_t::max_angle_tag(), boost::math::constants::half_pi<coordinate_type>());
-    for(typename arc_to_bezier_t::iterator it(a2b); !it.eof(); it.advance())
+      typename arc_to_bezier_t::max_angle_tag(), boost::math::constants::half_pi<calculation_type>());
+    typename arc_to_bezier_t::iterator it(a2b);
+    for(int i = 1; i < a2b.size(); ++i, it.advance())
       path_cubic_bezier_to<Policy>(
-        it.p1x(), it.p1y(),
-        it.p2x(), it.p2y(),
-        it.p3x(), it.p3y(),
+        static_cast<coordinate_type>(it.p1x()), static_cast<coordinate_type>(it.p1y()),
+        static_cast<coordinate_type>(it.p2x()), static_cast<coordinate_type>(it.p2y()),
+        static_cast<coordinate_type>(it.p3x()), static_cast<coordinate_type>(it.p3y()),
         tag::coordinate::absolute(),
         false);
+    // Last segment ends exactly at the end point of the arc
+    path_cubic_bezier_to<Policy>(
+      static_cast<coordinate_type>(it.p1x()), static_cast<coordinate_type>(it.p1y()),
+      static_cast<coordinate_type>(it.p2x()), static_cast<coordinate_type>(it.p2y()),
+      x, y, tag::coordinate::absolute(), false);
   } 
 
   template<class Policy>
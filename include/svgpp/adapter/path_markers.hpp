@@ -101,6 +101,7 @@ class path_markers_adapter: boost::noncopyable
 {
 public:
   typedef Coordinate coordinate_type;
+  typedef typename calculation_number_type<Coordinate>::type calculation_type;
   typedef typename MarkersPolicy::directionality_policy::directionality_type directionality_type;
 
   path_markers_adapter(OutputContext & context)
@@ -261,28 +262,25 @@ public:
 
     in_subpath_ = true;
 
-    x_axis_rotation *= boost::math::constants::degree<coordinate_type>();
-    coordinate_type cx, cy, theta1, theta2;
-    arc_endpoint_to_center(last_x_, last_y_, x, y,
-      rx, ry, x_axis_rotation, large_arc_flag, sweep_flag,
-      cx, cy, theta1, theta2);
-
-    coordinate_type sin_theta = std::sin(x_axis_rotation);
-    coordinate_type cos_theta = std::cos(x_axis_rotation);
-    coordinate_type a_sin_eta1 = rx * std::sin(theta1);
-    coordinate_type b_cos_eta1 = ry * std::cos(theta1);
-    coordinate_type deriv_x1 = -a_sin_eta1 * cos_theta - b_cos_eta1 * sin_theta;
-    coordinate_type deriv_y1 = -a_sin_eta1 * sin_theta + b_cos_eta1 * cos_theta;
-    coordinate_type a_sin_eta2 = rx * std::sin(theta2);
-    coordinate_type b_cos_eta2 = ry * std::cos(theta2);
-    coordinate_type deriv_x2 = -a_sin_eta2 * cos_theta - b_cos_eta2 * sin_theta;
-    coordinate_type deriv_y2 = -a_sin_eta2 * sin_theta + b_cos_eta2 * cos_theta;
-
-    coordinate_type sweep_sign = sweep_flag ? 1 : -1;
+    calculation_type sin_phi = 0, cos_phi = 1;
+    if (x_axis_rotation != 0)
+    {
+      calculation_type phi = static_cast<calculation_type>(x_axis_rotation) 
+        * boost::math::constants::degree<calculation_type>();
+      sin_phi = std::sin(phi);
+      cos_phi = std::cos(phi);
+    }
+    calculation_type tangent1_x, tangent1_y, tangent2_x, tangent2_y;
+    arc_endpoint_tangents(
+      static_cast<calculation_type>(last_x_), static_cast<calculation_type>(last_y_), 
+      static_cast<calculation_type>(x), static_cast<calculation_type>(y),
+      static_cast<calculation_type>(rx), static_cast<calculation_type>(ry), 
+      sin_phi, cos_phi, large_arc_flag, sweep_flag,
+      tangent1_x, tangent1_y, tangent2_x, tangent2_y);
 
     on_nonzero_length_segment(
-      MarkersPolicy::directionality_policy::segment_directionality(deriv_x1 * sweep_sign, deriv_y1 * sweep_sign),
-      MarkersPolicy::directionality_policy::segment_directionality(deriv_x2 * sweep_sign, deriv_y2 * sweep_sign));
+      MarkersPolicy::directionality_policy::segment_directionality(tangent1_x, tangent1_y),
+      MarkersPolicy::directionality_policy::segment_directionality(tangent2_x, tangent2_y));
     last_x_ = x;
     last_y_ = y;
   }
@@ -14,7 +14,8 @@
 #include <boost/mpl/if.hpp>
 #include <boost/parameter.hpp>
 #include <boost/utility/enable_if.hpp>
-#include <boost/type_traits/is_floating_point.hpp>
+#include <boost/type_traits/is_integral.hpp>
+#include <svgpp/number_type.hpp>
 #include <svgpp/detail/adapt_context.hpp>
 #include <svgpp/policy/transform_events.hpp>
 #include <svgpp/policy/transform.hpp>
@@ -156,28 +157,35 @@ public:
 
   void transform_rotate(number_type angle)
   {
-    BOOST_STATIC_ASSERT(boost::is_floating_point<number_type>::value);
-    number_type cosa = std::cos(angle * boost::math::constants::degree<number_type>()), 
-      sina = std::sin(angle * boost::math::constants::degree<number_type>());
+    calculation_type const a = to_radians(angle);
+    number_type cosa = static_cast<number_type>(std::cos(a)), 
+      sina = static_cast<number_type>(std::sin(a));
     const boost::array<number_type, 6> matrix = {{cosa, sina, -sina, cosa, 0, 0}};
     this->transform_matrix(matrix);
   }
 
   void transform_skew_x(number_type angle)
   {
-    BOOST_STATIC_ASSERT(boost::is_floating_point<number_type>::value);
     const boost::array<number_type, 6> matrix = 
-      {{1, 0, std::tan(angle * boost::math::constants::degree<number_type>()), 1, 0, 0}};
+      {{1, 0, static_cast<number_type>(std::tan(to_radians(angle))), 1, 0, 0}};
     this->transform_matrix(matrix);
   }
 
   void transform_skew_y(number_type angle)
   {
-    BOOST_STATIC_ASSERT(boost::is_floating_point<number_type>::value);
     const boost::array<number_type, 6> matrix = 
-      {{1, std::tan(angle * boost::math::constants::degree<number_type>()), 0, 1, 0, 0}};
+      {{1, static_cast<number_type>(std::tan(to_radians(angle))), 0, 1, 0, 0}};
     this->transform_matrix(matrix);
   }
+
+private:
+  typedef typename calculation_number_type<number_type>::type calculation_type;
+
+  static calculation_type to_radians(number_type angle)
+  {
+    BOOST_STATIC_ASSERT(!boost::is_integral<number_type>::value);
+    return static_cast<calculation_type>(angle) * boost::math::constants::degree<calculation_type>();
+  }
 };
 
 template<class Context, class TransformPolicy, class EventsPolicy, class Number>
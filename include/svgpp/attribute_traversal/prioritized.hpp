@@ -8,7 +8,8 @@
 #pragma once
 
 #include <svgpp/detail/required_attributes_check.hpp>
-#include <svgpp/parser/css_style_iterator.hpp>
+#include <svgpp/parser/detail/value_cache.hpp>
+#include <svgpp/detail/adapt_context.hpp>
 #include <svgpp/detail/attribute_name_to_id.hpp>
 #include <svgpp/detail/names_dictionary.hpp>
 #include <svgpp/traits/attribute_groups.hpp>
@@ -334,7 +335,8 @@ struct attribute_traversal_prioritized
   typedef typename boost::parameter::parameters<
       boost::parameter::optional<tag::xml_attribute_policy>,
       boost::parameter::optional<tag::error_policy>,
-      boost::parameter::optional<tag::css_name_to_id_policy>
+      boost::parameter::optional<tag::css_name_to_id_policy>,
+      boost::parameter::optional<tag::value_cache_policy>
   >::bind<SVGPP_TEMPLATE_ARGS_PASS>::type args;
   typedef typename boost::parameter::value_type<args, tag::css_name_to_id_policy, 
     policy::css_name_to_id::default_policy>::type css_name_to_id_policy;
@@ -433,24 +435,41 @@ private:
   {
     style_value = XMLPolicy::get_value(xml_attributes_iterator);
     typename XMLPolicy::string_type style_string = XMLPolicy::get_string_range(style_value);
-    typedef css_style_iterator<typename boost::range_iterator<typename XMLPolicy::string_type>::type> css_iterator;
-    for(css_iterator it(boost::begin(style_string), boost::end(style_string)); !it.eof(); ++it)
+    typedef detail::unwrap_context<typename Dispatcher::context_type, tag::value_cache_policy> value_cache_context;
+    css_declaration_saver<XMLPolicy, ErrorPolicy, XMLAttributesIterator, Dispatcher, FoundAttributes> 
+      saver(xml_attributes_iterator, dispatcher, found);
+    return detail::load_css_declarations_with_value_cache<
+      typename value_cache_context::template bind<args>::type
+    >::template load<css_name_to_id_policy>(value_cache_context::get(dispatcher.context()), style_string, saver);
+  }
+
+  template<class XMLPolicy, class ErrorPolicy, class XMLAttributesIterator, class Dispatcher, class FoundAttributes>
+  class css_declaration_saver
+  {
+  public:
+    css_declaration_saver(XMLAttributesIterator const & xml_attributes_iterator, Dispatcher & dispatcher, 
+      FoundAttributes & found)
+      : xml_attributes_iterator_(xml_attributes_iterator)
+      , dispatcher_(dispatcher)
+      , found_(found)
+    {}
+
+    template<class Range>
+    bool operator()(detail::attribute_id style_id, Range const & name, Range const & value)
     {
-      detail::attribute_id style_id = css_name_to_id_policy::find(it->first);
       if (style_id == detail::unknown_attribute_id)
-      {
-        if (!ErrorPolicy::unknown_attribute(dispatcher.context(), 
-          XMLPolicy::get_attribute(xml_attributes_iterator), 
-          it->first, tag::source::css()))
-          return false;
-      }
-      else
-      {
-        found.save_css(style_id, it->second);
-      }
+        return ErrorPolicy::unknown_attribute(dispatcher_.context(), 
+          XMLPolicy::get_attribute(xml_attributes_iterator_), 
+          name, tag::source::css());
+      found_.save_css(style_id, value);
+      return true;
     }
-    return true;
-  }
+
+  private:
+    XMLAttributesIterator const & xml_attributes_iterator_;
+    Dispatcher & dispatcher_;
+    FoundAttributes & found_;
+  };
 
   template<class XMLPolicy, class ErrorPolicy, class XMLAttributesIterator, class Dispatcher, class FoundAttributes>
   static bool load_style(XMLAttributesIterator const &, Dispatcher &,
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <svgpp/number_type.hpp>
 #include <svgpp/traits/length_units.hpp>
 #include <boost/utility/enable_if.hpp>
 #include <boost/mpl/has_key.hpp>
@@ -21,6 +22,7 @@ class unitless_absolute
 public:
   typedef LengthType length_type;
   typedef NumberType number_type;
+  typedef typename calculation_number_type<NumberType>::type coefficient_type;
 
   unitless_absolute()
   {
@@ -28,12 +30,12 @@ public:
     set_absolute_units_coefficient(96, tag::length_units::in());
   }
 
-  unitless_absolute(number_type reference_to_output_coeff)
+  unitless_absolute(coefficient_type reference_to_output_coeff)
     : reference_to_output_coeff_(reference_to_output_coeff)
   {}
 
   template<class AbsoluteUnits>
-  void set_absolute_units_coefficient(number_type coeff, AbsoluteUnits)
+  void set_absolute_units_coefficient(coefficient_type coeff, AbsoluteUnits)
   {
     BOOST_MPL_ASSERT((boost::mpl::has_key<traits::absolute_length_units, AbsoluteUnits>));
     typedef typename traits::absolute_length_conversion_coefficient<ReferenceAbsoluteUnits, AbsoluteUnits>::ratio ratio;
@@ -41,7 +43,7 @@ public:
   }
 
   template<class AbsoluteUnits>
-  number_type get_absolute_units_coefficient(AbsoluteUnits) const
+  coefficient_type get_absolute_units_coefficient(AbsoluteUnits) const
   {
     BOOST_MPL_ASSERT((boost::mpl::has_key<traits::absolute_length_units, AbsoluteUnits>));
     typedef typename traits::absolute_length_conversion_coefficient<AbsoluteUnits, ReferenceAbsoluteUnits>::ratio ratio;
@@ -53,17 +55,20 @@ public:
   create_length(number_type number, Units) const
   {
     typedef typename traits::absolute_length_conversion_coefficient<Units, ReferenceAbsoluteUnits>::ratio ratio;
-    return static_cast<length_type>(number * reference_to_output_coeff_ * ratio::num / ratio::den );
+    return static_cast<length_type>(
+      static_cast<coefficient_type>(number) * reference_to_output_coeff_ * ratio::num / ratio::den);
   }
 
 private:
-  number_type reference_to_output_coeff_;
+  coefficient_type reference_to_output_coeff_;
 };
 
 template<class LengthType = double, class NumberType = double>
 class unitless_viewport
 {
 public:
+  typedef typename calculation_number_type<NumberType>::type coefficient_type;
+
   unitless_viewport(LengthType viewportWidth = 500, LengthType viewportHeight = 500)
   {
     set_viewport_size(viewportWidth, viewportHeight);
@@ -72,53 +77,57 @@ public:
   void set_viewport_size(LengthType width, LengthType height)
   {
     // TODO: what if one of the types is integer?
-    widthCoefficient_ = width * 0.01;
-    heightCoefficient_ = height * 0.01;
-    otherCoefficient_ = std::sqrt((width * width + height * height) / 2) * 0.01;
+    coefficient_type const percent = coefficient_type(0.01);
+    coefficient_type const w = static_cast<coefficient_type>(width), h = static_cast<coefficient_type>(height);
+    widthCoefficient_ = w * percent;
+    heightCoefficient_ = h * percent;
+    otherCoefficient_ = std::sqrt((w * w + h * h) / 2) * percent;
   }
 
   LengthType create_length(NumberType number, tag::length_units::percent, tag::length_dimension::width) const 
   {
-    return static_cast<LengthType>(widthCoefficient_ * number);
+    return static_cast<LengthType>(widthCoefficient_ * static_cast<coefficient_type>(number));
   }
 
   LengthType create_length(NumberType number, tag::length_units::percent, tag::length_dimension::height) const 
   {
-    return static_cast<LengthType>(heightCoefficient_ * number);
+    return static_cast<LengthType>(heightCoefficient_ * static_cast<coefficient_type>(number));
   }
 
   LengthType create_length(NumberType number, tag::length_units::percent, tag::length_dimension::not_width_nor_height) const 
   {
-    return static_cast<LengthType>(otherCoefficient_ * number);
+    return static_cast<LengthType>(otherCoefficient_ * static_cast<coefficient_type>(number));
   }
 
 private:
-  NumberType widthCoefficient_, heightCoefficient_, otherCoefficient_;
+  coefficient_type widthCoefficient_, heightCoefficient_, otherCoefficient_;
 };
 
 template<class LengthType = double, class NumberType = double>
 class unitless_user_units
 {
 public:
-  unitless_user_units(NumberType user_units_coefficient = 1)
+  typedef typename calculation_number_type<NumberType>::type coefficient_type;
+
+  unitless_user_units(coefficient_type user_units_coefficient = 1)
     : user_units_coefficient_(user_units_coefficient)
   {}
 
   LengthType create_length(NumberType number, tag::length_units::px) const
   {
-    return number * user_units_coefficient_;
+    return static_cast<LengthType>(static_cast<coefficient_type>(number) * user_units_coefficient_);
   }
 
   LengthType create_length(NumberType number, tag::length_units::none) const
   {
-    return number * user_units_coefficient_;
+    return static_cast<LengthType>(static_cast<coefficient_type>(number) * user_units_coefficient_);
   }
 
-  void set_user_units_coefficient(NumberType coeff) { user_units_coefficient_ = coeff; }
-  NumberType get_user_units_coefficient() const { return user_units_coefficient_; }
+  void set_user_units_coefficient(coefficient_type coeff) { user_units_coefficient_ = coeff; }
+  coefficient_type get_user_units_coefficient() const { return user_units_coefficient_; }
 
 private:
-  NumberType user_units_coefficient_;
+  coefficient_type user_units_coefficient_;
 };
 
 template<class LengthType = double, class NumberType = double, class ReferenceAbsoluteUnits = tag::length_units::mm>
@@ -132,6 +141,8 @@ public:
   using unitless_viewport<LengthType, NumberType>::create_length;
   using unitless_user_units<LengthType, NumberType>::create_length;
 
+  typedef typename calculation_number_type<NumberType>::type coefficient_type;
+
   unitless()
     : em_coefficient_(10)
     , ex_coefficient_(10)
@@ -139,44 +150,44 @@ public:
 
   LengthType create_length(NumberType number, tag::length_units::em) const
   {
-    return number * em_coefficient_;
+    return static_cast<LengthType>(static_cast<coefficient_type>(number) * em_coefficient_);
   }
 
   LengthType create_length(NumberType number, tag::length_units::ex) const
   {
-    return number * ex_coefficient_;
+    return static_cast<LengthType>(static_cast<coefficient_type>(number) * ex_coefficient_);
   }
 
-  void set_em_coefficient(NumberType coeff)
+  void set_em_coefficient(coefficient_type coeff)
   { 
     em_coefficient_ = coeff; 
   }
 
-  void set_ex_coefficient(NumberType coeff)
+  void set_ex_coefficient(coefficient_type coeff)
   { 
     ex_coefficient_ = coeff; 
   }
 
-  void set_em_coefficient(NumberType coeff, tag::length_units::px)
+  void set_em_coefficient(coefficient_type coeff, tag::length_units::px)
   {
     em_coefficient_ = this->get_user_units_coefficient() * coeff;
   }
 
-  void set_ex_coefficient(NumberType coeff, tag::length_units::px)
+  void set_ex_coefficient(coefficient_type coeff, tag::length_units::px)
   {
     ex_coefficient_ = this->get_user_units_coefficient() * coeff;
   }
 
   template<class AbsoluteUnits>
   typename boost::enable_if<boost::mpl::has_key<traits::absolute_length_units, AbsoluteUnits> >::type
-  set_em_coefficient(NumberType coeff, AbsoluteUnits unitsTag)
+  set_em_coefficient(coefficient_type coeff, AbsoluteUnits unitsTag)
   {
     em_coefficient_ = coeff * this->get_absolute_units_coefficient(unitsTag);
   }
 
   template<class AbsoluteUnits>
   typename boost::enable_if<boost::mpl::has_key<traits::absolute_length_units, AbsoluteUnits> >::type
-  set_ex_coefficient(NumberType coeff, AbsoluteUnits unitsTag)
+  set_ex_coefficient(coefficient_type coeff, AbsoluteUnits unitsTag)
   {
     ex_coefficient_ = coeff * this->get_absolute_units_coefficient(unitsTag);
   }
@@ -190,7 +201,7 @@ public:
   }
 
 private:
-  NumberType em_coefficient_, ex_coefficient_;
+  coefficient_type em_coefficient_, ex_coefficient_;
 };
 
 typedef unitless<> default_factory;
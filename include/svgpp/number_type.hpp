@@ -18,4 +18,11 @@ namespace svgpp
     typedef default_number_type type;
   };
 
+  // Type used for trigonometric and other intermediate calculations on Number values
+  template<class Number>
+  struct calculation_number_type
+  {
+    typedef Number type;
+  };
+
 }
\ No newline at end of file
@@ -9,11 +9,43 @@
 
 #include <boost/noncopyable.hpp>
 #include <boost/iterator/iterator_facade.hpp>
+#include <boost/iterator/iterator_categories.hpp>
 #include <boost/range/iterator_range.hpp>
+#include <algorithm>
+#include <cstring>
+#include <cwchar>
+#include <iterator>
 
 namespace svgpp
 {
 
+namespace detail
+{
+  template<class Iterator>
+  inline Iterator css_find_char(Iterator begin, Iterator end, char ch)
+  {
+    return std::find(begin, end, ch);
+  }
+
+  inline char const * css_find_char(char const * begin, char const * end, char ch)
+  {
+    char const * found = static_cast<char const *>(std::memchr(begin, ch, end - begin));
+    return found ? found : end;
+  }
+
+  inline char * css_find_char(char * begin, char * end, char ch)
+  {
+    char * found = static_cast<char *>(std::memchr(begin, ch, end - begin));
+    return found ? found : end;
+  }
+
+  inline wchar_t const * css_find_char(wchar_t const * begin, wchar_t const * end, char ch)
+  {
+    wchar_t const * found = std::wmemchr(begin, static_cast<wchar_t>(ch), end - begin);
+    return found ? found : end;
+  }
+}
+
 template<class IteratorT>
 class css_style_iterator:
   public boost::iterator_facade< 
@@ -46,84 +78,82 @@ public:
 private:
   friend class boost::iterator_core_access;
 
+  typedef typename css_style_iterator<IteratorT>::value_type::first_type range_type;
+
   const typename css_style_iterator<IteratorT>::value_type & dereference() const
   {
     return value_;
   }
 
+  // Declarations are split by searching ';' and ':' (memchr for character pointers),
+  // instead of checking each character
   void increment()
   {
-    for(;;)
+    while (it_ != end_)
     {
-      bool skip = false;
-      IteratorT name_begin = end_, 
-        name_end = end_; // not used, suppressing "uninitialized" warning
-      for(; it_ != end_; ++it_)
+      IteratorT const declaration_end = detail::css_find_char(it_, end_, ';');
+      IteratorT const colon = detail::css_find_char(it_, declaration_end, ':');
+      IteratorT next = declaration_end;
+      if (next != end_)
+        ++next;
+      if (colon != declaration_end)
       {
-        switch (*it_)
+        IteratorT value_begin = colon;
+        ++value_begin;
+        range_type const name = trim(it_, colon);
+        if (!boost::empty(name) 
+          && detail::css_find_char(value_begin, declaration_end, ':') == declaration_end)
         {
-        case ' ': case '\r': case '\n': case '\t': 
-          break;
-        case ';':
-          skip = true;
-          break;
-        case ':':
-          if (name_begin == end_)
-          {
-            ++it_;
-            skip = true;
-          }
-          else
+          range_type const value = trim(value_begin, declaration_end);
+          if (!boost::empty(value))
           {
-            IteratorT value_begin = end_, 
-              value_end = end_; // not used, suppressing "uninitialized" warning
-            for(++it_; it_ != end_ && !skip && *it_ != ';'; ++it_)
-              switch (*it_)
-              {
-              case ' ': case '\r': case '\n': case '\t': 
-                break;
-              case ':': 
-                skip = true;
-                break;
-              default:
-                if (value_begin == end_)
-                  value_begin = it_;
-                value_end = it_;
-              }
-            if (!skip)
-            {
-              if (value_begin != end_)
-              {
-                if (it_ != end_)
-                  ++it_;
-                value_.first  = typename css_style_iterator<IteratorT>::value_type::first_type(name_begin, ++name_end);
-                value_.second = typename css_style_iterator<IteratorT>::value_type::second_type(value_begin, ++value_end);
-                return;
-              }
-              else
-                skip = true;
-            }
+            value_.first = name;
+            value_.second = value;
+            it_ = next;
+            return;
           }
-          break;
-        default:
-          if (name_begin == end_)
-             name_begin = it_;
-          name_end = it_;
         }
-        if (skip)
-          break;
       }
-      if (skip)
+      it_ = next;
+    }
+    value_.first  = range_type(end_, end_);
+  }
+
+  static bool is_space(typename std::iterator_traits<IteratorT>::value_type ch)
+  {
+    return ch == ' ' || ch == '\r' || ch == '\n' || ch == '\t';
+  }
+
+  static range_type trim(IteratorT begin, IteratorT end)
+  {
+    return trim(begin, end, typename boost::iterator_traversal<IteratorT>::type());
+  }
+
+  static range_type trim(IteratorT begin, IteratorT end, boost::bidirectional_traversal_tag)
+  {
+    for(; begin != end && is_space(*begin); ++begin)
+      ;
+    if (begin != end)
+      for(--end; is_space(*end); --end)
+        ;
+    else
+      return range_type(end, end);
+    return range_type(begin, ++end);
+  }
+
+  static range_type trim(IteratorT begin, IteratorT end, boost::forward_traversal_tag)
+  {
+    IteratorT first = end, last = end;
+    for(; begin != end; ++begin)
+      if (!is_space(*begin))
       {
-        for(; it_ != end_ && *it_ != ';'; ++it_)
-          ;
-        if (it_ == end_ || ++it_ == end_)
-          break;
+        if (first == end)
+          first = begin;
+        last = begin;
       }
-      else
-        break;
-    }
-    value_.first  = typename css_style_iterator<IteratorT>::value_type::first_type(end_, end_);
+    if (first == end)
+      return range_type(end, end);
+    return range_type(first, ++last);
   }
 
   bool equal(const css_style_iterator & other) const
@@ -0,0 +1,153 @@
+// Copyright Oleg Maximenko 2014.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://github.com/svgpp/svgpp for library home page.
+
+#pragma once
+
+#include <svgpp/definitions.hpp>
+#include <svgpp/parser/css_style_iterator.hpp>
+#include <boost/next_prior.hpp>
+#include <boost/range.hpp>
+#include <iterator>
+
+namespace svgpp { namespace detail
+{
+
+// Parser must provide:
+//   parse_events<Number, EventsPolicy>(events_context, attribute_value) - runs grammar,
+//   record(tape, attribute_value) - runs grammar writing events to tape,
+//   replay<EventsPolicy>(tape, events_context).
+template<class ValueCachePolicy, bool Enabled = ValueCachePolicy::enabled>
+struct parse_with_value_cache
+{
+  template<class Parser, class Number, class EventsPolicy,
+    class AttributeTag, class CacheContext, class EventsContext, class AttributeValue>
+  static bool parse(AttributeTag, CacheContext &, EventsContext & events_context, AttributeValue const & attribute_value)
+  {
+    return Parser::template parse_events<Number, EventsPolicy>(events_context, attribute_value);
+  }
+};
+
+template<class ValueCachePolicy>
+struct parse_with_value_cache<ValueCachePolicy, true>
+{
+  template<class Parser, class Number, class EventsPolicy,
+    class AttributeTag, class CacheContext, class EventsContext, class AttributeValue>
+  static bool parse(AttributeTag, CacheContext & cache_context, EventsContext & events_context, AttributeValue const & attribute_value)
+  {
+    typedef typename ValueCachePolicy::cache_type cache_t;
+    typedef typename cache_t::tape_type tape_t;
+
+    cache_t * cache = ValueCachePolicy::cache(cache_context);
+    if (!cache)
+      return Parser::template parse_events<Number, EventsPolicy>(events_context, attribute_value);
+    if (tape_t const * cached = cache->find(AttributeTag::attribute_id, attribute_value))
+    {
+      Parser::template replay<EventsPolicy>(*cached, events_context);
+      return true;
+    }
+    tape_t tape;
+    // On error events preceding the error are passed as usual, but value isn't cached
+    bool const succeeded = Parser::record(tape, attribute_value);
+    Parser::template replay<EventsPolicy>(tape, events_context);
+    if (succeeded)
+      cache->insert(AttributeTag::attribute_id, attribute_value, tape);
+    return succeeded;
+  }
+};
+
+// Calls 'visitor(attribute_id, name, value)' for each declaration in 'style' attribute value,
+// stops if visitor returns false
+template<class CssNameToIdPolicy, class StringRange, class Visitor>
+bool visit_css_declarations(StringRange & style_string, Visitor & visitor)
+{
+  typedef css_style_iterator<typename boost::range_iterator<StringRange>::type> css_iterator;
+  for(css_iterator it(boost::begin(style_string), boost::end(style_string)); !it.eof(); ++it)
+    if (!visitor(CssNameToIdPolicy::find(it->first), it->first, it->second))
+      return false;
+  return true;
+}
+
+template<class Declarations, class Visitor, class Iterator>
+class css_declarations_recorder
+{
+public:
+  css_declarations_recorder(Declarations & declarations, Visitor & visitor, Iterator begin)
+    : declarations_(declarations)
+    , visitor_(visitor)
+    , begin_(begin)
+  {}
+
+  template<class Range>
+  bool operator()(attribute_id id, Range const & name, Range const & value)
+  {
+    typename Declarations::value_type declaration;
+    declaration.id = id;
+    declaration.name_begin = std::distance(begin_, boost::begin(name));
+    declaration.name_end = declaration.name_begin + boost::size(name);
+    declaration.value_begin = std::distance(begin_, boost::begin(value));
+    declaration.value_end = declaration.value_begin + boost::size(value);
+    declarations_.push_back(declaration);
+    return visitor_(id, name, value);
+  }
+
+private:
+  Declarations & declarations_;
+  Visitor & visitor_;
+  Iterator const begin_;
+};
+
+template<class ValueCachePolicy, bool Enabled = ValueCachePolicy::enabled>
+struct load_css_declarations_with_value_cache
+{
+  template<class CssNameToIdPolicy, class CacheContext, class StringRange, class Visitor>
+  static bool load(CacheContext &, StringRange & style_string, Visitor & visitor)
+  {
+    return visit_css_declarations<CssNameToIdPolicy>(style_string, visitor);
+  }
+};
+
+// Cached are name to id lookup results and boundaries of declarations. Values are passed as
+// substrings of 'style_string' so that error reporting and lifetime of values are the same
+// as without cache
+template<class ValueCachePolicy>
+struct load_css_declarations_with_value_cache<ValueCachePolicy, true>
+{
+  template<class CssNameToIdPolicy, class CacheContext, class StringRange, class Visitor>
+  static bool load(CacheContext & cache_context, StringRange & style_string, Visitor & visitor)
+  {
+    typedef typename ValueCachePolicy::cache_type cache_t;
+    typedef typename cache_t::css_declarations_type declarations_t;
+    typedef typename boost::range_iterator<StringRange>::type iterator_t;
+    typedef boost::iterator_range<iterator_t> range_t;
+
+    cache_t * cache = ValueCachePolicy::cache(cache_context);
+    if (!cache)
+      return visit_css_declarations<CssNameToIdPolicy>(style_string, visitor);
+    iterator_t const begin = boost::begin(style_string);
+    if (declarations_t const * cached = cache->find_css_declarations(style_string))
+    {
+      for(typename declarations_t::const_iterator it = cached->begin(); it != cached->end(); ++it)
+      {
+        iterator_t const name_begin = boost::next(begin, it->name_begin);
+        iterator_t const value_begin = boost::next(begin, it->value_begin);
+        if (!visitor(it->id, 
+          range_t(name_begin, boost::next(name_begin, it->name_end - it->name_begin)),
+          range_t(value_begin, boost::next(value_begin, it->value_end - it->value_begin))))
+          return false;
+      }
+      return true;
+    }
+    declarations_t declarations;
+    css_declarations_recorder<declarations_t, Visitor, iterator_t> recorder(declarations, visitor, begin);
+    if (!visit_css_declarations<CssNameToIdPolicy>(style_string, recorder))
+      return false;
+    cache->insert_css_declarations(style_string, declarations);
+    return true;
+  }
+};
+
+}}
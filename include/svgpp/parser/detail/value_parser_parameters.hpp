@@ -21,6 +21,7 @@ private:
   typedef typename boost::parameter::parameters<
       boost::parameter::optional<tag::number_type>
     , boost::parameter::optional<tag::error_policy>
+    , boost::parameter::optional<tag::value_cache_policy>
   >::template bind<SVGPP_TEMPLATE_ARGS_PASS>::type args;
 
 public:
@@ -31,6 +32,9 @@ public:
 
   typedef typename detail::unwrap_context<Context, tag::error_policy> error_policy_context;
   typedef typename error_policy_context::template bind<args>::type error_policy;
+
+  typedef typename detail::unwrap_context<Context, tag::value_cache_policy> value_cache_context;
+  typedef typename value_cache_context::template bind<args>::type value_cache_policy;
 };
 
 }}
\ No newline at end of file
@@ -11,7 +11,9 @@
 #include <svgpp/definitions.hpp>
 #include <svgpp/adapter/path_markers.hpp>
 #include <svgpp/parser/value_parser_fwd.hpp>
+#include <svgpp/parser/detail/value_cache.hpp>
 #include <svgpp/parser/detail/value_parser_parameters.hpp>
+#include <svgpp/policy/path_events.hpp>
 #if defined(SVGPP_USE_EXTERNAL_PATH_DATA_PARSER)
 # include <svgpp/parser/external_function/parse_path_data.hpp>
 # include <svgpp/parser/external_function/path_events_interface_proxy.hpp>
@@ -29,11 +31,8 @@ struct value_parser<tag::type::path_data, SVGPP_TEMPLATE_ARGS_PASS>
   static bool parse(AttributeTag tag, Context & context, AttributeValue const & attribute_value, 
                                     tag::source::attribute)
   {
-    namespace qi = boost::spirit::qi;
-
     typedef detail::value_parser_parameters<Context, SVGPP_TEMPLATE_ARGS_PASS> args_t;
     typedef typename args_t::number_type coordinate_t;
-    typedef typename boost::range_const_iterator<AttributeValue>::type iterator_t;
 
     typedef typename boost::parameter::parameters<
       boost::parameter::optional<tag::path_events_policy>
@@ -41,35 +40,18 @@ struct value_parser<tag::type::path_data, SVGPP_TEMPLATE_ARGS_PASS>
     typedef detail::bind_context_parameters_wrapper<Context, args2_t> context_t;
     typedef typename detail::unwrap_context<context_t, tag::path_events_policy> path_events_context;
     typedef detail::path_adapter_if_needed<context_t> adapted_context_t; 
+    typedef detail::unwrap_context<typename adapted_context_t::adapted_context, tag::path_events_policy> 
+      adapted_path_events_context;
 
     context_t bound_context(context);
     typename adapted_context_t::type path_adapter(path_events_context::get(bound_context));
     typename adapted_context_t::adapted_context_holder adapted_path_context(adapted_context_t::adapt_context(bound_context, path_adapter));
-    iterator_t it = boost::begin(attribute_value), end = boost::end(attribute_value);
-#if defined(SVGPP_USE_EXTERNAL_PATH_DATA_PARSER)
-    detail::path_events_interface_proxy<
-      typename detail::unwrap_context<typename adapted_context_t::adapted_context, tag::path_events_policy>::type,
-      coordinate_t,
-      typename detail::unwrap_context<typename adapted_context_t::adapted_context, tag::path_events_policy>::policy
-    > events_interface_proxy(
-      detail::unwrap_context<typename adapted_context_t::adapted_context, tag::path_events_policy>::get(
-          adapted_path_context));
-    if (detail::parse_path_data<iterator_t, coordinate_t>(it, end, events_interface_proxy)
-      && it == end)
-#else
-    typedef path_data_grammar<
-      iterator_t, 
-      typename detail::unwrap_context<typename adapted_context_t::adapted_context, tag::path_events_policy>::type,
-      coordinate_t,
-      typename detail::unwrap_context<typename adapted_context_t::adapted_context, tag::path_events_policy>::policy
-    > path_data_grammar;
-    SVGPP_STATIC_IF_SAFE const path_data_grammar grammar;
-    if (qi::phrase_parse(it, end, grammar(boost::phoenix::ref(
-        detail::unwrap_context<typename adapted_context_t::adapted_context, tag::path_events_policy>::get(
-          adapted_path_context))), 
-        typename path_data_grammar::skipper_type()) 
-      && it == end)
-#endif
+    if (detail::parse_with_value_cache<typename args_t::value_cache_policy>::template parse<
+          value_parser, coordinate_t, typename adapted_path_events_context::policy>(
+        tag, 
+        args_t::value_cache_context::get(context), 
+        adapted_path_events_context::get(adapted_path_context), 
+        attribute_value))
     {
       return true;
     }
@@ -78,6 +60,39 @@ struct value_parser<tag::type::path_data, SVGPP_TEMPLATE_ARGS_PASS>
       return args_t::error_policy::parse_failed(args_t::error_policy_context::get(context), tag, attribute_value);
     }
   }
+
+  template<class Coordinate, class EventsPolicy, class EventsContext, class AttributeValue>
+  static bool parse_events(EventsContext & events_context, AttributeValue const & attribute_value)
+  {
+    namespace qi = boost::spirit::qi;
+
+    typedef typename boost::range_const_iterator<AttributeValue>::type iterator_t;
+
+    iterator_t it = boost::begin(attribute_value), end = boost::end(attribute_value);
+#if defined(SVGPP_USE_EXTERNAL_PATH_DATA_PARSER)
+    detail::path_events_interface_proxy<EventsContext, Coordinate, EventsPolicy> events_interface_proxy(events_context);
+    return detail::parse_path_data<iterator_t, Coordinate>(it, end, events_interface_proxy)
+      && it == end;
+#else
+    typedef path_data_grammar<iterator_t, EventsContext, Coordinate, EventsPolicy> path_data_grammar;
+    SVGPP_STATIC_IF_SAFE const path_data_grammar grammar;
+    return qi::phrase_parse(it, end, grammar(boost::phoenix::ref(events_context)), 
+        typename path_data_grammar::skipper_type()) 
+      && it == end;
+#endif
+  }
+
+  template<class Tape, class AttributeValue>
+  static bool record(Tape & tape, AttributeValue const & attribute_value)
+  {
+    return parse_events<typename Tape::number_type, policy::path_events::forward_to_method<Tape> >(tape, attribute_value);
+  }
+
+  template<class EventsPolicy, class Tape, class EventsContext>
+  static void replay(Tape const & tape, EventsContext & events_context)
+  {
+    tape.template replay_path<EventsPolicy>(events_context);
+  }
 };
 
 }
\ No newline at end of file
@@ -11,7 +11,9 @@
 #include <svgpp/definitions.hpp>
 #include <svgpp/adapter/transform.hpp>
 #include <svgpp/parser/value_parser_fwd.hpp>
+#include <svgpp/parser/detail/value_cache.hpp>
 #include <svgpp/parser/detail/value_parser_parameters.hpp>
+#include <svgpp/policy/transform_events.hpp>
 #if defined(SVGPP_USE_EXTERNAL_TRANSFORM_PARSER)
 # include <svgpp/parser/external_function/parse_transform.hpp>
 # include <svgpp/parser/external_function/transform_events_interface_proxy.hpp>
@@ -30,7 +32,6 @@ struct value_parser<tag::type::transform_list, SVGPP_TEMPLATE_ARGS_PASS>
                                     tag::source::attribute)
   {
     typedef detail::value_parser_parameters<Context, SVGPP_TEMPLATE_ARGS_PASS> args_t;
-    typedef typename boost::range_const_iterator<AttributeValue>::type iterator_t;
     typedef typename boost::parameter::parameters<
       boost::parameter::optional<tag::transform_events_policy>
     >::template bind<SVGPP_TEMPLATE_ARGS_PASS>::type args2_t;
@@ -38,40 +39,22 @@ struct value_parser<tag::type::transform_list, SVGPP_TEMPLATE_ARGS_PASS>
     typedef typename detail::unwrap_context<context_t, tag::transform_events_policy> transform_events_context;
     typedef typename transform_events_context::policy transform_events_policy;
     typedef detail::transform_adapter_if_needed<context_t> adapted_context_t; 
-    typedef 
-      typename detail::unwrap_context<typename adapted_context_t::adapted_context, tag::transform_events_policy>::policy
-        adapted_transform_events_policy;
+    typedef detail::unwrap_context<typename adapted_context_t::adapted_context, tag::transform_events_policy>
+      adapted_transform_events_context;
+    typedef typename adapted_transform_events_context::policy adapted_transform_events_policy;
 
     context_t bound_context(context);
     typename adapted_context_t::type transform_adapter(transform_events_context::get(bound_context));
     typename adapted_context_t::adapted_context_holder adapted_transform_context(adapted_context_t::adapt_context(bound_context, transform_adapter));
+    typename adapted_transform_events_policy::context_type & events_context = 
+      adapted_transform_events_context::get(adapted_transform_context);
     
-    iterator_t it = boost::begin(attribute_value), end = boost::end(attribute_value);
-#if defined(SVGPP_USE_EXTERNAL_TRANSFORM_PARSER)
-    detail::transform_events_interface_proxy<
-      typename adapted_transform_events_policy::context_type,
-      typename args_t::number_type,
-      adapted_transform_events_policy
-    > events_interface_proxy(
-      detail::unwrap_context<typename adapted_context_t::adapted_context, tag::transform_events_policy>::get(
-        adapted_transform_context));
-    if (detail::parse_transform<iterator_t, typename args_t::number_type>(it, end, events_interface_proxy)
-      && it == end)
-#else
-    typedef transform_grammar<
-      iterator_t, 
-      typename adapted_transform_events_policy::context_type,
-      typename args_t::number_type,
-      adapted_transform_events_policy
-    > transform_grammar_t;
-    SVGPP_STATIC_IF_SAFE const transform_grammar_t grammar;
-    if (boost::spirit::qi::phrase_parse(it, end, 
-        grammar(boost::phoenix::ref(
-          detail::unwrap_context<typename adapted_context_t::adapted_context, tag::transform_events_policy>::get(
-            adapted_transform_context))), 
-        typename transform_grammar_t::skipper_type()) 
-      && it == end)
-#endif
+    if (detail::parse_with_value_cache<typename args_t::value_cache_policy>::template parse<
+          value_parser, typename args_t::number_type, adapted_transform_events_policy>(
+        tag, 
+        args_t::value_cache_context::get(context), 
+        events_context, 
+        attribute_value))
     {
       adapted_context_t::on_exit_attribute(transform_adapter);
       return true;
@@ -81,6 +64,38 @@ struct value_parser<tag::type::transform_list, SVGPP_TEMPLATE_ARGS_PASS>
       return args_t::error_policy::parse_failed(args_t::error_policy_context::get(context), tag, attribute_value);
     }
   }
+
+  template<class Number, class EventsPolicy, class EventsContext, class AttributeValue>
+  static bool parse_events(EventsContext & events_context, AttributeValue const & attribute_value)
+  {
+    typedef typename boost::range_const_iterator<AttributeValue>::type iterator_t;
+
+    iterator_t it = boost::begin(attribute_value), end = boost::end(attribute_value);
+#if defined(SVGPP_USE_EXTERNAL_TRANSFORM_PARSER)
+    detail::transform_events_interface_proxy<EventsContext, Number, EventsPolicy> events_interface_proxy(events_context);
+    return detail::parse_transform<iterator_t, Number>(it, end, events_interface_proxy)
+      && it == end;
+#else
+    typedef transform_grammar<iterator_t, EventsContext, Number, EventsPolicy> transform_grammar_t;
+    SVGPP_STATIC_IF_SAFE const transform_grammar_t grammar;
+    return boost::spirit::qi::phrase_parse(it, end, 
+        grammar(boost::phoenix::ref(events_context)), 
+        typename transform_grammar_t::skipper_type()) 
+      && it == end;
+#endif
+  }
+
+  template<class Tape, class AttributeValue>
+  static bool record(Tape & tape, AttributeValue const & attribute_value)
+  {
+    return parse_events<typename Tape::number_type, policy::transform_events::forward_to_method<Tape> >(tape, attribute_value);
+  }
+
+  template<class EventsPolicy, class Tape, class EventsContext>
+  static void replay(Tape const & tape, EventsContext & events_context)
+  {
+    tape.template replay_transform<EventsPolicy>(events_context);
+  }
 };
 
 }
\ No newline at end of file
@@ -37,6 +37,25 @@ struct all_to_path
   static const bool convert_only_rounded_rect_to_path = false;
 };
 
+// Plain rectangles, circles, ellipses and lines are passed to Basic Shapes Events Policy
+// (e.g. instance_of_unit_shape), rounded rectangles, polylines and polygons are converted to path
+struct instance_shapes
+{
+  typedef boost::mpl::set3<
+    tag::element::rect,
+    tag::element::polyline,
+    tag::element::polygon
+  > convert_to_path;
+
+  typedef boost::mpl::set3<
+    tag::element::line,
+    tag::element::circle,
+    tag::element::ellipse
+  > collect_attributes;
+
+  static const bool convert_only_rounded_rect_to_path = true;
+};
+
 typedef all_to_path default_policy;
 
 template<class Context>
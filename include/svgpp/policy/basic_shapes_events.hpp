@@ -7,6 +7,9 @@
 
 #pragma once
 
+#include <svgpp/definitions.hpp>
+#include <boost/array.hpp>
+
 namespace svgpp { namespace policy { namespace basic_shapes_events
 {
 
@@ -45,6 +48,57 @@ struct forward_to_method
   }
 };
 
+// Passes shapes as instances of unit_shape_outline (svgpp/utility/unit_shape_outline.hpp) with
+// transform matrix that maps the outline to user coordinates:
+//   context.set_unit_shape_instance(tag::element::circle(), matrix)  - for circles, unit_shape_outline::circle()
+//   context.set_unit_shape_instance(tag::element::ellipse(), matrix) - for ellipses, unit_shape_outline::circle()
+//   context.set_unit_shape_instance(tag::element::rect(), matrix)    - for rectangles, unit_shape_outline::square()
+//   context.set_unit_shape_instance(tag::element::line(), matrix)    - for lines, unit_shape_outline::line()
+// Rounded rectangles can't be instanced and are passed to context.set_rect(x, y, width, height, rx, ry)
+template<class Context>
+struct instance_of_unit_shape
+{
+  template<class Coordinate>
+  static void set_rect(Context & context, Coordinate x, Coordinate y, Coordinate width, Coordinate height,
+    Coordinate rx, Coordinate ry)
+  {
+    if (rx == 0 || ry == 0)
+      set_rect(context, x, y, width, height);
+    else
+      context.set_rect(x, y, width, height, rx, ry);
+  }
+
+  template<class Coordinate>
+  static void set_rect(Context & context, Coordinate x, Coordinate y, Coordinate width, Coordinate height)
+  {
+    boost::array<Coordinate, 6> const matrix = {{ width, 0, 0, height, x, y }};
+    context.set_unit_shape_instance(tag::element::rect(), matrix);
+  }
+
+  template<class Coordinate>
+  static void set_line(Context & context, Coordinate x1, Coordinate y1, Coordinate x2, Coordinate y2)
+  {
+    // Rotation and uniform scale, so that matrix is invertible
+    Coordinate const dx = x2 - x1, dy = y2 - y1;
+    boost::array<Coordinate, 6> const matrix = {{ dx, dy, -dy, dx, x1, y1 }};
+    context.set_unit_shape_instance(tag::element::line(), matrix);
+  }
+
+  template<class Coordinate>
+  static void set_circle(Context & context, Coordinate cx, Coordinate cy, Coordinate r)
+  {
+    boost::array<Coordinate, 6> const matrix = {{ r, 0, 0, r, cx, cy }};
+    context.set_unit_shape_instance(tag::element::circle(), matrix);
+  }
+
+  template<class Coordinate>
+  static void set_ellipse(Context & context, Coordinate cx, Coordinate cy, Coordinate rx, Coordinate ry)
+  {
+    boost::array<Coordinate, 6> const matrix = {{ rx, 0, 0, ry, cx, cy }};
+    context.set_unit_shape_instance(tag::element::ellipse(), matrix);
+  }
+};
+
 template<class Context>
 struct default_policy: forward_to_method<Context>
 {};
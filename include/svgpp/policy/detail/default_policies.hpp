@@ -23,6 +23,7 @@
 #include <svgpp/policy/marker_events.hpp>
 #include <svgpp/policy/path.hpp>
 #include <svgpp/policy/transform.hpp>
+#include <svgpp/policy/value_cache.hpp>
 #include <svgpp/template_parameters.hpp>
 
 namespace svgpp { namespace detail 
@@ -109,6 +110,12 @@ struct get_default_policy<Context, tag::transform_events_policy>
   typedef policy::transform_events::default_policy<Context> type;
 };
 
+template<class Context>
+struct get_default_policy<Context, tag::value_cache_policy>
+{
+  typedef typename policy::value_cache::by_context<Context>::type type;
+};
+
 template<class Context>
 struct get_default_policy<Context, tag::angle_factory>
 {
@@ -11,7 +11,18 @@
 #include <boost/config.hpp>
 #include <boost/math/constants/constants.hpp>
 
-namespace svgpp { namespace policy 
+namespace svgpp 
+{
+  
+// Directions of path segments coming into and out of the marker vertex. 
+// Vectors aren't normalized, angle of the marker is the angle of bisector of in and out directions
+template<class Number>
+struct marker_tangents
+{
+  Number in_x, in_y, out_x, out_y;
+};
+
+namespace policy 
 { 
   
 namespace marker_directionality
@@ -30,12 +41,12 @@ struct radians
   template<class Coordinate>
   static directionality_type segment_directionality(Coordinate dx, Coordinate dy)
   {
-    return std::atan2(dy, dx);
+    return std::atan2(static_cast<directionality_type>(dy), static_cast<directionality_type>(dx));
   }
 
   static directionality_type bisector_directionality(directionality_type in_segment, directionality_type out_segment)
   {
-    directionality_type dir = (in_segment + out_segment) * 0.5;
+    directionality_type dir = (in_segment + out_segment) * directionality_type(0.5);
     if (std::fabs(in_segment - out_segment) > boost::math::constants::pi<directionality_type>())
     {
       if (dir < 0)
@@ -47,6 +58,34 @@ struct radians
   }
 };
 
+// Doesn't use trigonometric functions or square root, 
+// normalization and angle calculation is left to the user code (see svgpp::marker_batch)
+template<class Number = double>
+struct tangents
+{
+  typedef marker_tangents<Number> directionality_type;
+
+  static directionality_type undetermined_directionality()
+  {
+    directionality_type result = { 1, 0, 1, 0 };
+    return result;
+  }
+
+  template<class Coordinate>
+  static directionality_type segment_directionality(Coordinate dx, Coordinate dy)
+  {
+    directionality_type result = { 
+      static_cast<Number>(dx), static_cast<Number>(dy), static_cast<Number>(dx), static_cast<Number>(dy) };
+    return result;
+  }
+
+  static directionality_type bisector_directionality(directionality_type const & in_segment, directionality_type const & out_segment)
+  {
+    directionality_type result = { in_segment.out_x, in_segment.out_y, out_segment.in_x, out_segment.in_y };
+    return result;
+  }
+};
+
 } // namespace marker_directionality
 
 namespace markers
@@ -68,6 +107,14 @@ struct calculate_always
   static const bool always_calculate_auto_orient = true; // Doesn't call marker_get_config if true
 };
 
+struct calculate_tangents
+{
+  typedef marker_directionality::tangents<> directionality_policy;
+
+  static const bool calculate_markers = true;
+  static const bool always_calculate_auto_orient = false; // Doesn't call marker_get_config if true
+};
+
 struct raw
 {
   static const bool calculate_markers = false;
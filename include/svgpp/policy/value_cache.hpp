@@ -0,0 +1,41 @@
+// Copyright Oleg Maximenko 2014.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://github.com/svgpp/svgpp for library home page.
+
+#pragma once
+
+namespace svgpp { namespace policy { namespace value_cache
+{
+
+struct disabled
+{
+  static const bool enabled = false;
+};
+
+// Cache object (usually svgpp::value_cache<>) is owned by context. Its scope
+// (per document, per thread etc.) is defined by the owner.
+// Context::value_cache() may return NULL to disable caching at runtime.
+template<class Context, class Cache = typename Context::value_cache_type>
+struct forward_to_method
+{
+  static const bool enabled = true;
+  typedef Cache cache_type;
+
+  static cache_type * cache(Context & context)
+  {
+    return context.value_cache();
+  }
+};
+
+typedef disabled default_policy;
+
+template<class Context>
+struct by_context
+{
+  typedef default_policy type;
+};
+
+}}}
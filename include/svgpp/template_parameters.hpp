@@ -74,5 +74,6 @@ BOOST_PARAMETER_TEMPLATE_KEYWORD(markers_policy)
 BOOST_PARAMETER_TEMPLATE_KEYWORD(number_type)
 BOOST_PARAMETER_TEMPLATE_KEYWORD(path_policy)
 BOOST_PARAMETER_TEMPLATE_KEYWORD(transform_policy)
+BOOST_PARAMETER_TEMPLATE_KEYWORD(value_cache_policy)
 
 }
\ No newline at end of file
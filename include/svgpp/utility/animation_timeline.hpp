@@ -0,0 +1,847 @@
+// Copyright Oleg Maximenko 2014.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://github.com/svgpp/svgpp for library home page.
+
+#pragma once
+
+#include <svgpp/config.hpp>
+#include <svgpp/definitions.hpp>
+#include <svgpp/factory/integer_color.hpp>
+#include <svgpp/parser/detail/common.hpp>
+#include <svgpp/parser/grammar/clock_value.hpp>
+#include <svgpp/parser/grammar/color.hpp>
+#include <boost/array.hpp>
+#include <boost/optional.hpp>
+#include <boost/range.hpp>
+#include <boost/spirit/include/qi.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <limits>
+#include <locale>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace svgpp
+{
+
+enum animation_element
+{
+  animation_animate,
+  animation_set,
+  animation_animate_color,
+  animation_animate_transform,
+  animation_animate_motion
+};
+
+enum animation_calc_mode
+{
+  animation_calc_mode_discrete,
+  animation_calc_mode_linear,
+  animation_calc_mode_paced,
+  animation_calc_mode_spline
+};
+
+enum animation_restart
+{
+  animation_restart_always,
+  animation_restart_when_not_active,
+  animation_restart_never
+};
+
+// Timing and values of one animation element. Times are in seconds from document begin
+template<class Number = double>
+struct animation_definition
+{
+  animation_definition(animation_element e = animation_animate)
+    : element(e)
+    , begin(1, Number(0))
+    , freeze(false)
+    , restart(animation_restart_always)
+    , additive_sum(false)
+    , accumulate_sum(false)
+  {}
+
+  animation_element element;
+  std::string target_id;
+  std::string attribute_name;
+  // Value of 'type' attribute of animateTransform: "translate", "scale", "rotate", "skewX" or "skewY"
+  std::string transform_type;
+  // Each offset value of 'begin' starts new interval (unless 'restart' prevents it), that ends
+  // the previous one. Default is single interval starting at 0
+  std::vector<Number> begin, end;
+  // Not set if 'dur' is missing, "indefinite" or "media"
+  boost::optional<Number> dur;
+  // Infinity if "indefinite"
+  boost::optional<Number> repeat_count, repeat_dur;
+  bool freeze;
+  animation_restart restart;
+  boost::optional<animation_calc_mode> calc_mode;
+  bool additive_sum, accumulate_sum;
+  boost::optional<std::string> from, to, by;
+  std::vector<std::string> values;
+  std::vector<Number> key_times;
+  std::vector<boost::array<Number, 4> > key_splines;
+};
+
+namespace detail
+{
+  template<class Range>
+  void split_animation_list(Range const & range, std::vector<std::string> & items)
+  {
+    items.clear();
+    std::string const str(boost::begin(range), boost::end(range));
+    std::string::size_type pos = 0;
+    for(;;)
+    {
+      std::string::size_type const separator = str.find(';', pos);
+      std::string::size_type const item_end = separator == std::string::npos ? str.size() : separator;
+      std::string::size_type const first = str.find_first_not_of(" \t\r\n", pos);
+      if (first != std::string::npos && first < item_end)
+      {
+        std::string::size_type const last = str.find_last_not_of(" \t\r\n", item_end - 1);
+        items.push_back(str.substr(first, last + 1 - first));
+      }
+      if (separator == std::string::npos)
+        break;
+      pos = separator + 1;
+    }
+  }
+
+  template<class Number>
+  bool parse_animation_numbers(std::string const & str, Number * numbers, std::size_t count)
+  {
+    namespace qi = boost::spirit::qi;
+    typedef std::string::const_iterator iterator_t;
+    SVGPP_STATIC_IF_SAFE const qi::real_parser<Number, detail::number_policies<Number, tag::source::attribute> > number;
+    SVGPP_STATIC_IF_SAFE const detail::comma_wsp_rule<iterator_t> comma_wsp;
+    iterator_t it = str.begin(), end = str.end();
+    for(std::size_t i = 0; i < count; ++i)
+    {
+      if (i > 0)
+        qi::parse(it, end, comma_wsp);
+      if (!qi::parse(it, end, number, numbers[i]))
+        return false;
+    }
+    return it == end;
+  }
+}
+
+// Receives attributes of animation elements from document_traversal and fills animation_definition.
+// begin, end, keyTimes, keySplines, values, from, to and by attributes must be passed as strings
+// (e.g. included in passthrough_attributes). Only offset values of begin and end are supported,
+// syncbase, event, repeat, accessKey and wallclock values are ignored
+template<class Number = double>
+class collect_animation_attributes
+{
+public:
+  typedef animation_definition<Number> definition_type;
+
+  collect_animation_attributes(animation_element element, std::string const & parent_id)
+    : definition_(element)
+  {
+    definition_.target_id = parent_id;
+    if (element == animation_animate_transform || element == animation_animate_motion)
+      definition_.attribute_name = "transform";
+  }
+
+  definition_type const & definition() const { return definition_; }
+
+  template<class StringRange>
+  void set(tag::attribute::xlink::href, tag::iri_fragment, StringRange const & fragment)
+  {
+    definition_.target_id.assign(boost::begin(fragment), boost::end(fragment));
+  }
+
+  template<class StringRange>
+  void set(tag::attribute::xlink::href, StringRange const &) {}
+
+  template<class StringRange>
+  void set(tag::attribute::attributeName, StringRange const & range)
+  {
+    definition_.attribute_name.assign(boost::begin(range), boost::end(range));
+  }
+
+  void set(tag::attribute::attributeType, tag::value::CSS) {}
+  void set(tag::attribute::attributeType, tag::value::XML) {}
+  void set(tag::attribute::attributeType, tag::value::auto_) {}
+
+  void set(tag::attribute::type, tag::value::translate) { definition_.transform_type = "translate"; }
+  void set(tag::attribute::type, tag::value::scale)     { definition_.transform_type = "scale"; }
+  void set(tag::attribute::type, tag::value::rotate)    { definition_.transform_type = "rotate"; }
+  void set(tag::attribute::type, tag::value::skewX)     { definition_.transform_type = "skewX"; }
+  void set(tag::attribute::type, tag::value::skewY)     { definition_.transform_type = "skewY"; }
+
+  void set(tag::attribute::dur, tag::value::media) {}
+  void set(tag::attribute::dur, tag::value::indefinite) {}
+  void set(tag::attribute::dur, Number clock_seconds)
+  {
+    if (clock_seconds > 0)
+      definition_.dur = clock_seconds;
+  }
+
+  void set(tag::attribute::repeatDur, tag::value::indefinite) { definition_.repeat_dur = infinity(); }
+  void set(tag::attribute::repeatDur, Number clock_seconds) { definition_.repeat_dur = clock_seconds; }
+
+  void set(tag::attribute::repeatCount, tag::value::indefinite) { definition_.repeat_count = infinity(); }
+  void set(tag::attribute::repeatCount, Number number)
+  {
+    if (number > 0)
+      definition_.repeat_count = number;
+  }
+
+  void set(tag::attribute::min, tag::value::media) {}
+  void set(tag::attribute::min, Number) {}
+  void set(tag::attribute::max, tag::value::media) {}
+  void set(tag::attribute::max, Number) {}
+
+  void set(tag::attribute::restart, tag::value::always)        { definition_.restart = animation_restart_always; }
+  void set(tag::attribute::restart, tag::value::whenNotActive) { definition_.restart = animation_restart_when_not_active; }
+  void set(tag::attribute::restart, tag::value::never)         { definition_.restart = animation_restart_never; }
+
+  void set(tag::attribute::fill, tag::value::freeze) { definition_.freeze = true; }
+  void set(tag::attribute::fill, tag::value::remove) { definition_.freeze = false; }
+
+  void set(tag::attribute::calcMode, tag::value::discrete) { definition_.calc_mode = animation_calc_mode_discrete; }
+  void set(tag::attribute::calcMode, tag::value::linear)   { definition_.calc_mode = animation_calc_mode_linear; }
+  void set(tag::attribute::calcMode, tag::value::paced)    { definition_.calc_mode = animation_calc_mode_paced; }
+  void set(tag::attribute::calcMode, tag::value::spline)   { definition_.calc_mode = animation_calc_mode_spline; }
+
+  void set(tag::attribute::additive, tag::value::replace) { definition_.additive_sum = false; }
+  void set(tag::attribute::additive, tag::value::sum)     { definition_.additive_sum = true; }
+
+  void set(tag::attribute::accumulate, tag::value::none) { definition_.accumulate_sum = false; }
+  void set(tag::attribute::accumulate, tag::value::sum)  { definition_.accumulate_sum = true; }
+
+  template<class StringRange>
+  void set(tag::attribute::begin, StringRange const & range) { parse_time_list(range, definition_.begin); }
+  template<class StringRange>
+  void set(tag::attribute::end, StringRange const & range) { parse_time_list(range, definition_.end); }
+
+  template<class StringRange>
+  void set(tag::attribute::values, StringRange const & range)
+  {
+    detail::split_animation_list(range, definition_.values);
+  }
+
+  template<class StringRange>
+  void set(tag::attribute::keyTimes, StringRange const & range)
+  {
+    std::vector<std::string> items;
+    detail::split_animation_list(range, items);
+    definition_.key_times.resize(items.size());
+    for(std::size_t i = 0; i < items.size(); ++i)
+      if (!detail::parse_animation_numbers(items[i], &definition_.key_times[i], 1))
+      {
+        definition_.key_times.clear();
+        return;
+      }
+  }
+
+  template<class StringRange>
+  void set(tag::attribute::keySplines, StringRange const & range)
+  {
+    std::vector<std::string> items;
+    detail::split_animation_list(range, items);
+    definition_.key_splines.resize(items.size());
+    for(std::size_t i = 0; i < items.size(); ++i)
+      if (!detail::parse_animation_numbers(items[i], definition_.key_splines[i].data(), 4))
+      {
+        definition_.key_splines.clear();
+        return;
+      }
+  }
+
+  template<class StringRange>
+  void set(tag::attribute::from, StringRange const & range) { definition_.from = std::string(boost::begin(range), boost::end(range)); }
+  template<class StringRange>
+  void set(tag::attribute::to, StringRange const & range) { definition_.to = std::string(boost::begin(range), boost::end(range)); }
+  template<class StringRange>
+  void set(tag::attribute::by, StringRange const & range) { definition_.by = std::string(boost::begin(range), boost::end(range)); }
+
+private:
+  definition_type definition_;
+
+  static Number infinity() { return std::numeric_limits<Number>::infinity(); }
+
+  template<class StringRange>
+  static void parse_time_list(StringRange const & range, std::vector<Number> & times)
+  {
+    namespace qi = boost::spirit::qi;
+    typedef std::string::const_iterator iterator_t;
+    SVGPP_STATIC_IF_SAFE const clock_value_grammar<iterator_t, Number> clock_value;
+
+    std::vector<std::string> items;
+    detail::split_animation_list(range, items);
+    times.clear();
+    for(std::vector<std::string>::const_iterator item = items.begin(); item != items.end(); ++item)
+    {
+      iterator_t it = item->begin(), end = item->end();
+      char sign = '+';
+      if (qi::parse(it, end, qi::char_("+-"), sign))
+        qi::parse(it, end, *detail::character_encoding_namespace::space);
+      Number offset;
+      if (qi::parse(it, end, clock_value, offset) && it == end)
+        times.push_back(sign == '-' ? -offset : offset);
+    }
+    std::sort(times.begin(), times.end());
+  }
+};
+
+// Animated value of attribute at some moment
+struct animated_attribute
+{
+  std::string const * target_id;
+  std::string const * attribute_name;
+  std::string value;
+  // If true, value must be added to the underlying value of the attribute
+  // (for transform - appended to the transform list), otherwise it replaces underlying value
+  bool additive;
+};
+
+// Stores animation intervals sorted by begin time in implicit balanced tree, augmented
+// with maximum interval end in each subtree. evaluate() visits only active intervals
+// and O(log n) others. Values are split to numbers and text on add(), so evaluation
+// only interpolates numbers and formats the result
+template<class Number = double>
+class animation_timeline
+{
+public:
+  typedef animation_definition<Number> definition_type;
+
+  animation_timeline()
+    : tree_built_(true)
+  {}
+
+  void add(definition_type const & definition)
+  {
+    animation a;
+    if (!prepare(definition, a))
+      return;
+    std::size_t const animation_index = animations_.size();
+    animations_.push_back(a);
+
+    std::size_t const first_interval = intervals_.size();
+    // Begin times are sorted
+    for(typename std::vector<Number>::const_iterator b = definition.begin.begin(); b != definition.begin.end(); ++b)
+    {
+      if (intervals_.size() > first_interval)
+      {
+        // At most one interval of the animation is active or frozen at any time
+        interval & previous = intervals_.back();
+        if (*b == previous.begin || definition.restart == animation_restart_never)
+          continue;
+        if (definition.restart == animation_restart_when_not_active && *b < previous.active_end)
+          continue;
+        previous.active_end = std::min(previous.active_end, *b);
+        previous.end = std::min(previous.end, *b);
+      }
+      interval i;
+      i.begin = *b;
+      i.active_end = i.begin + a.active_duration;
+      // End instance that is before begin doesn't end the interval
+      typename std::vector<Number>::const_iterator e =
+        std::lower_bound(definition.end.begin(), definition.end.end(), i.begin);
+      if (e != definition.end.end() && *e < i.active_end)
+        i.active_end = *e;
+      i.end = definition.freeze ? infinity() : i.active_end;
+      i.animation = animation_index;
+      intervals_.push_back(i);
+    }
+    tree_built_ = false;
+  }
+
+  // Underlying value of the attribute is needed for "to" animations, that interpolate from it.
+  // If it isn't set, "to" animation sets "to" value for the whole active duration
+  void set_base_value(std::string const & target_id, std::string const & attribute_name, std::string const & value)
+  {
+    channel & c = channels_[get_channel(target_id, attribute_name, false)];
+    c.base_value = split_value(value, false);
+    c.has_base_value = true;
+  }
+
+  std::size_t intervals_count() const { return intervals_.size(); }
+
+  void clear()
+  {
+    animations_.clear();
+    intervals_.clear();
+    max_end_.clear();
+    channels_.clear();
+    channel_by_name_.clear();
+    tree_built_ = true;
+  }
+
+  // Fills list of attributes values at time t, in sandwich order (by begin time, then by order
+  // of add() calls) grouped by target attribute. Animations replaced by later non-additive animation
+  // of the same attribute are skipped. Pointers in the result are invalidated by add()
+  void evaluate(Number t, std::vector<animated_attribute> & result) const
+  {
+    result.clear();
+    build_tree();
+    active_.clear();
+    query(0, intervals_.size(), t);
+    // Stable sort keeps sandwich order inside the channel
+    std::stable_sort(active_.begin(), active_.end(), channel_less(*this));
+    for(std::size_t group = 0; group < active_.size(); )
+    {
+      std::size_t const channel_index = animations_[intervals_[active_[group]].animation].channel;
+      std::size_t group_end = group + 1;
+      while (group_end < active_.size()
+        && animations_[intervals_[active_[group_end]].animation].channel == channel_index)
+        ++group_end;
+      std::size_t first = group;
+      for(std::size_t i = group; i < group_end; ++i)
+        if (!animations_[intervals_[active_[i]].animation].additive)
+          first = i;
+      for(std::size_t i = first; i < group_end; ++i)
+      {
+        interval const & in = intervals_[active_[i]];
+        animation const & a = animations_[in.animation];
+        channel const & c = channels_[a.channel];
+        animated_attribute attribute;
+        attribute.target_id = &c.target_id;
+        attribute.attribute_name = &c.attribute_name;
+        attribute.additive = a.additive;
+        result.push_back(attribute);
+        calculate_value(a, c, in, t, result.back().value);
+      }
+      group = group_end;
+    }
+  }
+
+private:
+  // Value split to text fragments and numbers between them, text.size() == numbers.size() + 1
+  struct split_value_type
+  {
+    std::vector<std::string> text;
+    std::vector<Number> numbers;
+    bool color;
+  };
+
+  struct animation
+  {
+    animation_element element;
+    std::size_t channel;
+    std::string transform_type;
+    std::vector<split_value_type> values;
+    std::vector<Number> key_times;
+    std::vector<boost::array<Number, 4> > key_splines;
+    animation_calc_mode calc_mode;
+    // Values have same text fragments and may be interpolated
+    bool numeric;
+    bool to_animation;
+    bool additive, accumulate;
+    Number dur; // infinity if indefinite
+    Number active_duration;
+  };
+
+  struct interval
+  {
+    Number begin, active_end, end;
+    std::size_t animation;
+  };
+
+  struct channel
+  {
+    channel() : has_base_value(false) {}
+
+    std::string target_id, attribute_name;
+    split_value_type base_value;
+    bool has_base_value;
+  };
+
+  struct begin_less
+  {
+    bool operator()(interval const & lhs, interval const & rhs) const { return lhs.begin < rhs.begin; }
+  };
+
+  struct channel_less
+  {
+    channel_less(animation_timeline const & timeline) : timeline_(timeline) {}
+
+    bool operator()(std::size_t lhs, std::size_t rhs) const
+    {
+      return timeline_.animations_[timeline_.intervals_[lhs].animation].channel
+        < timeline_.animations_[timeline_.intervals_[rhs].animation].channel;
+    }
+
+    animation_timeline const & timeline_;
+  };
+
+  std::vector<animation> animations_;
+  std::vector<channel> channels_;
+  typedef std::pair<std::pair<std::string, std::string>, bool> channel_key;
+  std::map<channel_key, std::size_t> channel_by_name_;
+  mutable std::vector<interval> intervals_;
+  // max_end_[i] - maximum end of intervals in subtree with root i
+  mutable std::vector<Number> max_end_;
+  mutable bool tree_built_;
+  mutable std::vector<std::size_t> active_;
+
+  static Number infinity() { return std::numeric_limits<Number>::infinity(); }
+
+  // Motion is sandwiched separately from other animations of the transform
+  std::size_t get_channel(std::string const & target_id, std::string const & attribute_name, bool motion)
+  {
+    std::pair<typename std::map<channel_key, std::size_t>::iterator, bool> ins = channel_by_name_.insert(
+      std::make_pair(channel_key(std::make_pair(target_id, attribute_name), motion), channels_.size()));
+    if (ins.second)
+    {
+      channels_.push_back(channel());
+      channels_.back().target_id = target_id;
+      channels_.back().attribute_name = attribute_name;
+    }
+    return ins.first->second;
+  }
+
+  void build_tree() const
+  {
+    if (tree_built_)
+      return;
+    tree_built_ = true;
+    // Stable sort keeps order of add() for intervals with same begin
+    std::stable_sort(intervals_.begin(), intervals_.end(), begin_less());
+    max_end_.resize(intervals_.size());
+    build_subtree(0, intervals_.size());
+  }
+
+  Number build_subtree(std::size_t lo, std::size_t hi) const
+  {
+    if (lo == hi)
+      return -infinity();
+    std::size_t const mid = lo + (hi - lo) / 2;
+    max_end_[mid] = std::max(intervals_[mid].end,
+      std::max(build_subtree(lo, mid), build_subtree(mid + 1, hi)));
+    return max_end_[mid];
+  }
+
+  // In-order traversal, so active intervals are found in order of begin
+  void query(std::size_t lo, std::size_t hi, Number t) const
+  {
+    if (lo == hi)
+      return;
+    std::size_t const mid = lo + (hi - lo) / 2;
+    if (!(t < max_end_[mid]))
+      return;
+    query(lo, mid, t);
+    if (t < intervals_[mid].begin)
+      return;
+    if (t < intervals_[mid].end)
+      active_.push_back(mid);
+    query(mid + 1, hi, t);
+  }
+
+  bool prepare(definition_type const & definition, animation & a)
+  {
+    a.element = definition.element;
+    a.transform_type = definition.transform_type;
+    a.additive = definition.additive_sum;
+    a.accumulate = definition.accumulate_sum && definition.element != animation_set;
+    a.to_animation = false;
+    a.calc_mode = definition.calc_mode
+      ? *definition.calc_mode
+      : (definition.element == animation_animate_motion ? animation_calc_mode_paced : animation_calc_mode_linear);
+    bool const color = definition.element == animation_animate_color;
+
+    if (definition.element == animation_set)
+    {
+      if (!definition.to)
+        return false;
+      a.values.push_back(split_value(*definition.to, color));
+      a.calc_mode = animation_calc_mode_discrete;
+      a.additive = false;
+    }
+    else if (!definition.values.empty())
+    {
+      for(std::vector<std::string>::const_iterator v = definition.values.begin(); v != definition.values.end(); ++v)
+        a.values.push_back(split_value(*v, color));
+    }
+    else if (definition.from && (definition.to || definition.by))
+    {
+      a.values.push_back(split_value(*definition.from, color));
+      if (definition.to)
+        a.values.push_back(split_value(*definition.to, color));
+      else
+      {
+        split_value_type by = split_value(*definition.by, color);
+        if (!compatible(a.values[0], by))
+          return false;
+        for(std::size_t i = 0; i < by.numbers.size(); ++i)
+          by.numbers[i] += a.values[0].numbers[i];
+        a.values.push_back(by);
+      }
+    }
+    else if (definition.by)
+    {
+      // "by" animation adds from zero to "by" value to underlying value
+      a.values.push_back(split_value(*definition.by, color));
+      a.values.insert(a.values.begin(), a.values[0]);
+      std::fill(a.values[0].numbers.begin(), a.values[0].numbers.end(), Number(0));
+      a.additive = true;
+    }
+    else if (definition.to)
+    {
+      a.values.push_back(split_value(*definition.to, color));
+      a.to_animation = true;
+      a.additive = false;
+      a.accumulate = false;
+    }
+    else
+      return false;
+
+    a.numeric = true;
+    for(std::size_t i = 1; i < a.values.size(); ++i)
+      if (!compatible(a.values[0], a.values[i]))
+        a.numeric = false;
+    if (!a.numeric)
+    {
+      a.calc_mode = animation_calc_mode_discrete;
+      a.accumulate = false;
+    }
+    // Motion is supplemental transformation applied to the current transform
+    if (a.element == animation_animate_motion)
+      a.additive = true;
+
+    if (definition.key_times.size() == a.values.size()
+      && a.calc_mode != animation_calc_mode_paced
+      && !a.to_animation)
+      a.key_times = definition.key_times;
+    if (a.calc_mode == animation_calc_mode_spline)
+    {
+      if (definition.key_splines.size() + 1 == a.values.size())
+        a.key_splines = definition.key_splines;
+      else
+        a.calc_mode = animation_calc_mode_linear;
+    }
+    if (a.calc_mode == animation_calc_mode_paced && a.values.size() > 1)
+      set_paced_key_times(a);
+
+    a.channel = get_channel(definition.target_id, definition.attribute_name,
+      definition.element == animation_animate_motion);
+
+    a.dur = definition.dur ? *definition.dur : infinity();
+    if (definition.repeat_count || definition.repeat_dur)
+    {
+      a.active_duration = infinity();
+      if (definition.repeat_count)
+        a.active_duration = *definition.repeat_count * a.dur;
+      if (definition.repeat_dur)
+        a.active_duration = std::min(a.active_duration, *definition.repeat_dur);
+    }
+    else
+      a.active_duration = a.dur;
+    return true;
+  }
+
+  static void set_paced_key_times(animation & a)
+  {
+    a.key_times.resize(a.values.size());
+    a.key_times[0] = 0;
+    for(std::size_t i = 1; i < a.values.size(); ++i)
+    {
+      Number distance = 0;
+      for(std::size_t j = 0; j < a.values[i].numbers.size(); ++j)
+      {
+        Number const d = a.values[i].numbers[j] - a.values[i - 1].numbers[j];
+        distance += d * d;
+      }
+      a.key_times[i] = a.key_times[i - 1] + std::sqrt(distance);
+    }
+    Number const total = a.key_times.back();
+    if (total > 0)
+    {
+      for(std::size_t i = 1; i < a.key_times.size(); ++i)
+        a.key_times[i] /= total;
+      a.calc_mode = animation_calc_mode_linear;
+    }
+    else
+    {
+      a.key_times.clear();
+      a.calc_mode = animation_calc_mode_discrete;
+    }
+  }
+
+  static bool compatible(split_value_type const & lhs, split_value_type const & rhs)
+  {
+    return lhs.text == rhs.text && lhs.color == rhs.color;
+  }
+
+  static split_value_type split_value(std::string const & value, bool color)
+  {
+    namespace qi = boost::spirit::qi;
+    typedef std::string::const_iterator iterator_t;
+    typedef color_grammar<tag::source::attribute, iterator_t, factory::color::integer<> > color_grammar_t;
+    SVGPP_STATIC_IF_SAFE const color_grammar_t color_rule;
+    SVGPP_STATIC_IF_SAFE const qi::real_parser<Number, detail::number_policies<Number, tag::source::attribute> > number;
+
+    split_value_type result;
+    result.color = false;
+    // Colors are interpolated by components
+    iterator_t it = value.begin();
+    int rgb;
+    if (qi::parse(it, value.end(), color_rule, rgb) && it == value.end())
+    {
+      result.color = true;
+      result.text.push_back("rgb(");
+      result.text.push_back(",");
+      result.text.push_back(",");
+      result.text.push_back(")");
+      result.numbers.push_back(Number((rgb >> 16) & 0xff));
+      result.numbers.push_back(Number((rgb >> 8) & 0xff));
+      result.numbers.push_back(Number(rgb & 0xff));
+      return result;
+    }
+    else if (color)
+    {
+      result.text.push_back(value);
+      return result;
+    }
+
+    std::string text;
+    for(it = value.begin(); it != value.end(); )
+    {
+      char const c = *it;
+      bool const identifier = !text.empty()
+        && (std::isalnum(static_cast<unsigned char>(text[text.size() - 1]))
+          || text[text.size() - 1] == '#' || text[text.size() - 1] == '_');
+      Number n;
+      iterator_t number_end = it;
+      if (!identifier && (c == '-' || c == '+' || c == '.' || (c >= '0' && c <= '9'))
+        && qi::parse(number_end, value.end(), number, n))
+      {
+        result.text.push_back(text);
+        result.numbers.push_back(n);
+        text.clear();
+        it = number_end;
+      }
+      else
+      {
+        text += c;
+        ++it;
+      }
+    }
+    result.text.push_back(text);
+    return result;
+  }
+
+  static Number spline(boost::array<Number, 4> const & s, Number x)
+  {
+    // Solve Bx(u) = x by bisection, Bx is monotonic for control points in [0, 1]
+    Number lo = 0, hi = 1, u = x;
+    for(int i = 0; i < 30; ++i)
+    {
+      Number const v = 1 - u;
+      Number const bx = 3 * v * v * u * s[0] + 3 * v * u * u * s[2] + u * u * u;
+      if (bx < x)
+        lo = u;
+      else
+        hi = u;
+      u = (lo + hi) / 2;
+    }
+    Number const v = 1 - u;
+    return 3 * v * v * u * s[1] + 3 * v * u * u * s[3] + u * u * u;
+  }
+
+  void calculate_value(animation const & a, channel const & c, interval const & in, Number t, std::string & value) const
+  {
+    Number iteration = 0, progress = 0;
+    if (a.dur != infinity())
+    {
+      Number const elapsed = std::min(t, in.active_end) - in.begin;
+      iteration = std::floor(elapsed / a.dur);
+      progress = (elapsed - iteration * a.dur) / a.dur;
+      // Frozen at the end of iteration
+      if (t >= in.active_end && progress == 0 && iteration > 0)
+      {
+        iteration -= 1;
+        progress = 1;
+      }
+    }
+
+    std::size_t const count = a.values.size();
+    split_value_type const * from = &a.values[0];
+    split_value_type const * to = from;
+    Number local = 0;
+    if (a.to_animation)
+    {
+      if (c.has_base_value && compatible(c.base_value, a.values[0]))
+      {
+        from = &c.base_value;
+        local = progress;
+      }
+    }
+    else if (a.calc_mode == animation_calc_mode_discrete)
+    {
+      std::size_t index = 0;
+      if (!a.key_times.empty())
+      {
+        while (index + 1 < count && a.key_times[index + 1] <= progress)
+          ++index;
+      }
+      else
+        index = std::min(static_cast<std::size_t>(progress * count), count - 1);
+      from = to = &a.values[index];
+    }
+    else if (count > 1)
+    {
+      std::size_t segment = 0;
+      if (!a.key_times.empty())
+      {
+        while (segment + 2 < count && a.key_times[segment + 1] <= progress)
+          ++segment;
+        Number const length = a.key_times[segment + 1] - a.key_times[segment];
+        local = length > 0 ? (progress - a.key_times[segment]) / length : 1;
+      }
+      else
+      {
+        Number const position = progress * (count - 1);
+        segment = std::min(static_cast<std::size_t>(position), count - 2);
+        local = position - segment;
+      }
+      local = std::max(Number(0), std::min(Number(1), local));
+      if (a.calc_mode == animation_calc_mode_spline)
+        local = spline(a.key_splines[segment], local);
+      from = &a.values[segment];
+      to = &a.values[segment + 1];
+    }
+
+    std::ostringstream str;
+    str.imbue(std::locale::classic());
+    str.precision(10);
+    if (a.element == animation_animate_transform)
+      str << (a.transform_type.empty() ? "translate" : a.transform_type) << '(';
+    else if (a.element == animation_animate_motion)
+      str << "translate(";
+    for(std::size_t i = 0; i < to->numbers.size(); ++i)
+    {
+      Number n = from->numbers[i] + (to->numbers[i] - from->numbers[i]) * local;
+      if (a.accumulate && iteration > 0)
+      {
+        // Repeated transforms are composed: rotation center isn't accumulated, scale is multiplied
+        if (a.element != animation_animate_transform)
+          n += iteration * a.values.back().numbers[i];
+        else if (a.transform_type == "scale")
+          n *= std::pow(a.values.back().numbers[i], iteration);
+        else if (a.transform_type != "rotate" || i == 0)
+          n += iteration * a.values.back().numbers[i];
+      }
+      str << to->text[i];
+      if (to->color)
+        str << static_cast<int>(std::max(Number(0), std::min(Number(255), n)) + Number(0.5));
+      else
+        str << n;
+    }
+    str << to->text.back();
+    if (a.element == animation_animate_transform || a.element == animation_animate_motion)
+      str << ')';
+    value = str.str();
+  }
+};
+
+}
@@ -13,24 +13,24 @@
 namespace svgpp
 {
 
-template<class Number>
-void arc_endpoint_to_center(Number x1, Number y1, Number x2, Number y2,
-  Number & rx, Number & ry, Number phi, bool large_arc_flag, bool sweep_flag,
-  Number & cx, Number & cy, Number & theta1, Number & theta2)
+namespace detail
 {
-  Number sin_phi = std::sin(phi);
-  Number cos_phi = std::cos(phi);
 
-  Number x1s, y1s;
+// Calculates end point and center in the coordinate system aligned with ellipse axes
+// and centered at the middle of the chord
+template<class Number>
+void arc_endpoint_to_center_prime(Number x1, Number y1, Number x2, Number y2,
+  Number & rx, Number & ry, Number sin_phi, Number cos_phi, bool large_arc_flag, bool sweep_flag,
+  Number & x1s, Number & y1s, Number & cxs, Number & cys)
+{
   {
     // SVG 1.1 (F.6.5.1)
-    Number dx2 = (x1 - x2) * 0.5;
-    Number dy2 = (y1 - y2) * 0.5;
+    Number dx2 = (x1 - x2) * Number(0.5);
+    Number dy2 = (y1 - y2) * Number(0.5);
 
     x1s =  cos_phi * dx2 + sin_phi * dy2;
     y1s = -sin_phi * dx2 + cos_phi * dy2;
   }
-  Number cxs, cys;
   {
     
     Number rx2 = rx * rx;
@@ -56,11 +56,48 @@ void arc_endpoint_to_center(Number x1, Number y1, Number x2, Number y2,
     cxs = coeff * rx_ry * y1s;
     cys = -coeff * x1s / rx_ry;
   }
+}
+
+}
+
+template<class Number>
+void arc_endpoint_to_center(Number x1, Number y1, Number x2, Number y2,
+  Number & rx, Number & ry, Number phi, bool large_arc_flag, bool sweep_flag,
+  Number & cx, Number & cy, Number & theta1, Number & theta2)
+{
+  Number sin_phi = std::sin(phi);
+  Number cos_phi = std::cos(phi);
+
+  Number x1s, y1s, cxs, cys;
+  detail::arc_endpoint_to_center_prime(x1, y1, x2, y2, rx, ry, sin_phi, cos_phi, large_arc_flag, sweep_flag,
+    x1s, y1s, cxs, cys);
   // SVG 1.1 (F.6.5.3)
-  cx = cxs * cos_phi - cys * sin_phi + (x1 + x2) * 0.5;
-  cy = cxs * sin_phi + cys * cos_phi + (y1 + y2) * 0.5;
+  cx = cxs * cos_phi - cys * sin_phi + (x1 + x2) * Number(0.5);
+  cy = cxs * sin_phi + cys * cos_phi + (y1 + y2) * Number(0.5);
   theta1 = std::atan2(( y1s - cys)/ry, ( x1s - cxs)/rx);
   theta2 = std::atan2((-y1s - cys)/ry, (-x1s - cxs)/rx);
 }
 
+// Calculates tangent vectors at the start and end points of the arc in direction of drawing.
+// Vectors aren't normalized. Only sine and cosine of phi are used, no other trigonometric functions
+template<class Number>
+void arc_endpoint_tangents(Number x1, Number y1, Number x2, Number y2,
+  Number rx, Number ry, Number sin_phi, Number cos_phi, bool large_arc_flag, bool sweep_flag,
+  Number & tangent1_x, Number & tangent1_y, Number & tangent2_x, Number & tangent2_y)
+{
+  Number x1s, y1s, cxs, cys;
+  detail::arc_endpoint_to_center_prime(x1, y1, x2, y2, rx, ry, sin_phi, cos_phi, large_arc_flag, sweep_flag,
+    x1s, y1s, cxs, cys);
+  // Point on the ellipse relative to center is (rx * cos(eta), ry * sin(eta)), 
+  // its derivative (-rx * sin(eta), ry * cos(eta)) multiplied by rx * ry is used
+  Number const rx2 = sweep_flag ? rx * rx : -rx * rx;
+  Number const ry2 = sweep_flag ? ry * ry : -ry * ry;
+  Number const t1x = -rx2 * ( y1s - cys), t1y = ry2 * ( x1s - cxs);
+  Number const t2x = -rx2 * (-y1s - cys), t2y = ry2 * (-x1s - cxs);
+  tangent1_x = t1x * cos_phi - t1y * sin_phi;
+  tangent1_y = t1x * sin_phi + t1y * cos_phi;
+  tangent2_x = t2x * cos_phi - t2y * sin_phi;
+  tangent2_y = t2x * sin_phi + t2y * cos_phi;
+}
+
 }
\ No newline at end of file
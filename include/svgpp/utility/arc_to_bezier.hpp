@@ -213,7 +213,7 @@ private:
       for(int j=0; j<3; ++j, eta_sum_j += eta_sum)
         cos_eta_sum[j] = std::cos(eta_sum_j);
     }
-    bool coefficient_set = b_div_a >= 0.25 ? 1 : 0;
+    bool coefficient_set = b_div_a >= Number(0.25) ? 1 : 0;
     Number c[2];
     for(int i=0; i<2; ++i)
     {
@@ -249,14 +249,14 @@ private:
         }
       }
       size_ *= 2;
-      deta_ *= 0.5;
+      deta_ *= Number(0.5);
     }
   }
 
   void calculate_step(max_angle_tag, Number eta2, Number max_angle)
   {
     deta_ = eta2 - eta1_;
-    size_ = static_cast<int>(std::fabs(deta_) / max_angle + 1.0);
+    size_ = static_cast<int>(std::fabs(deta_) / max_angle + 1);
     deta_ /= size_;
   }
 
@@ -264,7 +264,7 @@ private:
   {
     cos_theta_ = std::cos(theta);
     sin_theta_ = std::sin(theta);
-    Number tan_deta = std::tan(deta_ * 0.5);
+    Number tan_deta = std::tan(deta_ * Number(0.5));
     alpha_ = std::sin(deta_) * (std::sqrt(4 + 3 * tan_deta * tan_deta) - 1) * boost::math::constants::third<Number>();
   }
 };
@@ -0,0 +1,417 @@
+// Copyright Oleg Maximenko 2014.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://github.com/svgpp/svgpp for library home page.
+
+#pragma once
+
+#include <svgpp/document_traversal.hpp>
+#include <svgpp/utility/event_stream.hpp>
+#include <boost/detail/scoped_enum_emulation.hpp>
+#include <boost/mpl/for_each.hpp>
+#include <boost/optional.hpp>
+#include <boost/type_traits/add_pointer.hpp>
+#include <algorithm>
+#include <vector>
+
+// Pull counterpart of document_traversal. XML tree is walked with explicit stack one step
+// at a time: on each step attributes of a single element are loaded by document_traversal
+// to event_stream_writer and then recorded events are returned one by one.
+
+namespace svgpp
+{
+
+BOOST_SCOPED_ENUM_START(document_event_type)
+{
+  enter_element,
+  exit_element,
+  attribute,
+  text,
+  path,
+  transform
+};
+BOOST_SCOPED_ENUM_END
+
+namespace detail
+{
+
+template<class Function>
+void element_id_to_any_tag(element_type_id id, Function & function)
+{
+  switch (id)
+  {
+#define SVGPP_ON(element_name, str) \
+  case element_type_id_## element_name: \
+    function(tag::element::element_name()); \
+    break;
+#include <svgpp/detail/dict/enumerate_all_elements.inc>
+#undef SVGPP_ON
+  default:
+    BOOST_ASSERT(false);
+    break;
+  }
+}
+
+// Runtime representation of traits::child_element_types
+class document_event_content_model
+{
+public:
+  document_event_content_model(element_type_id child_id = unknown_element_type_id)
+    : child_id_(child_id)
+    , has_elements_(false)
+    , has_text_(false)
+    , child_expected_(false)
+  {}
+
+  template<class ElementTag>
+  void operator()(ElementTag)
+  {
+    boost::mpl::for_each<typename traits::child_element_types<ElementTag>::type, boost::add_pointer<boost::mpl::_1> >(
+      child_visitor(*this));
+  }
+
+  bool has_elements() const { return has_elements_; }
+  bool has_text() const { return has_text_; }
+  bool child_expected() const { return child_expected_; }
+
+private:
+  class child_visitor
+  {
+  public:
+    child_visitor(document_event_content_model & model)
+      : model_(model)
+    {}
+
+    template<class ChildElementTag>
+    void operator()(ChildElementTag *) const
+    {
+      model_.has_elements_ = true;
+      if (ChildElementTag::element_id == model_.child_id_)
+        model_.child_expected_ = true;
+    }
+
+    void operator()(tag::text_content *) const
+    {
+      model_.has_text_ = true;
+    }
+
+  private:
+    document_event_content_model & model_;
+  };
+
+  element_type_id const child_id_;
+  bool has_elements_, has_text_, child_expected_;
+};
+
+}
+
+template<class XMLElement, SVGPP_TEMPLATE_ARGS2_DEF>
+class document_event_reader: private document_traversal<SVGPP_TEMPLATE_ARGS2_PASS>, boost::noncopyable
+{
+  typedef document_traversal<SVGPP_TEMPLATE_ARGS2_PASS> traversal;
+
+public:
+  // Context type that policies set for document_traversal are applied to
+  typedef event_stream_writer context_type;
+
+  explicit document_event_reader(XMLElement const & xml_element_svg)
+    : root_(xml_element_svg)
+    , started_(false)
+    , finished_(false)
+    , pending_(false)
+    , depth_(0)
+  {}
+
+  // Moves to the next event. Returns false at the end of document or if traversal was stopped
+  // by error policy
+  bool next()
+  {
+    if (pending_)
+      skip_event();
+    while (!stream_ || stream_->eof())
+    {
+      if (finished_)
+        return false;
+      writer_.clear();
+      std::size_t const depth = stack_.size();
+      if (!step())
+        finished_ = true;
+      depth_ = std::max(depth, stack_.size());
+      stream_.emplace(&writer_.data()[0], &writer_.data()[0] + writer_.data().size());
+      stream_->skip(detail::event_stream_header_size);
+    }
+    read_event_info();
+    pending_ = true;
+    return true;
+  }
+
+  BOOST_SCOPED_ENUM(document_event_type) type() const { return type_; }
+
+  // Valid for enter_element events
+  detail::element_type_id element_id() const { return static_cast<detail::element_type_id>(id_); }
+
+  // Valid for attribute events
+  detail::attribute_id attribute_id() const { return static_cast<detail::attribute_id>(id_); }
+
+  template<class ElementTag>
+  bool is_element(ElementTag) const
+  {
+    return type_ == document_event_type::enter_element && id_ == ElementTag::element_id;
+  }
+
+  template<class AttributeTag>
+  bool is_attribute(AttributeTag) const
+  {
+    return type_ == document_event_type::attribute && id_ == AttributeTag::attribute_id;
+  }
+
+  // Nesting level of the element the current event belongs to. Root element attributes have depth 1,
+  // enter_element and exit_element events have the same depth as attributes of the element
+  std::size_t depth() const { return depth_; }
+
+  // Passes current event to the context, as event_stream_player does. Strings and lists
+  // passed are valid until next call to 'next'. Returns false if event was skipped
+  template<class ProcessedAttributes, class Context>
+  bool play(Context & context)
+  {
+    BOOST_ASSERT(pending_);
+    pending_ = false;
+    return event_stream_player<ProcessedAttributes>::play_event(*stream_, context);
+  }
+
+  // Skips remaining attributes and content of the current element, next event will be
+  // 'exit_element' of the element
+  void skip_element()
+  {
+    BOOST_ASSERT(!stack_.empty());
+    stream_ = boost::none;
+    pending_ = false;
+    stack_.back().done = true;
+  }
+
+private:
+  typedef typename traversal::args args;
+  typedef typename traversal::is_element_processed is_element_processed;
+  typedef typename boost::parameter::value_type<args, tag::xml_element_policy,
+    policy::xml::element_iterator<XMLElement> >::type xml_policy_t;
+  typedef typename boost::parameter::value_type<args, tag::error_policy,
+    policy::error::default_policy<context_type> >::type error_policy;
+  typedef typename boost::parameter::value_type<args, tag::text_events_policy,
+    policy::text_events::default_policy<context_type> >::type text_events_policy;
+  typedef typename boost::parameter::value_type<args, tag::document_traversal_control_policy,
+    policy::document_traversal_control::default_policy<context_type> >::type traversal_control_policy;
+  typedef typename xml_policy_t::iterator_type xml_iterator_t;
+
+  struct frame
+  {
+    frame(detail::element_type_id element_id, detail::element_type_id content_id, xml_iterator_t const & child)
+      : element_id(element_id)
+      , content_id(content_id)
+      , child(child)
+      , text(false)
+      , done(false)
+    {}
+
+    detail::element_type_id element_id;
+    // Element which child_element_types are used. Differs from element_id only for 'a' element,
+    // that may contain any element that its parent may contain, except itself
+    detail::element_type_id content_id;
+    xml_iterator_t child;
+    bool text, done;
+  };
+
+  class element_loader
+  {
+  public:
+    element_loader(context_type & context, xml_iterator_t const & xml_element)
+      : context_(context)
+      , xml_element_(xml_element)
+      , processed_(false)
+      , result_(true)
+    {}
+
+    template<class ElementTag>
+    typename boost::enable_if<typename boost::mpl::apply<is_element_processed, ElementTag>::type>::type
+    operator()(ElementTag tag)
+    {
+      processed_ = true;
+      context_.on_enter_element(tag);
+      result_ = traversal::template load_attributes<void>(xml_element_, context_, tag);
+    }
+
+    template<class ElementTag>
+    typename boost::disable_if<typename boost::mpl::apply<is_element_processed, ElementTag>::type>::type
+    operator()(ElementTag)
+    {}
+
+    bool processed() const { return processed_; }
+    bool succeeded() const { return result_; }
+
+  private:
+    context_type & context_;
+    xml_iterator_t const & xml_element_;
+    bool processed_, result_;
+  };
+
+  XMLElement const root_;
+  event_stream_writer writer_;
+  boost::optional<detail::event_stream_reader> stream_;
+  std::vector<frame> stack_;
+  bool started_, finished_, pending_;
+  std::size_t depth_;
+  BOOST_SCOPED_ENUM(document_event_type) type_;
+  unsigned id_;
+
+  // Writes events of the next XML node to writer_. Returns false if there are no more events
+  bool step()
+  {
+    if (!started_)
+    {
+      started_ = true;
+      return load_root();
+    }
+    if (stack_.empty())
+      return false;
+    frame & parent = stack_.back();
+    if (parent.done || xml_policy_t::is_end(parent.child))
+    {
+      stack_.pop_back();
+      if (stack_.empty())
+        return false;
+      writer_.on_exit_element();
+      return child_processed();
+    }
+
+    xml_iterator_t const xml_child = parent.child;
+    if (parent.text)
+    {
+      xml_policy_t::advance_element_or_text(parent.child);
+      if (xml_policy_t::is_text(xml_child))
+      {
+        typename xml_policy_t::element_text_type text = xml_policy_t::get_text(xml_child);
+        text_events_policy::set_text(writer_, xml_policy_t::get_string_range(text));
+        return child_processed();
+      }
+      if (!traversal_control_policy::process_child(writer_, xml_child))
+        return child_processed();
+    }
+    else
+      xml_policy_t::advance_element(parent.child);
+    return load_child_element(xml_child);
+  }
+
+  bool load_root()
+  {
+    typename xml_policy_t::element_name_type element_name = xml_policy_t::get_local_name(root_);
+    detail::element_type_id const element_id = detail::element_name_to_id_dictionary::find(
+      xml_policy_t::get_string_range(element_name));
+    // Nothing to load if error policy doesn't stop on errors
+    if (element_id == detail::unknown_element_type_id)
+    {
+      error_policy::unknown_element(writer_, root_, xml_policy_t::get_string_range(element_name));
+      return false;
+    }
+    if (element_id != detail::element_type_id_svg)
+    {
+      error_policy::unexpected_element(writer_, root_);
+      return false;
+    }
+    if (!traversal::template load_attributes<void>(root_, writer_, tag::element::svg()))
+      return false;
+    push_frame(element_id, element_id, root_);
+    return true;
+  }
+
+  bool load_child_element(xml_iterator_t const & xml_element)
+  {
+    frame const & parent = stack_.back();
+    typename xml_policy_t::element_name_type element_name = xml_policy_t::get_local_name(xml_element);
+    detail::element_type_id const element_id = detail::element_name_to_id_dictionary::find(
+      xml_policy_t::get_string_range(element_name));
+    if (element_id == detail::unknown_element_type_id)
+      return error_policy::unknown_element(writer_, xml_element, xml_policy_t::get_string_range(element_name))
+        && child_processed();
+
+    detail::document_event_content_model parent_content(element_id);
+    detail::element_id_to_any_tag(parent.content_id, parent_content);
+    if (!parent_content.child_expected()
+      || (element_id == detail::element_type_id_a && parent.element_id == detail::element_type_id_a))
+      return error_policy::unexpected_element(writer_, xml_element) && child_processed();
+
+    element_loader loader(writer_, xml_element);
+    detail::element_id_to_any_tag(element_id, loader);
+    if (!loader.processed())
+      return child_processed();
+    if (!loader.succeeded())
+      return false;
+    push_frame(element_id, element_id == detail::element_type_id_a ? parent.content_id : element_id,
+      xml_element);
+    return true;
+  }
+
+  template<class XMLElementT>
+  void push_frame(detail::element_type_id element_id, detail::element_type_id content_id,
+    XMLElementT const & xml_element)
+  {
+    detail::document_event_content_model content;
+    detail::element_id_to_any_tag(content_id, content);
+    if (content.has_text())
+    {
+      stack_.push_back(frame(element_id, content_id, xml_policy_t::get_child_elements_and_texts(xml_element)));
+      stack_.back().text = true;
+    }
+    else
+    {
+      stack_.push_back(frame(element_id, content_id, xml_policy_t::get_child_elements(xml_element)));
+      // As in document_traversal, content of elements that can't have child elements isn't loaded
+      stack_.back().done = !content.has_elements();
+    }
+    if (!traversal_control_policy::proceed_to_element_content(writer_))
+      stack_.back().done = true;
+  }
+
+  bool child_processed()
+  {
+    if (!traversal_control_policy::proceed_to_next_child(writer_))
+      stack_.back().done = true;
+    return true;
+  }
+
+  void skip_event()
+  {
+    struct null_context {} context;
+    event_stream_player<boost::mpl::set0<> >::play_event(*stream_, context);
+    pending_ = false;
+  }
+
+  void read_event_info()
+  {
+    detail::event_stream_reader peek(*stream_);
+    int const op = peek.template read<boost::uint8_t>();
+    id_ = 0;
+    switch (op)
+    {
+    case detail::event_stream_op_enter_element:
+      type_ = document_event_type::enter_element;
+      id_ = peek.template read<boost::uint16_t>();
+      break;
+    case detail::event_stream_op_exit_element:
+      type_ = document_event_type::exit_element;
+      break;
+    case detail::event_stream_op_set:
+      type_ = document_event_type::attribute;
+      id_ = peek.template read<boost::uint16_t>();
+      break;
+    case detail::event_stream_op_text:
+      type_ = document_event_type::text;
+      break;
+    default:
+      type_ = op <= detail::event_stream_op_path_exit ? document_event_type::path : document_event_type::transform;
+      break;
+    }
+  }
+};
+
+}
@@ -0,0 +1,1146 @@
+// Copyright Oleg Maximenko 2014.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://github.com/svgpp/svgpp for library home page.
+
+#pragma once
+
+#include <boost/config.hpp>
+
+#if defined(BOOST_NO_CXX11_VARIADIC_TEMPLATES) || defined(BOOST_NO_CXX11_DECLTYPE)
+# error svgpp/utility/event_stream.hpp requires C++11 variadic templates and decltype
+#endif
+
+#include <svgpp/definitions.hpp>
+#include <svgpp/factory/icc_color_stub.hpp>
+#include <svgpp/policy/error.hpp>
+#include <boost/array.hpp>
+#include <boost/assert.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/iterator/iterator_facade.hpp>
+#include <boost/mpl/has_key.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/range.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/integral_constant.hpp>
+#include <boost/type_traits/is_arithmetic.hpp>
+#include <boost/type_traits/is_floating_point.hpp>
+#include <boost/type_traits/is_integral.hpp>
+#include <boost/type_traits/is_same.hpp>
+#include <boost/utility/enable_if.hpp>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Binary recording of events passed by document_traversal to the context.
+//
+// Stream layout (native byte order, numbers are stored as double):
+//   header: magic "SVGPPEVS", uint16 version, uint16 element count, uint16 attribute count,
+//           uint16 literal count
+//   records: uint8 operation followed by its operands.
+// Dictionary sizes are stored to reject streams written by incompatible SVG++ versions,
+// because element, attribute and literal ids are their positions in the dictionaries.
+
+namespace svgpp
+{
+
+class event_stream_error: public exception_base
+{
+public:
+  event_stream_error(char const * message)
+    : message_(message)
+  {}
+
+  virtual ~event_stream_error() throw() {}
+
+  virtual const char * what() const throw()
+  {
+    return message_;
+  }
+
+private:
+  char const * message_;
+};
+
+namespace detail
+{
+
+enum event_stream_literal_id
+{
+#define SVGPP_ON_VALUE(value_name) event_stream_literal_id_## value_name,
+#define SVGPP_ON_VALUE2(value_name, string) SVGPP_ON_VALUE(value_name)
+#include <svgpp/detail/dict/enumerate_literal_values.inc>
+#define SVGPP_EVENT_STREAM_EXTRA_LITERALS \
+  SVGPP_ON_VALUE(rect) \
+  SVGPP_ON_VALUE(underline) \
+  SVGPP_ON_VALUE(overline) \
+  SVGPP_ON_VALUE(line_through) \
+  SVGPP_ON_VALUE(blink) \
+  SVGPP_ON_VALUE(meet) \
+  SVGPP_ON_VALUE(slice) \
+  SVGPP_ON_VALUE(xMinYMin) \
+  SVGPP_ON_VALUE(xMidYMin) \
+  SVGPP_ON_VALUE(xMaxYMin) \
+  SVGPP_ON_VALUE(xMinYMid) \
+  SVGPP_ON_VALUE(xMidYMid) \
+  SVGPP_ON_VALUE(xMaxYMid) \
+  SVGPP_ON_VALUE(xMinYMax) \
+  SVGPP_ON_VALUE(xMidYMax) \
+  SVGPP_ON_VALUE(xMaxYMax)
+  SVGPP_EVENT_STREAM_EXTRA_LITERALS
+#undef SVGPP_ON_VALUE
+#undef SVGPP_ON_VALUE2
+  event_stream_literal_count
+};
+
+template<class T>
+struct event_stream_literal
+{
+  static const bool is_literal = false;
+};
+
+#define SVGPP_ON_VALUE(value_name) \
+  template<> struct event_stream_literal<tag::value::value_name> { \
+    static const bool is_literal = true; \
+    static const event_stream_literal_id id = event_stream_literal_id_## value_name; };
+#define SVGPP_ON_VALUE2(value_name, string) SVGPP_ON_VALUE(value_name)
+#include <svgpp/detail/dict/enumerate_literal_values.inc>
+SVGPP_EVENT_STREAM_EXTRA_LITERALS
+#undef SVGPP_ON_VALUE
+#undef SVGPP_ON_VALUE2
+
+template<class T>
+struct is_number_pair: boost::false_type
+{};
+
+template<class T1, class T2>
+struct is_number_pair<std::pair<T1, T2> >: boost::is_arithmetic<T1>
+{};
+
+// Argument type codes:
+//   'n' - number, 'i' - integer (or integer color), 'b' - bool, 'l' - literal (tag::value::*),
+//   'f' - tag::iri_fragment, 'k' - tag::skip_icc_color, 's' - string, 'r' - range of numbers,
+//   'p' - range of pairs of numbers
+template<class T, class Enable = void>
+struct event_stream_arg_code
+{
+  typedef typename boost::range_value<T>::type value_type;
+  static const char value =
+    boost::is_same<value_type, char>::value ? 's'
+    : boost::is_floating_point<value_type>::value || boost::is_integral<value_type>::value ? 'r'
+    : is_number_pair<value_type>::value ? 'p'
+    : 0;
+  BOOST_STATIC_ASSERT_MSG(value != 0, "Value type can't be stored in event stream");
+};
+
+template<class T>
+struct event_stream_arg_code<T, typename boost::enable_if<boost::is_floating_point<T> >::type>
+{
+  static const char value = 'n';
+};
+
+template<class T>
+struct event_stream_arg_code<T, typename boost::enable_if_c<
+  boost::is_integral<T>::value && !boost::is_same<T, bool>::value>::type>
+{
+  static const char value = 'i';
+};
+
+template<>
+struct event_stream_arg_code<bool>
+{
+  static const char value = 'b';
+};
+
+template<class T>
+struct event_stream_arg_code<T, typename boost::enable_if_c<event_stream_literal<T>::is_literal>::type>
+{
+  static const char value = 'l';
+};
+
+template<>
+struct event_stream_arg_code<tag::iri_fragment>
+{
+  static const char value = 'f';
+};
+
+template<>
+struct event_stream_arg_code<tag::skip_icc_color>
+{
+  static const char value = 'k';
+};
+
+enum event_stream_signature
+{
+  event_stream_signature_l,
+  event_stream_signature_n,
+  event_stream_signature_nn,
+  event_stream_signature_nnnn,
+  event_stream_signature_i,
+  event_stream_signature_s,
+  event_stream_signature_fs,
+  event_stream_signature_sl,
+  event_stream_signature_fsl,
+  event_stream_signature_si,
+  event_stream_signature_fsi,
+  event_stream_signature_bl,
+  event_stream_signature_bll,
+  event_stream_signature_r,
+  event_stream_signature_lnnnn,
+  event_stream_signature_lblblblb,
+  event_stream_signature_ik,
+  event_stream_signature_sik,
+  event_stream_signature_fsik,
+  event_stream_signature_p,
+  event_stream_signature_count
+};
+
+inline char const * event_stream_signature_codes(int signature)
+{
+  static char const * const codes[event_stream_signature_count] = {
+    "l", "n", "nn", "nnnn", "i", "s", "fs", "sl", "fsl", "si", "fsi", "bl", "bll", "r", "lnnnn", "lblblblb",
+    "ik", "sik", "fsik", "p"
+  };
+  return codes[signature];
+}
+
+inline int find_event_stream_signature(char const * codes)
+{
+  for(int i = 0; i < event_stream_signature_count; ++i)
+    if (std::strcmp(event_stream_signature_codes(i), codes) == 0)
+      return i;
+  return -1;
+}
+
+enum event_stream_operation
+{
+  event_stream_op_enter_element,
+  event_stream_op_exit_element,
+  event_stream_op_set,
+  event_stream_op_text,
+  // Path segment operations are even, relative variant is 'op + 1'
+  event_stream_op_path_move_to = 8,
+  event_stream_op_path_line_to = 10,
+  event_stream_op_path_line_to_horizontal = 12,
+  event_stream_op_path_line_to_vertical = 14,
+  event_stream_op_path_cubic_bezier_to = 16,
+  event_stream_op_path_cubic_bezier_short_to = 18,
+  event_stream_op_path_quadratic_bezier_to = 20,
+  event_stream_op_path_quadratic_bezier_short_to = 22,
+  event_stream_op_path_elliptical_arc_to = 24,
+  event_stream_op_path_close_subpath = 26,
+  event_stream_op_path_exit,
+  event_stream_op_transform_matrix,
+  event_stream_op_transform_translate,
+  event_stream_op_transform_translate_x,
+  event_stream_op_transform_scale,
+  event_stream_op_transform_uniform_scale,
+  event_stream_op_transform_rotate,
+  event_stream_op_transform_rotate_around,
+  event_stream_op_transform_skew_x,
+  event_stream_op_transform_skew_y
+};
+
+static const char event_stream_magic[8] = { 'S', 'V', 'G', 'P', 'P', 'E', 'V', 'S' };
+static const boost::uint16_t event_stream_version = 1;
+static const std::size_t event_stream_header_size = 16;
+
+}
+
+// Context for document_traversal that records all received events.
+// Attribute values must be passed with default factories: numbers and lengths as floating point,
+// colors as integers, strings and lists as ranges.
+class event_stream_writer: boost::noncopyable
+{
+public:
+  event_stream_writer()
+  {
+    data_.insert(data_.end(), detail::event_stream_magic, detail::event_stream_magic + 8);
+    write<boost::uint16_t>(detail::event_stream_version);
+    write<boost::uint16_t>(detail::element_type_count);
+    write<boost::uint16_t>(detail::attribute_count);
+    write<boost::uint16_t>(detail::event_stream_literal_count);
+  }
+
+  std::vector<char> const & data() const { return data_; }
+
+  // Removes recorded events, header is kept
+  void clear() { data_.resize(detail::event_stream_header_size); }
+
+  template<class ElementTag>
+  void on_enter_element(ElementTag)
+  {
+    write_op(detail::event_stream_op_enter_element);
+    write<boost::uint16_t>(ElementTag::element_id);
+  }
+
+  void on_exit_element()
+  {
+    write_op(detail::event_stream_op_exit_element);
+  }
+
+  template<class AttributeTag, class... Args>
+  void set(AttributeTag, Args const &... args)
+  {
+    static const char codes[] = { detail::event_stream_arg_code<Args>::value..., 0 };
+    static const int signature = detail::find_event_stream_signature(codes);
+    if (signature < 0)
+      throw event_stream_error("Attribute value can't be stored in event stream");
+    write_op(detail::event_stream_op_set);
+    write<boost::uint16_t>(AttributeTag::attribute_id);
+    write<boost::uint8_t>(signature);
+    write_args(args...);
+  }
+
+  template<class Range>
+  void set_text(Range const & text)
+  {
+    write_op(detail::event_stream_op_text);
+    write_string(text);
+  }
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_move_to(Coordinate x, Coordinate y, AbsoluteOrRelative)
+  {
+    write_path_op(detail::event_stream_op_path_move_to, AbsoluteOrRelative());
+    write_numbers(x, y);
+  }
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_line_to(Coordinate x, Coordinate y, AbsoluteOrRelative)
+  {
+    write_path_op(detail::event_stream_op_path_line_to, AbsoluteOrRelative());
+    write_numbers(x, y);
+  }
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_line_to_ortho(Coordinate coord, bool horizontal, AbsoluteOrRelative)
+  {
+    write_path_op(horizontal
+      ? detail::event_stream_op_path_line_to_horizontal
+      : detail::event_stream_op_path_line_to_vertical, AbsoluteOrRelative());
+    write_numbers(coord);
+  }
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_cubic_bezier_to(Coordinate x1, Coordinate y1, Coordinate x2, Coordinate y2,
+    Coordinate x, Coordinate y, AbsoluteOrRelative)
+  {
+    write_path_op(detail::event_stream_op_path_cubic_bezier_to, AbsoluteOrRelative());
+    write_numbers(x1, y1, x2, y2, x, y);
+  }
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_cubic_bezier_to(Coordinate x2, Coordinate y2, Coordinate x, Coordinate y, AbsoluteOrRelative)
+  {
+    write_path_op(detail::event_stream_op_path_cubic_bezier_short_to, AbsoluteOrRelative());
+    write_numbers(x2, y2, x, y);
+  }
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_quadratic_bezier_to(Coordinate x1, Coordinate y1, Coordinate x, Coordinate y, AbsoluteOrRelative)
+  {
+    write_path_op(detail::event_stream_op_path_quadratic_bezier_to, AbsoluteOrRelative());
+    write_numbers(x1, y1, x, y);
+  }
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_quadratic_bezier_to(Coordinate x, Coordinate y, AbsoluteOrRelative)
+  {
+    write_path_op(detail::event_stream_op_path_quadratic_bezier_short_to, AbsoluteOrRelative());
+    write_numbers(x, y);
+  }
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_elliptical_arc_to(Coordinate rx, Coordinate ry, Coordinate x_axis_rotation,
+    bool large_arc_flag, bool sweep_flag, Coordinate x, Coordinate y, AbsoluteOrRelative)
+  {
+    write_path_op(detail::event_stream_op_path_elliptical_arc_to, AbsoluteOrRelative());
+    write_numbers(rx, ry, x_axis_rotation);
+    write<boost::uint8_t>((large_arc_flag ? 1 : 0) | (sweep_flag ? 2 : 0));
+    write_numbers(x, y);
+  }
+
+  void path_close_subpath()
+  {
+    write_op(detail::event_stream_op_path_close_subpath);
+  }
+
+  void path_exit()
+  {
+    write_op(detail::event_stream_op_path_exit);
+  }
+
+  template<class Number>
+  void transform_matrix(const boost::array<Number, 6> & matrix)
+  {
+    write_op(detail::event_stream_op_transform_matrix);
+    for(int i = 0; i < 6; ++i)
+      write_numbers(matrix[i]);
+  }
+
+  template<class Number>
+  void transform_translate(Number tx, Number ty)
+  {
+    write_op(detail::event_stream_op_transform_translate);
+    write_numbers(tx, ty);
+  }
+
+  template<class Number>
+  void transform_translate(Number tx)
+  {
+    write_op(detail::event_stream_op_transform_translate_x);
+    write_numbers(tx);
+  }
+
+  template<class Number>
+  void transform_scale(Number sx, Number sy)
+  {
+    write_op(detail::event_stream_op_transform_scale);
+    write_numbers(sx, sy);
+  }
+
+  template<class Number>
+  void transform_scale(Number scale)
+  {
+    write_op(detail::event_stream_op_transform_uniform_scale);
+    write_numbers(scale);
+  }
+
+  template<class Number>
+  void transform_rotate(Number angle)
+  {
+    write_op(detail::event_stream_op_transform_rotate);
+    write_numbers(angle);
+  }
+
+  template<class Number>
+  void transform_rotate(Number angle, Number cx, Number cy)
+  {
+    write_op(detail::event_stream_op_transform_rotate_around);
+    write_numbers(angle, cx, cy);
+  }
+
+  template<class Number>
+  void transform_skew_x(Number angle)
+  {
+    write_op(detail::event_stream_op_transform_skew_x);
+    write_numbers(angle);
+  }
+
+  template<class Number>
+  void transform_skew_y(Number angle)
+  {
+    write_op(detail::event_stream_op_transform_skew_y);
+    write_numbers(angle);
+  }
+
+private:
+  std::vector<char> data_;
+
+  template<class T>
+  void write(T value)
+  {
+    char const * p = reinterpret_cast<char const *>(&value);
+    data_.insert(data_.end(), p, p + sizeof(T));
+  }
+
+  void write_op(int op)
+  {
+    write<boost::uint8_t>(op);
+  }
+
+  void write_path_op(int op, tag::coordinate::absolute) { write_op(op); }
+  void write_path_op(int op, tag::coordinate::relative) { write_op(op + 1); }
+
+  void write_numbers() {}
+
+  template<class Number, class... Numbers>
+  void write_numbers(Number value, Numbers... values)
+  {
+    write<double>(value);
+    write_numbers(values...);
+  }
+
+  template<class Range>
+  void write_string(Range const & range)
+  {
+    write<boost::uint32_t>(boost::size(range));
+    data_.insert(data_.end(), boost::begin(range), boost::end(range));
+  }
+
+  // Numbers of list are aligned to be passed as range of pointers to mapped data.
+  // Range is iterated once, because list values are parsed while iterating
+  template<class Range>
+  void write_number_list(Range const & range)
+  {
+    std::size_t const count_offset = data_.size();
+    write<boost::uint32_t>(0);
+    data_.resize((data_.size() + sizeof(double) - 1) / sizeof(double) * sizeof(double));
+    boost::uint32_t count = 0;
+    for(typename boost::range_iterator<Range const>::type it = boost::begin(range); it != boost::end(range); ++it)
+      count += write_list_item(*it);
+    std::memcpy(&data_[count_offset], &count, sizeof(count));
+  }
+
+  template<class Number>
+  int write_list_item(Number value)
+  {
+    write<double>(value);
+    return 1;
+  }
+
+  template<class Number1, class Number2>
+  int write_list_item(std::pair<Number1, Number2> const & value)
+  {
+    write_numbers(value.first, value.second);
+    return 2;
+  }
+
+  void write_args() {}
+
+  template<class Arg, class... Args>
+  void write_args(Arg const & arg, Args const &... args)
+  {
+    write_value(arg, detail::event_stream_arg_code<Arg>());
+    write_args(args...);
+  }
+
+  template<class Arg, class Code>
+  void write_value(Arg const & arg, Code, typename boost::enable_if_c<Code::value == 'n'>::type * = NULL)
+  {
+    write<double>(arg);
+  }
+
+  template<class Arg, class Code>
+  void write_value(Arg const & arg, Code, typename boost::enable_if_c<Code::value == 'i'>::type * = NULL)
+  {
+    write<boost::int32_t>(arg);
+  }
+
+  template<class Arg, class Code>
+  void write_value(Arg const & arg, Code, typename boost::enable_if_c<Code::value == 'b'>::type * = NULL)
+  {
+    write<boost::uint8_t>(arg ? 1 : 0);
+  }
+
+  template<class Arg, class Code>
+  void write_value(Arg const &, Code, typename boost::enable_if_c<Code::value == 'l'>::type * = NULL)
+  {
+    write<boost::uint16_t>(detail::event_stream_literal<Arg>::id);
+  }
+
+  template<class Arg, class Code>
+  void write_value(Arg const &, Code, typename boost::enable_if_c<Code::value == 'f' || Code::value == 'k'>::type * = NULL)
+  {}
+
+  template<class Arg, class Code>
+  void write_value(Arg const & arg, Code, typename boost::enable_if_c<Code::value == 's'>::type * = NULL)
+  {
+    write_string(arg);
+  }
+
+  template<class Arg, class Code>
+  void write_value(Arg const & arg, Code, typename boost::enable_if_c<Code::value == 'r'>::type * = NULL)
+  {
+    write_number_list(arg);
+  }
+
+  template<class Arg, class Code>
+  void write_value(Arg const & arg, Code, typename boost::enable_if_c<Code::value == 'p'>::type * = NULL)
+  {
+    write_number_list(arg);
+  }
+};
+
+namespace detail
+{
+
+class event_stream_reader
+{
+public:
+  typedef boost::iterator_range<char const *> string_type;
+  typedef boost::iterator_range<double const *> number_list_type;
+
+  event_stream_reader(char const * begin, char const * end)
+    : begin_(begin)
+    , it_(begin)
+    , end_(end)
+  {}
+
+  bool eof() const { return it_ == end_; }
+
+  void skip(std::size_t size) { take(size); }
+
+  template<class T>
+  T read()
+  {
+    T value;
+    std::memcpy(&value, take(sizeof(T)), sizeof(T));
+    return value;
+  }
+
+  string_type read_string()
+  {
+    boost::uint32_t const size = read<boost::uint32_t>();
+    char const * begin = take(size);
+    return string_type(begin, begin + size);
+  }
+
+  // Writer aligns list relative to the stream start, so numbers are aligned in memory only if 
+  // the stream data is aligned
+  number_list_type read_number_list()
+  {
+    boost::uint32_t const count = read<boost::uint32_t>();
+    std::size_t const offset = it_ - begin_;
+    take((offset + sizeof(double) - 1) / sizeof(double) * sizeof(double) - offset);
+    if (reinterpret_cast<std::size_t>(it_) % sizeof(double) != 0)
+      throw event_stream_error("Event stream data isn't aligned to the size of double");
+    if (count > static_cast<std::size_t>(end_ - it_) / sizeof(double))
+      throw event_stream_error("Unexpected end of event stream");
+    double const * begin = reinterpret_cast<double const *>(take(count * sizeof(double)));
+    return number_list_type(begin, begin + count);
+  }
+
+private:
+  char const * const begin_;
+  char const * it_;
+  char const * const end_;
+
+  char const * take(std::size_t size)
+  {
+    if (static_cast<std::size_t>(end_ - it_) < size)
+      throw event_stream_error("Unexpected end of event stream");
+    char const * p = it_;
+    it_ += size;
+    return p;
+  }
+};
+
+// Iterates pairs of numbers stored one after another
+class event_stream_point_iterator: public boost::iterator_facade<
+  event_stream_point_iterator, std::pair<double, double> const, 
+  boost::random_access_traversal_tag, std::pair<double, double> >
+{
+public:
+  event_stream_point_iterator(double const * p = NULL)
+    : p_(p)
+  {}
+
+private:
+  friend class boost::iterator_core_access;
+
+  double const * p_;
+
+  std::pair<double, double> dereference() const { return std::make_pair(p_[0], p_[1]); }
+  bool equal(event_stream_point_iterator const & other) const { return p_ == other.p_; }
+  void increment() { p_ += 2; }
+  void decrement() { p_ -= 2; }
+  void advance(std::ptrdiff_t n) { p_ += 2 * n; }
+  std::ptrdiff_t distance_to(event_stream_point_iterator const & other) const { return (other.p_ - p_) / 2; }
+};
+
+struct event_stream_args
+{
+  double numbers[4];
+  boost::int32_t integer;
+  bool flags[4];
+  unsigned literals[4];
+  event_stream_reader::string_type string;
+  event_stream_reader::number_list_type number_list;
+
+  boost::iterator_range<event_stream_point_iterator> points() const
+  {
+    return boost::iterator_range<event_stream_point_iterator>(
+      event_stream_point_iterator(number_list.begin()), event_stream_point_iterator(number_list.end()));
+  }
+};
+
+// Context methods are called only if they exist with matching arguments
+#define SVGPP_EVENT_STREAM_CALL(method) \
+  template<class Context, class... Args> \
+  inline auto event_stream_call_## method(Context & context, int, Args const &... args) \
+    -> decltype(context.method(args...), bool()) \
+  { context.method(args...); return true; } \
+  template<class Context, class... Args> \
+  inline bool event_stream_call_## method(Context &, long, Args const &...) \
+  { return false; }
+
+SVGPP_EVENT_STREAM_CALL(on_enter_element)
+SVGPP_EVENT_STREAM_CALL(on_exit_element)
+SVGPP_EVENT_STREAM_CALL(set)
+SVGPP_EVENT_STREAM_CALL(set_text)
+SVGPP_EVENT_STREAM_CALL(path_move_to)
+SVGPP_EVENT_STREAM_CALL(path_line_to)
+SVGPP_EVENT_STREAM_CALL(path_line_to_ortho)
+SVGPP_EVENT_STREAM_CALL(path_cubic_bezier_to)
+SVGPP_EVENT_STREAM_CALL(path_quadratic_bezier_to)
+SVGPP_EVENT_STREAM_CALL(path_elliptical_arc_to)
+SVGPP_EVENT_STREAM_CALL(path_close_subpath)
+SVGPP_EVENT_STREAM_CALL(path_exit)
+SVGPP_EVENT_STREAM_CALL(transform_matrix)
+SVGPP_EVENT_STREAM_CALL(transform_translate)
+SVGPP_EVENT_STREAM_CALL(transform_scale)
+SVGPP_EVENT_STREAM_CALL(transform_rotate)
+SVGPP_EVENT_STREAM_CALL(transform_skew_x)
+SVGPP_EVENT_STREAM_CALL(transform_skew_y)
+
+#undef SVGPP_EVENT_STREAM_CALL
+
+template<class Function>
+bool dispatch_event_stream_literal(unsigned id, Function & function)
+{
+  switch (id)
+  {
+#define SVGPP_ON_VALUE(value_name) case event_stream_literal_id_## value_name: return function(tag::value::value_name());
+#define SVGPP_ON_VALUE2(value_name, string) SVGPP_ON_VALUE(value_name)
+#include <svgpp/detail/dict/enumerate_literal_values.inc>
+  SVGPP_EVENT_STREAM_EXTRA_LITERALS
+#undef SVGPP_ON_VALUE
+#undef SVGPP_ON_VALUE2
+  default:
+    return false;
+  }
+}
+
+template<class Function>
+bool dispatch_event_stream_paint_literal(unsigned id, Function & function)
+{
+  switch (id)
+  {
+  case event_stream_literal_id_none: return function(tag::value::none());
+  case event_stream_literal_id_currentColor: return function(tag::value::currentColor());
+  default: return false;
+  }
+}
+
+template<class Function>
+bool dispatch_event_stream_align_literal(unsigned id, Function & function)
+{
+  switch (id)
+  {
+#define SVGPP_CASE(value_name) case event_stream_literal_id_## value_name: return function(tag::value::value_name());
+  SVGPP_CASE(xMinYMin)
+  SVGPP_CASE(xMidYMin)
+  SVGPP_CASE(xMaxYMin)
+  SVGPP_CASE(xMinYMid)
+  SVGPP_CASE(xMidYMid)
+  SVGPP_CASE(xMaxYMid)
+  SVGPP_CASE(xMinYMax)
+  SVGPP_CASE(xMidYMax)
+  SVGPP_CASE(xMaxYMax)
+#undef SVGPP_CASE
+  default:
+    return false;
+  }
+}
+
+// Calls context.set(AttributeTag(), args..., literal)
+template<class Context, class AttributeTag, class... Args>
+class event_stream_set_with_literal
+{
+public:
+  event_stream_set_with_literal(Context & context, Args const &... args)
+    : context_(context)
+    , args_(args...)
+  {}
+
+  template<class Literal>
+  bool operator()(Literal literal)
+  {
+    return call(literal, typename make_indices<sizeof...(Args)>::type());
+  }
+
+private:
+  template<int... I> struct indices {};
+  template<int N, int... I> struct make_indices: make_indices<N - 1, N - 1, I...> {};
+  template<int... I> struct make_indices<0, I...> { typedef indices<I...> type; };
+
+  Context & context_;
+  std::tuple<Args const &...> args_;
+
+  template<class Literal, int... I>
+  bool call(Literal literal, indices<I...>)
+  {
+    return event_stream_call_set(context_, 0, AttributeTag(), std::get<I>(args_)..., literal);
+  }
+};
+
+template<class Context, class AttributeTag>
+class event_stream_set_preserve_aspect_ratio
+{
+public:
+  event_stream_set_preserve_aspect_ratio(Context & context, bool defer, unsigned meet_or_slice)
+    : context_(context)
+    , defer_(defer)
+    , meet_or_slice_(meet_or_slice)
+  {}
+
+  template<class Align>
+  bool operator()(Align align)
+  {
+    switch (meet_or_slice_)
+    {
+    case event_stream_literal_id_meet:
+      return event_stream_call_set(context_, 0, AttributeTag(), defer_, align, tag::value::meet());
+    case event_stream_literal_id_slice:
+      return event_stream_call_set(context_, 0, AttributeTag(), defer_, align, tag::value::slice());
+    default:
+      return false;
+    }
+  }
+
+private:
+  Context & context_;
+  bool const defer_;
+  unsigned const meet_or_slice_;
+};
+
+template<class Context, class AttributeTag>
+class event_stream_set_rect_or_new
+{
+public:
+  event_stream_set_rect_or_new(Context & context, double const * numbers)
+    : context_(context)
+    , numbers_(numbers)
+  {}
+
+  bool operator()(tag::value::rect literal)
+  {
+    return event_stream_call_set(context_, 0, AttributeTag(), literal,
+      numbers_[0], numbers_[1], numbers_[2], numbers_[3]);
+  }
+
+  bool operator()(tag::value::new_ literal)
+  {
+    return event_stream_call_set(context_, 0, AttributeTag(), literal,
+      numbers_[0], numbers_[1], numbers_[2], numbers_[3]);
+  }
+
+  template<class Literal>
+  bool operator()(Literal)
+  {
+    return false;
+  }
+
+private:
+  Context & context_;
+  double const * numbers_;
+};
+
+template<class Context, class AttributeTag>
+bool play_event_stream_set(Context & context, int signature, event_stream_args const & a)
+{
+  switch (signature)
+  {
+  case event_stream_signature_l:
+  {
+    event_stream_set_with_literal<Context, AttributeTag> set(context);
+    return dispatch_event_stream_literal(a.literals[0], set);
+  }
+  case event_stream_signature_n:
+    return event_stream_call_set(context, 0, AttributeTag(), a.numbers[0]);
+  case event_stream_signature_nn:
+    return event_stream_call_set(context, 0, AttributeTag(), a.numbers[0], a.numbers[1]);
+  case event_stream_signature_nnnn:
+    return event_stream_call_set(context, 0, AttributeTag(), a.numbers[0], a.numbers[1], a.numbers[2], a.numbers[3]);
+  case event_stream_signature_i:
+    return event_stream_call_set(context, 0, AttributeTag(), a.integer);
+  case event_stream_signature_s:
+    return event_stream_call_set(context, 0, AttributeTag(), a.string);
+  case event_stream_signature_fs:
+    return event_stream_call_set(context, 0, AttributeTag(), tag::iri_fragment(), a.string);
+  case event_stream_signature_sl:
+  {
+    event_stream_set_with_literal<Context, AttributeTag, event_stream_reader::string_type> set(context, a.string);
+    return dispatch_event_stream_paint_literal(a.literals[0], set);
+  }
+  case event_stream_signature_fsl:
+  {
+    event_stream_set_with_literal<Context, AttributeTag, tag::iri_fragment, event_stream_reader::string_type>
+      set(context, tag::iri_fragment(), a.string);
+    return dispatch_event_stream_paint_literal(a.literals[0], set);
+  }
+  case event_stream_signature_si:
+    return event_stream_call_set(context, 0, AttributeTag(), a.string, a.integer);
+  case event_stream_signature_fsi:
+    return event_stream_call_set(context, 0, AttributeTag(), tag::iri_fragment(), a.string, a.integer);
+  case event_stream_signature_bl:
+  {
+    event_stream_set_with_literal<Context, AttributeTag, bool> set(context, a.flags[0]);
+    return dispatch_event_stream_literal(a.literals[0], set);
+  }
+  case event_stream_signature_bll:
+  {
+    event_stream_set_preserve_aspect_ratio<Context, AttributeTag> set(context, a.flags[0], a.literals[1]);
+    return dispatch_event_stream_align_literal(a.literals[0], set);
+  }
+  case event_stream_signature_r:
+    return event_stream_call_set(context, 0, AttributeTag(), a.number_list);
+  case event_stream_signature_p:
+    return event_stream_call_set(context, 0, AttributeTag(), a.points());
+  case event_stream_signature_lnnnn:
+  {
+    event_stream_set_rect_or_new<Context, AttributeTag> set(context, a.numbers);
+    return dispatch_event_stream_literal(a.literals[0], set);
+  }
+  case event_stream_signature_lblblblb:
+    return event_stream_call_set(context, 0, AttributeTag(),
+      tag::value::underline(), a.flags[0], tag::value::overline(), a.flags[1],
+      tag::value::line_through(), a.flags[2], tag::value::blink(), a.flags[3]);
+  case event_stream_signature_ik:
+    return event_stream_call_set(context, 0, AttributeTag(), a.integer, tag::skip_icc_color());
+  case event_stream_signature_sik:
+    return event_stream_call_set(context, 0, AttributeTag(), a.string, a.integer, tag::skip_icc_color());
+  case event_stream_signature_fsik:
+    return event_stream_call_set(context, 0, AttributeTag(), tag::iri_fragment(), a.string, a.integer, 
+      tag::skip_icc_color());
+  default:
+    return false;
+  }
+}
+
+}
+
+// Passes events recorded by event_stream_writer to the context. Only attributes from ProcessedAttributes
+// (Associative Sequence of attribute tags) are passed, events not supported by the context are skipped.
+// Strings and number lists are passed as ranges pointing to the stream data, that must be aligned
+// to the size of double (e.g. be memory mapped file or allocated by 'new'), otherwise 
+// event_stream_error is thrown.
+template<class ProcessedAttributes>
+struct event_stream_player
+{
+  // Returns number of skipped events
+  template<class Context>
+  static std::size_t play(char const * data, std::size_t size, Context & context)
+  {
+    if (reinterpret_cast<std::size_t>(data) % sizeof(double) != 0)
+      throw event_stream_error("Event stream data isn't aligned to the size of double");
+    detail::event_stream_reader reader(data, data + size);
+    check_header(reader);
+
+    std::size_t skipped = 0;
+    while (!reader.eof())
+      if (!play_record(reader, context))
+        ++skipped;
+    return skipped;
+  }
+
+  // Passes single event at the reader position, returns false if event was skipped
+  template<class Context>
+  static bool play_event(detail::event_stream_reader & reader, Context & context)
+  {
+    return play_record(reader, context);
+  }
+
+private:
+  typedef detail::event_stream_reader reader_t;
+
+  static void check_header(reader_t & reader)
+  {
+    for(int i = 0; i < 8; ++i)
+      if (reader.read<char>() != detail::event_stream_magic[i])
+        throw event_stream_error("Not an SVG++ event stream");
+    if (reader.read<boost::uint16_t>() != detail::event_stream_version
+      || reader.read<boost::uint16_t>() != detail::element_type_count
+      || reader.read<boost::uint16_t>() != detail::attribute_count
+      || reader.read<boost::uint16_t>() != detail::event_stream_literal_count)
+      throw event_stream_error("Event stream was written by incompatible version");
+  }
+
+  template<class Context>
+  static bool play_record(reader_t & reader, Context & context)
+  {
+    int const op = reader.read<boost::uint8_t>();
+    switch (op)
+    {
+    case detail::event_stream_op_enter_element:
+      return play_enter_element(reader.read<boost::uint16_t>(), context);
+    case detail::event_stream_op_exit_element:
+      return detail::event_stream_call_on_exit_element(context, 0);
+    case detail::event_stream_op_set:
+      return play_set(reader, context);
+    case detail::event_stream_op_text:
+      return detail::event_stream_call_set_text(context, 0, reader.read_string());
+    case detail::event_stream_op_path_close_subpath:
+      return detail::event_stream_call_path_close_subpath(context, 0);
+    case detail::event_stream_op_path_exit:
+      return detail::event_stream_call_path_exit(context, 0);
+    case detail::event_stream_op_transform_matrix:
+    {
+      boost::array<double, 6> matrix;
+      for(int i = 0; i < 6; ++i)
+        matrix[i] = reader.read<double>();
+      return detail::event_stream_call_transform_matrix(context, 0, matrix);
+    }
+    case detail::event_stream_op_transform_translate:
+    {
+      double const tx = reader.read<double>();
+      return detail::event_stream_call_transform_translate(context, 0, tx, reader.read<double>());
+    }
+    case detail::event_stream_op_transform_translate_x:
+      return detail::event_stream_call_transform_translate(context, 0, reader.read<double>());
+    case detail::event_stream_op_transform_scale:
+    {
+      double const sx = reader.read<double>();
+      return detail::event_stream_call_transform_scale(context, 0, sx, reader.read<double>());
+    }
+    case detail::event_stream_op_transform_uniform_scale:
+      return detail::event_stream_call_transform_scale(context, 0, reader.read<double>());
+    case detail::event_stream_op_transform_rotate:
+      return detail::event_stream_call_transform_rotate(context, 0, reader.read<double>());
+    case detail::event_stream_op_transform_rotate_around:
+    {
+      double n[3];
+      read_numbers(reader, n, 3);
+      return detail::event_stream_call_transform_rotate(context, 0, n[0], n[1], n[2]);
+    }
+    case detail::event_stream_op_transform_skew_x:
+      return detail::event_stream_call_transform_skew_x(context, 0, reader.read<double>());
+    case detail::event_stream_op_transform_skew_y:
+      return detail::event_stream_call_transform_skew_y(context, 0, reader.read<double>());
+    default:
+      if (op >= detail::event_stream_op_path_move_to && op < detail::event_stream_op_path_close_subpath)
+      {
+        if (op & 1)
+          return play_path_segment(reader, context, op - 1, tag::coordinate::relative());
+        else
+          return play_path_segment(reader, context, op, tag::coordinate::absolute());
+      }
+      throw event_stream_error("Invalid event stream operation");
+    }
+  }
+
+  static void read_numbers(reader_t & reader, double * numbers, int count)
+  {
+    for(int i = 0; i < count; ++i)
+      numbers[i] = reader.read<double>();
+  }
+
+  template<class Context, class AbsoluteOrRelative>
+  static bool play_path_segment(reader_t & reader, Context & context, int op, AbsoluteOrRelative absoluteOrRelative)
+  {
+    double n[7];
+    switch (op)
+    {
+    case detail::event_stream_op_path_move_to:
+      read_numbers(reader, n, 2);
+      return detail::event_stream_call_path_move_to(context, 0, n[0], n[1], absoluteOrRelative);
+    case detail::event_stream_op_path_line_to:
+      read_numbers(reader, n, 2);
+      return detail::event_stream_call_path_line_to(context, 0, n[0], n[1], absoluteOrRelative);
+    case detail::event_stream_op_path_line_to_horizontal:
+      return detail::event_stream_call_path_line_to_ortho(context, 0, reader.read<double>(), true, absoluteOrRelative);
+    case detail::event_stream_op_path_line_to_vertical:
+      return detail::event_stream_call_path_line_to_ortho(context, 0, reader.read<double>(), false, absoluteOrRelative);
+    case detail::event_stream_op_path_cubic_bezier_to:
+      read_numbers(reader, n, 6);
+      return detail::event_stream_call_path_cubic_bezier_to(context, 0, n[0], n[1], n[2], n[3], n[4], n[5], absoluteOrRelative);
+    case detail::event_stream_op_path_cubic_bezier_short_to:
+      read_numbers(reader, n, 4);
+      return detail::event_stream_call_path_cubic_bezier_to(context, 0, n[0], n[1], n[2], n[3], absoluteOrRelative);
+    case detail::event_stream_op_path_quadratic_bezier_to:
+      read_numbers(reader, n, 4);
+      return detail::event_stream_call_path_quadratic_bezier_to(context, 0, n[0], n[1], n[2], n[3], absoluteOrRelative);
+    case detail::event_stream_op_path_quadratic_bezier_short_to:
+      read_numbers(reader, n, 2);
+      return detail::event_stream_call_path_quadratic_bezier_to(context, 0, n[0], n[1], absoluteOrRelative);
+    case detail::event_stream_op_path_elliptical_arc_to:
+    {
+      read_numbers(reader, n, 3);
+      int const flags = reader.read<boost::uint8_t>();
+      read_numbers(reader, n + 3, 2);
+      return detail::event_stream_call_path_elliptical_arc_to(context, 0, n[0], n[1], n[2],
+        (flags & 1) != 0, (flags & 2) != 0, n[3], n[4], absoluteOrRelative);
+    }
+    default:
+      throw event_stream_error("Invalid event stream operation");
+    }
+  }
+
+  template<class Context>
+  static bool play_enter_element(unsigned id, Context & context)
+  {
+    switch (id)
+    {
+#define SVGPP_ON(element_name, str) \
+    case detail::element_type_id_## element_name: \
+      return detail::event_stream_call_on_enter_element(context, 0, tag::element::element_name());
+#include <svgpp/detail/dict/enumerate_all_elements.inc>
+#undef SVGPP_ON
+    default:
+      throw event_stream_error("Invalid element id in event stream");
+    }
+  }
+
+  template<class Context>
+  static bool play_set(reader_t & reader, Context & context)
+  {
+    unsigned const id = reader.read<boost::uint16_t>();
+    int const signature = reader.read<boost::uint8_t>();
+    if (signature >= detail::event_stream_signature_count)
+      throw event_stream_error("Invalid event stream signature");
+    detail::event_stream_args args;
+    read_args(reader, signature, args);
+
+    switch (id)
+    {
+#define SVGPP_ON(attribute_name, attribute_string) \
+    case detail::attribute_id_## attribute_name: \
+      return play_attribute<tag::attribute::attribute_name>(context, signature, args);
+#define SVGPP_ON_NS(ns, attribute_name, attribute_string) \
+    case detail::attribute_id_## ns ## _ ## attribute_name: \
+      return play_attribute<tag::attribute::ns::attribute_name>(context, signature, args);
+#define SVGPP_ON_STYLE(attribute_name, attribute_string) SVGPP_ON(attribute_name, attribute_string)
+#include <svgpp/detail/dict/enumerate_all_attributes.inc>
+#undef SVGPP_ON
+#undef SVGPP_ON_NS
+#undef SVGPP_ON_STYLE
+    default:
+      throw event_stream_error("Invalid attribute id in event stream");
+    }
+  }
+
+  template<class AttributeTag, class Context>
+  static bool play_attribute(Context & context, int signature, detail::event_stream_args const & args,
+    typename boost::enable_if<boost::mpl::has_key<ProcessedAttributes, AttributeTag> >::type * = NULL)
+  {
+    return detail::play_event_stream_set<Context, AttributeTag>(context, signature, args);
+  }
+
+  template<class AttributeTag, class Context>
+  static bool play_attribute(Context &, int, detail::event_stream_args const &,
+    typename boost::disable_if<boost::mpl::has_key<ProcessedAttributes, AttributeTag> >::type * = NULL)
+  {
+    return false;
+  }
+
+  static void read_args(reader_t & reader, int signature, detail::event_stream_args & args)
+  {
+    int numbers = 0, flags = 0, literals = 0;
+    for(char const * code = detail::event_stream_signature_codes(signature); *code; ++code)
+      switch (*code)
+      {
+      case 'n': args.numbers[numbers++] = reader.read<double>(); break;
+      case 'i': args.integer = reader.read<boost::int32_t>(); break;
+      case 'b': args.flags[flags++] = reader.read<boost::uint8_t>() != 0; break;
+      case 'l': args.literals[literals++] = reader.read<boost::uint16_t>(); break;
+      case 's': args.string = reader.read_string(); break;
+      case 'r': args.number_list = reader.read_number_list(); break;
+      case 'p': 
+        args.number_list = reader.read_number_list(); 
+        // Points are iterated by pairs
+        if (args.number_list.size() % 2 != 0)
+          throw event_stream_error("Odd number of coordinates in list of points");
+        break;
+      }
+  }
+};
+
+}
+
+#undef SVGPP_EVENT_STREAM_EXTRA_LITERALS
@@ -0,0 +1,146 @@
+// Copyright Oleg Maximenko 2014.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://github.com/svgpp/svgpp for library home page.
+
+#pragma once
+
+#include <svgpp/number_type.hpp>
+#include <boost/config.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/type_traits/is_arithmetic.hpp>
+#include <boost/type_traits/is_floating_point.hpp>
+#include <boost/utility/enable_if.hpp>
+#include <boost/spirit/include/qi_numeric.hpp>
+
+#if defined(BOOST_NO_CXX11_EXPLICIT_CONVERSION_OPERATORS)
+#error svgpp::fixed_point requires explicit conversion operators support
+#endif
+
+namespace svgpp
+{
+
+// Signed fixed-point number stored in 32 bits with FractionBits bits after the binary point.
+// Values are implicitly constructed from arithmetic types (rounding to nearest) and explicitly
+// converted to floating point types. Overflow isn't checked.
+template<int FractionBits>
+class fixed_point
+{
+  BOOST_STATIC_ASSERT(FractionBits > 0 && FractionBits < 31);
+
+public:
+  typedef boost::int32_t storage_type;
+
+  static const storage_type one = storage_type(1) << FractionBits;
+
+  fixed_point()
+    : raw_(0)
+  {}
+
+  template<class Number>
+  fixed_point(Number value, typename boost::enable_if<boost::is_arithmetic<Number> >::type * = NULL)
+    : raw_(from_number(value, boost::is_floating_point<Number>()))
+  {}
+
+  static fixed_point from_raw(storage_type raw)
+  {
+    fixed_point result;
+    result.raw_ = raw;
+    return result;
+  }
+
+  storage_type raw() const { return raw_; }
+
+  explicit operator double() const { return static_cast<double>(raw_) / one; }
+  explicit operator float() const { return static_cast<float>(raw_) / one; }
+
+  fixed_point operator-() const { return from_raw(-raw_); }
+  fixed_point operator+() const { return *this; }
+
+  fixed_point & operator+=(fixed_point rhs) { raw_ += rhs.raw_; return *this; }
+  fixed_point & operator-=(fixed_point rhs) { raw_ -= rhs.raw_; return *this; }
+  fixed_point & operator*=(fixed_point rhs) { raw_ = multiply(raw_, rhs.raw_); return *this; }
+  fixed_point & operator/=(fixed_point rhs) { raw_ = divide(raw_, rhs.raw_); return *this; }
+
+  friend fixed_point operator+(fixed_point lhs, fixed_point rhs) { return lhs += rhs; }
+  friend fixed_point operator-(fixed_point lhs, fixed_point rhs) { return lhs -= rhs; }
+  friend fixed_point operator*(fixed_point lhs, fixed_point rhs) { return lhs *= rhs; }
+  friend fixed_point operator/(fixed_point lhs, fixed_point rhs) { return lhs /= rhs; }
+
+  friend bool operator==(fixed_point lhs, fixed_point rhs) { return lhs.raw_ == rhs.raw_; }
+  friend bool operator!=(fixed_point lhs, fixed_point rhs) { return lhs.raw_ != rhs.raw_; }
+  friend bool operator<(fixed_point lhs, fixed_point rhs) { return lhs.raw_ < rhs.raw_; }
+  friend bool operator>(fixed_point lhs, fixed_point rhs) { return lhs.raw_ > rhs.raw_; }
+  friend bool operator<=(fixed_point lhs, fixed_point rhs) { return lhs.raw_ <= rhs.raw_; }
+  friend bool operator>=(fixed_point lhs, fixed_point rhs) { return lhs.raw_ >= rhs.raw_; }
+
+private:
+  typedef boost::int64_t wide_type;
+
+  storage_type raw_;
+
+  template<class Number>
+  static storage_type from_number(Number value, boost::true_type /*is_floating_point*/)
+  {
+    value *= one;
+    return static_cast<storage_type>(value < 0 ? value - Number(0.5) : value + Number(0.5));
+  }
+
+  template<class Number>
+  static storage_type from_number(Number value, boost::false_type /*is_floating_point*/)
+  {
+    return static_cast<storage_type>(value) << FractionBits;
+  }
+
+  static storage_type multiply(storage_type lhs, storage_type rhs)
+  {
+    wide_type const product = static_cast<wide_type>(lhs) * rhs;
+    return static_cast<storage_type>((product + (one >> 1)) >> FractionBits);
+  }
+
+  static storage_type divide(storage_type lhs, storage_type rhs)
+  {
+    // Rounds half away from zero
+    wide_type numerator = static_cast<wide_type>(lhs) * one;
+    wide_type denominator = rhs;
+    bool const negative = (numerator < 0) != (denominator < 0);
+    if (numerator < 0) numerator = -numerator;
+    if (denominator < 0) denominator = -denominator;
+    wide_type const quotient = (numerator + denominator / 2) / denominator;
+    return static_cast<storage_type>(negative ? -quotient : quotient);
+  }
+};
+
+typedef fixed_point<8> fixed_24_8;
+
+// Angles, radii and other intermediate values lose too much precision in fixed-point
+template<int FractionBits>
+struct calculation_number_type<fixed_point<FractionBits> >
+{
+  typedef double type;
+};
+
+}
+
+namespace boost { namespace spirit { namespace qi { namespace detail
+{
+  // Numbers are parsed as double and rounded once, otherwise mantissa accumulated in
+  // fixed-point overflows on long fractions
+  template<int FractionBits, class RealPolicies>
+  struct real_impl<svgpp::fixed_point<FractionBits>, RealPolicies>
+  {
+    template <class Iterator, class Attribute>
+    static bool parse(Iterator & first, Iterator const & last, Attribute & attr,
+      RealPolicies const & policies)
+    {
+      double value;
+      if (!real_impl<double, RealPolicies>::parse(first, last, value, policies))
+        return false;
+      spirit::traits::assign_to(svgpp::fixed_point<FractionBits>(value), attr);
+      return true;
+    }
+  };
+}}}}
@@ -9,6 +9,8 @@
 
 #include <svgpp/definitions.hpp>
 #include <svgpp/utility/gil/common.hpp>
+#include <svgpp/utility/gil/simd.hpp>
+#include <boost/gil/algorithm.hpp>
 #include <boost/gil/channel_algorithm.hpp>
 #include <boost/gil/color_base_algorithm.hpp>
 
@@ -144,4 +146,17 @@ struct blend_pixel
   }
 };
 
+// Same as gil::transform_pixels(src_a, src_b, dst, blend_pixel<BlendModeTag>()).
+// Rows of 8-bit RGBA views are processed with SIMD kernels
+template<class BlendModeTag, class SrcView1, class SrcView2, class DstView>
+void blend_pixels(SrcView1 const & src_a, SrcView2 const & src_b, DstView const & dst)
+{
+#if defined(SVGPP_GIL_SIMD)
+  gil_detail::simd::transform_pixels(src_a, src_b, dst,
+    blend_pixel<BlendModeTag>(), gil_detail::simd::blend_row_fn<BlendModeTag>());
+#else
+  boost::gil::transform_pixels(src_a, src_b, dst, blend_pixel<BlendModeTag>());
+#endif
+}
+
 }}
@@ -7,10 +7,15 @@
 
 #pragma once
 
+#include <svgpp/utility/gil/simd.hpp>
 #include <cmath>
+#include <boost/gil/algorithm.hpp>
+#include <boost/gil/channel.hpp>
 #include <boost/gil/color_base_algorithm.hpp>
 #include <boost/gil/rgba.hpp>
+#include <boost/mpl/bool.hpp>
 #include <boost/multi_array.hpp>
+#include <boost/type_traits/is_same.hpp>
 
 namespace svgpp { namespace gil_utility {
 
@@ -35,25 +40,71 @@ public:
 
   Color operator()(const Color & color) const 
   {
-    // TODO integer optimization
     namespace gil = boost::gil;
+    typedef typename gil::color_element_type<Color, gil::red_t>::type channel_t;
     Color result;
-    typename gil::color_element_type<Color, gil::red_t>::type 
+    channel_t
       r = gil::get_color(color, gil::red_t()),
       g = gil::get_color(color, gil::green_t()),
       b = gil::get_color(color, gil::blue_t()),
       a = gil::get_color(color, gil::alpha_t());
-    gil::get_color(result, gil::red_t())    = matrix_[0][0] * r + matrix_[0][1] * g + matrix_[0][2] * b + matrix_[0][3] * a + matrix_[0][4];
-    gil::get_color(result, gil::green_t())  = matrix_[1][0] * r + matrix_[1][1] * g + matrix_[1][2] * b + matrix_[1][3] * a + matrix_[1][4];
-    gil::get_color(result, gil::blue_t())   = matrix_[2][0] * r + matrix_[2][1] * g + matrix_[2][2] * b + matrix_[2][3] * a + matrix_[2][4];
-    gil::get_color(result, gil::alpha_t())  = matrix_[3][0] * r + matrix_[3][1] * g + matrix_[3][2] * b + matrix_[3][3] * a + matrix_[3][4];
+    gil::get_color(result, gil::red_t())    = to_channel<channel_t>(matrix_[0][0] * r + matrix_[0][1] * g + matrix_[0][2] * b + matrix_[0][3] * a + matrix_[0][4]);
+    gil::get_color(result, gil::green_t())  = to_channel<channel_t>(matrix_[1][0] * r + matrix_[1][1] * g + matrix_[1][2] * b + matrix_[1][3] * a + matrix_[1][4]);
+    gil::get_color(result, gil::blue_t())   = to_channel<channel_t>(matrix_[2][0] * r + matrix_[2][1] * g + matrix_[2][2] * b + matrix_[2][3] * a + matrix_[2][4]);
+    gil::get_color(result, gil::alpha_t())  = to_channel<channel_t>(matrix_[3][0] * r + matrix_[3][1] * g + matrix_[3][2] * b + matrix_[3][3] * a + matrix_[3][4]);
     return result;
   }
 
+  // Always 4x5
+  matrix_t const & matrix() const { return matrix_; }
+
 private:
   matrix_t matrix_;
+
+  // Clamps to channel range (NaN becomes minimum) and truncates
+  template<class Channel>
+  static Channel to_channel(Scalar value)
+  {
+    Scalar const min_value = boost::gil::channel_traits<Channel>::min_value();
+    Scalar const max_value = boost::gil::channel_traits<Channel>::max_value();
+    return static_cast<Channel>(value > min_value ? (value < max_value ? value : max_value) : min_value);
+  }
 };
 
+namespace detail
+{
+  template<class SrcView, class DstView, class Color, class Scalar>
+  void color_matrix_pixels(SrcView const & src, DstView const & dst, 
+    color_matrix_transform<Color, Scalar> const & transform, boost::mpl::false_)
+  {
+    boost::gil::transform_pixels(src, dst, transform);
+  }
+
+#if defined(SVGPP_GIL_SIMD)
+  template<class SrcView, class DstView, class Color>
+  void color_matrix_pixels(SrcView const & src, DstView const & dst, 
+    color_matrix_transform<Color, double> const & transform, boost::mpl::true_)
+  {
+    gil_detail::simd::transform_pixels(src, dst, transform, 
+      gil_detail::simd::color_matrix_row_fn(transform.matrix()));
+  }
+#endif
+}
+
+// Same as gil::transform_pixels(src, dst, transform).
+// Rows of 8-bit RGBA views are processed with SIMD kernels if Scalar is double
+template<class SrcView, class DstView, class Color, class Scalar>
+void color_matrix_pixels(SrcView const & src, DstView const & dst, color_matrix_transform<Color, Scalar> const & transform)
+{
+  detail::color_matrix_pixels(src, dst, transform, 
+#if defined(SVGPP_GIL_SIMD)
+    boost::mpl::bool_<boost::is_same<Scalar, double>::value>()
+#else
+    boost::mpl::false_()
+#endif
+    );
+}
+
 // A saturate operation is equivalent to the following matrix operation:
 // | R' |     |0.213+0.787s  0.715-0.715s  0.072-0.072s 0  0 |   | R |
 // | G' |     |0.213-0.213s  0.715+0.285s  0.072-0.072s 0  0 |   | G |
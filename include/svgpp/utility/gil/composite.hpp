@@ -9,6 +9,8 @@
 
 #include <svgpp/definitions.hpp>
 #include <svgpp/utility/gil/common.hpp>
+#include <svgpp/utility/gil/simd.hpp>
+#include <boost/gil/algorithm.hpp>
 #include <boost/gil/channel_algorithm.hpp>
 #include <boost/gil/color_base_algorithm.hpp>
 
@@ -159,6 +161,12 @@ struct composite_arithmetic_channel_fn<boost::uint8_t>
     return clamp_channel_bits8(k1_ * channel_a * channel_b / 65535 + k2_ * channel_a / 255 + k3_ * channel_b / 255 + k4_);
   }
 
+  // Coefficients multiplied by 255
+  int k1() const { return k1_; }
+  int k2() const { return k2_; }
+  int k3() const { return k3_; }
+  int k4() const { return k4_; }
+
 private:
   int k1_, k2_, k3_, k4_;
 };
@@ -232,4 +240,32 @@ private:
   gil_detail::composite_arithmetic_channel_fn<typename gil::color_element_type<Color, gil::alpha_t>::type> a_;
 };
 
+// Same as gil::transform_pixels(src_a, src_b, dst, composite_pixel<CompositeModeTag>()).
+// Rows of 8-bit RGBA views are processed with SIMD kernels
+template<class CompositeModeTag, class SrcView1, class SrcView2, class DstView>
+void composite_pixels(SrcView1 const & src_a, SrcView2 const & src_b, DstView const & dst)
+{
+#if defined(SVGPP_GIL_SIMD)
+  gil_detail::simd::transform_pixels(src_a, src_b, dst,
+    composite_pixel<CompositeModeTag>(), gil_detail::simd::composite_row_fn<CompositeModeTag>());
+#else
+  gil::transform_pixels(src_a, src_b, dst, composite_pixel<CompositeModeTag>());
+#endif
+}
+
+// Same as gil::transform_pixels(src_a, src_b, dst, composite_pixel_arithmetic<...>(k1, k2, k3, k4))
+template<class SrcView1, class SrcView2, class DstView, class Coefficient>
+void composite_pixels_arithmetic(SrcView1 const & src_a, SrcView2 const & src_b, DstView const & dst,
+  Coefficient k1, Coefficient k2, Coefficient k3, Coefficient k4)
+{
+  composite_pixel_arithmetic<typename DstView::value_type> const pixel_fn(k1, k2, k3, k4);
+#if defined(SVGPP_GIL_SIMD)
+  gil_detail::composite_arithmetic_channel_fn<boost::uint8_t> const channel_fn(k1, k2, k3, k4);
+  gil_detail::simd::transform_pixels(src_a, src_b, dst, pixel_fn,
+    gil_detail::simd::composite_arithmetic_row_fn(channel_fn.k1(), channel_fn.k2(), channel_fn.k3(), channel_fn.k4()));
+#else
+  gil::transform_pixels(src_a, src_b, dst, pixel_fn);
+#endif
+}
+
 }}
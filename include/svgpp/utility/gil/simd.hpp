@@ -0,0 +1,449 @@
+// Copyright Oleg Maximenko 2014.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://github.com/svgpp/svgpp for library home page.
+
+#pragma once
+
+// SIMD kernels for 8-bit RGBA pixel operations used by blend.hpp, composite.hpp and color_matrix.hpp.
+// SSE2 is used as a baseline on x86 and x86-64, AVX2 version is selected at runtime if CPU supports it.
+// Kernels reproduce integer arithmetic of scalar implementations exactly, so results are bit-exact.
+// Define SVGPP_GIL_NO_SIMD to use only scalar code, SVGPP_GIL_NO_AVX2 to use only SSE2 kernels.
+
+#include <svgpp/definitions.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/gil/algorithm.hpp>
+#include <boost/gil/typedefs.hpp>
+#include <boost/mpl/and.hpp>
+#include <boost/type_traits/is_pointer.hpp>
+#include <boost/type_traits/is_same.hpp>
+#include <algorithm>
+#include <cstddef>
+
+#if !defined(SVGPP_GIL_NO_SIMD) \
+  && (defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+# define SVGPP_GIL_SIMD
+#endif
+
+#if defined(SVGPP_GIL_SIMD) && !defined(SVGPP_GIL_NO_AVX2)
+# if defined(__clang__)
+#   if __clang_major__ >= 9
+#     define SVGPP_GIL_SIMD_AVX2
+#   endif
+# elif defined(__GNUC__)
+#   if __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9)
+#     define SVGPP_GIL_SIMD_AVX2
+#   endif
+# elif defined(_MSC_VER) && _MSC_VER >= 1800
+#   define SVGPP_GIL_SIMD_AVX2
+# endif
+#endif
+
+#if defined(SVGPP_GIL_SIMD)
+
+#include <emmintrin.h>
+#if defined(SVGPP_GIL_SIMD_AVX2)
+# include <immintrin.h>
+# if defined(_MSC_VER) && !defined(__clang__)
+#   include <intrin.h>
+# endif
+#endif
+
+namespace svgpp { namespace gil_detail { namespace simd
+{
+
+// Pixel is unpacked to 4 32-bit lanes, one per channel. Multiplications and divisions
+// are done in 32 bits, so intermediate values of scalar formulas fit without overflow.
+// Division by 255 and 65535 is replaced by exact multiplication by reciprocal.
+
+namespace sse2
+{
+
+typedef __m128i vec;
+
+// Number of pixels in vec
+static const std::size_t vec_pixels = 1;
+
+inline vec vset1(int value) { return _mm_set1_epi32(value); }
+inline vec vadd(vec a, vec b) { return _mm_add_epi32(a, b); }
+inline vec vsub(vec a, vec b) { return _mm_sub_epi32(a, b); }
+inline vec vxor(vec a, vec b) { return _mm_xor_si128(a, b); }
+// All ones in negative lanes
+inline vec vsign(vec a) { return _mm_srai_epi32(a, 31); }
+
+// Low 32 bits of products (SSE2 lacks pmulld)
+inline vec vmul(vec a, vec b)
+{
+  vec const even = _mm_mul_epu32(a, b);
+  vec const odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+  return _mm_unpacklo_epi32(
+    _mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+    _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+inline vec vmin(vec a, vec b)
+{
+  vec const greater = _mm_cmpgt_epi32(a, b);
+  return _mm_or_si128(_mm_and_si128(greater, b), _mm_andnot_si128(greater, a));
+}
+
+inline vec vmax(vec a, vec b)
+{
+  vec const greater = _mm_cmpgt_epi32(a, b);
+  return _mm_or_si128(_mm_and_si128(greater, a), _mm_andnot_si128(greater, b));
+}
+
+// (x * Magic) >> Shift for unsigned 32-bit lanes, Shift >= 32
+template<unsigned Magic, int Shift>
+inline vec vmulhi_shift(vec x)
+{
+  vec const magic = _mm_set1_epi32(int(Magic));
+  vec const even = _mm_srli_epi64(_mm_mul_epu32(x, magic), Shift);
+  vec const odd = _mm_srli_epi64(_mm_mul_epu32(_mm_srli_epi64(x, 32), magic), Shift);
+  return _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+}
+
+inline vec vbroadcast_alpha(vec pixel) { return _mm_shuffle_epi32(pixel, _MM_SHUFFLE(3, 3, 3, 3)); }
+
+// Color channels from 'color' and alpha channel from 'alpha'
+inline vec vmerge_alpha(vec color, vec alpha)
+{
+  vec const mask = _mm_set_epi32(-1, 0, 0, 0);
+  return _mm_or_si128(_mm_and_si128(mask, alpha), _mm_andnot_si128(mask, color));
+}
+
+// Loads 4 * vec_pixels pixels
+inline void vload(boost::uint8_t const * src, vec (&pixels)[4])
+{
+  vec const zero = _mm_setzero_si128();
+  vec const packed = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src));
+  vec const lo = _mm_unpacklo_epi8(packed, zero), hi = _mm_unpackhi_epi8(packed, zero);
+  pixels[0] = _mm_unpacklo_epi16(lo, zero);
+  pixels[1] = _mm_unpackhi_epi16(lo, zero);
+  pixels[2] = _mm_unpacklo_epi16(hi, zero);
+  pixels[3] = _mm_unpackhi_epi16(hi, zero);
+}
+
+// Stores 4 * vec_pixels pixels, channels are clamped to 0..255
+inline void vstore(boost::uint8_t * dst, vec const (&pixels)[4])
+{
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_packus_epi16(
+    _mm_packs_epi32(pixels[0], pixels[1]), _mm_packs_epi32(pixels[2], pixels[3])));
+}
+
+// 4 doubles, one per output channel
+struct dvec
+{
+  __m128d lo, hi;
+};
+
+inline dvec dset1(double value)
+{
+  dvec result = { _mm_set1_pd(value), _mm_set1_pd(value) };
+  return result;
+}
+
+inline dvec dload(double const * src)
+{
+  dvec result = { _mm_loadu_pd(src), _mm_loadu_pd(src + 2) };
+  return result;
+}
+
+inline dvec dadd(dvec a, dvec b)
+{
+  dvec result = { _mm_add_pd(a.lo, b.lo), _mm_add_pd(a.hi, b.hi) };
+  return result;
+}
+
+inline dvec dmul(dvec a, dvec b)
+{
+  dvec result = { _mm_mul_pd(a.lo, b.lo), _mm_mul_pd(a.hi, b.hi) };
+  return result;
+}
+
+// Clamps to 0..255 (NaN becomes 0) and truncates
+inline __m128i dtruncate_channels(dvec a)
+{
+  __m128d const zero = _mm_setzero_pd(), max = _mm_set1_pd(255);
+  return _mm_unpacklo_epi64(
+    _mm_cvttpd_epi32(_mm_min_pd(_mm_max_pd(a.lo, zero), max)),
+    _mm_cvttpd_epi32(_mm_min_pd(_mm_max_pd(a.hi, zero), max)));
+}
+
+#include <svgpp/utility/gil/simd_kernels.inc>
+
+} // namespace sse2
+
+#if defined(SVGPP_GIL_SIMD_AVX2)
+
+#if defined(__clang__)
+# pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+# pragma GCC push_options
+# pragma GCC target("avx2")
+#endif
+
+namespace avx2
+{
+
+typedef __m256i vec;
+
+static const std::size_t vec_pixels = 2;
+
+inline vec vset1(int value) { return _mm256_set1_epi32(value); }
+inline vec vadd(vec a, vec b) { return _mm256_add_epi32(a, b); }
+inline vec vsub(vec a, vec b) { return _mm256_sub_epi32(a, b); }
+inline vec vxor(vec a, vec b) { return _mm256_xor_si256(a, b); }
+inline vec vsign(vec a) { return _mm256_srai_epi32(a, 31); }
+inline vec vmul(vec a, vec b) { return _mm256_mullo_epi32(a, b); }
+inline vec vmin(vec a, vec b) { return _mm256_min_epi32(a, b); }
+inline vec vmax(vec a, vec b) { return _mm256_max_epi32(a, b); }
+
+template<unsigned Magic, int Shift>
+inline vec vmulhi_shift(vec x)
+{
+  vec const magic = _mm256_set1_epi32(int(Magic));
+  vec const even = _mm256_srli_epi64(_mm256_mul_epu32(x, magic), Shift);
+  vec const odd = _mm256_srli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), magic), Shift);
+  return _mm256_or_si256(even, _mm256_slli_epi64(odd, 32));
+}
+
+// Each 128-bit lane contains one pixel
+inline vec vbroadcast_alpha(vec pixel) { return _mm256_shuffle_epi32(pixel, _MM_SHUFFLE(3, 3, 3, 3)); }
+
+inline vec vmerge_alpha(vec color, vec alpha)
+{
+  return _mm256_blend_epi32(color, alpha, 0x88);
+}
+
+// Unpacking and packing instructions work within 128-bit lanes, so pixels order in vec is
+// {0, 4}, {1, 5}, {2, 6}, {3, 7}. vstore restores original order.
+inline void vload(boost::uint8_t const * src, vec (&pixels)[4])
+{
+  vec const zero = _mm256_setzero_si256();
+  vec const packed = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(src));
+  vec const lo = _mm256_unpacklo_epi8(packed, zero), hi = _mm256_unpackhi_epi8(packed, zero);
+  pixels[0] = _mm256_unpacklo_epi16(lo, zero);
+  pixels[1] = _mm256_unpackhi_epi16(lo, zero);
+  pixels[2] = _mm256_unpacklo_epi16(hi, zero);
+  pixels[3] = _mm256_unpackhi_epi16(hi, zero);
+}
+
+inline void vstore(boost::uint8_t * dst, vec const (&pixels)[4])
+{
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm256_packus_epi16(
+    _mm256_packs_epi32(pixels[0], pixels[1]), _mm256_packs_epi32(pixels[2], pixels[3])));
+}
+
+typedef __m256d dvec;
+
+inline dvec dset1(double value) { return _mm256_set1_pd(value); }
+inline dvec dload(double const * src) { return _mm256_loadu_pd(src); }
+inline dvec dadd(dvec a, dvec b) { return _mm256_add_pd(a, b); }
+inline dvec dmul(dvec a, dvec b) { return _mm256_mul_pd(a, b); }
+
+inline __m128i dtruncate_channels(dvec a)
+{
+  return _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(a, _mm256_setzero_pd()), _mm256_set1_pd(255)));
+}
+
+#include <svgpp/utility/gil/simd_kernels.inc>
+
+} // namespace avx2
+
+#if defined(__clang__)
+# pragma clang attribute pop
+#elif defined(__GNUC__)
+# pragma GCC pop_options
+#endif
+
+inline bool detect_avx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+  __cpuid(info, 1);
+  // OSXSAVE and AVX
+  if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+    return false;
+  // OS saves XMM and YMM registers
+  if ((_xgetbv(0) & 6) != 6)
+    return false;
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+inline bool cpu_supports_avx2()
+{
+  static bool const supported = detect_avx2();
+  return supported;
+}
+
+// AVX2 kernels are used by default if CPU supports them. May be reset to compare
+// implementations (not thread-safe)
+inline bool & use_avx2()
+{
+  static bool value = cpu_supports_avx2();
+  return value;
+}
+
+#endif // defined(SVGPP_GIL_SIMD_AVX2)
+
+// Row functions process as many pixels from the row start as kernel handles at once,
+// and return the number of processed pixels. The rest must be processed by scalar code.
+
+template<class BlendModeTag>
+struct blend_row_fn
+{
+  std::size_t operator()(boost::uint8_t const * src_a, boost::uint8_t const * src_b, boost::uint8_t * dst, std::size_t width) const
+  {
+#if defined(SVGPP_GIL_SIMD_AVX2)
+    if (use_avx2())
+      return avx2::blend_row<BlendModeTag>(src_a, src_b, dst, width);
+#endif
+    return sse2::blend_row<BlendModeTag>(src_a, src_b, dst, width);
+  }
+};
+
+template<class CompositeModeTag>
+struct composite_row_fn
+{
+  std::size_t operator()(boost::uint8_t const * src_a, boost::uint8_t const * src_b, boost::uint8_t * dst, std::size_t width) const
+  {
+#if defined(SVGPP_GIL_SIMD_AVX2)
+    if (use_avx2())
+      return avx2::composite_row<CompositeModeTag>(src_a, src_b, dst, width);
+#endif
+    return sse2::composite_row<CompositeModeTag>(src_a, src_b, dst, width);
+  }
+};
+
+// Coefficients are pre-multiplied by 255, as in composite_arithmetic_channel_fn
+struct composite_arithmetic_row_fn
+{
+  composite_arithmetic_row_fn(int k1, int k2, int k3, int k4)
+    : k1_(k1), k2_(k2), k3_(k3), k4_(k4)
+  {}
+
+  std::size_t operator()(boost::uint8_t const * src_a, boost::uint8_t const * src_b, boost::uint8_t * dst, std::size_t width) const
+  {
+#if defined(SVGPP_GIL_SIMD_AVX2)
+    if (use_avx2())
+      return avx2::composite_arithmetic_row(src_a, src_b, dst, width, k1_, k2_, k3_, k4_);
+#endif
+    return sse2::composite_arithmetic_row(src_a, src_b, dst, width, k1_, k2_, k3_, k4_);
+  }
+
+private:
+  int k1_, k2_, k3_, k4_;
+};
+
+// 4x5 matrix is stored by columns: 'columns[j][i]' is a coefficient of j-th input channel (or 1)
+// in i-th output channel
+struct color_matrix_row_fn
+{
+  template<class Matrix>
+  explicit color_matrix_row_fn(Matrix const & matrix)
+  {
+    for(int i = 0; i < 4; ++i)
+      for(int j = 0; j < 5; ++j)
+        columns_[j][i] = matrix[i][j];
+  }
+
+  std::size_t operator()(boost::uint8_t const * src, boost::uint8_t * dst, std::size_t width) const
+  {
+#if defined(SVGPP_GIL_SIMD_AVX2)
+    if (use_avx2())
+      return avx2::color_matrix_row(src, dst, width, columns_);
+#endif
+    return sse2::color_matrix_row(src, dst, width, columns_);
+  }
+
+private:
+  double columns_[5][4];
+};
+
+namespace gil = boost::gil;
+
+// Kernels work with interleaved 8-bit RGBA without padding between pixels
+template<class View>
+struct is_rgba8_view: boost::mpl::and_<
+  boost::is_pointer<typename View::x_iterator>,
+  boost::is_same<typename View::value_type, gil::rgba8_pixel_t>
+>
+{};
+
+template<class SrcView1, class SrcView2, class DstView, class PixelFn, class RowFn>
+void transform_pixels(SrcView1 const & src_a, SrcView2 const & src_b, DstView const & dst,
+  PixelFn const & pixel_fn, RowFn const & row_fn, boost::mpl::true_)
+{
+  std::size_t const width = dst.width();
+  for(std::ptrdiff_t y = 0; y < dst.height(); ++y)
+  {
+    typename SrcView1::x_iterator const a = src_a.row_begin(y);
+    typename SrcView2::x_iterator const b = src_b.row_begin(y);
+    typename DstView::x_iterator const d = dst.row_begin(y);
+    std::size_t const processed = row_fn(
+      reinterpret_cast<boost::uint8_t const *>(a), reinterpret_cast<boost::uint8_t const *>(b),
+      reinterpret_cast<boost::uint8_t *>(d), width);
+    std::transform(a + processed, a + width, b + processed, d + processed, pixel_fn);
+  }
+}
+
+template<class SrcView1, class SrcView2, class DstView, class PixelFn, class RowFn>
+void transform_pixels(SrcView1 const & src_a, SrcView2 const & src_b, DstView const & dst,
+  PixelFn const & pixel_fn, RowFn const &, boost::mpl::false_)
+{
+  gil::transform_pixels(src_a, src_b, dst, pixel_fn);
+}
+
+// Same as gil::transform_pixels(src_a, src_b, dst, pixel_fn), but uses row_fn for 8-bit RGBA views
+template<class SrcView1, class SrcView2, class DstView, class PixelFn, class RowFn>
+void transform_pixels(SrcView1 const & src_a, SrcView2 const & src_b, DstView const & dst,
+  PixelFn const & pixel_fn, RowFn const & row_fn)
+{
+  transform_pixels(src_a, src_b, dst, pixel_fn, row_fn,
+    typename boost::mpl::and_<is_rgba8_view<SrcView1>, is_rgba8_view<SrcView2>, is_rgba8_view<DstView> >::type());
+}
+
+template<class SrcView, class DstView, class PixelFn, class RowFn>
+void transform_pixels(SrcView const & src, DstView const & dst,
+  PixelFn const & pixel_fn, RowFn const & row_fn, boost::mpl::true_)
+{
+  std::size_t const width = dst.width();
+  for(std::ptrdiff_t y = 0; y < dst.height(); ++y)
+  {
+    typename SrcView::x_iterator const s = src.row_begin(y);
+    typename DstView::x_iterator const d = dst.row_begin(y);
+    std::size_t const processed = row_fn(
+      reinterpret_cast<boost::uint8_t const *>(s), reinterpret_cast<boost::uint8_t *>(d), width);
+    std::transform(s + processed, s + width, d + processed, pixel_fn);
+  }
+}
+
+template<class SrcView, class DstView, class PixelFn, class RowFn>
+void transform_pixels(SrcView const & src, DstView const & dst,
+  PixelFn const & pixel_fn, RowFn const &, boost::mpl::false_)
+{
+  gil::transform_pixels(src, dst, pixel_fn);
+}
+
+template<class SrcView, class DstView, class PixelFn, class RowFn>
+void transform_pixels(SrcView const & src, DstView const & dst,
+  PixelFn const & pixel_fn, RowFn const & row_fn)
+{
+  transform_pixels(src, dst, pixel_fn, row_fn,
+    typename boost::mpl::and_<is_rgba8_view<SrcView>, is_rgba8_view<DstView> >::type());
+}
+
+}}}
+
+#endif // defined(SVGPP_GIL_SIMD)
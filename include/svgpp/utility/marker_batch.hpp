@@ -0,0 +1,173 @@
+// Copyright Oleg Maximenko 2014.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://github.com/svgpp/svgpp for library home page.
+
+#pragma once
+
+#include <svgpp/adapter/path_markers.hpp>
+#include <svgpp/policy/marker_events.hpp>
+#include <svgpp/policy/markers.hpp>
+#include <cmath>
+#include <vector>
+
+namespace svgpp
+{
+
+// Collects markers of path or polyline, that are calculated by path_markers_adapter
+// with policy::markers::calculate_tangents, and calculates their orientation for all vertices at once.
+// Positions and directions are stored in separate arrays indexed by marker_index.
+// clear() must be called before processing next path
+template<class Number = double>
+class marker_batch
+{
+public:
+  typedef Number number_type;
+  typedef policy::markers::calculate_tangents markers_policy;
+
+  marker_batch()
+    : config_start_(marker_orient_auto)
+    , config_mid_(marker_orient_auto)
+    , config_end_(marker_orient_auto)
+    , normalized_(true)
+  {}
+
+  void set_config(marker_config start, marker_config mid, marker_config end)
+  {
+    config_start_ = start;
+    config_mid_ = mid;
+    config_end_ = end;
+  }
+
+  void clear()
+  {
+    vertex_.clear();
+    orient_auto_.clear();
+    x_.clear();
+    y_.clear();
+    in_x_.clear();
+    in_y_.clear();
+    out_x_.clear();
+    out_y_.clear();
+    direction_x_.clear();
+    direction_y_.clear();
+    normalized_ = true;
+  }
+
+  void marker_get_config(marker_config & start, marker_config & mid, marker_config & end) const
+  {
+    start = config_start_;
+    mid = config_mid_;
+    end = config_end_;
+  }
+
+  template<class Coordinate, class TangentsNumber>
+  void marker(marker_vertex v, Coordinate x, Coordinate y,
+    marker_tangents<TangentsNumber> const & tangents, unsigned marker_index)
+  {
+    add(v, true, x, y, marker_index);
+    in_x_[marker_index] = static_cast<Number>(tangents.in_x);
+    in_y_[marker_index] = static_cast<Number>(tangents.in_y);
+    out_x_[marker_index] = static_cast<Number>(tangents.out_x);
+    out_y_[marker_index] = static_cast<Number>(tangents.out_y);
+  }
+
+  template<class Coordinate>
+  void marker(marker_vertex v, Coordinate x, Coordinate y, tag::orient_fixed, unsigned marker_index)
+  {
+    add(v, false, x, y, marker_index);
+  }
+
+  std::size_t size() const { return vertex_.size(); }
+  marker_vertex vertex(std::size_t i) const { return static_cast<marker_vertex>(vertex_[i]); }
+  // false if marker_orient_fixed was requested for this vertex
+  bool orient_auto(std::size_t i) const { return orient_auto_[i] != 0; }
+
+  Number const * x() const { return x_.empty() ? NULL : &x_[0]; }
+  Number const * y() const { return y_.empty() ? NULL : &y_[0]; }
+
+  // Unit vectors of marker directions, (1, 0) for markers with fixed orientation
+  Number const * direction_x() const
+  {
+    normalize();
+    return direction_x_.empty() ? NULL : &direction_x_[0];
+  }
+
+  Number const * direction_y() const
+  {
+    normalize();
+    return direction_y_.empty() ? NULL : &direction_y_[0];
+  }
+
+  // Marker angle in radians
+  Number angle(std::size_t i) const
+  {
+    normalize();
+    return std::atan2(direction_y_[i], direction_x_[i]);
+  }
+
+private:
+  marker_config config_start_, config_mid_, config_end_;
+  std::vector<unsigned char> vertex_, orient_auto_;
+  std::vector<Number> x_, y_, in_x_, in_y_, out_x_, out_y_;
+  mutable std::vector<Number> direction_x_, direction_y_;
+  mutable bool normalized_;
+
+  template<class Coordinate>
+  void add(marker_vertex v, bool orient_auto, Coordinate x, Coordinate y, unsigned marker_index)
+  {
+    if (marker_index >= vertex_.size())
+    {
+      std::size_t const size = marker_index + 1;
+      vertex_.resize(size);
+      orient_auto_.resize(size);
+      x_.resize(size);
+      y_.resize(size);
+      in_x_.resize(size, 1);
+      in_y_.resize(size, 0);
+      out_x_.resize(size, 1);
+      out_y_.resize(size, 0);
+    }
+    vertex_[marker_index] = static_cast<unsigned char>(v);
+    orient_auto_[marker_index] = orient_auto;
+    x_[marker_index] = static_cast<Number>(x);
+    y_[marker_index] = static_cast<Number>(y);
+    normalized_ = false;
+  }
+
+  void normalize() const
+  {
+    if (normalized_)
+      return;
+    normalized_ = true;
+    std::size_t const size = vertex_.size();
+    direction_x_.resize(size);
+    direction_y_.resize(size);
+    if (size == 0)
+      return;
+    Number const * in_x = &in_x_[0], * in_y = &in_y_[0], * out_x = &out_x_[0], * out_y = &out_y_[0];
+    Number * direction_x = &direction_x_[0], * direction_y = &direction_y_[0];
+    // Branch-free loop over separate arrays to let compiler vectorize it
+    for(std::size_t i = 0; i < size; ++i)
+    {
+      Number const ix = in_x[i], iy = in_y[i], ox = out_x[i], oy = out_y[i];
+      Number const in_length = std::sqrt(ix * ix + iy * iy);
+      Number const out_length = std::sqrt(ox * ox + oy * oy);
+      // Sum of vectors scaled to the same length has direction of bisector
+      Number bx = ix * out_length + ox * in_length;
+      Number by = iy * out_length + oy * in_length;
+      Number length = std::sqrt(bx * bx + by * by);
+      // Opposite directions give zero bisector, in direction rotated by 90 degrees is used then
+      bool const opposite = length == 0;
+      bx = opposite ? -iy : bx;
+      by = opposite ? ix : by;
+      length = opposite ? in_length : length;
+      direction_x[i] = bx / length;
+      direction_y[i] = by / length;
+    }
+  }
+};
+
+}
@@ -0,0 +1,68 @@
+// Copyright Oleg Maximenko 2014.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://github.com/svgpp/svgpp for library home page.
+
+#pragma once
+
+#include <boost/array.hpp>
+
+namespace svgpp
+{
+
+// Canonical outlines of basic shapes, that are instanced by policy::basic_shapes_events::instance_of_unit_shape.
+// Each outline is a sequence of x, y pairs, built once and shared by all shapes.
+template<class Number = double>
+struct unit_shape_outline
+{
+  // Circle of radius 1 centered at origin: start point followed by 4 cubic Bézier segments
+  // (3 points each), in the same direction as circle converted to path
+  typedef boost::array<Number, 26> circle_type;
+  // Unit square (0, 0) - (1, 1): 4 vertices of closed polygon
+  typedef boost::array<Number, 8> square_type;
+  // Segment (0, 0) - (1, 0)
+  typedef boost::array<Number, 4> line_type;
+
+  static circle_type const & circle()
+  {
+    // 4/3 * (sqrt(2) - 1)
+    static const double k = 0.55228474983079339840;
+    static const double points[26] = {
+       1,  0,
+       1,  k,   k,  1,   0,  1,
+      -k,  1,  -1,  k,  -1,  0,
+      -1, -k,  -k, -1,   0, -1,
+       k, -1,   1, -k,   1,  0
+    };
+    static const circle_type outline = make<circle_type>(points);
+    return outline;
+  }
+
+  static square_type const & square()
+  {
+    static const double points[8] = { 0, 0,  1, 0,  1, 1,  0, 1 };
+    static const square_type outline = make<square_type>(points);
+    return outline;
+  }
+
+  static line_type const & line()
+  {
+    static const double points[4] = { 0, 0,  1, 0 };
+    static const line_type outline = make<line_type>(points);
+    return outline;
+  }
+
+private:
+  template<class Array>
+  static Array make(double const * points)
+  {
+    Array result;
+    for(std::size_t i = 0; i < result.size(); ++i)
+      result[i] = static_cast<Number>(points[i]);
+    return result;
+  }
+};
+
+}
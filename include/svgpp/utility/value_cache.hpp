@@ -0,0 +1,482 @@
+// Copyright Oleg Maximenko 2014.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+//
+// See http://github.com/svgpp/svgpp for library home page.
+
+#pragma once
+
+#include <svgpp/definitions.hpp>
+#include <boost/array.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/range.hpp>
+#include <boost/unordered_map.hpp>
+#include <algorithm>
+#include <list>
+#include <string>
+#include <vector>
+
+namespace svgpp
+{
+
+namespace detail
+{
+
+// Sequence of path or transform events as they were emitted by grammar,
+// before passing through adapters
+template<class Number>
+class value_tape
+{
+public:
+  typedef Number number_type;
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_move_to(Coordinate x, Coordinate y, AbsoluteOrRelative)
+  {
+    add(op_path_move_to + is_relative(AbsoluteOrRelative()), x, y);
+  }
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_line_to(Coordinate x, Coordinate y, AbsoluteOrRelative)
+  {
+    add(op_path_line_to + is_relative(AbsoluteOrRelative()), x, y);
+  }
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_line_to_ortho(Coordinate coord, bool horizontal, AbsoluteOrRelative)
+  {
+    add((horizontal ? op_path_line_to_horizontal : op_path_line_to_vertical) + is_relative(AbsoluteOrRelative()), coord);
+  }
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_cubic_bezier_to(Coordinate x1, Coordinate y1, Coordinate x2, Coordinate y2,
+    Coordinate x, Coordinate y, AbsoluteOrRelative)
+  {
+    add(op_path_cubic_bezier_to + is_relative(AbsoluteOrRelative()), x1, y1, x2, y2);
+    push(x, y);
+  }
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_cubic_bezier_to(Coordinate x2, Coordinate y2, Coordinate x, Coordinate y, AbsoluteOrRelative)
+  {
+    add(op_path_cubic_bezier_short_to + is_relative(AbsoluteOrRelative()), x2, y2, x, y);
+  }
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_quadratic_bezier_to(Coordinate x1, Coordinate y1, Coordinate x, Coordinate y, AbsoluteOrRelative)
+  {
+    add(op_path_quadratic_bezier_to + is_relative(AbsoluteOrRelative()), x1, y1, x, y);
+  }
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_quadratic_bezier_to(Coordinate x, Coordinate y, AbsoluteOrRelative)
+  {
+    add(op_path_quadratic_bezier_short_to + is_relative(AbsoluteOrRelative()), x, y);
+  }
+
+  template<class Coordinate, class AbsoluteOrRelative>
+  void path_elliptical_arc_to(Coordinate rx, Coordinate ry, Coordinate x_axis_rotation,
+    bool large_arc_flag, bool sweep_flag, Coordinate x, Coordinate y, AbsoluteOrRelative)
+  {
+    add(op_path_elliptical_arc_to + is_relative(AbsoluteOrRelative()), rx, ry, x_axis_rotation);
+    push(Number(large_arc_flag ? 1 : 0), Number(sweep_flag ? 1 : 0));
+    push(x, y);
+  }
+
+  void path_close_subpath()
+  {
+    ops_.push_back(op_path_close_subpath);
+  }
+
+  void path_exit()
+  {
+    ops_.push_back(op_path_exit);
+  }
+
+  template<class Coordinate>
+  void transform_matrix(const boost::array<Coordinate, 6> & matrix)
+  {
+    add(op_transform_matrix, matrix[0], matrix[1], matrix[2], matrix[3]);
+    push(matrix[4], matrix[5]);
+  }
+
+  template<class Coordinate>
+  void transform_translate(Coordinate tx, Coordinate ty)
+  { add(op_transform_translate, tx, ty); }
+
+  template<class Coordinate>
+  void transform_translate(Coordinate tx)
+  { add(op_transform_translate_x, tx); }
+
+  template<class Coordinate>
+  void transform_scale(Coordinate sx, Coordinate sy)
+  { add(op_transform_scale, sx, sy); }
+
+  template<class Coordinate>
+  void transform_scale(Coordinate scale)
+  { add(op_transform_uniform_scale, scale); }
+
+  template<class Coordinate>
+  void transform_rotate(Coordinate angle)
+  { add(op_transform_rotate, angle); }
+
+  template<class Coordinate>
+  void transform_rotate(Coordinate angle, Coordinate cx, Coordinate cy)
+  { add(op_transform_rotate_around, angle, cx, cy); }
+
+  template<class Coordinate>
+  void transform_skew_x(Coordinate angle)
+  { add(op_transform_skew_x, angle); }
+
+  template<class Coordinate>
+  void transform_skew_y(Coordinate angle)
+  { add(op_transform_skew_y, angle); }
+
+  template<class EventsPolicy, class Context>
+  void replay_path(Context & context) const
+  {
+    typename numbers_t::const_iterator n = numbers_.begin();
+    for(typename ops_t::const_iterator op = ops_.begin(); op != ops_.end(); ++op)
+    {
+      if (*op == op_path_close_subpath)
+        EventsPolicy::path_close_subpath(context);
+      else if (*op == op_path_exit)
+        EventsPolicy::path_exit(context);
+      else if (*op & 1)
+        replay_path_segment<EventsPolicy>(context, *op - 1, n, tag::coordinate::relative());
+      else
+        replay_path_segment<EventsPolicy>(context, *op, n, tag::coordinate::absolute());
+    }
+  }
+
+  template<class EventsPolicy, class Context>
+  void replay_transform(Context & context) const
+  {
+    typename numbers_t::const_iterator n = numbers_.begin();
+    for(typename ops_t::const_iterator op = ops_.begin(); op != ops_.end(); ++op)
+    {
+      switch (*op)
+      {
+      case op_transform_matrix:
+      {
+        boost::array<Number, 6> matrix;
+        std::copy(n, n + 6, matrix.begin());
+        EventsPolicy::transform_matrix(context, matrix);
+        n += 6;
+        break;
+      }
+      case op_transform_translate:
+        EventsPolicy::transform_translate(context, n[0], n[1]);
+        n += 2;
+        break;
+      case op_transform_translate_x:
+        EventsPolicy::transform_translate(context, *n++);
+        break;
+      case op_transform_scale:
+        EventsPolicy::transform_scale(context, n[0], n[1]);
+        n += 2;
+        break;
+      case op_transform_uniform_scale:
+        EventsPolicy::transform_scale(context, *n++);
+        break;
+      case op_transform_rotate:
+        EventsPolicy::transform_rotate(context, *n++);
+        break;
+      case op_transform_rotate_around:
+        EventsPolicy::transform_rotate(context, n[0], n[1], n[2]);
+        n += 3;
+        break;
+      case op_transform_skew_x:
+        EventsPolicy::transform_skew_x(context, *n++);
+        break;
+      case op_transform_skew_y:
+        EventsPolicy::transform_skew_y(context, *n++);
+        break;
+      }
+    }
+  }
+
+  std::size_t size_in_bytes() const
+  {
+    return ops_.size() + numbers_.size() * sizeof(Number);
+  }
+
+  void swap(value_tape & other)
+  {
+    ops_.swap(other.ops_);
+    numbers_.swap(other.numbers_);
+  }
+
+private:
+  typedef std::vector<unsigned char> ops_t;
+  typedef std::vector<Number> numbers_t;
+
+  // Path segment operations are even, relative variant is 'op + 1'
+  enum op
+  {
+    op_path_move_to = 0,
+    op_path_line_to = 2,
+    op_path_line_to_horizontal = 4,
+    op_path_line_to_vertical = 6,
+    op_path_cubic_bezier_to = 8,
+    op_path_cubic_bezier_short_to = 10,
+    op_path_quadratic_bezier_to = 12,
+    op_path_quadratic_bezier_short_to = 14,
+    op_path_elliptical_arc_to = 16,
+    op_path_close_subpath = 18,
+    op_path_exit,
+    op_transform_matrix,
+    op_transform_translate,
+    op_transform_translate_x,
+    op_transform_scale,
+    op_transform_uniform_scale,
+    op_transform_rotate,
+    op_transform_rotate_around,
+    op_transform_skew_x,
+    op_transform_skew_y
+  };
+
+  ops_t ops_;
+  numbers_t numbers_;
+
+  static int is_relative(tag::coordinate::absolute) { return 0; }
+  static int is_relative(tag::coordinate::relative) { return 1; }
+
+  template<class Coordinate>
+  void add(int op, Coordinate a)
+  {
+    ops_.push_back(static_cast<unsigned char>(op));
+    numbers_.push_back(a);
+  }
+
+  template<class Coordinate>
+  void add(int op, Coordinate a, Coordinate b)
+  {
+    ops_.push_back(static_cast<unsigned char>(op));
+    push(a, b);
+  }
+
+  template<class Coordinate>
+  void add(int op, Coordinate a, Coordinate b, Coordinate c)
+  {
+    add(op, a);
+    push(b, c);
+  }
+
+  template<class Coordinate>
+  void add(int op, Coordinate a, Coordinate b, Coordinate c, Coordinate d)
+  {
+    add(op, a, b);
+    push(c, d);
+  }
+
+  template<class Coordinate>
+  void push(Coordinate a, Coordinate b)
+  {
+    numbers_.push_back(a);
+    numbers_.push_back(b);
+  }
+
+  template<class EventsPolicy, class Context, class AbsoluteOrRelative>
+  static void replay_path_segment(Context & context, int op,
+    typename numbers_t::const_iterator & n, AbsoluteOrRelative absoluteOrRelative)
+  {
+    switch (op)
+    {
+    case op_path_move_to:
+      EventsPolicy::path_move_to(context, n[0], n[1], absoluteOrRelative);
+      n += 2;
+      break;
+    case op_path_line_to:
+      EventsPolicy::path_line_to(context, n[0], n[1], absoluteOrRelative);
+      n += 2;
+      break;
+    case op_path_line_to_horizontal:
+      EventsPolicy::path_line_to_ortho(context, *n++, true, absoluteOrRelative);
+      break;
+    case op_path_line_to_vertical:
+      EventsPolicy::path_line_to_ortho(context, *n++, false, absoluteOrRelative);
+      break;
+    case op_path_cubic_bezier_to:
+      EventsPolicy::path_cubic_bezier_to(context, n[0], n[1], n[2], n[3], n[4], n[5], absoluteOrRelative);
+      n += 6;
+      break;
+    case op_path_cubic_bezier_short_to:
+      EventsPolicy::path_cubic_bezier_to(context, n[0], n[1], n[2], n[3], absoluteOrRelative);
+      n += 4;
+      break;
+    case op_path_quadratic_bezier_to:
+      EventsPolicy::path_quadratic_bezier_to(context, n[0], n[1], n[2], n[3], absoluteOrRelative);
+      n += 4;
+      break;
+    case op_path_quadratic_bezier_short_to:
+      EventsPolicy::path_quadratic_bezier_to(context, n[0], n[1], absoluteOrRelative);
+      n += 2;
+      break;
+    case op_path_elliptical_arc_to:
+      EventsPolicy::path_elliptical_arc_to(context, n[0], n[1], n[2], n[3] != 0, n[4] != 0, n[5], n[6], absoluteOrRelative);
+      n += 7;
+      break;
+    }
+  }
+};
+
+// Declaration of 'style' attribute, offsets are relative to the beginning of the attribute value.
+// Declarations with unknown property names are kept with 'unknown_attribute_id'
+struct css_declaration
+{
+  attribute_id id;
+  std::size_t name_begin, name_end;
+  std::size_t value_begin, value_end;
+};
+
+}
+
+// Bounded LRU cache of decoded path data and transform list values keyed by
+// attribute id and attribute value, and of declarations split from 'style' attribute values.
+// Not thread safe - use one instance per thread or per document.
+template<class Number = double, class Char = char>
+class value_cache: boost::noncopyable
+{
+public:
+  typedef Number number_type;
+  typedef detail::value_tape<Number> tape_type;
+
+  explicit value_cache(std::size_t max_size = 1024 * 1024)
+    : size_(0)
+    , max_size_(max_size)
+    , hits_(0)
+    , misses_(0)
+  {}
+
+  typedef std::vector<detail::css_declaration> css_declarations_type;
+
+  template<class Range>
+  tape_type const * find(detail::attribute_id id, Range const & value)
+  {
+    entry const * e = find_entry(id, value);
+    return e ? &e->tape_ : NULL;
+  }
+
+  // Takes content of 'tape'
+  template<class Range>
+  void insert(detail::attribute_id id, Range const & value, tape_type & tape)
+  {
+    if (entry * e = insert_entry(id, value, tape.size_in_bytes()))
+      e->tape_.swap(tape);
+  }
+
+  template<class Range>
+  css_declarations_type const * find_css_declarations(Range const & style)
+  {
+    entry const * e = find_entry(detail::attribute_id_style, style);
+    return e ? &e->css_declarations_ : NULL;
+  }
+
+  // Takes content of 'declarations'
+  template<class Range>
+  void insert_css_declarations(Range const & style, css_declarations_type & declarations)
+  {
+    if (entry * e = insert_entry(detail::attribute_id_style, style, 
+      declarations.size() * sizeof(detail::css_declaration)))
+      e->css_declarations_.swap(declarations);
+  }
+
+  void clear()
+  {
+    index_.clear();
+    entries_.clear();
+    size_ = 0;
+  }
+
+  std::size_t size() const { return size_; }
+  std::size_t max_size() const { return max_size_; }
+  std::size_t hits() const { return hits_; }
+  std::size_t misses() const { return misses_; }
+
+private:
+  struct entry
+  {
+    detail::attribute_id id_;
+    std::size_t hash_;
+    std::size_t size_;
+    std::basic_string<Char> value_;
+    tape_type tape_;
+    css_declarations_type css_declarations_;
+  };
+
+  typedef std::list<entry> entries_t;
+  typedef boost::unordered_multimap<std::size_t, typename entries_t::iterator> index_t;
+
+  entries_t entries_;
+  index_t index_;
+  std::size_t size_, max_size_;
+  std::size_t hits_, misses_;
+
+  template<class Range>
+  entry const * find_entry(detail::attribute_id id, Range const & value)
+  {
+    std::pair<typename index_t::iterator, typename index_t::iterator> range = index_.equal_range(hash(id, value));
+    for(; range.first != range.second; ++range.first)
+    {
+      typename entries_t::iterator e = range.first->second;
+      if (e->id_ == id
+        && e->value_.size() == static_cast<std::size_t>(boost::size(value))
+        && std::equal(e->value_.begin(), e->value_.end(), boost::begin(value)))
+      {
+        entries_.splice(entries_.begin(), entries_, e);
+        ++hits_;
+        return &*e;
+      }
+    }
+    ++misses_;
+    return NULL;
+  }
+
+  template<class Range>
+  entry * insert_entry(detail::attribute_id id, Range const & value, std::size_t content_size)
+  {
+    std::size_t const entry_size = sizeof(entry)
+      + boost::size(value) * sizeof(Char) + content_size;
+    if (entry_size > max_size_)
+      return NULL;
+    while (size_ + entry_size > max_size_)
+      evict();
+    entries_.push_front(entry());
+    entry & e = entries_.front();
+    e.id_ = id;
+    e.hash_ = hash(id, value);
+    e.value_.assign(boost::begin(value), boost::end(value));
+    e.size_ = entry_size;
+    size_ += entry_size;
+    index_.insert(std::make_pair(e.hash_, entries_.begin()));
+    return &e;
+  }
+
+  template<class Range>
+  static std::size_t hash(detail::attribute_id id, Range const & value)
+  {
+    std::size_t seed = boost::hash_range(boost::begin(value), boost::end(value));
+    boost::hash_combine(seed, static_cast<int>(id));
+    return seed;
+  }
+
+  void evict()
+  {
+    typename entries_t::iterator last = entries_.end();
+    --last;
+    std::pair<typename index_t::iterator, typename index_t::iterator> range = index_.equal_range(last->hash_);
+    for(; range.first != range.second; ++range.first)
+      if (range.first->second == last)
+      {
+        index_.erase(range.first);
+        break;
+      }
+    size_ -= last->size_;
+    entries_.erase(last);
+  }
+};
+
+}
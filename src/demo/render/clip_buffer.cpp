@@ -1,58 +1,230 @@
 #include "clip_buffer.hpp"
 
 #if defined(RENDERER_AGG)
-#include <agg_alpha_mask_u8.h>
 #include <agg_conv_curve.h>
+#include <agg_conv_transform.h>
 #include <agg_path_storage.h>
-#include <agg_pixfmt_amask_adaptor.h>
-#include <agg_pixfmt_gray.h>
 #include <agg_rasterizer_scanline_aa.h>
-#include <agg_renderer_base.h>
 #include <agg_renderer_scanline.h>
+#include <agg_scanline_boolean_algebra.h>
 #include <agg_scanline_p.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #endif
 
 #include <svgpp/svgpp.hpp>
 
 #if defined(RENDERER_AGG)
-typedef agg::pixfmt_gray8 pixfmt_t;
-typedef agg::renderer_base<pixfmt_t> renderer_base_t;
+namespace
+{
+  // Replaces 'spans' with intersection of 'spans' and 'shape'
+  template<class ScanlineGen>
+  void intersectSpans(agg::scanline_storage_aa8 & spans, ScanlineGen & shape)
+  {
+    agg::scanline_p8 scanline1, scanline2, scanline;
+    agg::scanline_storage_aa8 intersection;
+    agg::sbool_intersect_shapes_aa(spans, shape, scanline1, scanline2, scanline, intersection);
+    spans = intersection;
+  }
+
+  // Replaces 'spans' with union of 'spans' and 'shape'
+  template<class ScanlineGen>
+  void uniteSpans(agg::scanline_storage_aa8 & spans, ScanlineGen & shape)
+  {
+    agg::scanline_p8 scanline1, scanline2, scanline;
+    agg::scanline_storage_aa8 united;
+    agg::sbool_unite_shapes_aa(spans, shape, scanline1, scanline2, scanline, united);
+    spans = united;
+  }
+
+  void clearPixels(boost::gil::rgba8_view_t const & view, int y, int x1, int x2)
+  {
+    if (x1 < x2)
+      std::memset(&view(x1, y), 0, (x2 - x1) * sizeof(boost::gil::rgba8_pixel_t));
+  }
+
+  // Part of pixel 'i' that is covered by [x1, x2] segment
+  double pixelCoverage(double x1, double x2, int i)
+  {
+    return std::max(0.0, std::min(x2, i + 1.0) - std::max(x1, double(i)));
+  }
+
+  void multiplyAlpha(boost::gil::rgba8_view_t const & view, int x, int y, double coverage)
+  {
+    if (coverage < 1)
+    {
+      using namespace boost::gil;
+      get_color(view(x, y), alpha_t()) = channel_multiply(get_color(view(x, y), alpha_t()), 
+        static_cast<unsigned char>(coverage * 255 + 0.5));
+    }
+  }
+
+  void multiplyAlpha(boost::gil::rgba8_view_t const & view, int y, int x1, int x2, 
+    agg::int8u const * covers, bool solid)
+  {
+    using namespace boost::gil;
+    rgba8_view_t::x_iterator pixel = view.row_begin(y) + x1;
+    for(int x = x1; x < x2; ++x, ++pixel)
+    {
+      get_color(*pixel, alpha_t()) = channel_multiply(get_color(*pixel, alpha_t()), *covers);
+      if (!solid)
+        ++covers;
+    }
+  }
+}
 #endif
 
 ClipBuffer::ClipBuffer(int width, int height)
+#if defined(RENDERER_AGG)
+  : box_(0, 0, width, height)
+  , rectangular_(true)
+#else
   : buffer_(width * height, 0xff)
+#endif
   , width_(width), height_(height)
 {}
 
 ClipBuffer::ClipBuffer(ClipBuffer const & src)
+#if defined(RENDERER_AGG)
+  : box_(src.box_)
+  , rectangular_(src.rectangular_)
+  , spans_(src.spans_)
+#else
   : buffer_(src.buffer_)
+#endif
   , width_(src.width_), height_(src.height_)
 {}
 
-boost::gil::gray8c_view_t ClipBuffer::gilView() const
+void ClipBuffer::apply(boost::gil::rgba8_view_t const & view, int x, int y) const
+{
+#if defined(RENDERER_AGG)
+  int const width = int(view.width()), height = int(view.height());
+  if (rectangular_)
+  {
+    // Only pixels on the edges of the rectangle are partially covered
+    int const left = std::min(std::max(int(std::floor(box_.x1)) - x, 0), width);
+    int const right = std::min(std::max(int(std::ceil(box_.x2)) - x, left), width);
+    for(int row = 0; row < height; ++row)
+    {
+      double const row_coverage = pixelCoverage(box_.y1, box_.y2, y + row);
+      if (row_coverage == 0 || left == right)
+      {
+        clearPixels(view, row, 0, width);
+        continue;
+      }
+      clearPixels(view, row, 0, left);
+      clearPixels(view, row, right, width);
+      for(int column = left; column < right; ++column)
+      {
+        if (row_coverage == 1 && column == left + 1 && column < right - 1)
+          column = right - 1; // Inner pixels are fully covered
+        multiplyAlpha(view, column, row, row_coverage * pixelCoverage(box_.x1, box_.x2, x + column));
+      }
+    }
+    return;
+  }
+
+  // Pixels outside of spans are cleared, pixels in solid spans with full coverage are kept as is
+  int row = 0; // View rows above are processed
+  agg::scanline_storage_aa8::embedded_scanline scanline(spans_);
+  if (spans_.rewind_scanlines())
+  {
+    while (row < height && spans_.sweep_scanline(scanline))
+    {
+      int const scanline_row = scanline.y() - y;
+      if (scanline_row < 0)
+        continue;
+      if (scanline_row >= height)
+        break;
+      for(; row < scanline_row; ++row)
+        clearPixels(view, row, 0, width);
+      int cleared_to = 0;
+      agg::scanline_storage_aa8::embedded_scanline::const_iterator span = scanline.begin();
+      for(unsigned num_spans = scanline.num_spans(); num_spans != 0; --num_spans, ++span)
+      {
+        bool const solid = span->len < 0;
+        int const span_x1 = span->x - x, span_x2 = span_x1 + std::abs(span->len);
+        int const x1 = std::max(span_x1, 0), x2 = std::min(span_x2, width);
+        if (x1 >= x2)
+          continue;
+        clearPixels(view, row, cleared_to, x1);
+        cleared_to = x2;
+        if (!solid || *span->covers != 0xff)
+          multiplyAlpha(view, row, x1, x2, span->covers + (solid ? 0 : x1 - span_x1), solid);
+      }
+      clearPixels(view, row, cleared_to, width);
+      ++row;
+    }
+  }
+  for(; row < height; ++row)
+    clearPixels(view, row, 0, width);
+#else
+  boost::gil::gray8c_view_t const mask = boost::gil::subimage_view(
+    boost::gil::interleaved_view(width_, height_, 
+      reinterpret_cast<const boost::gil::gray8_pixel_t *>(&buffer_[0]), width_),
+    x, y, view.width(), view.height());
+  for(int row = 0; row < view.height(); ++row)
+  {
+    boost::gil::rgba8_view_t::x_iterator pixel = view.row_begin(row);
+    boost::gil::gray8c_view_t::x_iterator cover = mask.row_begin(row);
+    for(int column = 0; column < view.width(); ++column, ++pixel, ++cover)
+    {
+      using namespace boost::gil;
+      get_color(*pixel, alpha_t()) = channel_multiply(
+        get_color(*pixel, alpha_t()), get_color(*cover, gray_color_t()));
+    }
+  }
+#endif
+}
+
+#if defined(RENDERER_AGG)
+void ClipBuffer::buildSpans()
 {
-  return boost::gil::interleaved_view(width_, height_, 
-    reinterpret_cast<const boost::gil::gray8_pixel_t *>(&buffer_[0]), width_);
+  if (!rectangular_)
+    return;
+  rectangular_ = false;
+  if (!box_.is_valid())
+    return;
+  agg::rasterizer_scanline_aa<> rasterizer;
+  rasterizer.move_to_d(box_.x1, box_.y1);
+  rasterizer.line_to_d(box_.x2, box_.y1);
+  rasterizer.line_to_d(box_.x2, box_.y2);
+  rasterizer.line_to_d(box_.x1, box_.y2);
+  rasterizer.close_polygon();
+  agg::scanline_p8 scanline;
+  agg::render_scanlines(rasterizer, scanline, spans_);
 }
 
+void ClipBuffer::updateBox()
+{
+  if (spans_.rewind_scanlines())
+    box_ = agg::rect_d(spans_.min_x(), spans_.min_y(), spans_.max_x() + 1, spans_.max_y() + 1);
+  else
+    box_ = agg::rect_d(0, 0, -1, -1);
+}
+#endif
+
 void ClipBuffer::intersectClipRect(transform_t const & transform, number_t x, number_t y, number_t width, number_t height)
 {
 #if defined(RENDERER_AGG)
-  typedef agg::renderer_scanline_aa_solid<renderer_base_t> renderer_t;
-
-  agg::rendering_buffer rbuf(&buffer_[0], width, height, width);
-  pixfmt_t pixfmt(rbuf);
-  renderer_base_t renderer_base(pixfmt);
-  agg::scanline_p8 scanline;
+  if ((transform.shx == 0 && transform.shy == 0) || (transform.sx == 0 && transform.sy == 0))
+  {
+    // Rectangle stays axis-aligned
+    number_t x1 = x, y1 = y, x2 = x + width, y2 = y + height;
+    transform.transform(&x1, &y1);
+    transform.transform(&x2, &y2);
+    agg::rect_d rect(x1, y1, x2, y2);
+    rect.normalize();
+    box_ = agg::intersect_rectangles(box_, rect);
+    if (rectangular_)
+      return;
+  }
+  else
+    buildSpans();
 
   agg::rasterizer_scanline_aa<> rasterizer;
-  rasterizer.filling_rule(agg::fill_even_odd);
-
-  rasterizer.move_to_d(0, 0);
-  rasterizer.line_to_d(pixfmt.width(), 0);
-  rasterizer.line_to_d(pixfmt.width(), pixfmt.height());
-  rasterizer.line_to_d(0, pixfmt.height());
-  rasterizer.close_polygon();
+  rasterizer.clip_box(0, 0, width_, height_);
 
   number_t px = x, py = y;
   transform.transform(&px, &py);
@@ -68,7 +240,8 @@ void ClipBuffer::intersectClipRect(transform_t const & transform, number_t x, nu
   rasterizer.line_to_d(px, py);
   rasterizer.close_polygon();
 
-  agg::render_scanlines_aa_solid(rasterizer, scanline, renderer_base, agg::gray8(0));
+  intersectSpans(spans_, rasterizer);
+  updateBox();
 #elif defined(RENDERER_GDIPLUS)
 
 #endif
@@ -113,13 +286,15 @@ namespace
     ElementBase(
       XMLDocument & xml_document,
 #if defined(RENDERER_AGG)
-      agg::rendering_buffer & rbuf, 
+      agg::scanline_storage_aa8 & shape, 
+      int width, int height,
 #endif
       transform_t const & transform
       )
       : xml_document_(xml_document)
 #if defined(RENDERER_AGG)
-      , rbuf_(rbuf)
+      , shape_(shape)
+      , width_(width), height_(height)
       , transform_(transform)
 #endif
       , display_(true)
@@ -133,7 +308,8 @@ namespace
     ElementBase(ElementBase const & parent)
       : xml_document_(parent.xml_document_)
 #if defined(RENDERER_AGG)
-      , rbuf_(parent.rbuf_)
+      , shape_(parent.shape_)
+      , width_(parent.width_), height_(parent.height_)
       , transform_(parent.transform_)
 #endif
       , display_(parent.display_)
@@ -172,7 +348,8 @@ namespace
   protected:
     XMLDocument & xml_document_;
 #if defined(RENDERER_AGG)
-    agg::rendering_buffer & rbuf_;
+    agg::scanline_storage_aa8 & shape_; // Union of clipPath children
+    int const width_, height_;
 #endif
     transform_t transform_;
     bool display_;
@@ -241,12 +418,10 @@ namespace
   
         curved_transformed_t curved_transformed(curved, transform_);
         agg::rasterizer_scanline_aa<> rasterizer;
-        agg::scanline_p8 scanline;
-        pixfmt_t pixfmt(rbuf_);
-        renderer_base_t renderer_base(pixfmt);
+        rasterizer.clip_box(0, 0, width_, height_);
         rasterizer.filling_rule(nonzero_clip_rule_ ? agg::fill_non_zero : agg::fill_even_odd);
         rasterizer.add_path(curved_transformed);
-        agg::render_scanlines_aa_solid(rasterizer, scanline, renderer_base, agg::gray8(0));
+        uniteSpans(shape_, rasterizer);
       }
 #elif defined(RENDERER_GDIPLUS)
 
@@ -364,19 +539,12 @@ void ClipBuffer::intersectClipPath(XMLDocument & xml_document, svg_string_t cons
     try
     {
 #if defined(RENDERER_AGG)
-      std::vector<unsigned char> clip_path_buffer(width_ * height_, 0xff);
-      agg::rendering_buffer clip_path_rbuf(&clip_path_buffer[0], width_, height_, width_);
-      ElementBase root_context(xml_document, clip_path_rbuf, transform);
+      agg::scanline_storage_aa8 clip_path_shape;
+      ElementBase root_context(xml_document, clip_path_shape, width_, height_, transform);
       document_traversal::load_expected_element(node, root_context, svgpp::tag::element::clipPath());
-
-      typedef agg::amask_no_clip_gray8 alpha_mask_t;
-      alpha_mask_t clip_path_alpha_mask(clip_path_rbuf);
-      agg::rendering_buffer rbuf(&buffer_[0], width_, height_, width_);
-      pixfmt_t buffer_pixfmt(rbuf);
-      typedef agg::pixfmt_amask_adaptor<pixfmt_t, alpha_mask_t> pixfmt_masked_t;
-      pixfmt_masked_t pixfmt_masked(buffer_pixfmt, clip_path_alpha_mask);
-      agg::renderer_base<pixfmt_masked_t> renderer_base(pixfmt_masked);
-      renderer_base.clear(agg::gray8(0));
+      buildSpans();
+      intersectSpans(spans_, clip_path_shape);
+      updateBox();
 #endif
     } 
     catch (std::exception const & e)
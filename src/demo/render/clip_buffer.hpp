@@ -3,19 +3,47 @@
 #include <vector>
 #include <boost/gil/gil_all.hpp>
 #include "common.hpp"
+#if defined(RENDERER_AGG)
+#include <agg_scanline_storage_aa.h>
+#endif
 
+// Clipping region in coordinates of the topmost image buffer.
+// For AGG it is stored as scanlines of spans with coverage, solid spans are run-length encoded.
+// So memory and time needed for copying, intersecting and applying the region depend on
+// its complexity rather than on its area.
+// While region is an axis-aligned rectangle (e.g. intersection of viewports) spans aren't built, 
+// the rectangle is used as a scissor box instead
 class ClipBuffer
 {
 public:
   ClipBuffer(int width, int height);
   ClipBuffer(ClipBuffer const & src);
 
-  boost::gil::gray8c_view_t gilView() const;
+  // Multiplies alpha of pixels in 'view' by coverage of the region. 
+  // (x, y) is position of 'view' top left corner
+  void apply(boost::gil::rgba8_view_t const & view, int x, int y) const;
+
+#if defined(RENDERER_AGG)
+  // Bounds of the region with subpixel precision. Nothing is visible outside of it
+  agg::rect_d const & box() const { return box_; }
+  // Whether region is exactly box()
+  bool isRectangle() const { return rectangular_; }
+#endif
 
   void intersectClipRect(transform_t const & transform, number_t x, number_t y, number_t width, number_t height);
   void intersectClipPath(XMLDocument & xml_document, svg_string_t const & id, transform_t const & transform);
 
 private:
+#if defined(RENDERER_AGG)
+  agg::rect_d box_;
+  bool rectangular_;
+  // Is empty while 'rectangular_' is set. Is rewound during iteration
+  mutable agg::scanline_storage_aa8 spans_;
+
+  void buildSpans();
+  void updateBox();
+#else
   std::vector<unsigned char> buffer_;
+#endif
   const int width_, height_;
 };
\ No newline at end of file
@@ -1,7 +1,8 @@
 ﻿#define BOOST_MPL_CFG_NO_PREPROCESSED_HEADERS
-#define BOOST_MPL_LIMIT_SET_SIZE 40
+#define BOOST_MPL_LIMIT_SET_SIZE 50
 
 #include "filter.hpp"
+#include "filter_kernels.hpp"
 
 #include <svgpp/document_traversal.hpp>
 #include <svgpp/utility/gil/blend.hpp>
@@ -11,15 +12,67 @@
 #include <boost/gil/gil_all.hpp>
 #include <boost/mpl/set.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
 #include <boost/variant.hpp>
 #include <boost/math/constants/constants.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace boost {
+  namespace mpl {
+
+#   define BOOST_PP_ITERATION_PARAMS_1 \
+    (3,(51, 66, <boost/mpl/set/aux_/numbered.hpp>))
+#   include BOOST_PP_ITERATE()
+
+  }
+}
 
 namespace mpl = boost::mpl;
 namespace gil = boost::gil;
 
+// Length of filter region or primitive subregion as written in the attribute. Filter is compiled 
+// once, and percentages depend on the viewport or bounding box of each use, so lengths are 
+// converted to user units by FilterGraphBinder
+struct RegionLength
+{
+  typedef boost::variant<
+    svgpp::tag::length_units::none, svgpp::tag::length_units::px,
+    svgpp::tag::length_units::em, svgpp::tag::length_units::ex,
+    svgpp::tag::length_units::in, svgpp::tag::length_units::cm,
+    svgpp::tag::length_units::mm, svgpp::tag::length_units::pt,
+    svgpp::tag::length_units::pc, svgpp::tag::length_units::percent> units_t;
+
+  double value_;
+  units_t units_;
+};
+
+// Length factory for svgpp that keeps number and units
+struct region_length_factory
+{
+  typedef RegionLength length_type;
+  typedef double number_type;
+
+  template<class Units>
+  RegionLength create_length(number_type number, Units units) const
+  {
+    RegionLength const length = { number, units };
+    return length;
+  }
+
+  template<class Dimension>
+  RegionLength create_length(number_type number, svgpp::tag::length_units::percent units, Dimension) const
+  {
+    return create_length(number, units);
+  }
+};
+
+// Attributes that aren't set get default values that depend on element
 struct ElementWithRegion
 {
-  double x_, y_, width_, height_;
+  boost::optional<RegionLength> x_, y_, width_, height_;
 };
 
 struct FilterInput
@@ -122,9 +175,124 @@ struct feColorMatrix: FilterElementBase
   boost::optional<std::vector<double> > values_;
 };
 
+struct feGaussianBlur: FilterElementBase
+{
+  feGaussianBlur()
+    : stdDeviationX_(0)
+    , stdDeviationY_(0)
+  {}
+
+  FilterInput input_;
+  double stdDeviationX_, stdDeviationY_;
+};
+
+struct feMorphology: FilterElementBase
+{
+  enum Operator { opErode, opDilate };
+
+  feMorphology()
+    : operator_(opErode)
+    , radiusX_(0)
+    , radiusY_(0)
+  {}
+
+  FilterInput input_;
+  Operator operator_;
+  double radiusX_, radiusY_;
+};
+
+struct feConvolveMatrix: FilterElementBase
+{
+  feConvolveMatrix()
+    : orderX_(3)
+    , orderY_(3)
+    , bias_(0)
+    , edgeMode_(ConvolveMatrix::edgeDuplicate)
+    , preserveAlpha_(false)
+  {}
+
+  FilterInput input_;
+  double orderX_, orderY_;
+  std::vector<double> kernelMatrix_;
+  boost::optional<double> divisor_;
+  double bias_;
+  boost::optional<int> targetX_, targetY_;
+  ConvolveMatrix::EdgeMode edgeMode_;
+  bool preserveAlpha_;
+};
+
+struct feTurbulence: FilterElementBase
+{
+  feTurbulence()
+    : baseFrequencyX_(0)
+    , baseFrequencyY_(0)
+    , numOctaves_(1)
+    , seed_(0)
+    , fractalNoise_(false)
+    , stitchTiles_(false)
+  {}
+
+  double baseFrequencyX_, baseFrequencyY_;
+  int numOctaves_;
+  double seed_;
+  bool fractalNoise_, stitchTiles_;
+};
+
+struct LightSource
+{
+  enum Type { lsNone, lsDistant, lsPoint, lsSpot };
+
+  LightSource()
+    : type_(lsNone)
+    , azimuth_(0), elevation_(0)
+    , x_(0), y_(0), z_(0)
+    , pointsAtX_(0), pointsAtY_(0), pointsAtZ_(0)
+    , specularExponent_(1)
+  {}
+
+  Type type_;
+  double azimuth_, elevation_;
+  double x_, y_, z_;
+  double pointsAtX_, pointsAtY_, pointsAtZ_;
+  double specularExponent_;
+  boost::optional<double> limitingConeAngle_;
+};
+
+struct feLighting: FilterElementBase
+{
+  feLighting()
+    : surfaceScale_(1)
+  {}
+
+  FilterInput input_;
+  double surfaceScale_;
+  boost::optional<color_t> lighting_color_; // White if not set
+  LightSource light_;
+};
+
+struct feDiffuseLighting: feLighting
+{
+  feDiffuseLighting()
+    : diffuseConstant_(1)
+  {}
+
+  double diffuseConstant_;
+};
+
+struct feSpecularLighting: feLighting
+{
+  feSpecularLighting()
+    : specularConstant_(1)
+    , specularExponent_(1)
+  {}
+
+  double specularConstant_, specularExponent_;
+};
+
 
 typedef boost::variant<feBlend, feComponentTransfer, feOffset, feComposite, feMerge, feFlood, 
-  feColorMatrix> FilterElement;
+  feColorMatrix, feGaussianBlur, feMorphology, feConvolveMatrix, feTurbulence, 
+  feDiffuseLighting, feSpecularLighting> FilterElement;
 
 class ElementWithRegionContext
 {
@@ -133,15 +301,37 @@ public:
     : data_(data)
   {}
 
-  void set(svgpp::tag::attribute::x, double val)  { data_.x_ = val; }
-  void set(svgpp::tag::attribute::y, double val)  { data_.y_ = val; }
-  void set(svgpp::tag::attribute::width, double val)  { data_.width_ = val; }
-  void set(svgpp::tag::attribute::height, double val) { data_.height_ = val; }
+  void set(svgpp::tag::attribute::x, RegionLength const & val)  { data_.x_ = val; }
+  void set(svgpp::tag::attribute::y, RegionLength const & val)  { data_.y_ = val; }
+  void set(svgpp::tag::attribute::width, RegionLength const & val)  { data_.width_ = val; }
+  void set(svgpp::tag::attribute::height, RegionLength const & val) { data_.height_ = val; }
 
 protected:
   ElementWithRegion & data_;
 };
 
+// 'color' property that 'currentColor' refers to. It is inherited from the 'filter' element, 
+// ancestors of 'filter' aren't traversed, so the initial value is black
+class ElementWithColorContext
+{
+public:
+  ElementWithColorContext(color_t const & parent_color)
+    : color_(parent_color)
+  {}
+
+  void set(svgpp::tag::attribute::color, color_t color)
+  { color_ = color; }
+
+  void set(svgpp::tag::attribute::color, svgpp::tag::value::inherit)
+  {}
+
+  color_t const & color() const
+  { return color_; }
+
+private:
+  color_t color_;
+};
+
 template<class InAttributeTag>
 class ElementWithInputContext
 {
@@ -196,11 +386,16 @@ protected:
   FilterElementBase & data_;
 };
 
-class FilterContext: public ElementWithRegionContext
+class FilterContext: 
+  public ElementWithRegionContext,
+  public ElementWithColorContext
 {
 public:
   FilterContext()
     : ElementWithRegionContext(region_)
+    , ElementWithColorContext(BlackColor())
+    , filterUnitsUseObjectBoundingBox_(true)
+    , primitiveUnitsUseObjectBoundingBox_(false)
   {}
 
   void on_enter_element(svgpp::tag::element::filter) const 
@@ -210,6 +405,7 @@ public:
   {}
 
   using ElementWithRegionContext::set;
+  using ElementWithColorContext::set;
 
   void set(svgpp::tag::attribute::filterUnits, svgpp::tag::value::userSpaceOnUse)
   {
@@ -221,13 +417,23 @@ public:
     filterUnitsUseObjectBoundingBox_ = true;
   }
 
+  void set(svgpp::tag::attribute::primitiveUnits, svgpp::tag::value::userSpaceOnUse)
+  {
+    primitiveUnitsUseObjectBoundingBox_ = false;
+  }
+
+  void set(svgpp::tag::attribute::primitiveUnits, svgpp::tag::value::objectBoundingBox)
+  {
+    primitiveUnitsUseObjectBoundingBox_ = true;
+  }
+
   void addElement(FilterElement const & el)
   {
     elements_.push_back(el);
   }
 
   ElementWithRegion region_;
-  bool filterUnitsUseObjectBoundingBox_;
+  bool filterUnitsUseObjectBoundingBox_, primitiveUnitsUseObjectBoundingBox_;
   std::vector<FilterElement> elements_;
 };
 
@@ -480,41 +686,57 @@ private:
 };
 
 class feFloodContext: 
-  public FilterElementBaseContext
+  public FilterElementBaseContext,
+  public ElementWithColorContext
 {
 public:
   feFloodContext(FilterContext & parent)
     : FilterElementBaseContext(data_)
+    , ElementWithColorContext(parent.color())
     , parent_(parent)
+    , currentColor_(false)
   {
   }
 
-  void on_exit_element() const 
+  void on_exit_element()
   {
+    // 'color' may follow 'flood-color' in attributes
+    if (currentColor_)
+      data_.flood_color_ = color();
     parent_.addElement(data_);
   }
 
   using FilterElementBaseContext::set;
+  using ElementWithColorContext::set;
   
-  // TODO: inheriting and 'style' handling for flood-color and flood-opacity
+  // TODO: 'style' handling for flood-color and flood-opacity
+
+  // Parent is 'filter' element, it doesn't get these properties, so they have initial values
   void set(svgpp::tag::attribute::flood_color, svgpp::tag::value::inherit)
-  {}
+  { 
+    data_.flood_color_ = BlackColor(); 
+    currentColor_ = false;
+  }
 
   void set(svgpp::tag::attribute::flood_color, svgpp::tag::value::currentColor)
-  {}
+  { currentColor_ = true; }
 
   void set(svgpp::tag::attribute::flood_color, color_t color, svgpp::tag::skip_icc_color = svgpp::tag::skip_icc_color())
-  { data_.flood_color_ = color; }
+  { 
+    data_.flood_color_ = color; 
+    currentColor_ = false;
+  }
 
   void set(svgpp::tag::attribute::flood_opacity, double val)
   { data_.flood_opacity_ = val; }
 
   void set(svgpp::tag::attribute::flood_opacity, svgpp::tag::value::inherit)
-  {}
+  { data_.flood_opacity_ = 1.0; }
 
 private:
   FilterContext & parent_;
   feFlood data_;
+  bool currentColor_;
 };
 
 class feColorMatrixContext: 
@@ -561,201 +783,678 @@ private:
   feColorMatrix data_;
 };
 
-struct context_factories
+class feGaussianBlurContext: 
+  public FilterElementBaseContext,
+  public ElementWithInputContext<svgpp::tag::attribute::in>
 {
-  template<class ParentContext, class ElementTag>
-  struct apply;
-};
+public:
+  feGaussianBlurContext(FilterContext & parent)
+    : FilterElementBaseContext(data_)
+    , ElementWithInputContext<svgpp::tag::attribute::in>(data_.input_)
+    , parent_(parent)
+  {
+  }
 
-template<>
-struct context_factories::apply<FilterContext, svgpp::tag::element::feBlend>
-{
-  typedef svgpp::factory::context::on_stack<feBlendContext> type;
-};
+  void on_exit_element() const 
+  {
+    parent_.addElement(data_);
+  }
 
-template<>
-struct context_factories::apply<FilterContext, svgpp::tag::element::feOffset>
-{
-  typedef svgpp::factory::context::on_stack<feOffsetContext> type;
-};
+  using FilterElementBaseContext::set;
+  using ElementWithInputContext<svgpp::tag::attribute::in>::set;
 
-template<>
-struct context_factories::apply<FilterContext, svgpp::tag::element::feComposite>
-{
-  typedef svgpp::factory::context::on_stack<feCompositeContext> type;
-};
+  void set(svgpp::tag::attribute::stdDeviation, double val)
+  { data_.stdDeviationX_ = data_.stdDeviationY_ = val; }
 
-template<>
-struct context_factories::apply<FilterContext, svgpp::tag::element::feComponentTransfer>
-{
-  typedef svgpp::factory::context::on_stack<feComponentTransferContext> type;
-};
+  void set(svgpp::tag::attribute::stdDeviation, double x, double y)
+  { 
+    data_.stdDeviationX_ = x; 
+    data_.stdDeviationY_ = y; 
+  }
 
-template<>
-struct context_factories::apply<FilterContext, svgpp::tag::element::feMerge>
-{
-  typedef svgpp::factory::context::on_stack<feMergeContext> type;
+private:
+  FilterContext & parent_;
+  feGaussianBlur data_;
 };
 
-template<>
-struct context_factories::apply<feMergeContext, svgpp::tag::element::feMergeNode>
+class feMorphologyContext: 
+  public FilterElementBaseContext,
+  public ElementWithInputContext<svgpp::tag::attribute::in>
 {
-  typedef svgpp::factory::context::on_stack<feMergeNodeContext> type;
-};
+public:
+  feMorphologyContext(FilterContext & parent)
+    : FilterElementBaseContext(data_)
+    , ElementWithInputContext<svgpp::tag::attribute::in>(data_.input_)
+    , parent_(parent)
+  {
+  }
 
-template<>
-struct context_factories::apply<FilterContext, svgpp::tag::element::feFlood>
-{
-  typedef svgpp::factory::context::on_stack<feFloodContext> type;
-};
+  void on_exit_element() const 
+  {
+    parent_.addElement(data_);
+  }
 
-template<>
-struct context_factories::apply<FilterContext, svgpp::tag::element::feColorMatrix>
-{
-  typedef svgpp::factory::context::on_stack<feColorMatrixContext> type;
-};
+  using FilterElementBaseContext::set;
+  using ElementWithInputContext<svgpp::tag::attribute::in>::set;
 
-template<>
-struct context_factories::apply<feComponentTransferContext, svgpp::tag::element::feFuncA>
-{
-  typedef svgpp::factory::context::on_stack<feFuncContext<feComponentTransfer::argbA> > type;
-};
+  void set(svgpp::tag::attribute::operator_, svgpp::tag::value::erode)
+  { data_.operator_ = feMorphology::opErode; }
 
-template<>
-struct context_factories::apply<feComponentTransferContext, svgpp::tag::element::feFuncR>
-{
-  typedef svgpp::factory::context::on_stack<feFuncContext<feComponentTransfer::argbR> > type;
-};
+  void set(svgpp::tag::attribute::operator_, svgpp::tag::value::dilate)
+  { data_.operator_ = feMorphology::opDilate; }
 
-template<>
-struct context_factories::apply<feComponentTransferContext, svgpp::tag::element::feFuncG>
-{
-  typedef svgpp::factory::context::on_stack<feFuncContext<feComponentTransfer::argbG> > type;
-};
+  void set(svgpp::tag::attribute::radius, double val)
+  { data_.radiusX_ = data_.radiusY_ = val; }
 
-template<>
-struct context_factories::apply<feComponentTransferContext, svgpp::tag::element::feFuncB>
-{
-  typedef svgpp::factory::context::on_stack<feFuncContext<feComponentTransfer::argbB> > type;
+  void set(svgpp::tag::attribute::radius, double x, double y)
+  { 
+    data_.radiusX_ = x; 
+    data_.radiusY_ = y; 
+  }
+
+private:
+  FilterContext & parent_;
+  feMorphology data_;
 };
 
-class BlendView: public IFilterView
+class feConvolveMatrixContext: 
+  public FilterElementBaseContext,
+  public ElementWithInputContext<svgpp::tag::attribute::in>
 {
+  typedef mpl::map<
+    mpl::pair< svgpp::tag::value::duplicate, mpl::integral_c<ConvolveMatrix::EdgeMode, ConvolveMatrix::edgeDuplicate> >,
+    mpl::pair< svgpp::tag::value::wrap,      mpl::integral_c<ConvolveMatrix::EdgeMode, ConvolveMatrix::edgeWrap> >,
+    mpl::pair< svgpp::tag::value::none,      mpl::integral_c<ConvolveMatrix::EdgeMode, ConvolveMatrix::edgeNone> >
+  > edge_mode_to_enum;
+
 public:
-  BlendView(feBlend const & fe, IFilterViewPtr const & in1, IFilterViewPtr const & in2)
-    : fe_(fe)
-    , in1_(in1)
-    , in2_(in2)
-  {}
+  feConvolveMatrixContext(FilterContext & parent)
+    : FilterElementBaseContext(data_)
+    , ElementWithInputContext<svgpp::tag::attribute::in>(data_.input_)
+    , parent_(parent)
+  {
+  }
 
-  virtual gil::rgba8c_view_t view() 
+  void on_exit_element() const 
   {
-    if (in1_)
-    {
-      image_.recreate(in1_->view().dimensions());
-      switch(fe_.mode_)
-      {
-      case feBlend::mNormal:
-        gil::transform_pixels(in1_->view(), in2_->view(), gil::view(image_), 
-          svgpp::gil_utility::blend_pixel<svgpp::tag::value::normal>());
-        break;
-      case feBlend::mMultiply:
-        gil::transform_pixels(in1_->view(), in2_->view(), gil::view(image_),
-          svgpp::gil_utility::blend_pixel<svgpp::tag::value::multiply>());
-        break;
-      case feBlend::mScreen:
-        gil::transform_pixels(in1_->view(), in2_->view(), gil::view(image_),
-          svgpp::gil_utility::blend_pixel<svgpp::tag::value::screen>());
-        break;
-      case feBlend::mDarken:
-        gil::transform_pixels(in1_->view(), in2_->view(), gil::view(image_),
-          svgpp::gil_utility::blend_pixel<svgpp::tag::value::darken>());
-        break;
-      case feBlend::mLighten:
-        gil::transform_pixels(in1_->view(), in2_->view(), gil::view(image_), 
-          svgpp::gil_utility::blend_pixel<svgpp::tag::value::lighten>());
-        break;
-      default:
-        BOOST_ASSERT(false);
-      }
-      in1_.reset();
-      in2_.reset();
-    }
-    return gil::const_view(image_);
+    parent_.addElement(data_);
   }
 
-private:
-  feBlend const fe_;
-  IFilterViewPtr in1_, in2_;
-  boost::gil::rgba8_image_t image_;
-};
+  using FilterElementBaseContext::set;
+  using ElementWithInputContext<svgpp::tag::attribute::in>::set;
 
-class CompositeView: public IFilterView
-{
-public:
-  CompositeView(feComposite const & fe, IFilterViewPtr const & in1, IFilterViewPtr const & in2)
-    : fe_(fe)
-    , in1_(in1)
-    , in2_(in2)
-  {}
+  void set(svgpp::tag::attribute::order, double val)
+  { data_.orderX_ = data_.orderY_ = val; }
 
-  virtual gil::rgba8c_view_t view() 
+  void set(svgpp::tag::attribute::order, double x, double y)
+  { 
+    data_.orderX_ = x; 
+    data_.orderY_ = y; 
+  }
+
+  template<class Values>
+  void set(svgpp::tag::attribute::kernelMatrix, Values const & values)
   {
-    if (in1_)
-    {
-      image_.recreate(in1_->view().dimensions());
-      switch(fe_.operator_)
-      {
-      case feComposite::opOver:
-        gil::transform_pixels(in1_->view(), in2_->view(), gil::view(image_), 
-          svgpp::gil_utility::composite_pixel<svgpp::tag::value::over>());
-        break;
-      case feComposite::opIn:
-        gil::transform_pixels(in1_->view(), in2_->view(), gil::view(image_), 
-          svgpp::gil_utility::composite_pixel<svgpp::tag::value::in>());
-        break;
-      case feComposite::opOut:
-        gil::transform_pixels(in1_->view(), in2_->view(), gil::view(image_), 
-          svgpp::gil_utility::composite_pixel<svgpp::tag::value::out>());
-        break;
-      case feComposite::opAtop:
-        gil::transform_pixels(in1_->view(), in2_->view(), gil::view(image_), 
-          svgpp::gil_utility::composite_pixel<svgpp::tag::value::atop>());
-        break;
-      case feComposite::opXor:
-        gil::transform_pixels(in1_->view(), in2_->view(), gil::view(image_), 
-          svgpp::gil_utility::composite_pixel<svgpp::tag::value::xor_>());
-        break;
-      case feComposite::opArithmetic:
-        gil::transform_pixels(in1_->view(), in2_->view(), gil::view(image_), 
-          svgpp::gil_utility::composite_pixel_arithmetic<boost::gil::rgba8c_view_t::value_type>(fe_.k1_, fe_.k2_, fe_.k3_, fe_.k4_));
-        break;
-      default:
-        BOOST_ASSERT(false);
-      }
-      in1_.reset();
-      in2_.reset();
-    }
-    return gil::const_view(image_);
+    data_.kernelMatrix_.assign(boost::begin(values), boost::end(values));
   }
 
-private:
-  feComposite const fe_;
-  IFilterViewPtr in1_, in2_;
-  boost::gil::rgba8_image_t image_;
-};
+  void set(svgpp::tag::attribute::divisor, double val)
+  { data_.divisor_ = val; }
 
-typedef boost::array<boost::uint8_t, 256> ChannelTransferTable;
+  void set(svgpp::tag::attribute::bias, double val)
+  { data_.bias_ = val; }
 
-struct ComponentTransferPixel
-{
-  ComponentTransferPixel(ChannelTransferTable const * tables)
-    : tables_(tables)
-  {}
+  void set(svgpp::tag::attribute::targetX, int val)
+  { data_.targetX_ = val; }
 
-  gil::rgba8_pixel_t operator()(const gil::rgba8_pixel_t & src) const 
+  void set(svgpp::tag::attribute::targetY, int val)
+  { data_.targetY_ = val; }
+
+  template<class EdgeMode>
+  void set(svgpp::tag::attribute::edgeMode, EdgeMode)
   {
-    gil::rgba8_pixel_t dst;
+    data_.edgeMode_ = mpl::at<edge_mode_to_enum, EdgeMode>::type::value;
+  }
+
+  void set(svgpp::tag::attribute::preserveAlpha, svgpp::tag::value::true_)
+  { data_.preserveAlpha_ = true; }
+
+  void set(svgpp::tag::attribute::preserveAlpha, svgpp::tag::value::false_)
+  { data_.preserveAlpha_ = false; }
+
+private:
+  FilterContext & parent_;
+  feConvolveMatrix data_;
+};
+
+class feTurbulenceContext: 
+  public FilterElementBaseContext
+{
+public:
+  feTurbulenceContext(FilterContext & parent)
+    : FilterElementBaseContext(data_)
+    , parent_(parent)
+  {
+  }
+
+  void on_exit_element() const 
+  {
+    parent_.addElement(data_);
+  }
+
+  using FilterElementBaseContext::set;
+
+  void set(svgpp::tag::attribute::baseFrequency, double val)
+  { data_.baseFrequencyX_ = data_.baseFrequencyY_ = val; }
+
+  void set(svgpp::tag::attribute::baseFrequency, double x, double y)
+  { 
+    data_.baseFrequencyX_ = x; 
+    data_.baseFrequencyY_ = y; 
+  }
+
+  void set(svgpp::tag::attribute::numOctaves, int val)
+  { data_.numOctaves_ = val; }
+
+  void set(svgpp::tag::attribute::seed, double val)
+  { data_.seed_ = val; }
+
+  void set(svgpp::tag::attribute::stitchTiles, svgpp::tag::value::stitch)
+  { data_.stitchTiles_ = true; }
+
+  void set(svgpp::tag::attribute::stitchTiles, svgpp::tag::value::noStitch)
+  { data_.stitchTiles_ = false; }
+
+  void set(svgpp::tag::attribute::type, svgpp::tag::value::fractalNoise)
+  { data_.fractalNoise_ = true; }
+
+  void set(svgpp::tag::attribute::type, svgpp::tag::value::turbulence)
+  { data_.fractalNoise_ = false; }
+
+private:
+  FilterContext & parent_;
+  feTurbulence data_;
+};
+
+class LightingContext: 
+  public FilterElementBaseContext,
+  public ElementWithInputContext<svgpp::tag::attribute::in>,
+  public ElementWithColorContext
+{
+public:
+  LightingContext(feLighting & data, FilterContext const & parent)
+    : FilterElementBaseContext(data)
+    , ElementWithInputContext<svgpp::tag::attribute::in>(data.input_)
+    , ElementWithColorContext(parent.color())
+    , lighting_(data)
+    , currentColor_(false)
+  {
+  }
+
+  // Only the first light source child element is used
+  void setLightSource(LightSource const & light)
+  {
+    if (lighting_.light_.type_ == LightSource::lsNone)
+      lighting_.light_ = light;
+  }
+
+  using FilterElementBaseContext::set;
+  using ElementWithInputContext<svgpp::tag::attribute::in>::set;
+  using ElementWithColorContext::set;
+
+  void set(svgpp::tag::attribute::surfaceScale, double val)
+  { lighting_.surfaceScale_ = val; }
+
+  // Parent is 'filter' element, it doesn't get 'lighting-color', so initial value (white) is used
+  void set(svgpp::tag::attribute::lighting_color, svgpp::tag::value::inherit)
+  { 
+    lighting_.lighting_color_ = boost::none; 
+    currentColor_ = false;
+  }
+
+  void set(svgpp::tag::attribute::lighting_color, svgpp::tag::value::currentColor)
+  { currentColor_ = true; }
+
+  void set(svgpp::tag::attribute::lighting_color, color_t color, svgpp::tag::skip_icc_color = svgpp::tag::skip_icc_color())
+  { 
+    lighting_.lighting_color_ = color; 
+    currentColor_ = false;
+  }
+
+protected:
+  // Must be called on exit from element, 'color' may follow 'lighting-color' in attributes
+  void resolveCurrentColor()
+  {
+    if (currentColor_)
+      lighting_.lighting_color_ = color();
+  }
+
+private:
+  feLighting & lighting_;
+  bool currentColor_;
+};
+
+class feDiffuseLightingContext: 
+  public LightingContext
+{
+public:
+  feDiffuseLightingContext(FilterContext & parent)
+    : LightingContext(data_, parent)
+    , parent_(parent)
+  {
+  }
+
+  void on_exit_element()
+  {
+    resolveCurrentColor();
+    parent_.addElement(data_);
+  }
+
+  using LightingContext::set;
+
+  void set(svgpp::tag::attribute::diffuseConstant, double val)
+  { data_.diffuseConstant_ = val; }
+
+private:
+  FilterContext & parent_;
+  feDiffuseLighting data_;
+};
+
+class feSpecularLightingContext: 
+  public LightingContext
+{
+public:
+  feSpecularLightingContext(FilterContext & parent)
+    : LightingContext(data_, parent)
+    , parent_(parent)
+  {
+  }
+
+  void on_exit_element()
+  {
+    resolveCurrentColor();
+    parent_.addElement(data_);
+  }
+
+  using LightingContext::set;
+
+  void set(svgpp::tag::attribute::specularConstant, double val)
+  { data_.specularConstant_ = val; }
+
+  void set(svgpp::tag::attribute::specularExponent, double val)
+  { data_.specularExponent_ = val; }
+
+private:
+  FilterContext & parent_;
+  feSpecularLighting data_;
+};
+
+template<LightSource::Type TypeArg>
+class LightSourceContext
+{
+public:
+  LightSourceContext(LightingContext & parent)
+    : parent_(parent)
+  {
+    data_.type_ = TypeArg;
+  }
+
+  void on_exit_element() const
+  {
+    parent_.setLightSource(data_);
+  }
+
+  void set(svgpp::tag::attribute::azimuth, double val) { data_.azimuth_ = val; }
+  void set(svgpp::tag::attribute::elevation, double val) { data_.elevation_ = val; }
+  void set(svgpp::tag::attribute::x, double val) { data_.x_ = val; }
+  void set(svgpp::tag::attribute::y, double val) { data_.y_ = val; }
+  void set(svgpp::tag::attribute::z, double val) { data_.z_ = val; }
+  void set(svgpp::tag::attribute::pointsAtX, double val) { data_.pointsAtX_ = val; }
+  void set(svgpp::tag::attribute::pointsAtY, double val) { data_.pointsAtY_ = val; }
+  void set(svgpp::tag::attribute::pointsAtZ, double val) { data_.pointsAtZ_ = val; }
+  void set(svgpp::tag::attribute::specularExponent, double val) { data_.specularExponent_ = val; }
+  void set(svgpp::tag::attribute::limitingConeAngle, double val) { data_.limitingConeAngle_ = val; }
+
+protected:
+  LightingContext & parent_;
+  LightSource data_;
+};
+
+struct context_factories
+{
+  template<class ParentContext, class ElementTag>
+  struct apply;
+};
+
+template<>
+struct context_factories::apply<FilterContext, svgpp::tag::element::feBlend>
+{
+  typedef svgpp::factory::context::on_stack<feBlendContext> type;
+};
+
+template<>
+struct context_factories::apply<FilterContext, svgpp::tag::element::feOffset>
+{
+  typedef svgpp::factory::context::on_stack<feOffsetContext> type;
+};
+
+template<>
+struct context_factories::apply<FilterContext, svgpp::tag::element::feComposite>
+{
+  typedef svgpp::factory::context::on_stack<feCompositeContext> type;
+};
+
+template<>
+struct context_factories::apply<FilterContext, svgpp::tag::element::feComponentTransfer>
+{
+  typedef svgpp::factory::context::on_stack<feComponentTransferContext> type;
+};
+
+template<>
+struct context_factories::apply<FilterContext, svgpp::tag::element::feMerge>
+{
+  typedef svgpp::factory::context::on_stack<feMergeContext> type;
+};
+
+template<>
+struct context_factories::apply<feMergeContext, svgpp::tag::element::feMergeNode>
+{
+  typedef svgpp::factory::context::on_stack<feMergeNodeContext> type;
+};
+
+template<>
+struct context_factories::apply<FilterContext, svgpp::tag::element::feFlood>
+{
+  typedef svgpp::factory::context::on_stack<feFloodContext> type;
+};
+
+template<>
+struct context_factories::apply<FilterContext, svgpp::tag::element::feColorMatrix>
+{
+  typedef svgpp::factory::context::on_stack<feColorMatrixContext> type;
+};
+
+template<>
+struct context_factories::apply<FilterContext, svgpp::tag::element::feGaussianBlur>
+{
+  typedef svgpp::factory::context::on_stack<feGaussianBlurContext> type;
+};
+
+template<>
+struct context_factories::apply<FilterContext, svgpp::tag::element::feMorphology>
+{
+  typedef svgpp::factory::context::on_stack<feMorphologyContext> type;
+};
+
+template<>
+struct context_factories::apply<FilterContext, svgpp::tag::element::feConvolveMatrix>
+{
+  typedef svgpp::factory::context::on_stack<feConvolveMatrixContext> type;
+};
+
+template<>
+struct context_factories::apply<FilterContext, svgpp::tag::element::feTurbulence>
+{
+  typedef svgpp::factory::context::on_stack<feTurbulenceContext> type;
+};
+
+template<>
+struct context_factories::apply<FilterContext, svgpp::tag::element::feDiffuseLighting>
+{
+  typedef svgpp::factory::context::on_stack<feDiffuseLightingContext> type;
+};
+
+template<>
+struct context_factories::apply<FilterContext, svgpp::tag::element::feSpecularLighting>
+{
+  typedef svgpp::factory::context::on_stack<feSpecularLightingContext> type;
+};
+
+template<>
+struct context_factories::apply<feComponentTransferContext, svgpp::tag::element::feFuncA>
+{
+  typedef svgpp::factory::context::on_stack<feFuncContext<feComponentTransfer::argbA> > type;
+};
+
+template<>
+struct context_factories::apply<feComponentTransferContext, svgpp::tag::element::feFuncR>
+{
+  typedef svgpp::factory::context::on_stack<feFuncContext<feComponentTransfer::argbR> > type;
+};
+
+template<>
+struct context_factories::apply<feComponentTransferContext, svgpp::tag::element::feFuncG>
+{
+  typedef svgpp::factory::context::on_stack<feFuncContext<feComponentTransfer::argbG> > type;
+};
+
+template<>
+struct context_factories::apply<feComponentTransferContext, svgpp::tag::element::feFuncB>
+{
+  typedef svgpp::factory::context::on_stack<feFuncContext<feComponentTransfer::argbB> > type;
+};
+
+// Light sources of both lighting elements
+template<class ElementTag>
+struct LightSourceFactory;
+
+template<>
+struct LightSourceFactory<svgpp::tag::element::feDistantLight>
+{
+  typedef svgpp::factory::context::on_stack<LightSourceContext<LightSource::lsDistant> > type;
+};
+
+template<>
+struct LightSourceFactory<svgpp::tag::element::fePointLight>
+{
+  typedef svgpp::factory::context::on_stack<LightSourceContext<LightSource::lsPoint> > type;
+};
+
+template<>
+struct LightSourceFactory<svgpp::tag::element::feSpotLight>
+{
+  typedef svgpp::factory::context::on_stack<LightSourceContext<LightSource::lsSpot> > type;
+};
+
+template<class ElementTag>
+struct context_factories::apply<feDiffuseLightingContext, ElementTag>: LightSourceFactory<ElementTag>
+{};
+
+template<class ElementTag>
+struct context_factories::apply<feSpecularLightingContext, ElementTag>: LightSourceFactory<ElementTag>
+{};
+
+namespace
+{
+  PixelRect intersectRects(PixelRect const & a, PixelRect const & b)
+  {
+    int const x1 = std::max(a.x_, b.x_), y1 = std::max(a.y_, b.y_);
+    int const x2 = std::min(a.x_ + a.width_, b.x_ + b.width_), y2 = std::min(a.y_ + a.height_, b.y_ + b.height_);
+    if (x1 >= x2 || y1 >= y2)
+      return PixelRect();
+    return PixelRect(x1, y1, x2 - x1, y2 - y1);
+  }
+
+  bool containsRect(PixelRect const & outer, PixelRect const & inner)
+  {
+    return inner.x_ >= outer.x_ && inner.y_ >= outer.y_
+      && inner.x_ + inner.width_ <= outer.x_ + outer.width_
+      && inner.y_ + inner.height_ <= outer.y_ + outer.height_;
+  }
+
+  // Pixels of 'in' over 'rect'. They are copied to 'buffer' only if 'in' doesn't cover 'rect'.
+  // NULL input is transparent black
+  gil::rgba8c_view_t inputView(IFilterViewPtr const & in, PixelRect const & rect, gil::rgba8_image_t & buffer)
+  {
+    PixelRect const region = in ? in->region() : PixelRect();
+    if (in && containsRect(region, rect))
+      return gil::subimage_view(in->view(), 
+        rect.x_ - region.x_, rect.y_ - region.y_, rect.width_, rect.height_);
+    buffer.recreate(rect.width_, rect.height_, gil::rgba8_pixel_t(0, 0, 0, 0), 0);
+    PixelRect const common = intersectRects(region, rect);
+    if (!common.empty())
+      gil::copy_pixels(
+        gil::subimage_view(in->view(), 
+          common.x_ - region.x_, common.y_ - region.y_, common.width_, common.height_),
+        gil::subimage_view(gil::view(buffer), 
+          common.x_ - rect.x_, common.y_ - rect.y_, common.width_, common.height_));
+    return gil::const_view(buffer);
+  }
+
+  void colorComponents(color_t const & color, double components[3])
+  {
+#if defined(RENDERER_AGG)
+    components[0] = color.r / 255.0;
+    components[1] = color.g / 255.0;
+    components[2] = color.b / 255.0;
+#elif defined(RENDERER_GDIPLUS)
+    components[0] = color.GetR() / 255.0;
+    components[1] = color.GetG() / 255.0;
+    components[2] = color.GetB() / 255.0;
+#elif defined(RENDERER_SKIA)
+    components[0] = SkColorGetR(color) / 255.0;
+    components[1] = SkColorGetG(color) / 255.0;
+    components[2] = SkColorGetB(color) / 255.0;
+#endif
+  }
+}
+
+// Calculates pixels of the primitive subregion on the first call of view()
+class PrimitiveView: public IFilterView
+{
+public:
+  PrimitiveView(PixelRect const & region)
+    : region_(region)
+    , calculated_(false)
+  {}
+
+  virtual gil::rgba8c_view_t view() 
+  {
+    if (!calculated_)
+    {
+      image_.recreate(region_.width_, region_.height_);
+      calculate(gil::view(image_));
+      calculated_ = true;
+    }
+    return gil::const_view(image_);
+  }
+
+  virtual PixelRect region() const { return region_; }
+
+protected:
+  // Must fill all of 'result' and may release inputs
+  virtual void calculate(gil::rgba8_view_t const & result) = 0;
+
+private:
+  PixelRect const region_;
+  bool calculated_;
+  boost::gil::rgba8_image_t image_;
+};
+
+class BlendView: public PrimitiveView
+{
+public:
+  BlendView(feBlend const & fe, PixelRect const & region, IFilterViewPtr const & in1, IFilterViewPtr const & in2)
+    : PrimitiveView(region)
+    , fe_(fe)
+    , in1_(in1)
+    , in2_(in2)
+  {}
+
+protected:
+  virtual void calculate(gil::rgba8_view_t const & result) 
+  {
+    gil::rgba8_image_t buffer1, buffer2;
+    gil::rgba8c_view_t const in1 = inputView(in1_, region(), buffer1);
+    gil::rgba8c_view_t const in2 = inputView(in2_, region(), buffer2);
+    switch(fe_.mode_)
+    {
+    case feBlend::mNormal:
+      svgpp::gil_utility::blend_pixels<svgpp::tag::value::normal>(in1, in2, result);
+      break;
+    case feBlend::mMultiply:
+      svgpp::gil_utility::blend_pixels<svgpp::tag::value::multiply>(in1, in2, result);
+      break;
+    case feBlend::mScreen:
+      svgpp::gil_utility::blend_pixels<svgpp::tag::value::screen>(in1, in2, result);
+      break;
+    case feBlend::mDarken:
+      svgpp::gil_utility::blend_pixels<svgpp::tag::value::darken>(in1, in2, result);
+      break;
+    case feBlend::mLighten:
+      svgpp::gil_utility::blend_pixels<svgpp::tag::value::lighten>(in1, in2, result);
+      break;
+    default:
+      BOOST_ASSERT(false);
+    }
+    in1_.reset();
+    in2_.reset();
+  }
+
+private:
+  feBlend const & fe_;
+  IFilterViewPtr in1_, in2_;
+};
+
+class CompositeView: public PrimitiveView
+{
+public:
+  CompositeView(feComposite const & fe, PixelRect const & region, IFilterViewPtr const & in1, IFilterViewPtr const & in2)
+    : PrimitiveView(region)
+    , fe_(fe)
+    , in1_(in1)
+    , in2_(in2)
+  {}
+
+protected:
+  virtual void calculate(gil::rgba8_view_t const & result) 
+  {
+    gil::rgba8_image_t buffer1, buffer2;
+    gil::rgba8c_view_t const in1 = inputView(in1_, region(), buffer1);
+    gil::rgba8c_view_t const in2 = inputView(in2_, region(), buffer2);
+    switch(fe_.operator_)
+    {
+    case feComposite::opOver:
+      svgpp::gil_utility::composite_pixels<svgpp::tag::value::over>(in1, in2, result);
+      break;
+    case feComposite::opIn:
+      svgpp::gil_utility::composite_pixels<svgpp::tag::value::in>(in1, in2, result);
+      break;
+    case feComposite::opOut:
+      svgpp::gil_utility::composite_pixels<svgpp::tag::value::out>(in1, in2, result);
+      break;
+    case feComposite::opAtop:
+      svgpp::gil_utility::composite_pixels<svgpp::tag::value::atop>(in1, in2, result);
+      break;
+    case feComposite::opXor:
+      svgpp::gil_utility::composite_pixels<svgpp::tag::value::xor_>(in1, in2, result);
+      break;
+    case feComposite::opArithmetic:
+      svgpp::gil_utility::composite_pixels_arithmetic(in1, in2, result, fe_.k1_, fe_.k2_, fe_.k3_, fe_.k4_);
+      break;
+    default:
+      BOOST_ASSERT(false);
+    }
+    in1_.reset();
+    in2_.reset();
+  }
+
+private:
+  feComposite const & fe_;
+  IFilterViewPtr in1_, in2_;
+};
+
+typedef boost::array<boost::uint8_t, 256> ChannelTransferTable;
+
+struct ComponentTransferPixel
+{
+  ComponentTransferPixel(ChannelTransferTable const * tables)
+    : tables_(tables)
+  {}
+
+  gil::rgba8_pixel_t operator()(const gil::rgba8_pixel_t & src) const 
+  {
+    gil::rgba8_pixel_t dst;
     for(size_t ch = 0; ch < 4; ++ch)
       dst[ch] = tables_[ch][src[ch]];
 
@@ -763,338 +1462,939 @@ struct ComponentTransferPixel
   }
 
 private:
-  ChannelTransferTable const * tables_;
+  ChannelTransferTable const * tables_;
+};
+
+class ComponentTransferView: public PrimitiveView
+{
+public:
+  ComponentTransferView(feComponentTransfer const & fe, PixelRect const & region, IFilterViewPtr const & in)
+    : PrimitiveView(region)
+    , fe_(fe)
+    , in_(in)
+  {}
+
+protected:
+  virtual void calculate(gil::rgba8_view_t const & result) 
+  {
+    ChannelTransferTable tables[4];
+    for(int ch = 0; ch < 4; ++ch)
+    {
+      ChannelTransferTable & table = tables[ch];
+      feFunc const & func = fe_.func_[ch];
+      switch(func.type_)
+      {
+      case feFunc::fTable:
+      case feFunc::fDiscrete: // TODO
+      case feFunc::fIdentity:
+        for(int i=0; i<256; ++i)
+          table[i] = i;
+        break;
+      case feFunc::fLinear:
+        // C' = slope * C + intercept
+        for(int i=0; i<256; ++i)
+          table[i] = svgpp::gil_detail::clamp_channel_bits8(static_cast<int>(func.slope_ * i + func.intercept_ * 255 + 0.49));
+        break;
+      case feFunc::fGamma:
+        for(int i=0; i<256; ++i)
+          // C' = amplitude * pow(C, exponent) + offset
+          table[i] = svgpp::gil_detail::clamp_channel_bits8(static_cast<int>(
+            (func.amplitude_ * std::pow(i / 255.0, func.exponent_) + func.offset_) * 255.0 + 0.49));
+        break;
+      default:
+        BOOST_ASSERT(false);
+      }
+    }
+    gil::rgba8_image_t buffer;
+    gil::transform_pixels(inputView(in_, region(), buffer), result, ComponentTransferPixel(tables));
+    in_.reset();
+  }
+
+private:
+  feComponentTransfer const & fe_;
+  IFilterViewPtr in_;
+};
+
+class OffsetView: public PrimitiveView
+{
+public:
+  // 'dx' and 'dy' are in device pixels
+  OffsetView(PixelRect const & region, IFilterViewPtr const & in, int dx, int dy)
+    : PrimitiveView(region)
+    , in_(in)
+    , dx_(dx)
+    , dy_(dy)
+  {}
+
+protected:
+  virtual void calculate(gil::rgba8_view_t const & result) 
+  {
+    PixelRect const source = region();
+    gil::rgba8_image_t buffer;
+    gil::copy_pixels(
+      inputView(in_, PixelRect(source.x_ - dx_, source.y_ - dy_, source.width_, source.height_), buffer), 
+      result);
+    in_.reset();
+  }
+
+private:
+  IFilterViewPtr in_;
+  int const dx_, dy_;
+};
+
+class GaussianBlurView: public PrimitiveView
+{
+public:
+  // Standard deviations are in device pixels
+  GaussianBlurView(PixelRect const & region, IFilterViewPtr const & in, double stdDeviationX, double stdDeviationY)
+    : PrimitiveView(region)
+    , in_(in)
+    , stdDeviationX_(stdDeviationX)
+    , stdDeviationY_(stdDeviationY)
+  {}
+
+protected:
+  virtual void calculate(gil::rgba8_view_t const & result) 
+  {
+    // Only input pixels within blur reach from the subregion are used
+    PixelRect const target = region();
+    int const reachX = gaussianBlurReach(stdDeviationX_), reachY = gaussianBlurReach(stdDeviationY_);
+    PixelRect source(target.x_ - reachX, target.y_ - reachY, 
+      target.width_ + 2 * reachX, target.height_ + 2 * reachY);
+    if (in_)
+      source = intersectRects(source, in_->region());
+    if (source.empty())
+      gil::fill_pixels(result, gil::rgba8_pixel_t(0, 0, 0, 0));
+    else
+    {
+      gil::rgba8_image_t buffer;
+      gaussianBlur(inputView(in_, source, buffer), target.x_ - source.x_, target.y_ - source.y_, 
+        result, stdDeviationX_, stdDeviationY_);
+    }
+    in_.reset();
+  }
+
+private:
+  IFilterViewPtr in_;
+  double const stdDeviationX_, stdDeviationY_;
+};
+
+class MorphologyView: public PrimitiveView
+{
+public:
+  // Radii are in device pixels
+  MorphologyView(PixelRect const & region, IFilterViewPtr const & in, int radiusX, int radiusY, bool dilate)
+    : PrimitiveView(region)
+    , in_(in)
+    , radiusX_(radiusX)
+    , radiusY_(radiusY)
+    , dilate_(dilate)
+  {}
+
+protected:
+  virtual void calculate(gil::rgba8_view_t const & result) 
+  {
+    // Pixels outside of the input region are transparent, so they aren't copied even for erosion
+    PixelRect const target = region();
+    PixelRect source(target.x_ - radiusX_, target.y_ - radiusY_, 
+      target.width_ + 2 * radiusX_, target.height_ + 2 * radiusY_);
+    if (in_)
+      source = intersectRects(source, in_->region());
+    if (source.empty())
+      gil::fill_pixels(result, gil::rgba8_pixel_t(0, 0, 0, 0));
+    else
+    {
+      gil::rgba8_image_t buffer;
+      morphology(inputView(in_, source, buffer), target.x_ - source.x_, target.y_ - source.y_, 
+        result, radiusX_, radiusY_, dilate_);
+    }
+    in_.reset();
+  }
+
+private:
+  IFilterViewPtr in_;
+  int const radiusX_, radiusY_;
+  bool const dilate_;
+};
+
+class ConvolveMatrixView: public PrimitiveView
+{
+public:
+  ConvolveMatrixView(PixelRect const & region, IFilterViewPtr const & in, ConvolveMatrix const & matrix)
+    : PrimitiveView(region)
+    , in_(in)
+    , matrix_(matrix)
+  {}
+
+protected:
+  virtual void calculate(gil::rgba8_view_t const & result) 
+  {
+    // Edge modes extend the whole input image, so it is used as is
+    PixelRect const target = region();
+    if (in_ && !in_->region().empty())
+    {
+      PixelRect const source = in_->region();
+      convolveMatrix(in_->view(), target.x_ - source.x_, target.y_ - source.y_, result, matrix_);
+    }
+    else
+      gil::fill_pixels(result, gil::rgba8_pixel_t(0, 0, 0, 0));
+    in_.reset();
+  }
+
+private:
+  IFilterViewPtr in_;
+  ConvolveMatrix const matrix_;
 };
 
-class ComponentTransferView: public IFilterView
+class TurbulenceView: public PrimitiveView
 {
 public:
-  ComponentTransferView(feComponentTransfer const & fe, IFilterViewPtr const & in)
-    : fe_(fe)
-    , in_(in)
+  TurbulenceView(PixelRect const & region, Turbulence const & params)
+    : PrimitiveView(region)
+    , params_(params)
   {}
 
-  virtual gil::rgba8c_view_t view() 
+protected:
+  virtual void calculate(gil::rgba8_view_t const & result) 
   {
-    if (in_)
-    {
-      image_.recreate(in_->view().dimensions());
-      ChannelTransferTable tables[4];
-      for(int ch = 0; ch < 4; ++ch)
-      {
-        ChannelTransferTable & table = tables[ch];
-        feFunc const & func = fe_.func_[ch];
-        switch(func.type_)
-        {
-        case feFunc::fTable:
-        case feFunc::fDiscrete: // TODO
-        case feFunc::fIdentity:
-          for(int i=0; i<256; ++i)
-            table[i] = i;
-          break;
-        case feFunc::fLinear:
-          // C' = slope * C + intercept
-          for(int i=0; i<256; ++i)
-            table[i] = svgpp::gil_detail::clamp_channel_bits8(static_cast<int>(func.slope_ * i + func.intercept_ * 255 + 0.49));
-          break;
-        case feFunc::fGamma:
-          for(int i=0; i<256; ++i)
-            // C' = amplitude * pow(C, exponent) + offset
-            table[i] = svgpp::gil_detail::clamp_channel_bits8(static_cast<int>(
-              (func.amplitude_ * std::pow(i / 255.0, func.exponent_) + func.offset_) * 255.0 + 0.49));
-          break;
-        default:
-          BOOST_ASSERT(false);
-        }
-      }
-      gil::transform_pixels(in_->view(), gil::view(image_), ComponentTransferPixel(tables));
-      in_.reset();
-    }
-    return gil::const_view(image_);
+    turbulence(region().x_, region().y_, result, params_);
   }
 
 private:
-  feComponentTransfer const fe_;
-  IFilterViewPtr in_;
-  boost::gil::rgba8_image_t image_;
+  Turbulence const params_;
 };
 
-class OffsetView: public IFilterView
+class LightingView: public PrimitiveView
 {
 public:
-  OffsetView(feOffset const & fe, IFilterViewPtr const & in)
-    : fe_(fe)
+  LightingView(PixelRect const & region, IFilterViewPtr const & in, Lighting const & params)
+    : PrimitiveView(region)
     , in_(in)
+    , params_(params)
   {}
 
-  virtual gil::rgba8c_view_t view() 
+protected:
+  virtual void calculate(gil::rgba8_view_t const & result) 
   {
-    // TODO: use transform
-    if (in_)
-    {
-      image_.recreate(in_->view().dimensions(), gil::rgba8_pixel_t(0, 0, 0, 0), 0);
-      int w = image_.width() - std::abs(fe_.dx_);
-      int h = image_.height() - std::abs(fe_.dy_);
-      if (w > 0 && h > 0)
-      {
-        gil::copy_pixels(
-          gil::subimage_view(in_->view(),  
-            std::max(0.0, -fe_.dx_), std::max(0.0, -fe_.dy_), w, h),
-          gil::subimage_view(gil::view(image_),  
-            std::max(0.0, fe_.dx_), std::max(0.0, fe_.dy_), w, h));
-      }
-      in_.reset();
-    }
-    return gil::const_view(image_);
+    gil::rgba8_image_t buffer;
+    lighting(inputView(in_, region(), buffer), region().x_, region().y_, result, params_);
+    in_.reset();
   }
 
 private:
-  feOffset const fe_;
   IFilterViewPtr in_;
-  boost::gil::rgba8_image_t image_;
+  Lighting const params_;
 };
 
-class MergeView: public IFilterView
+class MergeView: public PrimitiveView
 {
 public:
+  MergeView(PixelRect const & region)
+    : PrimitiveView(region)
+  {}
+
   void addNode(IFilterViewPtr const & in)
   {
     nodes_.push_back(in);
   }
 
-  virtual gil::rgba8c_view_t view() 
+protected:
+  virtual void calculate(gil::rgba8_view_t const & result) 
   {
-    // TODO: what if empty?
-    if (!nodes_.empty())
-    {
-      image_.recreate(nodes_.front()->view().dimensions());
-      if (nodes_.size() == 1)
-        gil::copy_pixels(nodes_.front()->view(), gil::view(image_));
-      else
-      {
-        gil::transform_pixels(nodes_[0]->view(), nodes_[1]->view(), gil::view(image_), 
-          svgpp::gil_utility::composite_pixel<svgpp::tag::value::over>());
-        for(size_t i = 2; i < nodes_.size(); ++i)
-          gil::transform_pixels(gil::view(image_), nodes_[i]->view(), gil::view(image_), 
-            svgpp::gil_utility::composite_pixel<svgpp::tag::value::over>());
-      }
-      nodes_.clear();
-    }
-    return gil::const_view(image_);
+    gil::fill_pixels(result, gil::rgba8_pixel_t(0, 0, 0, 0));
+    // Each node is placed over the previous ones
+    gil::rgba8_image_t buffer;
+    for(size_t i = 0; i < nodes_.size(); ++i)
+      svgpp::gil_utility::composite_pixels<svgpp::tag::value::over>(
+        inputView(nodes_[i], region(), buffer), result, result);
+    nodes_.clear();
   }
 
 private:
   std::vector<IFilterViewPtr> nodes_;
-  boost::gil::rgba8_image_t image_;
 };
 
-class FloodView: public IFilterView
+class FloodView: public PrimitiveView
 {
 public:
-  FloodView(feFlood const & fe)
-    : fe_(fe)
+  FloodView(feFlood const & fe, PixelRect const & region)
+    : PrimitiveView(region)
+    , fe_(fe)
   {}
 
-  virtual gil::rgba8c_view_t view() 
+protected:
+  virtual void calculate(gil::rgba8_view_t const & result) 
   {
-    if (image_.width() == 0)
-    {
-      //image_.recreate(in_->view().dimensions(), gil::rgba8_pixel_t(0, 0, 0, 0), 0);
-    }
-    return gil::const_view(image_);
+    double components[3];
+    colorComponents(fe_.flood_color_, components);
+    double const alpha = std::min(1.0, std::max(0.0, fe_.flood_opacity_));
+    // Premultiplied
+    gil::fill_pixels(result, gil::rgba8_pixel_t(
+      svgpp::gil_detail::clamp_channel_bits8(static_cast<int>(components[0] * alpha * 255 + 0.5)),
+      svgpp::gil_detail::clamp_channel_bits8(static_cast<int>(components[1] * alpha * 255 + 0.5)),
+      svgpp::gil_detail::clamp_channel_bits8(static_cast<int>(components[2] * alpha * 255 + 0.5)),
+      svgpp::gil_detail::clamp_channel_bits8(static_cast<int>(alpha * 255 + 0.5))));
   }
 
 private:
-  feFlood const fe_;
-  boost::gil::rgba8_image_t image_;
+  feFlood const & fe_;
 };
 
-class ColorMatrixView: public IFilterView
+class ColorMatrixView: public PrimitiveView
 {
 public:
-  ColorMatrixView(feColorMatrix const & fe, IFilterViewPtr const & input)
-    : fe_(fe)
+  ColorMatrixView(feColorMatrix const & fe, PixelRect const & region, IFilterViewPtr const & input)
+    : PrimitiveView(region)
+    , fe_(fe)
     , in_(input)
   {}
 
-  virtual gil::rgba8c_view_t view() 
+protected:
+  virtual void calculate(gil::rgba8_view_t const & result) 
   {
-    if (in_)
+    typedef svgpp::gil_utility::color_matrix_transform<boost::gil::rgba8c_view_t::value_type> transform_t;
+    gil::rgba8_image_t buffer;
+    gil::rgba8c_view_t const in = inputView(in_, region(), buffer);
+    switch(fe_.type_)
     {
-      typedef svgpp::gil_utility::color_matrix_transform<boost::gil::rgba8c_view_t::value_type> transform_t;
-      image_.recreate(in_->view().dimensions());
-      switch(fe_.type_)
-      {
-      case feColorMatrix::mMatrix:
-      {
-        if (fe_.values_ && fe_.values_->size() != 20)
-          throw std::runtime_error("For feColorMatrix type=\"matrix\", 'values' must be a list of 20 values");
-        boost::multi_array<double, 2> m(boost::extents[4][5]);
-        if (fe_.values_)
-          m.assign(fe_.values_->begin(), fe_.values_->end());
-        else
-          for(int i=0; i<4; ++i)
-            m[i][i] = 1;
-        gil::transform_pixels(in_->view(), gil::view(image_), transform_t(m));
-      }
-      break;
-      case feColorMatrix::mSaturate:
-      {
-        if (fe_.values_ && fe_.values_->size() != 1)
-          throw std::runtime_error("For feColorMatrix type=\"saturate\", 'values' must be single real number");
-        double saturate = fe_.values_ ? fe_.values_->front() : 1;
-        saturate = std::min(1.0, std::max(0.0, saturate));
-        gil::transform_pixels(in_->view(), gil::view(image_), 
-          transform_t(svgpp::gil_utility::get_saturate_matrix(saturate)));
-      }
-      break;
-      case feColorMatrix::mHueRotate:
-      {
-        if (fe_.values_ && fe_.values_->size() != 1)
-          throw std::runtime_error("For feColorMatrix type=\"hueRotate\", 'values' must be single real number");
-        double angle = fe_.values_ ? fe_.values_->front() : 0;
-        gil::transform_pixels(in_->view(), gil::view(image_), 
-          transform_t(svgpp::gil_utility::get_hue_rotate_matrix(angle * boost::math::constants::degree<double>())));
-      }
-      break;
-      case feColorMatrix::mLuminanceToAlpha:
-      {
-        gil::copy_pixels(
-          gil::color_converted_view<gil::rgba8_pixel_t>(
-            in_->view(),
-            svgpp::gil_utility::rgba_to_mask_color_converter<boost::gil::alpha_t>()
-          ),
-          gil::view(image_));
-      }
-      break;
-      }
+    case feColorMatrix::mMatrix:
+    {
+      if (fe_.values_ && fe_.values_->size() != 20)
+        throw std::runtime_error("For feColorMatrix type=\"matrix\", 'values' must be a list of 20 values");
+      boost::multi_array<double, 2> m(boost::extents[4][5]);
+      if (fe_.values_)
+        m.assign(fe_.values_->begin(), fe_.values_->end());
+      else
+        for(int i=0; i<4; ++i)
+          m[i][i] = 1;
+      svgpp::gil_utility::color_matrix_pixels(in, result, transform_t(m));
     }
-    return gil::const_view(image_);
+    break;
+    case feColorMatrix::mSaturate:
+    {
+      if (fe_.values_ && fe_.values_->size() != 1)
+        throw std::runtime_error("For feColorMatrix type=\"saturate\", 'values' must be single real number");
+      double saturate = fe_.values_ ? fe_.values_->front() : 1;
+      saturate = std::min(1.0, std::max(0.0, saturate));
+      svgpp::gil_utility::color_matrix_pixels(in, result, 
+        transform_t(svgpp::gil_utility::get_saturate_matrix(saturate)));
+    }
+    break;
+    case feColorMatrix::mHueRotate:
+    {
+      if (fe_.values_ && fe_.values_->size() != 1)
+        throw std::runtime_error("For feColorMatrix type=\"hueRotate\", 'values' must be single real number");
+      double angle = fe_.values_ ? fe_.values_->front() : 0;
+      svgpp::gil_utility::color_matrix_pixels(in, result, 
+        transform_t(svgpp::gil_utility::get_hue_rotate_matrix(angle * boost::math::constants::degree<double>())));
+    }
+    break;
+    case feColorMatrix::mLuminanceToAlpha:
+    {
+      gil::copy_pixels(
+        gil::color_converted_view<gil::rgba8_pixel_t>(
+          in,
+          svgpp::gil_utility::rgba_to_mask_color_converter<boost::gil::alpha_t>()
+        ),
+        result);
+    }
+    break;
+    }
+    in_.reset();
   }
 
 private:
+  feColorMatrix const & fe_;
   IFilterViewPtr in_;
-  feColorMatrix const fe_;
-  boost::gil::rgba8_image_t image_;
 };
 
-class AlphaChannelView: public IFilterView
+class AlphaChannelView: public PrimitiveView
 {
 public:
   AlphaChannelView(IFilterViewPtr const & in)
-    : in_(in)
+    : PrimitiveView(in ? in->region() : PixelRect())
+    , in_(in)
   {}
 
-  virtual gil::rgba8c_view_t view() 
+protected:
+  virtual void calculate(gil::rgba8_view_t const & result) 
   {
-    if (in_)
-    {
-      image_.recreate(in_->view().dimensions(), gil::rgba8_pixel_t(0, 0, 0, 0), 0);
-      gil::copy_pixels(
-        gil::kth_channel_view<gil::color_index_type<gil::rgba8_pixel_t, gil::alpha_t>::value>(in_->view()), 
-        gil::kth_channel_view<gil::color_index_type<gil::rgba8_pixel_t, gil::alpha_t>::value>(gil::view(image_)));
-      in_.reset();
-    }
-    return gil::const_view(image_);
+    gil::fill_pixels(result, gil::rgba8_pixel_t(0, 0, 0, 0));
+    gil::rgba8_image_t buffer;
+    gil::copy_pixels(
+      gil::kth_channel_view<gil::color_index_type<gil::rgba8_pixel_t, gil::alpha_t>::value>(inputView(in_, region(), buffer)), 
+      gil::kth_channel_view<gil::color_index_type<gil::rgba8_pixel_t, gil::alpha_t>::value>(result));
+    in_.reset();
   }
 
 private:
   IFilterViewPtr in_;
-  boost::gil::rgba8_image_t image_;
 };
 
-struct FilterElementVisitor:
-  public boost::static_visitor<>,
-  boost::noncopyable
+// Input of compiled primitive is either one of standard inputs or result of preceding primitive
+struct CompiledInput
+{
+  FilterInput::source source_; // Never fiNotSet
+  std::size_t primitive_; // Index of primitive if source_ == fiReference
+};
+
+struct CompiledPrimitive
+{
+  FilterElement element_;
+  ElementWithRegion region_; // Primitive subregion
+  std::vector<CompiledInput> inputs_; // 'in' and 'in2', or 'in' of each feMergeNode
+};
+
+class CompiledFilter
+{
+public:
+  ElementWithRegion region_;
+  bool filterUnitsUseObjectBoundingBox_, primitiveUnitsUseObjectBoundingBox_;
+  std::vector<CompiledPrimitive> primitives_; // Each one uses only preceding ones, last is the filter result
+};
+
+struct PrimitiveInputsVisitor:
+  public boost::static_visitor<FilterElementBase const *>
 {
-  FilterElementVisitor(Filters::Input const & input)
-    : input_(input)
+  PrimitiveInputsVisitor(std::vector<FilterInput const *> & inputs)
+    : inputs_(inputs)
   {}
 
-  void operator()(feBlend const & fe)
+  FilterElementBase const * operator()(feBlend const & fe) const
   {
-    boost::shared_ptr<BlendView> feView(new BlendView(fe, findInput(fe.input1_), findInput(fe.input2_)));
-    if (!fe.result_.empty())
-      namedFilters_[fe.result_] = feView;
-    lastFilter_ = feView;
+    inputs_.push_back(&fe.input1_);
+    inputs_.push_back(&fe.input2_);
+    return &fe;
   }
 
-  void operator()(feComponentTransfer const & fe)
+  FilterElementBase const * operator()(feComponentTransfer const & fe) const
   {
-    boost::shared_ptr<ComponentTransferView> feView(new ComponentTransferView(fe, findInput(fe.input_)));
-    if (!fe.result_.empty())
-      namedFilters_[fe.result_] = feView;
-    lastFilter_ = feView;
+    inputs_.push_back(&fe.input_);
+    return &fe;
   }
 
-  void operator()(feOffset const & fe)
+  FilterElementBase const * operator()(feOffset const & fe) const
   {
-    boost::shared_ptr<OffsetView> feView(new OffsetView(fe, findInput(fe.input_)));
-    if (!fe.result_.empty())
-      namedFilters_[fe.result_] = feView;
-    lastFilter_ = feView;
+    inputs_.push_back(&fe.input_);
+    return &fe;
   }
 
-  void operator()(feComposite const & fe)
+  FilterElementBase const * operator()(feComposite const & fe) const
   {
-    boost::shared_ptr<CompositeView> feView(new CompositeView(fe, findInput(fe.input1_), findInput(fe.input2_)));
-    if (!fe.result_.empty())
-      namedFilters_[fe.result_] = feView;
-    lastFilter_ = feView;
+    inputs_.push_back(&fe.input1_);
+    inputs_.push_back(&fe.input2_);
+    return &fe;
   }
 
-  void operator()(feMerge const & fe)
+  FilterElementBase const * operator()(feMerge const & fe) const
   {
-    boost::shared_ptr<MergeView> feView(new MergeView);
     for(std::vector<FilterInput>::const_iterator f = fe.inputs_.begin();
       f != fe.inputs_.end(); ++f)
-      feView->addNode(findInput(*f));
-    if (!fe.result_.empty())
-      namedFilters_[fe.result_] = feView;
-    lastFilter_ = feView;
+      inputs_.push_back(&*f);
+    return &fe;
+  }
+
+  FilterElementBase const * operator()(feFlood const & fe) const
+  {
+    return &fe;
+  }
+
+  FilterElementBase const * operator()(feColorMatrix const & fe) const
+  {
+    inputs_.push_back(&fe.input_);
+    return &fe;
+  }
+
+  FilterElementBase const * operator()(feGaussianBlur const & fe) const
+  {
+    inputs_.push_back(&fe.input_);
+    return &fe;
+  }
+
+  FilterElementBase const * operator()(feMorphology const & fe) const
+  {
+    inputs_.push_back(&fe.input_);
+    return &fe;
+  }
+
+  FilterElementBase const * operator()(feConvolveMatrix const & fe) const
+  {
+    inputs_.push_back(&fe.input_);
+    return &fe;
+  }
+
+  FilterElementBase const * operator()(feTurbulence const & fe) const
+  {
+    return &fe;
+  }
+
+  FilterElementBase const * operator()(feLighting const & fe) const
+  {
+    inputs_.push_back(&fe.input_);
+    return &fe;
+  }
+
+private:
+  std::vector<FilterInput const *> & inputs_;
+};
+
+// Rectangle in user space
+struct UserRect
+{
+  double x_, y_, width_, height_;
+};
+
+// Creates views for a single use of the compiled filter
+class FilterGraphBinder:
+  public boost::static_visitor<IFilterViewPtr>,
+  boost::noncopyable
+{
+public:
+  FilterGraphBinder(CompiledFilter const & filter, Filters::Input const & input, 
+    length_factory_t const & length_factory)
+    : filter_(filter)
+    , input_(input)
+    , lengthFactory_(length_factory)
+    , fractionLengthFactory_(length_factory)
+    , primitive_(NULL)
+  {
+    // Percentages of 'objectBoundingBox' units are fractions of the bounding box
+    fractionLengthFactory_.set_viewport_size(1, 1);
+    setBoundingBox();
+    UserRect defaults;
+    if (filter.filterUnitsUseObjectBoundingBox_)
+    {
+      UserRect const fractions = { -0.1, -0.1, 1.2, 1.2 };
+      defaults = fromBoundingBox(fractions);
+    }
+    else
+    {
+      using namespace svgpp::tag;
+      defaults.x_ = length_factory.create_length(-10, length_units::percent(), length_dimension::width());
+      defaults.y_ = length_factory.create_length(-10, length_units::percent(), length_dimension::height());
+      defaults.width_ = length_factory.create_length(120, length_units::percent(), length_dimension::width());
+      defaults.height_ = length_factory.create_length(120, length_units::percent(), length_dimension::height());
+    }
+    filterRegion_ = resolveRegion(filter.region_, filter.filterUnitsUseObjectBoundingBox_, defaults);
+    deviceFilterRegion_ = intersectRects(toDevice(filterRegion_), input.limit_);
+  }
+
+  // Returns NULL if the filter region is empty
+  IFilterViewPtr bind()
+  {
+    if (deviceFilterRegion_.empty())
+      return IFilterViewPtr();
+    views_.reserve(filter_.primitives_.size());
+    regions_.reserve(filter_.primitives_.size());
+    for(std::vector<CompiledPrimitive>::const_iterator primitive = filter_.primitives_.begin();
+      primitive != filter_.primitives_.end(); ++primitive)
+    {
+      primitive_ = &*primitive;
+      regions_.push_back(resolveRegion(primitive->region_, filter_.primitiveUnitsUseObjectBoundingBox_, 
+        defaultSubregion(*primitive)));
+      deviceRegion_ = intersectRects(toDevice(regions_.back()), deviceFilterRegion_);
+      views_.push_back(boost::apply_visitor(*this, primitive->element_));
+    }
+    return views_.back();
+  }
+
+  IFilterViewPtr operator()(feBlend const & fe)
+  {
+    return IFilterViewPtr(new BlendView(fe, deviceRegion_, getInput(0), getInput(1)));
+  }
+
+  IFilterViewPtr operator()(feComponentTransfer const & fe)
+  {
+    return IFilterViewPtr(new ComponentTransferView(fe, deviceRegion_, getInput(0)));
+  }
+
+  IFilterViewPtr operator()(feOffset const & fe)
+  {
+    double dx = fe.dx_, dy = fe.dy_;
+    if (filter_.primitiveUnitsUseObjectBoundingBox_)
+    {
+      dx *= boundingBox_.width_;
+      dy *= boundingBox_.height_;
+    }
+    boost::array<number_t, 6> const & m = input_.transform_;
+    return IFilterViewPtr(new OffsetView(deviceRegion_, getInput(0), 
+      int(std::floor(m[0] * dx + m[2] * dy + 0.5)), int(std::floor(m[1] * dx + m[3] * dy + 0.5))));
+  }
+
+  IFilterViewPtr operator()(feComposite const & fe)
+  {
+    return IFilterViewPtr(new CompositeView(fe, deviceRegion_, getInput(0), getInput(1)));
+  }
+
+  IFilterViewPtr operator()(feMerge const &)
+  {
+    boost::shared_ptr<MergeView> feView(new MergeView(deviceRegion_));
+    for(std::size_t i = 0; i < primitive_->inputs_.size(); ++i)
+      feView->addNode(getInput(i));
+    return feView;
+  }
+
+  IFilterViewPtr operator()(feFlood const & fe)
+  {
+    return IFilterViewPtr(new FloodView(fe, deviceRegion_));
+  }
+
+  IFilterViewPtr operator()(feColorMatrix const & fe)
+  {
+    return IFilterViewPtr(new ColorMatrixView(fe, deviceRegion_, getInput(0)));
+  }
+
+  IFilterViewPtr operator()(feGaussianBlur const & fe)
+  {
+    double stdDeviationX = fe.stdDeviationX_, stdDeviationY = fe.stdDeviationY_;
+    if (filter_.primitiveUnitsUseObjectBoundingBox_)
+    {
+      stdDeviationX *= boundingBox_.width_;
+      stdDeviationY *= boundingBox_.height_;
+    }
+    // Deviations are scaled along the axes of user space, rotation and skew are ignored.
+    // Blur wider than the filter region only makes the result fainter, deviations are limited to
+    // the region size to keep blur reach and buffers bounded
+    boost::array<number_t, 6> const & m = input_.transform_;
+    return IFilterViewPtr(new GaussianBlurView(deviceRegion_, getInput(0), 
+      std::min(stdDeviationX * std::sqrt(m[0] * m[0] + m[1] * m[1]), double(deviceFilterRegion_.width_)), 
+      std::min(stdDeviationY * std::sqrt(m[2] * m[2] + m[3] * m[3]), double(deviceFilterRegion_.height_))));
+  }
+
+  IFilterViewPtr operator()(feMorphology const & fe)
+  {
+    // Negative radius disables the effect
+    if (fe.radiusX_ < 0 || fe.radiusY_ < 0)
+      return getInput(0);
+    double radiusX = fe.radiusX_, radiusY = fe.radiusY_;
+    if (filter_.primitiveUnitsUseObjectBoundingBox_)
+    {
+      radiusX *= boundingBox_.width_;
+      radiusY *= boundingBox_.height_;
+    }
+    // Windows larger than the filter region give the same result
+    boost::array<number_t, 6> const & m = input_.transform_;
+    radiusX = std::min(radiusX * std::sqrt(m[0] * m[0] + m[1] * m[1]), double(deviceFilterRegion_.width_));
+    radiusY = std::min(radiusY * std::sqrt(m[2] * m[2] + m[3] * m[3]), double(deviceFilterRegion_.height_));
+    return IFilterViewPtr(new MorphologyView(deviceRegion_, getInput(0), 
+      int(std::floor(radiusX + 0.5)), int(std::floor(radiusY + 0.5)), fe.operator_ == feMorphology::opDilate));
+  }
+
+  // Kernel elements are applied to device pixels, 'kernelUnitLength' isn't supported
+  IFilterViewPtr operator()(feConvolveMatrix const & fe)
+  {
+    // Invalid attributes make the primitive pass the input through
+    if (!(fe.orderX_ >= 1 && fe.orderY_ >= 1) 
+      || fe.orderX_ * fe.orderY_ != double(fe.kernelMatrix_.size()))
+      return getInput(0);
+    ConvolveMatrix matrix;
+    matrix.orderX_ = int(fe.orderX_);
+    matrix.orderY_ = int(fe.orderY_);
+    matrix.targetX_ = fe.targetX_ ? *fe.targetX_ : matrix.orderX_ / 2;
+    matrix.targetY_ = fe.targetY_ ? *fe.targetY_ : matrix.orderY_ / 2;
+    if (matrix.orderX_ != fe.orderX_ || matrix.orderY_ != fe.orderY_ 
+      || matrix.targetX_ < 0 || matrix.targetX_ >= matrix.orderX_ 
+      || matrix.targetY_ < 0 || matrix.targetY_ >= matrix.orderY_)
+      return getInput(0);
+    matrix.kernel_ = fe.kernelMatrix_;
+    if (fe.divisor_ && *fe.divisor_ != 0)
+      matrix.divisor_ = *fe.divisor_;
+    else
+    {
+      double const sum = std::accumulate(fe.kernelMatrix_.begin(), fe.kernelMatrix_.end(), 0.0);
+      matrix.divisor_ = sum != 0 ? sum : 1;
+    }
+    matrix.bias_ = fe.bias_;
+    matrix.edgeMode_ = fe.edgeMode_;
+    matrix.preserveAlpha_ = fe.preserveAlpha_;
+    return IFilterViewPtr(new ConvolveMatrixView(deviceRegion_, getInput(0), matrix));
   }
 
-  void operator()(feFlood const & fe)
+  IFilterViewPtr operator()(feTurbulence const & fe)
   {
-    boost::shared_ptr<FloodView> feView(new FloodView(fe));
-    if (!fe.result_.empty())
-      namedFilters_[fe.result_] = feView;
-    lastFilter_ = feView;
+    Turbulence params;
+    params.baseFrequencyX_ = fe.baseFrequencyX_;
+    params.baseFrequencyY_ = fe.baseFrequencyY_;
+    if (filter_.primitiveUnitsUseObjectBoundingBox_)
+    {
+      // Frequencies are per bounding box size
+      params.baseFrequencyX_ = boundingBox_.width_ > 0 ? params.baseFrequencyX_ / boundingBox_.width_ : 0;
+      params.baseFrequencyY_ = boundingBox_.height_ > 0 ? params.baseFrequencyY_ / boundingBox_.height_ : 0;
+    }
+    params.numOctaves_ = fe.numOctaves_;
+    // Seed is truncated toward zero
+    params.seed_ = long(std::max(-2147483647.0, std::min(2147483647.0, fe.seed_)));
+    params.fractalNoise_ = fe.fractalNoise_;
+    params.stitchTiles_ = fe.stitchTiles_;
+    UserRect const & tile = regions_.back();
+    params.tileX_ = tile.x_;
+    params.tileY_ = tile.y_;
+    params.tileWidth_ = tile.width_;
+    params.tileHeight_ = tile.height_;
+
+    boost::array<number_t, 6> const & m = input_.transform_;
+    double const det = m[0] * m[3] - m[1] * m[2];
+    if (!(params.baseFrequencyX_ >= 0 && params.baseFrequencyY_ >= 0) || det == 0)
+    {
+      // Turbulence without octaves is transparent black
+      params.numOctaves_ = 0;
+      params.fractalNoise_ = false;
+      std::fill(params.toUser_, params.toUser_ + 6, 0.0);
+    }
+    else
+    {
+      params.toUser_[0] = m[3] / det;
+      params.toUser_[1] = -m[1] / det;
+      params.toUser_[2] = -m[2] / det;
+      params.toUser_[3] = m[0] / det;
+      params.toUser_[4] = (m[2] * m[5] - m[3] * m[4]) / det;
+      params.toUser_[5] = (m[1] * m[4] - m[0] * m[5]) / det;
+    }
+    return IFilterViewPtr(new TurbulenceView(deviceRegion_, params));
   }
 
-  void operator()(feColorMatrix const & fe)
+  IFilterViewPtr operator()(feDiffuseLighting const & fe)
   {
-    boost::shared_ptr<ColorMatrixView> feView(new ColorMatrixView(fe, findInput(fe.input_)));
-    if (!fe.result_.empty())
-      namedFilters_[fe.result_] = feView;
-    lastFilter_ = feView;
+    Lighting params = lightingParameters(fe);
+    params.specular_ = false;
+    params.constant_ = fe.diffuseConstant_;
+    params.specularExponent_ = 1;
+    return IFilterViewPtr(new LightingView(deviceRegion_, getInput(0), params));
   }
 
-  IFilterViewPtr const & lastFilter() { return lastFilter_; }
+  IFilterViewPtr operator()(feSpecularLighting const & fe)
+  {
+    Lighting params = lightingParameters(fe);
+    params.specular_ = true;
+    params.constant_ = fe.specularConstant_;
+    params.specularExponent_ = fe.specularExponent_;
+    return IFilterViewPtr(new LightingView(deviceRegion_, getInput(0), params));
+  }
 
 private:
+  // Light source and surface of lighting element in device space
+  Lighting lightingParameters(feLighting const & fe) const
+  {
+    boost::array<number_t, 6> const & m = input_.transform_;
+    // Heights are scaled by the mean scale of user space
+    double const scale = std::sqrt(std::abs(m[0] * m[3] - m[1] * m[2]));
+    double const degree = boost::math::constants::pi<double>() / 180;
+
+    Lighting params;
+    params.surfaceScale_ = fe.surfaceScale_ * scale;
+    if (fe.lighting_color_)
+      colorComponents(*fe.lighting_color_, params.color_);
+    else
+      std::fill(params.color_, params.color_ + 3, 1.0);
+
+    LightSource light = fe.light_;
+    if (filter_.primitiveUnitsUseObjectBoundingBox_)
+    {
+      // Coordinates are fractions of the bounding box, 'z' is relative to its normalized diagonal
+      double const diagonal = std::sqrt((boundingBox_.width_ * boundingBox_.width_ 
+        + boundingBox_.height_ * boundingBox_.height_) / 2);
+      light.x_ = boundingBox_.x_ + light.x_ * boundingBox_.width_;
+      light.y_ = boundingBox_.y_ + light.y_ * boundingBox_.height_;
+      light.z_ *= diagonal;
+      light.pointsAtX_ = boundingBox_.x_ + light.pointsAtX_ * boundingBox_.width_;
+      light.pointsAtY_ = boundingBox_.y_ + light.pointsAtY_ * boundingBox_.height_;
+      light.pointsAtZ_ *= diagonal;
+    }
+
+    params.position_[0] = m[0] * light.x_ + m[2] * light.y_ + m[4];
+    params.position_[1] = m[1] * light.x_ + m[3] * light.y_ + m[5];
+    params.position_[2] = light.z_ * scale;
+    params.pointsAt_[0] = m[0] * light.pointsAtX_ + m[2] * light.pointsAtY_ + m[4];
+    params.pointsAt_[1] = m[1] * light.pointsAtX_ + m[3] * light.pointsAtY_ + m[5];
+    params.pointsAt_[2] = light.pointsAtZ_ * scale;
+    params.spotExponent_ = light.specularExponent_;
+    params.cosConeAngle_ = light.limitingConeAngle_ 
+      ? std::cos(std::abs(*light.limitingConeAngle_) * degree) : -1;
+
+    double const azimuth = light.azimuth_ * degree, elevation = light.elevation_ * degree;
+    double const userX = std::cos(azimuth) * std::cos(elevation), userY = std::sin(azimuth) * std::cos(elevation);
+    params.direction_[0] = scale > 0 ? (m[0] * userX + m[2] * userY) / scale : userX;
+    params.direction_[1] = scale > 0 ? (m[1] * userX + m[3] * userY) / scale : userY;
+    params.direction_[2] = std::sin(elevation);
+    double const length = std::sqrt(params.direction_[0] * params.direction_[0] 
+      + params.direction_[1] * params.direction_[1] + params.direction_[2] * params.direction_[2]);
+    for(int i = 0; i < 3; ++i)
+      params.direction_[i] /= length;
+
+    switch(light.type_)
+    {
+    case LightSource::lsDistant:
+      params.light_ = Lighting::lightDistant;
+      break;
+    case LightSource::lsPoint:
+      params.light_ = Lighting::lightPoint;
+      break;
+    case LightSource::lsSpot:
+      params.light_ = Lighting::lightSpot;
+      break;
+    default:
+      // Element without light source is transparent black
+      params.light_ = Lighting::lightNone;
+      break;
+    }
+    return params;
+  }
+
+  CompiledFilter const & filter_;
   Filters::Input const & input_;
-  typedef std::map<svg_string_t, IFilterViewPtr> NamedFilters;
-  NamedFilters namedFilters_;
-  IFilterViewPtr lastFilter_;
-  mutable IFilterViewPtr sourceAlphaView_, backgroundAlphaView_;
+  length_factory_t const & lengthFactory_;
+  length_factory_t fractionLengthFactory_;
+  UserRect boundingBox_, filterRegion_;
+  PixelRect deviceFilterRegion_;
+  CompiledPrimitive const * primitive_;
+  PixelRect deviceRegion_; // Subregion of 'primitive_'
+  std::vector<IFilterViewPtr> views_;
+  std::vector<UserRect> regions_; // Subregions of primitives in 'views_'
+  IFilterViewPtr sourceAlphaView_, backgroundAlphaView_;
+
+  void setBoundingBox()
+  {
+    if (input_.boundingBox_)
+    {
+      boost::array<number_t, 4> const & box = *input_.boundingBox_;
+      UserRect const bbox = { box[0], box[1], box[2], box[3] };
+      boundingBox_ = bbox;
+      return;
+    }
+    // Renderer doesn't know geometry of the element, bounding box of the drawn pixels in user space is used
+    boost::array<number_t, 6> const & m = input_.transform_;
+    double const det = m[0] * m[3] - m[1] * m[2];
+    UserRect const empty = { 0, 0, 0, 0 };
+    boundingBox_ = empty;
+    if (input_.drawn_.empty() || det == 0)
+      return;
+    double min_x = std::numeric_limits<double>::max(), min_y = min_x;
+    double max_x = -min_x, max_y = -min_x;
+    for(int corner = 0; corner < 4; ++corner)
+    {
+      double const dx = input_.drawn_.x_ + (corner & 1 ? input_.drawn_.width_ : 0) - m[4];
+      double const dy = input_.drawn_.y_ + (corner & 2 ? input_.drawn_.height_ : 0) - m[5];
+      double const x = (m[3] * dx - m[2] * dy) / det, y = (m[0] * dy - m[1] * dx) / det;
+      min_x = std::min(min_x, x); max_x = std::max(max_x, x);
+      min_y = std::min(min_y, y); max_y = std::max(max_y, y);
+    }
+    UserRect const bbox = { min_x, min_y, max_x - min_x, max_y - min_y };
+    boundingBox_ = bbox;
+  }
 
-  IFilterViewPtr findInput(FilterInput const & in) const
+  UserRect fromBoundingBox(UserRect const & fractions) const
   {
-    switch (in.source_)
+    UserRect const rect = { 
+      boundingBox_.x_ + fractions.x_ * boundingBox_.width_, 
+      boundingBox_.y_ + fractions.y_ * boundingBox_.height_, 
+      fractions.width_ * boundingBox_.width_, 
+      fractions.height_ * boundingBox_.height_ };
+    return rect;
+  }
+
+  template<class Dimension>
+  class RegionLengthVisitor: public boost::static_visitor<double>
+  {
+  public:
+    RegionLengthVisitor(length_factory_t const & length_factory, double value)
+      : lengthFactory_(length_factory)
+      , value_(value)
+    {}
+
+    template<class Units>
+    double operator()(Units units) const
+    { return lengthFactory_.create_length(value_, units); }
+
+    double operator()(svgpp::tag::length_units::percent units) const
+    { return lengthFactory_.create_length(value_, units, Dimension()); }
+
+  private:
+    length_factory_t const & lengthFactory_;
+    double const value_;
+  };
+
+  // In user units, or in fractions of the bounding box if 'units_bbox' is set
+  template<class Dimension>
+  double resolveLength(RegionLength const & length, bool units_bbox) const
+  {
+    return boost::apply_visitor(RegionLengthVisitor<Dimension>(
+      units_bbox ? fractionLengthFactory_ : lengthFactory_, length.value_), length.units_);
+  }
+
+  // Attributes that are set replace corresponding values of 'defaults'
+  UserRect resolveRegion(ElementWithRegion const & region, bool units_bbox, UserRect const & defaults) const
+  {
+    using svgpp::tag::length_dimension::width;
+    using svgpp::tag::length_dimension::height;
+    UserRect rect = defaults;
+    if (units_bbox)
     {
-    case FilterInput::fiReference:
+      if (region.x_) rect.x_ = boundingBox_.x_ + resolveLength<width>(*region.x_, true) * boundingBox_.width_;
+      if (region.y_) rect.y_ = boundingBox_.y_ + resolveLength<height>(*region.y_, true) * boundingBox_.height_;
+      if (region.width_) rect.width_ = resolveLength<width>(*region.width_, true) * boundingBox_.width_;
+      if (region.height_) rect.height_ = resolveLength<height>(*region.height_, true) * boundingBox_.height_;
+    }
+    else
     {
-      NamedFilters::const_iterator f = namedFilters_.find(in.reference_);
-      if (f == namedFilters_.end())
-        throw std::runtime_error("Can't find filter element");
-      return f->second;
+      if (region.x_) rect.x_ = resolveLength<width>(*region.x_, false);
+      if (region.y_) rect.y_ = resolveLength<height>(*region.y_, false);
+      if (region.width_) rect.width_ = resolveLength<width>(*region.width_, false);
+      if (region.height_) rect.height_ = resolveLength<height>(*region.height_, false);
     }
-    case FilterInput::fiNotSet:
-      if (lastFilter_)
-        return lastFilter_;
-      else
-        return input_.sourceGraphic_;
+    return rect;
+  }
+
+  // Union of subregions of referenced primitives. Filter region if there are no inputs 
+  // or if standard input is used
+  UserRect defaultSubregion(CompiledPrimitive const & primitive) const
+  {
+    if (primitive.inputs_.empty())
+      return filterRegion_;
+    double x1 = std::numeric_limits<double>::max(), y1 = x1, x2 = -x1, y2 = -x1;
+    for(std::vector<CompiledInput>::const_iterator in = primitive.inputs_.begin(); in != primitive.inputs_.end(); ++in)
+    {
+      if (in->source_ != FilterInput::fiReference)
+        return filterRegion_;
+      UserRect const & region = regions_[in->primitive_];
+      x1 = std::min(x1, region.x_);
+      y1 = std::min(y1, region.y_);
+      x2 = std::max(x2, region.x_ + region.width_);
+      y2 = std::max(y2, region.y_ + region.height_);
+    }
+    UserRect const rect = { x1, y1, x2 - x1, y2 - y1 };
+    return rect;
+  }
+
+  // Pixels touched by the transformed rectangle
+  PixelRect toDevice(UserRect const & rect) const
+  {
+    if (!(rect.width_ > 0 && rect.height_ > 0))
+      return PixelRect();
+    boost::array<number_t, 6> const & m = input_.transform_;
+    double min_x = std::numeric_limits<double>::max(), min_y = min_x;
+    double max_x = -min_x, max_y = -min_x;
+    for(int corner = 0; corner < 4; ++corner)
+    {
+      double const x = rect.x_ + (corner & 1 ? rect.width_ : 0);
+      double const y = rect.y_ + (corner & 2 ? rect.height_ : 0);
+      double const dx = m[0] * x + m[2] * y + m[4], dy = m[1] * x + m[3] * y + m[5];
+      min_x = std::min(min_x, dx); max_x = std::max(max_x, dx);
+      min_y = std::min(min_y, dy); max_y = std::max(max_y, dy);
+    }
+    // Clamped to stay in range of int
+    double const bound = 1e9;
+    int const x1 = int(std::floor(std::max(-bound, min_x))), y1 = int(std::floor(std::max(-bound, min_y)));
+    int const x2 = int(std::ceil(std::min(bound, max_x))), y2 = int(std::ceil(std::min(bound, max_y)));
+    return PixelRect(x1, y1, x2 - x1, y2 - y1);
+  }
+
+  IFilterViewPtr getInput(std::size_t index)
+  {
+    CompiledInput const & in = primitive_->inputs_[index];
+    switch (in.source_)
+    {
+    case FilterInput::fiReference:
+      return views_[in.primitive_];
     case FilterInput::fiSourceGraphic:
       return input_.sourceGraphic_;
     case FilterInput::fiSourceAlpha:
@@ -1120,11 +2420,11 @@ private:
 
 namespace
 {
-  length_factory_t length_factory_instance;
+  region_length_factory const length_factory_instance = region_length_factory();
 
   struct length_policy_t
   {
-    typedef length_factory_t const length_factory_type;
+    typedef region_length_factory const length_factory_type;
 
     static length_factory_type & length_factory(ElementWithRegionContext const &)
     {
@@ -1133,98 +2433,187 @@ namespace
   };
 }
 
-IFilterViewPtr Filters::get(svg_string_t const & id, length_factory_t const &, Input const & input)
+boost::shared_ptr<CompiledFilter const> Filters::compile(svg_string_t const & id) const
 {
-  try
+  XMLElement node = xml_document_.findElementById(id);
+  if (!node)
+    throw std::runtime_error("Filter not found");
+
+  FilterContext filterContext;
+  svgpp::document_traversal<
+    svgpp::context_factories<context_factories>,
+    svgpp::color_factory<color_factory_t>,
+    svgpp::length_policy<length_policy_t>,
+    svgpp::processed_elements<
+      boost::mpl::set<
+        svgpp::tag::element::filter,
+        svgpp::tag::element::feBlend,
+        svgpp::tag::element::feMerge,
+        svgpp::tag::element::feMergeNode,
+        svgpp::tag::element::feDistantLight,
+        svgpp::tag::element::fePointLight,
+        svgpp::tag::element::feSpotLight,
+        svgpp::tag::element::feColorMatrix,
+        svgpp::tag::element::feComponentTransfer,
+        svgpp::tag::element::feComposite,
+        svgpp::tag::element::feConvolveMatrix,
+        svgpp::tag::element::feFlood,
+        svgpp::tag::element::feGaussianBlur,
+        svgpp::tag::element::feMorphology,
+        svgpp::tag::element::feTurbulence,
+        svgpp::tag::element::feDiffuseLighting,
+        svgpp::tag::element::feSpecularLighting,
+        svgpp::tag::element::feFuncA,
+        svgpp::tag::element::feFuncB,
+        svgpp::tag::element::feFuncG,
+        svgpp::tag::element::feFuncR,
+        svgpp::tag::element::feOffset
+      >::type
+    >,
+    svgpp::processed_attributes<
+      boost::mpl::set66<
+        // Filter region and primitive subregions
+        svgpp::tag::attribute::x,
+        svgpp::tag::attribute::y,
+        svgpp::tag::attribute::width,
+        svgpp::tag::attribute::height,
+        boost::mpl::pair<svgpp::tag::element::filter, svgpp::tag::attribute::filterUnits>,
+        boost::mpl::pair<svgpp::tag::element::filter, svgpp::tag::attribute::primitiveUnits>,
+        boost::mpl::pair<svgpp::tag::element::filter, svgpp::tag::attribute::color>,
+
+        svgpp::tag::attribute::result,
+        svgpp::tag::attribute::in,
+        svgpp::tag::attribute::in2,
+        boost::mpl::pair<svgpp::tag::element::feBlend, svgpp::tag::attribute::mode>,
+        boost::mpl::pair<svgpp::tag::element::feColorMatrix, svgpp::tag::attribute::type>,
+        boost::mpl::pair<svgpp::tag::element::feColorMatrix, svgpp::tag::attribute::values>,
+        boost::mpl::pair<svgpp::tag::element::feOffset, svgpp::tag::attribute::dx>,
+        boost::mpl::pair<svgpp::tag::element::feOffset, svgpp::tag::attribute::dy>,
+        boost::mpl::pair<svgpp::tag::element::feComposite, svgpp::tag::attribute::operator_>,
+        boost::mpl::pair<svgpp::tag::element::feComposite, svgpp::tag::attribute::k1>,
+        boost::mpl::pair<svgpp::tag::element::feComposite, svgpp::tag::attribute::k2>,
+        boost::mpl::pair<svgpp::tag::element::feComposite, svgpp::tag::attribute::k3>,
+        boost::mpl::pair<svgpp::tag::element::feComposite, svgpp::tag::attribute::k4>,
+        boost::mpl::pair<svgpp::tag::element::feFlood, svgpp::tag::attribute::flood_color>,
+        boost::mpl::pair<svgpp::tag::element::feFlood, svgpp::tag::attribute::flood_opacity>,
+        boost::mpl::pair<svgpp::tag::element::feFlood, svgpp::tag::attribute::color>,
+        boost::mpl::pair<svgpp::tag::element::feGaussianBlur, svgpp::tag::attribute::stdDeviation>,
+        boost::mpl::pair<svgpp::tag::element::feMorphology, svgpp::tag::attribute::operator_>,
+        boost::mpl::pair<svgpp::tag::element::feMorphology, svgpp::tag::attribute::radius>,
+        boost::mpl::pair<svgpp::tag::element::feConvolveMatrix, svgpp::tag::attribute::order>,
+        boost::mpl::pair<svgpp::tag::element::feConvolveMatrix, svgpp::tag::attribute::kernelMatrix>,
+        boost::mpl::pair<svgpp::tag::element::feConvolveMatrix, svgpp::tag::attribute::divisor>,
+        boost::mpl::pair<svgpp::tag::element::feConvolveMatrix, svgpp::tag::attribute::bias>,
+        boost::mpl::pair<svgpp::tag::element::feConvolveMatrix, svgpp::tag::attribute::targetX>,
+        boost::mpl::pair<svgpp::tag::element::feConvolveMatrix, svgpp::tag::attribute::targetY>,
+        boost::mpl::pair<svgpp::tag::element::feConvolveMatrix, svgpp::tag::attribute::edgeMode>,
+        boost::mpl::pair<svgpp::tag::element::feConvolveMatrix, svgpp::tag::attribute::preserveAlpha>,
+        boost::mpl::pair<svgpp::tag::element::feTurbulence, svgpp::tag::attribute::baseFrequency>,
+        boost::mpl::pair<svgpp::tag::element::feTurbulence, svgpp::tag::attribute::numOctaves>,
+        boost::mpl::pair<svgpp::tag::element::feTurbulence, svgpp::tag::attribute::seed>,
+        boost::mpl::pair<svgpp::tag::element::feTurbulence, svgpp::tag::attribute::stitchTiles>,
+        boost::mpl::pair<svgpp::tag::element::feTurbulence, svgpp::tag::attribute::type>,
+        boost::mpl::pair<svgpp::tag::element::feDiffuseLighting, svgpp::tag::attribute::surfaceScale>,
+        boost::mpl::pair<svgpp::tag::element::feDiffuseLighting, svgpp::tag::attribute::diffuseConstant>,
+        boost::mpl::pair<svgpp::tag::element::feDiffuseLighting, svgpp::tag::attribute::lighting_color>,
+        boost::mpl::pair<svgpp::tag::element::feDiffuseLighting, svgpp::tag::attribute::color>,
+        boost::mpl::pair<svgpp::tag::element::feSpecularLighting, svgpp::tag::attribute::surfaceScale>,
+        boost::mpl::pair<svgpp::tag::element::feSpecularLighting, svgpp::tag::attribute::specularConstant>,
+        boost::mpl::pair<svgpp::tag::element::feSpecularLighting, svgpp::tag::attribute::specularExponent>,
+        boost::mpl::pair<svgpp::tag::element::feSpecularLighting, svgpp::tag::attribute::lighting_color>,
+        boost::mpl::pair<svgpp::tag::element::feSpecularLighting, svgpp::tag::attribute::color>,
+
+        // light source element attributes, 'x' and 'y' are above
+        boost::mpl::pair<svgpp::tag::element::feDistantLight, svgpp::tag::attribute::azimuth>,
+        boost::mpl::pair<svgpp::tag::element::feDistantLight, svgpp::tag::attribute::elevation>,
+        svgpp::tag::attribute::z,
+        svgpp::tag::attribute::pointsAtX,
+        svgpp::tag::attribute::pointsAtY,
+        svgpp::tag::attribute::pointsAtZ,
+        boost::mpl::pair<svgpp::tag::element::feSpotLight, svgpp::tag::attribute::specularExponent>,
+        svgpp::tag::attribute::limitingConeAngle,
+
+        // transfer function element attributes
+        boost::mpl::pair<svgpp::tag::element::feFuncA, svgpp::tag::attribute::type>,
+        boost::mpl::pair<svgpp::tag::element::feFuncR, svgpp::tag::attribute::type>,
+        boost::mpl::pair<svgpp::tag::element::feFuncG, svgpp::tag::attribute::type>,
+        boost::mpl::pair<svgpp::tag::element::feFuncB, svgpp::tag::attribute::type>,
+        svgpp::tag::attribute::tableValues,
+        svgpp::tag::attribute::slope, 
+        svgpp::tag::attribute::intercept, 
+        svgpp::tag::attribute::amplitude, 
+        svgpp::tag::attribute::exponent, 
+        svgpp::tag::attribute::offset
+      >::type
+    >
+  >::load_expected_element(node, filterContext, svgpp::tag::element::filter());
+
+  if (filterContext.elements_.empty())
+    throw std::runtime_error("No filter elements in filter definition");
+
+  boost::shared_ptr<CompiledFilter> filter(new CompiledFilter);
+  filter->region_ = filterContext.region_;
+  filter->filterUnitsUseObjectBoundingBox_ = filterContext.filterUnitsUseObjectBoundingBox_;
+  filter->primitiveUnitsUseObjectBoundingBox_ = filterContext.primitiveUnitsUseObjectBoundingBox_;
+  filter->primitives_.reserve(filterContext.elements_.size());
+  typedef std::map<svg_string_t, std::size_t> results_t;
+  results_t results;
+  for(std::vector<FilterElement>::const_iterator fe = filterContext.elements_.begin();
+    fe != filterContext.elements_.end(); ++fe)
   {
-    if (XMLElement node = xml_document_.findElementById(id))
+    std::vector<FilterInput const *> inputs;
+    FilterElementBase const * base = boost::apply_visitor(PrimitiveInputsVisitor(inputs), *fe);
+    CompiledPrimitive primitive;
+    primitive.element_ = *fe;
+    primitive.region_ = *base;
+    for(std::vector<FilterInput const *>::const_iterator in = inputs.begin(); in != inputs.end(); ++in)
     {
-      FilterContext filterContext;
-      svgpp::document_traversal<
-        svgpp::context_factories<context_factories>,
-        svgpp::color_factory<color_factory_t>,
-        svgpp::length_policy<length_policy_t>,
-        svgpp::processed_elements<
-          boost::mpl::set<
-            svgpp::tag::element::filter,
-            svgpp::tag::element::feBlend,
-            svgpp::tag::element::feMerge,
-            svgpp::tag::element::feMergeNode,
-            svgpp::tag::element::feDistantLight,
-            svgpp::tag::element::fePointLight,
-            svgpp::tag::element::feSpotLight,
-            svgpp::tag::element::feColorMatrix,
-            svgpp::tag::element::feComponentTransfer,
-            svgpp::tag::element::feComposite,
-            svgpp::tag::element::feFlood,
-            svgpp::tag::element::feFuncA,
-            svgpp::tag::element::feFuncB,
-            svgpp::tag::element::feFuncG,
-            svgpp::tag::element::feFuncR,
-            svgpp::tag::element::feOffset
-          >::type
-        >,
-        svgpp::processed_attributes<
-          boost::mpl::set<
-            boost::mpl::pair<svgpp::tag::element::filter, svgpp::tag::attribute::x>,
-            boost::mpl::pair<svgpp::tag::element::filter, svgpp::tag::attribute::y>,
-            boost::mpl::pair<svgpp::tag::element::filter, svgpp::tag::attribute::width>,
-            boost::mpl::pair<svgpp::tag::element::filter, svgpp::tag::attribute::height>,
-            boost::mpl::pair<svgpp::tag::element::filter, svgpp::tag::attribute::filterUnits>,
-            //boost::mpl::pair<svgpp::tag::element::filter, svgpp::tag::attribute::primitiveUnits>,
-
-            svgpp::tag::attribute::result,
-            svgpp::tag::attribute::in,
-            svgpp::tag::attribute::in2,
-            boost::mpl::pair<svgpp::tag::element::feBlend, svgpp::tag::attribute::x>,
-            boost::mpl::pair<svgpp::tag::element::feBlend, svgpp::tag::attribute::y>,
-            boost::mpl::pair<svgpp::tag::element::feBlend, svgpp::tag::attribute::width>,
-            boost::mpl::pair<svgpp::tag::element::feBlend, svgpp::tag::attribute::height>,
-            boost::mpl::pair<svgpp::tag::element::feBlend, svgpp::tag::attribute::mode>,
-            boost::mpl::pair<svgpp::tag::element::feColorMatrix, svgpp::tag::attribute::type>,
-            boost::mpl::pair<svgpp::tag::element::feColorMatrix, svgpp::tag::attribute::values>,
-            boost::mpl::pair<svgpp::tag::element::feOffset, svgpp::tag::attribute::dx>,
-            boost::mpl::pair<svgpp::tag::element::feOffset, svgpp::tag::attribute::dy>,
-            boost::mpl::pair<svgpp::tag::element::feComposite, svgpp::tag::attribute::operator_>,
-            boost::mpl::pair<svgpp::tag::element::feComposite, svgpp::tag::attribute::k1>,
-            boost::mpl::pair<svgpp::tag::element::feComposite, svgpp::tag::attribute::k2>,
-            boost::mpl::pair<svgpp::tag::element::feComposite, svgpp::tag::attribute::k3>,
-            boost::mpl::pair<svgpp::tag::element::feComposite, svgpp::tag::attribute::k4>,
-            boost::mpl::pair<svgpp::tag::element::feFlood, svgpp::tag::attribute::flood_color>,
-            boost::mpl::pair<svgpp::tag::element::feFlood, svgpp::tag::attribute::flood_opacity>,
-
-            // transfer function element attributes
-            boost::mpl::pair<svgpp::tag::element::feFuncA, svgpp::tag::attribute::type>,
-            boost::mpl::pair<svgpp::tag::element::feFuncR, svgpp::tag::attribute::type>,
-            boost::mpl::pair<svgpp::tag::element::feFuncG, svgpp::tag::attribute::type>,
-            boost::mpl::pair<svgpp::tag::element::feFuncB, svgpp::tag::attribute::type>,
-            svgpp::tag::attribute::tableValues,
-            svgpp::tag::attribute::slope, 
-            svgpp::tag::attribute::intercept, 
-            svgpp::tag::attribute::amplitude, 
-            svgpp::tag::attribute::exponent, 
-            svgpp::tag::attribute::offset
-          >::type
-        >
-      >::load_expected_element(node, filterContext, svgpp::tag::element::filter());
-
-      FilterElementVisitor v(input);
-      for(std::vector<FilterElement>::const_iterator fe = filterContext.elements_.begin();
-        fe != filterContext.elements_.end(); ++fe)
+      CompiledInput compiled = { (*in)->source_, 0 };
+      if ((*in)->source_ == FilterInput::fiReference)
       {
-        boost::apply_visitor(v, *fe);
+        // Results with the same name are replaced by the later ones
+        results_t::const_iterator result = results.find((*in)->reference_);
+        if (result == results.end())
+          throw std::runtime_error("Can't find filter element");
+        compiled.primitive_ = result->second;
       }
-      if (!v.lastFilter())
-        throw std::runtime_error("No filter elements in filter definition");
-      return v.lastFilter();
+      else if ((*in)->source_ == FilterInput::fiNotSet)
+      {
+        if (filter->primitives_.empty())
+          compiled.source_ = FilterInput::fiSourceGraphic;
+        else
+        {
+          compiled.source_ = FilterInput::fiReference;
+          compiled.primitive_ = filter->primitives_.size() - 1;
+        }
+      }
+      primitive.inputs_.push_back(compiled);
     }
-    else
-      throw std::runtime_error("Filter not found");
+    if (!base->result_.empty())
+      results[base->result_] = filter->primitives_.size();
+    filter->primitives_.push_back(primitive);
   }
-  catch (std::exception const & e)
+  return filter;
+}
+
+IFilterViewPtr Filters::get(svg_string_t const & id, length_factory_t const & length_factory, Input const & input)
+{
+  std::map<svg_string_t, boost::shared_ptr<CompiledFilter const> >::iterator cached = cache_.find(id);
+  if (cached == cache_.end())
   {
-    // Not all filters implemented yet, we will skip such cases
-    std::cerr << e.what() << "\n";
-    return input.sourceGraphic_;
+    boost::shared_ptr<CompiledFilter const> filter;
+    try
+    {
+      filter = compile(id);
+    }
+    catch (std::exception const & e)
+    {
+      // Not all filters implemented yet, we will skip such cases
+      std::cerr << e.what() << "\n";
+    }
+    cached = cache_.insert(std::make_pair(id, filter)).first;
   }
-}
\ No newline at end of file
+  if (!cached->second)
+    return input.sourceGraphic_;
+  return FilterGraphBinder(*cached->second, input, length_factory).bind();
+}
@@ -1,19 +1,42 @@
 #pragma once
 
 #include "common.hpp"
+#include <boost/array.hpp>
 #include <boost/gil/typedefs.hpp>
+#include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
+#include <map>
+
+// Rectangle in device pixels
+struct PixelRect
+{
+  PixelRect()
+    : x_(0), y_(0), width_(0), height_(0)
+  {}
+
+  PixelRect(int x, int y, int width, int height)
+    : x_(x), y_(y), width_(width), height_(height)
+  {}
+
+  bool empty() const { return width_ <= 0 || height_ <= 0; }
+
+  int x_, y_, width_, height_;
+};
 
 class IFilterView
 {
 public:
   virtual ~IFilterView() {}
 
+  // Pixels of view() cover region(), pixels outside of it are transparent black
   virtual boost::gil::rgba8c_view_t view() = 0;
+  virtual PixelRect region() const = 0;
 };
 
 typedef boost::shared_ptr<IFilterView> IFilterViewPtr;
 
+class CompiledFilter;
+
 class Filters
 {
 public:
@@ -27,8 +50,21 @@ public:
     IFilterViewPtr backgroundImage_;
     IFilterViewPtr fillPaint_;
     IFilterViewPtr strokePaint_;
+    // From user space to device pixels, 'a b c d e f' as in 'matrix' transform
+    boost::array<number_t, 6> transform_;
+    // Bounding box of the element geometry in user space: x, y, width, height. 
+    // If not set, 'objectBoundingBox' units use bounding box of 'drawn_' instead
+    boost::optional<boost::array<number_t, 4> > boundingBox_;
+    // Pixels drawn by the element
+    PixelRect drawn_;
+    // Filter results outside of this rectangle aren't calculated
+    PixelRect limit_;
   };
 
+  // Filter element is parsed only on the first use of 'id', next uses only bind inputs
+  // to the compiled primitives. Returned views reference compiled filter owned by this object.
+  // Primitives are calculated only inside of the filter region and their subregions.
+  // Returns NULL if the filter result is empty
   IFilterViewPtr get(
     svg_string_t const & id, 
     length_factory_t const &,
@@ -36,4 +72,8 @@ public:
 
 private:
   XMLDocument & xml_document_;
+  // NULL for filters that failed to compile
+  std::map<svg_string_t, boost::shared_ptr<CompiledFilter const> > cache_;
+
+  boost::shared_ptr<CompiledFilter const> compile(svg_string_t const & id) const;
 };
\ No newline at end of file
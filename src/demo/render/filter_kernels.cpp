@@ -0,0 +1,1073 @@
+#include "filter_kernels.hpp"
+
+#include <svgpp/utility/gil/simd.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/gil/algorithm.hpp>
+#include <boost/math/constants/constants.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+namespace gil = boost::gil;
+
+void parallelBands(int count, std::size_t item_cost, std::function<void(int begin, int end)> const & fn)
+{
+  if (count <= 0)
+    return;
+  // Starting a thread costs about as much as this amount of work
+  std::size_t const min_band_cost = 1 << 16;
+  std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = std::min(threads, std::max<std::size_t>(1, std::size_t(count) * item_cost / min_band_cost));
+  threads = std::min(threads, std::size_t(count));
+  if (threads == 1)
+  {
+    fn(0, count);
+    return;
+  }
+
+  std::vector<std::exception_ptr> errors(threads);
+  auto const runBand = [&](std::size_t band)
+  {
+    try
+    {
+      fn(int(count * band / threads), int(count * (band + 1) / threads));
+    }
+    catch(...)
+    {
+      errors[band] = std::current_exception();
+    }
+  };
+  std::vector<std::thread> workers;
+  workers.reserve(threads - 1);
+  std::size_t band = 1;
+  try
+  {
+    for(; band < threads; ++band)
+      workers.push_back(std::thread(runBand, band));
+  }
+  catch(std::system_error const &)
+  {
+    // Bands that didn't get a thread are processed below
+  }
+  for(std::size_t rest = band; rest < threads; ++rest)
+    runBand(rest);
+  runBand(0);
+  for(std::vector<std::thread>::iterator worker = workers.begin(); worker != workers.end(); ++worker)
+    worker->join();
+  for(std::vector<std::exception_ptr>::const_iterator error = errors.begin(); error != errors.end(); ++error)
+    if (*error)
+      std::rethrow_exception(*error);
+}
+
+namespace
+{
+  typedef boost::uint8_t byte_t;
+
+  // Line operations process all 4 channels of a pixel at once. Lines are padded with
+  // transparent pixels, so that reads before the first and after the last pixel are valid
+
+#if defined(SVGPP_GIL_SIMD)
+  // Channels in 32-bit lanes
+  inline __m128i loadPixel(byte_t const * p)
+  {
+    boost::int32_t packed;
+    std::memcpy(&packed, p, 4);
+    __m128i const zero = _mm_setzero_si128();
+    return _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+  }
+
+  // Channels are clamped to 0..255
+  inline void storePixel(byte_t * p, __m128i channels)
+  {
+    __m128i const packed16 = _mm_packs_epi32(channels, channels);
+    boost::int32_t const packed = _mm_cvtsi128_si32(_mm_packus_epi16(packed16, packed16));
+    std::memcpy(p, &packed, 4);
+  }
+
+  // out[i] = average of in[i - left] .. in[i + right]
+  void boxBlurLine(byte_t const * in, byte_t * out, int size, int left, int right)
+  {
+    __m128 const scale = _mm_set1_ps(1.0f / (left + right + 1));
+    __m128i sum = _mm_setzero_si128();
+    for(int k = -left; k < right; ++k)
+      sum = _mm_add_epi32(sum, loadPixel(in + 4 * k));
+    for(int i = 0; i < size; ++i)
+    {
+      sum = _mm_add_epi32(sum, loadPixel(in + 4 * (i + right)));
+      storePixel(out + 4 * i, _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sum), scale)));
+      sum = _mm_sub_epi32(sum, loadPixel(in + 4 * (i - left)));
+    }
+  }
+
+  // out[i] = sum of in[i + k] * weights[|k|] for |k| <= radius
+  void kernelLine(byte_t const * in, byte_t * out, int size, float const * weights, int radius)
+  {
+    for(int i = 0; i < size; ++i)
+    {
+      byte_t const * center = in + 4 * i;
+      __m128 sum = _mm_mul_ps(_mm_cvtepi32_ps(loadPixel(center)), _mm_set1_ps(weights[0]));
+      for(int k = 1; k <= radius; ++k)
+        sum = _mm_add_ps(sum, _mm_mul_ps(
+          _mm_cvtepi32_ps(_mm_add_epi32(loadPixel(center - 4 * k), loadPixel(center + 4 * k))),
+          _mm_set1_ps(weights[k])));
+      storePixel(out + 4 * i, _mm_cvtps_epi32(sum));
+    }
+  }
+#else
+  // Rounding is the same as in SSE2 version
+  inline byte_t roundChannel(float value)
+  {
+    return byte_t(std::min(255L, std::lrint(value)));
+  }
+
+  void boxBlurLine(byte_t const * in, byte_t * out, int size, int left, int right)
+  {
+    float const scale = 1.0f / (left + right + 1);
+    int sum[4] = { 0, 0, 0, 0 };
+    for(int k = -left; k < right; ++k)
+      for(int ch = 0; ch < 4; ++ch)
+        sum[ch] += in[4 * k + ch];
+    for(int i = 0; i < size; ++i)
+      for(int ch = 0; ch < 4; ++ch)
+      {
+        sum[ch] += in[4 * (i + right) + ch];
+        out[4 * i + ch] = roundChannel(sum[ch] * scale);
+        sum[ch] -= in[4 * (i - left) + ch];
+      }
+  }
+
+  void kernelLine(byte_t const * in, byte_t * out, int size, float const * weights, int radius)
+  {
+    for(int i = 0; i < size; ++i)
+      for(int ch = 0; ch < 4; ++ch)
+      {
+        byte_t const * center = in + 4 * i + ch;
+        float sum = center[0] * weights[0];
+        for(int k = 1; k <= radius; ++k)
+          sum += (center[-4 * k] + center[4 * k]) * weights[k];
+        out[4 * i + ch] = roundChannel(sum);
+      }
+  }
+#endif
+
+#if defined(SVGPP_GIL_SIMD)
+  struct MinOp
+  {
+    __m128i operator()(__m128i a, __m128i b) const { return _mm_min_epu8(a, b); }
+    byte_t operator()(byte_t a, byte_t b) const { return std::min(a, b); }
+  };
+
+  struct MaxOp
+  {
+    __m128i operator()(__m128i a, __m128i b) const { return _mm_max_epu8(a, b); }
+    byte_t operator()(byte_t a, byte_t b) const { return std::max(a, b); }
+  };
+#else
+  struct MinOp
+  {
+    byte_t operator()(byte_t a, byte_t b) const { return std::min(a, b); }
+  };
+
+  struct MaxOp
+  {
+    byte_t operator()(byte_t a, byte_t b) const { return std::max(a, b); }
+  };
+#endif
+
+  // out[i] = op(a[i], b[i]) for each of 'size' bytes
+  template<class Op>
+  inline void combineBytes(byte_t const * a, byte_t const * b, byte_t * out, std::size_t size, Op op)
+  {
+    std::size_t i = 0;
+#if defined(SVGPP_GIL_SIMD)
+    for(; i + 16 <= size; i += 16)
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), op(
+        _mm_loadu_si128(reinterpret_cast<__m128i const *>(a + i)),
+        _mm_loadu_si128(reinterpret_cast<__m128i const *>(b + i))));
+    // Single pixels
+    for(; i + 4 <= size; i += 4)
+    {
+      boost::int32_t pa, pb;
+      std::memcpy(&pa, a + i, 4);
+      std::memcpy(&pb, b + i, 4);
+      boost::int32_t const result = _mm_cvtsi128_si32(op(_mm_cvtsi32_si128(pa), _mm_cvtsi32_si128(pb)));
+      std::memcpy(out + i, &result, 4);
+    }
+#endif
+    for(; i < size; ++i)
+      out[i] = op(a[i], b[i]);
+  }
+
+  // Minimum or maximum over each 'window' consecutive elements by van Herk/Gil-Werman algorithm:
+  // out[i] = op(in[i], ..., in[i + window - 1]) for i in [0, count - window].
+  // Elements are 'size' bytes long, 'in_stride' and 'out_stride' are distances between consecutive elements.
+  // Line is split into blocks of 'window' elements, each window spans suffix of one block and prefix of the next
+  template<class Op>
+  void runningExtremum(byte_t const * in, std::ptrdiff_t in_stride, int count, int window,
+    byte_t * out, std::ptrdiff_t out_stride, std::size_t size, 
+    std::vector<byte_t> & prefix, std::vector<byte_t> & suffix, Op op)
+  {
+    prefix.resize(count * size);
+    suffix.resize(count * size);
+    for(int block = 0; block < count; block += window)
+    {
+      int const end = std::min(count, block + window);
+      std::memcpy(&prefix[block * size], in + block * in_stride, size);
+      for(int i = block + 1; i < end; ++i)
+        combineBytes(&prefix[(i - 1) * size], in + i * in_stride, &prefix[i * size], size, op);
+      std::memcpy(&suffix[(end - 1) * size], in + (end - 1) * in_stride, size);
+      for(int i = end - 2; i >= block; --i)
+        combineBytes(&suffix[(i + 1) * size], in + i * in_stride, &suffix[i * size], size, op);
+    }
+    for(int i = 0; i + window <= count; ++i)
+      combineBytes(&suffix[i * size], &prefix[(i + window - 1) * size], out + i * out_stride, size, op);
+  }
+
+  template<class Op>
+  void morphologyImpl(gil::rgba8c_view_t const & src, int x, int y,
+    gil::rgba8_view_t const & dst, int radiusX, int radiusY, Op op)
+  {
+    int const width = int(dst.width()), height = int(dst.height());
+    int const src_width = int(src.width()), src_height = int(src.height());
+    if (width == 0 || height == 0)
+      return;
+    // Larger windows don't change the result: erosion window still sticks out of 'src' and dilation
+    // window covers all of it
+    radiusX = std::max(0, std::min(radiusX, src_width + width + std::abs(x)));
+    radiusY = std::max(0, std::min(radiusY, src_height + height + std::abs(y)));
+    int const rows = height + 2 * radiusY, columns = width + 2 * radiusX;
+
+    // Horizontal pass result for rows [y - radiusY, y + height + radiusY) of 'src'
+    std::size_t const row_bytes = std::size_t(width) * 4;
+    std::vector<byte_t> horizontal(rows * row_bytes);
+    parallelBands(rows, columns, [&](int begin, int end)
+    {
+      std::vector<byte_t> line(std::size_t(columns) * 4), prefix, suffix;
+      for(int row = begin; row < end; ++row)
+      {
+        byte_t * const result = &horizontal[row * row_bytes];
+        int const src_y = y - radiusY + row;
+        if (src_y < 0 || src_y >= src_height)
+        {
+          std::memset(result, 0, row_bytes);
+          continue;
+        }
+        // Pixels [x - radiusX, x + width + radiusX) of the row
+        std::fill(line.begin(), line.end(), 0);
+        int const copy_begin = std::max(0, x - radiusX), copy_end = std::min(src_width, x + width + radiusX);
+        if (copy_begin < copy_end)
+          std::memcpy(&line[4 * (copy_begin - x + radiusX)], 
+            reinterpret_cast<byte_t const *>(src.row_begin(src_y) + copy_begin), 4 * (copy_end - copy_begin));
+        runningExtremum(&line[0], 4, columns, 2 * radiusX + 1, result, 4, 4, prefix, suffix, op);
+      }
+    });
+
+    // Vertical pass processes bands of columns, whole rows of the band at once
+    byte_t * const dst_origin = reinterpret_cast<byte_t *>(dst.row_begin(0));
+    std::ptrdiff_t const dst_row_bytes = dst.pixels().row_size();
+    parallelBands(width, rows, [&](int begin, int end)
+    {
+      std::vector<byte_t> prefix, suffix;
+      runningExtremum(&horizontal[4 * begin], row_bytes, rows, 2 * radiusY + 1,
+        dst_origin + 4 * begin, dst_row_bytes, 4 * (end - begin), prefix, suffix, op);
+    });
+  }
+
+  // One dimensional gaussian blur
+  class LineBlur
+  {
+  public:
+    explicit LineBlur(double stdDeviation)
+      : reach_(0)
+    {
+      // Keeps box sizes and pixel positions within int range
+      stdDeviation = std::min(stdDeviation, max_blur_deviation);
+      if (!(stdDeviation > 0))
+        method_ = mCopy;
+      else if (stdDeviation < 2.0)
+      {
+        method_ = mKernel;
+        reach_ = int(std::ceil(3 * stdDeviation));
+        weights_.resize(reach_ + 1);
+        double total = 0;
+        for(int k = 0; k <= reach_; ++k)
+        {
+          weights_[k] = float(std::exp(-k * k / (2 * stdDeviation * stdDeviation)));
+          total += k == 0 ? weights_[k] : 2 * weights_[k];
+        }
+        for(int k = 0; k <= reach_; ++k)
+          weights_[k] = float(weights_[k] / total);
+      }
+      else
+      {
+        method_ = mBoxes;
+        // Box size from SVG specification, description of feGaussianBlur
+        int const d = int(std::floor(stdDeviation * 3 * std::sqrt(2 * boost::math::constants::pi<double>()) / 4 + 0.5));
+        if (d % 2)
+          for(int i = 0; i < 3; ++i)
+            boxes_[i][0] = boxes_[i][1] = d / 2;
+        else
+        {
+          // Two boxes of size d centered on pixel boundaries on the left and on the right,
+          // then box of size d + 1 centered on the pixel
+          boxes_[0][0] = d / 2;     boxes_[0][1] = d / 2 - 1;
+          boxes_[1][0] = d / 2 - 1; boxes_[1][1] = d / 2;
+          boxes_[2][0] = d / 2;     boxes_[2][1] = d / 2;
+        }
+        reach_ = boxes_[0][0] + boxes_[1][0] + boxes_[2][0];
+      }
+    }
+
+    int reach() const { return reach_; }
+
+    // 'in' contains 'in_size' pixels at positions [in_begin, in_begin + in_size), pixels at other positions
+    // are transparent. Blurred pixels at positions [out_begin, out_begin + out_size) are written to 'out',
+    // 'out_step' bytes apart
+    void apply(byte_t const * in, int in_begin, int in_size,
+      int out_begin, int out_size, byte_t * out, std::ptrdiff_t out_step,
+      std::vector<byte_t> & buffer1, std::vector<byte_t> & buffer2) const
+    {
+      // Only these output pixels may be non-transparent
+      int const begin = std::max(out_begin, in_begin - reach_);
+      int const end = std::min(out_begin + out_size, in_begin + in_size + reach_);
+      byte_t const transparent[4] = { 0, 0, 0, 0 };
+      for(int pos = out_begin; pos < out_begin + out_size; ++pos)
+        if (pos < begin || pos >= end)
+          std::memcpy(out + (pos - out_begin) * out_step, transparent, 4);
+      if (begin >= end)
+        return;
+
+      // Each buffer has 'reach_' transparent pixels on both sides of 'size' pixels at 'first' position
+      int const first = begin - reach_, size = end - begin + 2 * reach_;
+      std::size_t const padded_bytes = std::size_t(size + 2 * reach_) * 4;
+      buffer1.assign(padded_bytes, 0);
+      byte_t * const line1 = &buffer1[4 * reach_];
+      int const copy_begin = std::max(first, in_begin), copy_end = std::min(first + size, in_begin + in_size);
+      if (copy_begin < copy_end)
+        std::memcpy(line1 + 4 * (copy_begin - first), in + 4 * (copy_begin - in_begin), 4 * (copy_end - copy_begin));
+
+      byte_t const * result = line1;
+      switch(method_)
+      {
+      case mCopy:
+        break;
+      case mKernel:
+      {
+        buffer2.assign(padded_bytes, 0);
+        byte_t * const line2 = &buffer2[4 * reach_];
+        kernelLine(line1, line2, size, &weights_[0], reach_);
+        result = line2;
+        break;
+      }
+      case mBoxes:
+      {
+        buffer2.assign(padded_bytes, 0);
+        byte_t * const line2 = &buffer2[4 * reach_];
+        boxBlurLine(line1, line2, size, boxes_[0][0], boxes_[0][1]);
+        boxBlurLine(line2, line1, size, boxes_[1][0], boxes_[1][1]);
+        boxBlurLine(line1, line2, size, boxes_[2][0], boxes_[2][1]);
+        result = line2;
+        break;
+      }
+      }
+
+      for(int pos = begin; pos < end; ++pos)
+        std::memcpy(out + (pos - out_begin) * out_step, result + 4 * (pos - first), 4);
+    }
+
+  private:
+    enum Method { mCopy, mKernel, mBoxes };
+
+    Method method_;
+    int reach_;
+    int boxes_[3][2]; // Pixels on the left and on the right covered by each box
+    std::vector<float> weights_;
+  };
+}
+
+int gaussianBlurReach(double stdDeviation)
+{
+  return LineBlur(stdDeviation).reach();
+}
+
+void gaussianBlur(gil::rgba8c_view_t const & src, int x, int y,
+  gil::rgba8_view_t const & dst, double stdDeviationX, double stdDeviationY)
+{
+  LineBlur const blurX(stdDeviationX), blurY(stdDeviationY);
+  int const width = int(dst.width()), height = int(dst.height());
+  // Source rows that affect the result
+  int const y0 = std::max(0, y - blurY.reach()), y1 = std::min(int(src.height()), y + height + blurY.reach());
+  if (width == 0 || height == 0)
+    return;
+  if (y0 >= y1)
+  {
+    gil::fill_pixels(dst, gil::rgba8_pixel_t(0, 0, 0, 0));
+    return;
+  }
+  int const rows = y1 - y0;
+
+  // Result of the horizontal pass is stored transposed, so that vertical pass also reads
+  // contiguous lines: line 'i' contains column 'x + i' of the source rows [y0, y1)
+  std::vector<byte_t> transposed(std::size_t(width) * rows * 4);
+  std::ptrdiff_t const transposed_line = std::ptrdiff_t(rows) * 4;
+  parallelBands(rows, width + 2 * blurX.reach(), [&](int begin, int end)
+  {
+    std::vector<byte_t> buffer1, buffer2;
+    for(int row = begin; row < end; ++row)
+      blurX.apply(reinterpret_cast<byte_t const *>(src.row_begin(y0 + row)), 0, int(src.width()),
+        x, width, &transposed[4 * row], transposed_line, buffer1, buffer2);
+  });
+
+  byte_t * const dst_origin = reinterpret_cast<byte_t *>(dst.row_begin(0));
+  std::ptrdiff_t const dst_row_bytes = dst.pixels().row_size();
+  parallelBands(width, rows + 2 * blurY.reach(), [&](int begin, int end)
+  {
+    std::vector<byte_t> buffer1, buffer2;
+    for(int column = begin; column < end; ++column)
+      blurY.apply(&transposed[column * transposed_line], y0, rows,
+        y, height, dst_origin + 4 * column, dst_row_bytes, buffer1, buffer2);
+  });
+}
+
+void morphology(gil::rgba8c_view_t const & src, int x, int y,
+  gil::rgba8_view_t const & dst, int radiusX, int radiusY, bool dilate)
+{
+  if (dilate)
+    morphologyImpl(src, x, y, dst, radiusX, radiusY, MaxOp());
+  else
+    morphologyImpl(src, x, y, dst, radiusX, radiusY, MinOp());
+}
+
+namespace
+{
+#if defined(SVGPP_GIL_SIMD)
+  // Four channels of a pixel
+  typedef __m128 vec4_t;
+
+  inline vec4_t zero4() { return _mm_setzero_ps(); }
+  inline vec4_t load4(float const * p) { return _mm_loadu_ps(p); }
+  inline void store4(float * p, vec4_t v) { _mm_storeu_ps(p, v); }
+  inline vec4_t multiplyAdd4(vec4_t sum, vec4_t v, float weight) { return _mm_add_ps(sum, _mm_mul_ps(v, _mm_set1_ps(weight))); }
+  inline vec4_t sub4(vec4_t a, vec4_t b) { return _mm_sub_ps(a, b); }
+  inline vec4_t abs4(vec4_t v) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), v); }
+#else
+  struct vec4_t { float v_[4]; };
+
+  inline vec4_t zero4() { vec4_t const v = {{ 0, 0, 0, 0 }}; return v; }
+  inline vec4_t load4(float const * p) { vec4_t v; std::copy(p, p + 4, v.v_); return v; }
+  inline void store4(float * p, vec4_t v) { std::copy(v.v_, v.v_ + 4, p); }
+  inline vec4_t multiplyAdd4(vec4_t sum, vec4_t v, float weight) 
+  { 
+    for(int ch = 0; ch < 4; ++ch)
+      sum.v_[ch] += v.v_[ch] * weight;
+    return sum;
+  }
+
+  inline vec4_t sub4(vec4_t a, vec4_t b) 
+  { 
+    for(int ch = 0; ch < 4; ++ch)
+      a.v_[ch] -= b.v_[ch];
+    return a;
+  }
+
+  inline vec4_t abs4(vec4_t v) 
+  { 
+    for(int ch = 0; ch < 4; ++ch)
+      v.v_[ch] = std::abs(v.v_[ch]);
+    return v;
+  }
+#endif
+
+  // Sum of 'taps' pixels of 4 floats, 'step' floats apart, multiplied by 'weights'
+  inline vec4_t weightedSum(vec4_t sum, float const * in, std::ptrdiff_t step, float const * weights, int taps)
+  {
+    for(int k = 0; k < taps; ++k)
+      sum = multiplyAdd4(sum, load4(in + k * step), weights[k]);
+    return sum;
+  }
+
+  // Source coordinate of the pixel at 'pos' for given edge mode, -1 for transparent pixel
+  int edgeCoordinate(int pos, int size, ConvolveMatrix::EdgeMode edgeMode)
+  {
+    if (pos >= 0 && pos < size)
+      return pos;
+    switch(edgeMode)
+    {
+    case ConvolveMatrix::edgeDuplicate:
+      return pos < 0 ? 0 : size - 1;
+    case ConvolveMatrix::edgeWrap:
+      pos %= size;
+      return pos < 0 ? pos + size : pos;
+    default:
+      return -1;
+    }
+  }
+
+  // Finds 'column' and 'row', such that weights[a * columns + b] = column[a] * row[b]
+  bool separateKernel(std::vector<float> const & weights, int columns, int rows, 
+    std::vector<float> & column, std::vector<float> & row)
+  {
+    std::size_t pivot = 0;
+    for(std::size_t i = 1; i < weights.size(); ++i)
+      if (std::abs(weights[i]) > std::abs(weights[pivot]))
+        pivot = i;
+    float const max_weight = std::abs(weights[pivot]);
+    if (max_weight == 0)
+      return false;
+    int const pivot_row = int(pivot) / columns, pivot_column = int(pivot) % columns;
+    row.assign(weights.begin() + pivot_row * columns, weights.begin() + (pivot_row + 1) * columns);
+    column.resize(rows);
+    for(int a = 0; a < rows; ++a)
+      column[a] = weights[a * columns + pivot_column] / weights[pivot];
+    for(int a = 0; a < rows; ++a)
+      for(int b = 0; b < columns; ++b)
+        if (std::abs(weights[a * columns + b] - column[a] * row[b]) > max_weight * 1e-5f)
+          return false;
+    return true;
+  }
+
+  class ConvolveResult
+  {
+  public:
+    ConvolveResult(ConvolveMatrix const & matrix)
+      : scale_(float(1 / matrix.divisor_))
+      , bias_(float(matrix.bias_ * 255))
+      , preserveAlpha_(matrix.preserveAlpha_)
+    {}
+
+    // 'alpha' is the source alpha of the pixel, used if alpha is preserved
+    void store(vec4_t sum, float alpha, byte_t * out) const
+    {
+      float channels[4];
+      store4(channels, sum);
+      if (preserveAlpha_)
+      {
+        // Colors are calculated unpremultiplied
+        for(int ch = 0; ch < 3; ++ch)
+          out[ch] = byte_t(std::lrint(clamp(channels[ch] * scale_ + bias_, 255) * alpha / 255));
+        out[3] = byte_t(alpha);
+      }
+      else
+      {
+        out[3] = byte_t(std::lrint(clamp(channels[3] * scale_ + bias_, 255)));
+        for(int ch = 0; ch < 3; ++ch)
+          out[ch] = byte_t(std::lrint(clamp(channels[ch] * scale_ + bias_, out[3])));
+      }
+    }
+
+  private:
+    float const scale_, bias_;
+    bool const preserveAlpha_;
+
+    static float clamp(float value, float max)
+    {
+      return value > 0 ? std::min(value, max) : 0; // NaN is 0
+    }
+  };
+}
+
+void convolveMatrix(gil::rgba8c_view_t const & src, int x, int y,
+  gil::rgba8_view_t const & dst, ConvolveMatrix const & matrix)
+{
+  int const width = int(dst.width()), height = int(dst.height());
+  if (width == 0 || height == 0)
+    return;
+  if (src.width() == 0 || src.height() == 0)
+  {
+    gil::fill_pixels(dst, gil::rgba8_pixel_t(0, 0, 0, 0));
+    return;
+  }
+  int const columns = matrix.orderX_, rows = matrix.orderY_;
+  // Kernel rotated by 180 degrees: weights[a * columns + b] multiplies source pixel
+  // (c + b, r + a) of 'padded' for result pixel (c, r)
+  std::vector<float> weights(matrix.kernel_.rbegin(), matrix.kernel_.rend());
+
+  // Source pixels under the kernel, with edge mode applied, as 4 floats per pixel
+  int const padded_width = width + columns - 1, padded_height = height + rows - 1;
+  int const padded_x = x - matrix.targetX_, padded_y = y - matrix.targetY_;
+  std::ptrdiff_t const padded_row = std::ptrdiff_t(padded_width) * 4;
+  std::vector<float> padded(padded_height * padded_row, 0.0f);
+  std::vector<int> source_columns(padded_width);
+  for(int c = 0; c < padded_width; ++c)
+    source_columns[c] = edgeCoordinate(padded_x + c, int(src.width()), matrix.edgeMode_);
+  for(int r = 0; r < padded_height; ++r)
+  {
+    int const source_row = edgeCoordinate(padded_y + r, int(src.height()), matrix.edgeMode_);
+    if (source_row < 0)
+      continue;
+    gil::rgba8c_view_t::x_iterator const source = src.row_begin(source_row);
+    float * out = &padded[r * padded_row];
+    for(int c = 0; c < padded_width; ++c, out += 4)
+      if (source_columns[c] >= 0)
+      {
+        gil::rgba8_pixel_t const pixel = source[source_columns[c]];
+        out[3] = pixel[3];
+        // Preserved alpha is applied to unpremultiplied colors
+        float const color_scale = !matrix.preserveAlpha_ ? 1.0f : pixel[3] ? 255.0f / pixel[3] : 0.0f;
+        for(int ch = 0; ch < 3; ++ch)
+          out[ch] = std::min(255.0f, pixel[ch] * color_scale);
+      }
+  }
+
+  ConvolveResult const result(matrix);
+  // Alpha of the source pixel under the target element
+  float const * const source_alpha = &padded[matrix.targetY_ * padded_row + matrix.targetX_ * 4 + 3];
+  byte_t * const dst_origin = reinterpret_cast<byte_t *>(dst.row_begin(0));
+  std::ptrdiff_t const dst_row_bytes = dst.pixels().row_size();
+
+  std::vector<float> column_weights, row_weights;
+  if (separateKernel(weights, columns, rows, column_weights, row_weights))
+  {
+    parallelBands(height, std::size_t(width) * (columns + rows), [&](int begin, int end)
+    {
+      // Rows of 'padded' used by the band, convolved with 'row_weights'
+      int const band_rows = end - begin + rows - 1;
+      std::vector<float> horizontal(std::size_t(band_rows) * width * 4);
+      for(int r = 0; r < band_rows; ++r)
+        for(int c = 0; c < width; ++c)
+          store4(&horizontal[(std::size_t(r) * width + c) * 4], 
+            weightedSum(zero4(), &padded[(begin + r) * padded_row + c * 4], 4, &row_weights[0], columns));
+      for(int r = begin; r < end; ++r)
+        for(int c = 0; c < width; ++c)
+          result.store(
+            weightedSum(zero4(), &horizontal[(std::size_t(r - begin) * width + c) * 4], 
+              std::ptrdiff_t(width) * 4, &column_weights[0], rows),
+            source_alpha[r * padded_row + c * 4], dst_origin + r * dst_row_bytes + c * 4);
+    });
+  }
+  else
+  {
+    parallelBands(height, std::size_t(width) * columns * rows, [&](int begin, int end)
+    {
+      for(int r = begin; r < end; ++r)
+        for(int c = 0; c < width; ++c)
+        {
+          vec4_t sum = zero4();
+          for(int a = 0; a < rows; ++a)
+            sum = weightedSum(sum, &padded[(r + a) * padded_row + c * 4], 4, &weights[a * columns], columns);
+          result.store(sum, source_alpha[r * padded_row + c * 4], dst_origin + r * dst_row_bytes + c * 4);
+        }
+    });
+  }
+}
+
+namespace
+{
+  // Pseudo-random number generator and lattice from the reference implementation in SVG specification.
+  // Gradients of all 4 channels are stored together, so that channels are calculated at once
+  class TurbulenceLattice
+  {
+  public:
+    enum { size = 0x100, mask = 0xff, perlinN = 0x1000 };
+
+    struct Stitch
+    {
+      int width_, height_, wrapX_, wrapY_;
+    };
+
+    explicit TurbulenceLattice(long seed)
+    {
+      seed = setupSeed(seed);
+      float (*gradients)[2][4] = gradients_;
+      for(int channel = 0; channel < 4; ++channel)
+        for(int i = 0; i < size; ++i)
+        {
+          double gradient[2];
+          for(int j = 0; j < 2; ++j)
+            gradient[j] = double(((seed = random(seed)) % (size + size)) - size) / size;
+          double const length = std::sqrt(gradient[0] * gradient[0] + gradient[1] * gradient[1]);
+          for(int j = 0; j < 2; ++j)
+            gradients[i][j][channel] = length != 0 ? float(gradient[j] / length) : 0.0f;
+        }
+      for(int i = 0; i < size; ++i)
+        selector_[i] = i;
+      for(int i = size - 1; i > 0; --i)
+        std::swap(selector_[i], selector_[(seed = random(seed)) % size]);
+      for(int i = 0; i < size + 2; ++i)
+      {
+        selector_[size + i] = selector_[i];
+        std::copy(&gradients_[i][0][0], &gradients_[i][0][0] + 8, &gradients_[size + i][0][0]);
+      }
+    }
+
+    // Noise of all channels at point 'v', lattice points are wrapped according to 'stitch' if it isn't NULL
+    vec4_t noise(double vx, double vy, Stitch const * stitch) const
+    {
+      double const fx = std::floor(vx), fy = std::floor(vy);
+      int bx0 = int(fx) + perlinN, by0 = int(fy) + perlinN;
+      int bx1 = bx0 + 1, by1 = by0 + 1;
+      if (stitch)
+      {
+        if (bx0 >= stitch->wrapX_) bx0 -= stitch->width_;
+        if (bx1 >= stitch->wrapX_) bx1 -= stitch->width_;
+        if (by0 >= stitch->wrapY_) by0 -= stitch->height_;
+        if (by1 >= stitch->wrapY_) by1 -= stitch->height_;
+      }
+      int const i = selector_[bx0 & mask], j = selector_[bx1 & mask];
+      float const rx0 = float(vx - fx), ry0 = float(vy - fy), rx1 = rx0 - 1, ry1 = ry0 - 1;
+      float const sx = rx0 * rx0 * (3 - 2 * rx0), sy = ry0 * ry0 * (3 - 2 * ry0);
+      vec4_t const a = lerp(sx, 
+        dot(gradients_[selector_[i + (by0 & mask)]], rx0, ry0),
+        dot(gradients_[selector_[j + (by0 & mask)]], rx1, ry0));
+      vec4_t const b = lerp(sx, 
+        dot(gradients_[selector_[i + (by1 & mask)]], rx0, ry1),
+        dot(gradients_[selector_[j + (by1 & mask)]], rx1, ry1));
+      return lerp(sy, a, b);
+    }
+
+  private:
+    int selector_[size + size + 2];
+    float gradients_[size + size + 2][2][4]; // Coordinate, channel
+
+    static long setupSeed(long seed)
+    {
+      if (seed <= 0) 
+        seed = -(seed % (randM - 1)) + 1;
+      if (seed > randM - 1) 
+        seed = randM - 1;
+      return seed;
+    }
+
+    static long random(long seed)
+    {
+      long const result = randA * (seed % randQ) - randR * (seed / randQ);
+      return result <= 0 ? result + randM : result;
+    }
+
+    static vec4_t dot(float const (&gradient)[2][4], float x, float y)
+    {
+      return multiplyAdd4(multiplyAdd4(zero4(), load4(gradient[0]), x), load4(gradient[1]), y);
+    }
+
+    static vec4_t lerp(float t, vec4_t a, vec4_t b)
+    {
+      return multiplyAdd4(a, sub4(b, a), t);
+    }
+
+    static long const randM = 2147483647, randA = 16807, randQ = 127773 /* randM / randA */, randR = 2836 /* randM % randA */;
+  };
+
+  // Lattice is calculated once per seed
+  std::shared_ptr<TurbulenceLattice const> turbulenceLattice(long seed)
+  {
+    static std::mutex mutex;
+    static std::map<long, std::shared_ptr<TurbulenceLattice const> > cache;
+    std::size_t const max_cached_seeds = 16;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<long, std::shared_ptr<TurbulenceLattice const> >::const_iterator const cached = cache.find(seed);
+    if (cached != cache.end())
+      return cached->second;
+    if (cache.size() >= max_cached_seeds)
+      cache.clear();
+    std::shared_ptr<TurbulenceLattice const> const lattice = std::make_shared<TurbulenceLattice>(seed);
+    cache[seed] = lattice;
+    return lattice;
+  }
+
+  // Frequency closest to 'frequency', at which 'length' contains whole number of periods
+  double stitchFrequency(double frequency, double length)
+  {
+    if (frequency == 0)
+      return frequency;
+    double const low = std::floor(length * frequency) / length, high = std::ceil(length * frequency) / length;
+    return frequency / low < high / frequency ? low : high;
+  }
+}
+
+void turbulence(int x, int y, gil::rgba8_view_t const & dst, Turbulence const & params)
+{
+  int const width = int(dst.width()), height = int(dst.height());
+  if (width == 0 || height == 0)
+    return;
+  std::shared_ptr<TurbulenceLattice const> const lattice = turbulenceLattice(params.seed_);
+  // Further octaves don't change 8-bit result
+  int const octaves = std::min(params.numOctaves_, 10);
+
+  double frequencyX = params.baseFrequencyX_, frequencyY = params.baseFrequencyY_;
+  TurbulenceLattice::Stitch stitch = { 0, 0, 0, 0 };
+  if (params.stitchTiles_)
+  {
+    frequencyX = stitchFrequency(frequencyX, params.tileWidth_);
+    frequencyY = stitchFrequency(frequencyY, params.tileHeight_);
+    stitch.width_ = int(params.tileWidth_ * frequencyX + 0.5);
+    stitch.wrapX_ = int(params.tileX_ * frequencyX + TurbulenceLattice::perlinN + stitch.width_);
+    stitch.height_ = int(params.tileHeight_ * frequencyY + 0.5);
+    stitch.wrapY_ = int(params.tileY_ * frequencyY + TurbulenceLattice::perlinN + stitch.height_);
+  }
+
+  byte_t * const dst_origin = reinterpret_cast<byte_t *>(dst.row_begin(0));
+  std::ptrdiff_t const dst_row_bytes = dst.pixels().row_size();
+  double const * const m = params.toUser_;
+  parallelBands(height, std::size_t(width) * octaves * 32, [&](int begin, int end)
+  {
+    for(int row = begin; row < end; ++row)
+    {
+      byte_t * out = dst_origin + row * dst_row_bytes;
+      for(int column = 0; column < width; ++column, out += 4)
+      {
+        double const deviceX = x + column, deviceY = y + row;
+        double vx = (m[0] * deviceX + m[2] * deviceY + m[4]) * frequencyX;
+        double vy = (m[1] * deviceX + m[3] * deviceY + m[5]) * frequencyY;
+        TurbulenceLattice::Stitch octave_stitch = stitch;
+        vec4_t sum = zero4();
+        float ratio = 1;
+        for(int octave = 0; octave < octaves; ++octave)
+        {
+          vec4_t const noise = lattice->noise(vx, vy, params.stitchTiles_ ? &octave_stitch : NULL);
+          sum = multiplyAdd4(sum, params.fractalNoise_ ? noise : abs4(noise), 1 / ratio);
+          vx *= 2;
+          vy *= 2;
+          ratio *= 2;
+          octave_stitch.width_ *= 2;
+          octave_stitch.wrapX_ = 2 * octave_stitch.wrapX_ - TurbulenceLattice::perlinN;
+          octave_stitch.height_ *= 2;
+          octave_stitch.wrapY_ = 2 * octave_stitch.wrapY_ - TurbulenceLattice::perlinN;
+        }
+
+        // Channels are not premultiplied
+        float channels[4];
+        store4(channels, sum);
+        for(int ch = 0; ch < 4; ++ch)
+        {
+          float const value = params.fractalNoise_ ? (channels[ch] * 255 + 255) / 2 : channels[ch] * 255;
+          channels[ch] = value > 0 ? std::min(value, 255.0f) : 0;
+        }
+        for(int ch = 0; ch < 3; ++ch)
+          out[ch] = byte_t(std::lrint(channels[ch] * channels[3] / 255));
+        out[3] = byte_t(std::lrint(channels[3]));
+      }
+    }
+  });
+}
+
+namespace
+{
+  // pow(t, exponent) for t in [0, 1], interpolated in a table
+  class PowTable
+  {
+  public:
+    explicit PowTable(double exponent)
+    {
+      for(int i = 0; i <= size; ++i)
+        values_[i] = float(std::pow(double(i) / size, exponent));
+    }
+
+    float operator()(float t) const
+    {
+      if (!(t > 0)) // NaN too
+        return 0;
+      if (t >= 1)
+        return 1;
+      float const position = t * size;
+      int const index = int(position);
+      return values_[index] + (values_[index + 1] - values_[index]) * (position - index);
+    }
+
+  private:
+    static int const size = 1024;
+    float values_[size + 1];
+  };
+
+  // Alpha channel of the row with one duplicated pixel on each side, 'out' points to the first pixel
+  void loadAlpha(gil::rgba8c_view_t const & src, int row, float * out)
+  {
+    int const width = int(src.width());
+    gil::rgba8c_view_t::x_iterator const pixels = src.row_begin(row);
+    for(int x = 0; x < width; ++x)
+      out[x] = pixels[x][3];
+    out[-1] = out[0];
+    out[width] = out[width - 1];
+  }
+
+  // Sobel operators from the specification, including variants for edge pixels, applied to alpha 
+  // rows 'up', 'mid' and 'down'. Missing rows at the image edges must be replaced by 'mid'.
+  // Calculates 'nx' and 'ny', that are Nx and Ny multiplied by FACTORx and FACTORy from the specification
+  class SobelRow
+  {
+  public:
+    SobelRow(float const * up, float const * mid, float const * down, int width, bool has_up, bool has_down)
+      : up_(up), mid_(mid), down_(down), width_(width)
+      , up_weight_(has_up ? 1.0f : 0.0f)
+      , down_weight_(has_down ? 1.0f : 0.0f)
+      , rows_distance_((has_up ? 1 : 0) + (has_down ? 1 : 0))
+    {}
+
+    void operator()(float * nx, float * ny) const
+    {
+      int x = 0;
+      if (width_ > 2)
+      {
+        // Pixels not on the left and right edges
+        pixel(0, nx, ny);
+        x = 1;
+#if defined(SVGPP_GIL_SIMD)
+        __m128 const up_weight = _mm_set1_ps(up_weight_), down_weight = _mm_set1_ps(down_weight_);
+        __m128 const factor_x = _mm_set1_ps(1 / (up_weight_ + 2 + down_weight_));
+        __m128 const factor_y = _mm_set1_ps(rows_distance_ ? 1.0f / (2 * rows_distance_) : 0.0f);
+        for(; x + 4 <= width_ - 1; x += 4)
+        {
+          __m128 const up_left = _mm_loadu_ps(up_ + x - 1), up_center = _mm_loadu_ps(up_ + x), up_right = _mm_loadu_ps(up_ + x + 1);
+          __m128 const down_left = _mm_loadu_ps(down_ + x - 1), down_center = _mm_loadu_ps(down_ + x), 
+            down_right = _mm_loadu_ps(down_ + x + 1);
+          __m128 const mid_dx = _mm_sub_ps(_mm_loadu_ps(mid_ + x + 1), _mm_loadu_ps(mid_ + x - 1));
+          __m128 const sum_x = _mm_add_ps(_mm_add_ps(
+            _mm_mul_ps(up_weight, _mm_sub_ps(up_right, up_left)), 
+            _mm_add_ps(mid_dx, mid_dx)), 
+            _mm_mul_ps(down_weight, _mm_sub_ps(down_right, down_left)));
+          __m128 const center_dy = _mm_sub_ps(down_center, up_center);
+          __m128 const sum_y = _mm_add_ps(_mm_add_ps(
+            _mm_sub_ps(down_left, up_left), 
+            _mm_add_ps(center_dy, center_dy)), 
+            _mm_sub_ps(down_right, up_right));
+          _mm_storeu_ps(nx + x, _mm_mul_ps(sum_x, factor_x));
+          _mm_storeu_ps(ny + x, _mm_mul_ps(sum_y, factor_y));
+        }
+#endif
+      }
+      for(; x < width_; ++x)
+        pixel(x, nx, ny);
+    }
+
+  private:
+    float const * const up_, * const mid_, * const down_;
+    int const width_;
+    float const up_weight_, down_weight_;
+    int const rows_distance_;
+
+    void pixel(int x, float * nx, float * ny) const
+    {
+      // Rows have duplicated pixels on both sides, so differences at the edges are one-sided
+      float const left_weight = x > 0 ? 1.0f : 0.0f, right_weight = x + 1 < width_ ? 1.0f : 0.0f;
+      int const columns_distance = (x > 0 ? 1 : 0) + (x + 1 < width_ ? 1 : 0);
+      float const sum_x = up_weight_ * (up_[x + 1] - up_[x - 1]) + 2 * (mid_[x + 1] - mid_[x - 1]) 
+        + down_weight_ * (down_[x + 1] - down_[x - 1]);
+      float const sum_y = left_weight * (down_[x - 1] - up_[x - 1]) + 2 * (down_[x] - up_[x]) 
+        + right_weight * (down_[x + 1] - up_[x + 1]);
+      nx[x] = columns_distance ? sum_x * 2 / ((up_weight_ + 2 + down_weight_) * columns_distance) : 0;
+      ny[x] = rows_distance_ ? sum_y * 2 / ((left_weight + 2 + right_weight) * rows_distance_) : 0;
+    }
+  };
+
+  inline float dot3(float const * a, float const * b)
+  {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+  }
+
+  inline void normalize3(float * v)
+  {
+    float const length = std::sqrt(dot3(v, v));
+    if (length > 0)
+      for(int i = 0; i < 3; ++i)
+        v[i] /= length;
+  }
+
+  inline byte_t toChannel(float value)
+  {
+    return byte_t(std::lrint(value > 0 ? std::min(value, 1.0f) * 255 : 0));
+  }
+}
+
+void lighting(gil::rgba8c_view_t const & src, int x, int y,
+  gil::rgba8_view_t const & dst, Lighting const & params)
+{
+  int const width = int(dst.width()), height = int(dst.height());
+  if (width == 0 || height == 0)
+    return;
+  if (params.light_ == Lighting::lightNone)
+  {
+    gil::fill_pixels(dst, gil::rgba8_pixel_t(0, 0, 0, 0));
+    return;
+  }
+
+  PowTable const specular_pow(std::max(1.0, std::min(128.0, params.specularExponent_)));
+  PowTable const spot_pow(std::max(1.0, std::min(128.0, params.spotExponent_)));
+  float const surface_scale = float(params.surfaceScale_ / 255);
+  float const constant = float(params.constant_);
+  float const cos_cone_angle = float(params.cosConeAngle_);
+  float color[3], direction[3], position[3], spot_direction[3];
+  for(int i = 0; i < 3; ++i)
+  {
+    color[i] = float(params.color_[i]);
+    direction[i] = float(params.direction_[i]);
+    position[i] = float(params.position_[i]);
+    spot_direction[i] = float(params.pointsAt_[i] - params.position_[i]);
+  }
+  normalize3(spot_direction);
+
+  byte_t * const dst_origin = reinterpret_cast<byte_t *>(dst.row_begin(0));
+  std::ptrdiff_t const dst_row_bytes = dst.pixels().row_size();
+  parallelBands(height, std::size_t(width) * 64, [&](int begin, int end)
+  {
+    // Sliding window of alpha rows row - 1, row and row + 1, with padding
+    std::vector<float> rows_buffer(3 * (width + 2));
+    float * up = &rows_buffer[1], * mid = up + width + 2, * down = mid + width + 2;
+    if (begin > 0)
+      loadAlpha(src, begin - 1, up);
+    loadAlpha(src, begin, mid);
+    if (begin + 1 < height)
+      loadAlpha(src, begin + 1, down);
+    std::vector<float> nx(width), ny(width);
+
+    for(int row = begin; row < end; ++row)
+    {
+      if (row > begin)
+      {
+        std::swap(up, mid);
+        std::swap(mid, down);
+        if (row + 1 < height)
+          loadAlpha(src, row + 1, down);
+      }
+      bool const has_up = row > 0, has_down = row + 1 < height;
+      SobelRow(has_up ? up : mid, mid, has_down ? down : mid, width, has_up, has_down)(&nx[0], &ny[0]);
+
+      byte_t * out = dst_origin + row * dst_row_bytes;
+      for(int column = 0; column < width; ++column, out += 4)
+      {
+        float normal[3] = { -surface_scale * nx[column], -surface_scale * ny[column], 1 };
+        normalize3(normal);
+        float light[3] = { direction[0], direction[1], direction[2] };
+        float light_color[3] = { color[0], color[1], color[2] };
+        if (params.light_ != Lighting::lightDistant)
+        {
+          light[0] = position[0] - (x + column);
+          light[1] = position[1] - (y + row);
+          light[2] = position[2] - surface_scale * mid[column];
+          normalize3(light);
+          if (params.light_ == Lighting::lightSpot)
+          {
+            float const cos_angle = -dot3(light, spot_direction);
+            float const intensity = cos_angle < cos_cone_angle ? 0.0f : spot_pow(cos_angle);
+            for(int ch = 0; ch < 3; ++ch)
+              light_color[ch] *= intensity;
+          }
+        }
+
+        if (params.specular_)
+        {
+          // Halfway vector between the light and the eye at infinity
+          float halfway[3] = { light[0], light[1], light[2] + 1 };
+          normalize3(halfway);
+          float const factor = constant * specular_pow(dot3(normal, halfway));
+          for(int ch = 0; ch < 3; ++ch)
+            out[ch] = toChannel(factor * light_color[ch]);
+          out[3] = std::max(out[0], std::max(out[1], out[2]));
+        }
+        else
+        {
+          float const factor = constant * dot3(normal, light);
+          for(int ch = 0; ch < 3; ++ch)
+            out[ch] = toChannel(factor * light_color[ch]);
+          out[3] = 255;
+        }
+      }
+    }
+  });
+}
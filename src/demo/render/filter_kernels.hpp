@@ -0,0 +1,90 @@
+#pragma once
+
+#include <boost/gil/typedefs.hpp>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+// Pixel processing of filter primitives that is too heavy to be written with GIL algorithms.
+// Images are premultiplied 8-bit RGBA. Pixels outside of the source views are transparent black.
+
+// Splits [0, count) into bands and calls 'fn(begin, end)' for them on several threads.
+// 'item_cost' is an estimate of work per item (e.g. pixels in row), small jobs run on the calling thread only
+void parallelBands(int count, std::size_t item_cost, std::function<void(int begin, int end)> const & fn);
+
+// Larger standard deviations are clamped to this value by gaussianBlur and gaussianBlurReach
+static const double max_blur_deviation = 1 << 16;
+
+// Distance in pixels at which source pixels affect the result of gaussianBlur
+int gaussianBlurReach(double stdDeviation);
+
+// Standard deviations are in pixels, non-positive value disables blur in that direction.
+// 'dst' receives the blurred image starting at (x, y) in coordinates of 'src'.
+// Deviations of 2 and more are approximated with three box blurs, as recommended by SVG specification,
+// smaller ones use gaussian kernel
+void gaussianBlur(boost::gil::rgba8c_view_t const & src, int x, int y,
+  boost::gil::rgba8_view_t const & dst, double stdDeviationX, double stdDeviationY);
+
+// Minimum (erode) or maximum (dilate) of each channel over the window of (2 * radiusX + 1) x (2 * radiusY + 1)
+// pixels centered on the pixel. 'dst' receives the result starting at (x, y) in coordinates of 'src'.
+// Cost per pixel doesn't depend on the radii
+void morphology(boost::gil::rgba8c_view_t const & src, int x, int y,
+  boost::gil::rgba8_view_t const & dst, int radiusX, int radiusY, bool dilate);
+
+struct ConvolveMatrix
+{
+  enum EdgeMode { edgeDuplicate, edgeWrap, edgeNone };
+
+  int orderX_, orderY_;
+  std::vector<double> kernel_; // 'orderY_' rows of 'orderX_' elements
+  int targetX_, targetY_;
+  double divisor_; // Non-zero
+  double bias_;
+  EdgeMode edgeMode_;
+  bool preserveAlpha_;
+};
+
+// Applies the kernel as specified for feConvolveMatrix: rotated by 180 degrees, with element
+// (targetX_, targetY_) over the result pixel. 'src' is the whole input image, 'edgeMode_' defines pixels 
+// outside of it. 'dst' receives the result starting at (x, y) in coordinates of 'src'.
+// Kernels that are outer product of a column and a row are applied in two passes
+void convolveMatrix(boost::gil::rgba8c_view_t const & src, int x, int y,
+  boost::gil::rgba8_view_t const & dst, ConvolveMatrix const & matrix);
+
+struct Turbulence
+{
+  double baseFrequencyX_, baseFrequencyY_;
+  int numOctaves_;
+  long seed_;
+  bool fractalNoise_; // Otherwise turbulence
+  bool stitchTiles_;
+  double tileX_, tileY_, tileWidth_, tileHeight_; // Tile for stitching, in user space
+  double toUser_[6]; // Maps device pixel to user space, as 'a b c d e f' matrix
+};
+
+// Noise of the reference implementation in SVG specification, evaluated at user space points of
+// device pixels. 'dst' receives pixels starting from device pixel (x, y)
+void turbulence(int x, int y, boost::gil::rgba8_view_t const & dst, Turbulence const & params);
+
+struct Lighting
+{
+  enum LightType { lightNone, lightDistant, lightPoint, lightSpot };
+
+  bool specular_; // Otherwise diffuse
+  double surfaceScale_; // Height of opaque pixel, in device pixels
+  double constant_; // diffuseConstant or specularConstant
+  double specularExponent_;
+  double color_[3]; // Light color components in 0..1
+  LightType light_;
+  double direction_[3]; // Unit vector to the distant light
+  double position_[3]; // Point or spot light position, in device pixels
+  double pointsAt_[3]; // Spot light target, in device pixels
+  double spotExponent_;
+  double cosConeAngle_; // -1 if spot light isn't limited by cone
+};
+
+// Lights the surface defined by alpha channel of 'src', as specified for feDiffuseLighting and feSpecularLighting.
+// 'dst' has the same size as 'src', (x, y) is the position of their top left pixel in device pixels.
+// Exponents are clamped to 1..128
+void lighting(boost::gil::rgba8c_view_t const & src, int x, int y,
+  boost::gil::rgba8_view_t const & dst, Lighting const & params);
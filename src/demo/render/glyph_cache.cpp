@@ -0,0 +1,211 @@
+#include "glyph_cache.hpp"
+
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/functional/hash.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+Font::Font(std::string const & file_name, unsigned id)
+  : id_(id)
+{
+  std::ifstream file(file_name.c_str(), std::ios::binary);
+  data_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+  if (data_.empty())
+    throw std::runtime_error("Can't read font file " + file_name);
+  int const offset = stbtt_GetFontOffsetForIndex(&data_[0], 0);
+  if (offset < 0 || !stbtt_InitFont(&info_, &data_[0], offset))
+    throw std::runtime_error("Can't load font from " + file_name);
+}
+
+int Font::glyphIndex(int codepoint) const
+{
+  return stbtt_FindGlyphIndex(&info_, codepoint);
+}
+
+float Font::scaleForSize(float size) const
+{
+  return stbtt_ScaleForMappingEmToPixels(&info_, size);
+}
+
+int Font::advance(int glyph) const
+{
+  int advance_width, left_side_bearing;
+  stbtt_GetGlyphHMetrics(&info_, glyph, &advance_width, &left_side_bearing);
+  return advance_width;
+}
+
+int Font::kerning(int glyph1, int glyph2) const
+{
+  return stbtt_GetGlyphKernAdvance(&info_, glyph1, glyph2);
+}
+
+namespace
+{
+  std::string normalizeFamily(std::string family)
+  {
+    boost::algorithm::trim_if(family, boost::algorithm::is_any_of(" \t\r\n\"'"));
+    boost::algorithm::to_lower(family);
+    return family;
+  }
+}
+
+void FontSet::load(std::string const & spec)
+{
+  std::string::size_type const eq = spec.find('=');
+  fonts_.push_back(std::unique_ptr<Font>(
+    new Font(eq == std::string::npos ? spec : spec.substr(eq + 1), unsigned(fonts_.size()))));
+  if (eq != std::string::npos)
+    families_[normalizeFamily(spec.substr(0, eq))] = fonts_.back().get();
+}
+
+Font const * FontSet::find(std::string const & family_list) const
+{
+  if (fonts_.empty())
+    return NULL;
+  std::vector<std::string> families;
+  boost::algorithm::split(families, family_list, boost::algorithm::is_any_of(","));
+  for(std::vector<std::string>::const_iterator family = families.begin(); family != families.end(); ++family)
+  {
+    std::map<std::string, Font const *>::const_iterator font = families_.find(normalizeFamily(*family));
+    if (font != families_.end())
+      return font->second;
+  }
+  return fonts_.front().get();
+}
+
+std::size_t GlyphCache::KeyHash::operator()(Key const & key) const
+{
+  std::size_t seed = 0;
+  boost::hash_combine(seed, key.font);
+  boost::hash_combine(seed, key.size_bucket);
+  boost::hash_combine(seed, key.glyph);
+  boost::hash_combine(seed, key.subpixel);
+  return seed;
+}
+
+GlyphCache::GlyphCache(std::size_t max_pages)
+  : max_pages_(std::max<std::size_t>(max_pages, 1))
+  , use_counter_(0)
+  , hits_(0)
+  , misses_(0)
+{
+  // Masks point into page buffers, so pages must not be reallocated
+  pages_.reserve(max_pages_);
+}
+
+int GlyphCache::sizeBucket(double pixel_size)
+{
+  return int(pixel_size * size_buckets_per_pixel + 0.5);
+}
+
+GlyphMask const & GlyphCache::get(Font const & font, int size_bucket, int glyph, int subpixel)
+{
+  Key const key = { font.id(), size_bucket, glyph, subpixel };
+  ++use_counter_;
+  std::unordered_map<Key, Entry, KeyHash>::const_iterator cached = glyphs_.find(key);
+  if (cached != glyphs_.end())
+  {
+    ++hits_;
+    pages_[cached->second.page].last_use = use_counter_;
+    return cached->second.mask;
+  }
+  ++misses_;
+
+  float const scale = font.scaleForSize(float(size_bucket) / size_buckets_per_pixel);
+  float const shift_x = float(subpixel) / subpixel_positions;
+  int x0, y0, x1, y1;
+  stbtt_GetGlyphBitmapBoxSubpixel(&font.info(), glyph, scale, scale, shift_x, 0, &x0, &y0, &x1, &y1);
+  GlyphMask mask;
+  mask.left = x0;
+  mask.top = y0;
+  mask.width = std::max(x1 - x0, 0);
+  mask.height = std::max(y1 - y0, 0);
+  mask.covers = NULL;
+  mask.stride = 0;
+
+  if (mask.width == 0 || mask.height == 0 || mask.width > page_size || mask.height > page_size)
+  {
+    // Empty glyphs aren't worth caching, huge ones are rasterized each time
+    if (mask.width != 0 && mask.height != 0)
+    {
+      scratch_.resize(mask.width * mask.height);
+      stbtt_MakeGlyphBitmapSubpixel(&font.info(), &scratch_[0], mask.width, mask.height, mask.width,
+        scale, scale, shift_x, 0, glyph);
+      mask.covers = &scratch_[0];
+      mask.stride = mask.width;
+    }
+    scratch_mask_ = mask;
+    return scratch_mask_;
+  }
+
+  int x, y;
+  std::size_t page_index = 0;
+  for(; page_index != pages_.size(); ++page_index)
+    if (allocate(pages_[page_index], mask.width, mask.height, x, y))
+      break;
+  if (page_index == pages_.size())
+  {
+    if (pages_.size() < max_pages_)
+    {
+      pages_.push_back(Page());
+      pages_.back().covers.resize(page_size * page_size);
+      pages_.back().bottom = 0;
+    }
+    else
+      page_index = evictLeastRecentlyUsed();
+    allocate(pages_[page_index], mask.width, mask.height, x, y);
+  }
+
+  Page & page = pages_[page_index];
+  page.last_use = use_counter_;
+  page.keys.push_back(key);
+  mask.stride = page_size;
+  mask.covers = &page.covers[y * page_size + x];
+  stbtt_MakeGlyphBitmapSubpixel(&font.info(), &page.covers[y * page_size + x],
+    mask.width, mask.height, mask.stride, scale, scale, shift_x, 0, glyph);
+  Entry const entry = { page_index, mask };
+  return glyphs_.insert(std::make_pair(key, entry)).first->second.mask;
+}
+
+bool GlyphCache::allocate(Page & page, int width, int height, int & x, int & y) const
+{
+  for(std::vector<Shelf>::iterator shelf = page.shelves.begin(); shelf != page.shelves.end(); ++shelf)
+  {
+    // Don't waste more than a quarter of shelf height
+    if (height <= shelf->height && height * 4 >= shelf->height * 3
+      && shelf->x + width <= page_size)
+    {
+      x = shelf->x;
+      y = shelf->y;
+      shelf->x += width;
+      return true;
+    }
+  }
+  if (page.bottom + height > page_size)
+    return false;
+  Shelf const shelf = { page.bottom, height, width };
+  page.shelves.push_back(shelf);
+  page.bottom += height;
+  x = 0;
+  y = shelf.y;
+  return true;
+}
+
+std::size_t GlyphCache::evictLeastRecentlyUsed()
+{
+  std::size_t lru = 0;
+  for(std::size_t i = 1; i < pages_.size(); ++i)
+    if (pages_[i].last_use < pages_[lru].last_use)
+      lru = i;
+  Page & page = pages_[lru];
+  for(std::vector<Key>::const_iterator key = page.keys.begin(); key != page.keys.end(); ++key)
+    glyphs_.erase(*key);
+  page.keys.clear();
+  page.shelves.clear();
+  page.bottom = 0;
+  return lru;
+}
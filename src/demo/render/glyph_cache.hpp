@@ -0,0 +1,132 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stb/stb_truetype.h>
+
+// TrueType font loaded with stb_truetype
+class Font: boost::noncopyable
+{
+public:
+  Font(std::string const & file_name, unsigned id);
+
+  unsigned id() const { return id_; }
+  stbtt_fontinfo const & info() const { return info_; }
+
+  int glyphIndex(int codepoint) const;
+  // Coefficient from font units to pixels (or user units) for given em size
+  float scaleForSize(float size) const;
+  // In font units
+  int advance(int glyph) const;
+  int kerning(int glyph1, int glyph2) const;
+
+private:
+  unsigned const id_;
+  std::vector<unsigned char> data_;
+  stbtt_fontinfo info_;
+};
+
+// Fonts by family name. Default (first loaded) font is used for families that aren't loaded
+class FontSet: boost::noncopyable
+{
+public:
+  // Argument is either "<file name>" or "<family>=<file name>"
+  void load(std::string const & spec);
+
+  bool empty() const { return fonts_.empty(); }
+  // Takes value of 'font-family' property - comma separated list of family names
+  Font const * find(std::string const & family_list) const;
+
+private:
+  std::vector<std::unique_ptr<Font> > fonts_;
+  std::map<std::string, Font const *> families_;
+};
+
+struct GlyphMask
+{
+  unsigned char const * covers; // Rows of coverage values, 'stride' bytes apart
+  int stride;
+  int left, top; // Offset of top left pixel from pen position
+  int width, height;
+};
+
+// Coverage masks of rasterized glyphs, packed into fixed-size atlas pages.
+// Glyph is identified by font, size bucket, glyph index and horizontal subpixel offset, so that
+// repeated strings blit cached masks instead of rasterizing outlines.
+// When all pages are full, the least recently used page is cleared together with glyphs on it.
+// Isn't thread-safe, must be used only by thread that executes draw commands.
+class GlyphCache: boost::noncopyable
+{
+public:
+  static const int size_buckets_per_pixel = 4;
+  static const int subpixel_positions = 4;
+
+  explicit GlyphCache(std::size_t max_pages = 16);
+
+  // Size bucket for size in pixels, 0 if text is too small to be drawn
+  static int sizeBucket(double pixel_size);
+
+  // Returned mask is valid until the next call
+  GlyphMask const & get(Font const & font, int size_bucket, int glyph, int subpixel);
+
+  std::size_t hits() const { return hits_; }
+  std::size_t misses() const { return misses_; }
+
+private:
+  static const int page_size = 512;
+
+  struct Key
+  {
+    unsigned font;
+    int size_bucket, glyph, subpixel;
+
+    bool operator==(Key const & other) const
+    {
+      return font == other.font && size_bucket == other.size_bucket
+        && glyph == other.glyph && subpixel == other.subpixel;
+    }
+  };
+
+  struct KeyHash
+  {
+    std::size_t operator()(Key const & key) const;
+  };
+
+  struct Entry
+  {
+    std::size_t page;
+    GlyphMask mask;
+  };
+
+  // Glyphs of similar height are placed in rows, left to right
+  struct Shelf
+  {
+    int y, height, x;
+  };
+
+  struct Page
+  {
+    std::vector<unsigned char> covers;
+    std::vector<Shelf> shelves;
+    int bottom;
+    unsigned long last_use;
+    std::vector<Key> keys;
+  };
+
+  std::size_t const max_pages_;
+  std::vector<Page> pages_;
+  std::unordered_map<Key, Entry, KeyHash> glyphs_;
+  unsigned long use_counter_;
+  std::size_t hits_, misses_;
+  // For glyphs that don't fit into the page
+  std::vector<unsigned char> scratch_;
+  GlyphMask scratch_mask_;
+
+  bool allocate(Page & page, int width, int height, int & x, int & y) const;
+  std::size_t evictLeastRecentlyUsed();
+};
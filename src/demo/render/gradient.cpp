@@ -12,15 +12,31 @@ class GradientContext
 {
 public:
   GradientContext(
+    Gradients & gradients,
     length_factory_t const & length_factory/*,
     get_bounding_box_func_t const & get_bounding_box*/)
-    : referenced_length_factory_(length_factory)
+    : gradients_(gradients)
+    , referenced_length_factory_(length_factory)
     //, get_bounding_box_(get_bounding_box)
+    , viewport_dependent_(false)
   {}
 
+  // Gradient referenced by xlink:href
+  boost::optional<Gradient> getReferenced(svg_string_t const & id)
+  {
+    bool viewport_dependent = false;
+    boost::optional<Gradient> const referenced = gradients_.get(id, referenced_length_factory_, &viewport_dependent);
+    viewport_dependent_ = viewport_dependent_ || viewport_dependent;
+    if (!referenced)
+      std::cerr << "Gradient \"" << std::string(id.begin(), id.end()) << "\" referenced by xlink:href not found\n";
+    return referenced;
+  }
+
+  Gradients & gradients_;
   length_factory_t const & referenced_length_factory_; 
   //get_bounding_box_func_t const & get_bounding_box_;*/
   boost::optional<Gradient> gradient_;
+  bool viewport_dependent_;
 };
 
 struct afterGradientUnitsTag {};
@@ -62,9 +78,10 @@ private:
 class GradientBaseContext
 {
 public:
-  GradientBaseContext(GradientBase & data, GradientContext const & gradientContext)
+  GradientBaseContext(GradientBase & data, GradientContext & gradientContext)
     : data_(data)
     , gradientContext_(gradientContext)
+    , own_stops_(false)
   {}
 
   length_factory_t const & length_factory()
@@ -74,6 +91,12 @@ public:
 
   void addStop(GradientStop stop)
   {
+    // Stops of referenced gradient are used only if there are no own stops
+    if (!own_stops_)
+    {
+      data_.stops_.clear();
+      own_stops_ = true;
+    }
     if (!data_.stops_.empty() && data_.stops_.back().offset_ > stop.offset_)
       stop.offset_ = data_.stops_.back().offset_;
     data_.stops_.push_back(stop);
@@ -90,6 +113,10 @@ public:
 #endif
   }
 
+  template<class IRI>
+  void set(svgpp::tag::attribute::xlink::href, IRI const & fragment)
+  { std::cerr << "External references aren't supported\n"; }
+
   template<class StringRange>
   void set(svgpp::tag::attribute::id, StringRange const & str)
   {
@@ -126,7 +153,10 @@ public:
   bool notify(afterGradientUnitsTag)
   { 
     if (!data_.useObjectBoundingBox_)
+    {
       length_factory_ = gradientContext_.referenced_length_factory_;
+      gradientContext_.viewport_dependent_ = true;
+    }
     else
       length_factory_.set_viewport_size(1.0, 1.0);
     return true; 
@@ -135,8 +165,26 @@ public:
 protected:
   svg_string_t id_;
   GradientBase & data_;
-  GradientContext const & gradientContext_;
+  GradientContext & gradientContext_;
   length_factory_t length_factory_;
+  bool own_stops_;
+
+  // Copies attributes common for all gradients and stops from the gradient referenced by 
+  // xlink:href. Returns referenced gradient if it is of the same type
+  template<class GradientType, class IRI>
+  GradientType const * inheritReferenced(IRI const & fragment)
+  {
+    boost::optional<Gradient> const referenced = 
+      gradientContext_.getReferenced(svg_string_t(boost::begin(fragment), boost::end(fragment)));
+    if (!referenced)
+      return NULL;
+    data_ = getGradientBase(*referenced);
+    referenced_ = referenced; // Keeps returned pointer valid
+    return boost::get<GradientType>(referenced_.get_ptr());
+  }
+
+private:
+  boost::optional<Gradient> referenced_;
 };
 
 void GradientStopContext::on_exit_element()
@@ -170,6 +218,16 @@ public:
 
   using GradientBaseContext::set;
 
+  template<class IRI>
+  void set(svgpp::tag::attribute::xlink::href, svgpp::tag::iri_fragment, IRI const & fragment)
+  {
+    if (LinearGradient const * referenced = inheritReferenced<LinearGradient>(fragment))
+    {
+      data_ = *referenced;
+      x2_set_ = true;
+    }
+  }
+
   void set(svgpp::tag::attribute::x1, number_t val)
   { data_.x1_ = val; }
 
@@ -221,6 +279,16 @@ public:
 
   using GradientBaseContext::set;
 
+  template<class IRI>
+  void set(svgpp::tag::attribute::xlink::href, svgpp::tag::iri_fragment, IRI const & fragment)
+  {
+    if (RadialGradient const * referenced = inheritReferenced<RadialGradient>(fragment))
+    {
+      data_ = *referenced;
+      cx_set_ = cy_set_ = r_set_ = fx_set_ = fy_set_ = true;
+    }
+  }
+
   void set(svgpp::tag::attribute::cx, number_t val)
   { cx_set_ = true; data_.cx_ = val; }
 
@@ -274,6 +342,8 @@ struct attribute_traversal: svgpp::policy::attribute_traversal::default_policy
   typedef boost::mpl::if_<
     boost::mpl::has_key<svgpp::traits::gradient_elements, boost::mpl::_1>,
     boost::mpl::vector<
+      // Referenced gradient provides defaults for the rest of attributes
+      svgpp::tag::attribute::xlink::href,
       svgpp::tag::attribute::gradientUnits,
       svgpp::notify_context<afterGradientUnitsTag>
     >,
@@ -281,17 +351,54 @@ struct attribute_traversal: svgpp::policy::attribute_traversal::default_policy
   > get_priority_attributes_by_element;
 };
 
-boost::optional<Gradient> Gradients::get(
+boost::optional<Gradient> const & Gradients::get(
     svg_string_t const & id, 
     length_factory_t const & length_factory/*, 
-    get_bounding_box_func_t const & get_bounding_box*/)
+    get_bounding_box_func_t const & get_bounding_box*/,
+    bool * viewport_dependent)
+{
+  number_t const viewport_width = length_factory.create_length(
+    100, svgpp::tag::length_units::percent(), svgpp::tag::length_dimension::width());
+  number_t const viewport_height = length_factory.create_length(
+    100, svgpp::tag::length_units::percent(), svgpp::tag::length_dimension::height());
+  std::vector<CachedGradient> & cached = cache_[id];
+  for(std::vector<CachedGradient>::const_iterator it = cached.begin(); it != cached.end(); ++it)
+    if (!it->viewportDependent_ 
+      || (it->viewportWidth_ == viewport_width && it->viewportHeight_ == viewport_height))
+    {
+      if (viewport_dependent)
+        *viewport_dependent = it->viewportDependent_;
+      return it->gradient_;
+    }
+
+  if (!loading_.insert(id).second)
+  {
+    // Result of the loop is not cached, only the outermost call that started loading 'id' inserts it
+    std::cerr << "Gradient \"" << std::string(id.begin(), id.end()) << "\" references itself\n";
+    static boost::optional<Gradient> const no_gradient;
+    if (viewport_dependent)
+      *viewport_dependent = false;
+    return no_gradient;
+  }
+  CachedGradient result;
+  result.viewportDependent_ = false;
+  result.viewportWidth_ = viewport_width;
+  result.viewportHeight_ = viewport_height;
+  load(id, length_factory, result);
+  loading_.erase(id);
+  if (viewport_dependent)
+    *viewport_dependent = result.viewportDependent_;
+  cached.push_back(result);
+  return cached.back().gradient_;
+}
+
+void Gradients::load(svg_string_t const & id, length_factory_t const & length_factory, CachedGradient & result)
 {
-  // TODO: inheritance via xlink::href
   if (XMLElement node = xml_document_.findElementById(id))
   {
     try
     {
-      GradientContext gradient_context(length_factory);
+      GradientContext gradient_context(*this, length_factory);
       svgpp::document_traversal<
         svgpp::number_type<number_t>,
         svgpp::context_factories<gradient_context_factories>,
@@ -321,6 +428,8 @@ boost::optional<Gradient> Gradients::get(
             svgpp::tag::attribute::gradientTransform,
             svgpp::tag::attribute::spreadMethod,
             svgpp::tag::attribute::offset,
+            boost::mpl::pair<svgpp::tag::element::linearGradient, svgpp::tag::attribute::xlink::href>,
+            boost::mpl::pair<svgpp::tag::element::radialGradient, svgpp::tag::attribute::xlink::href>,
             boost::mpl::pair<svgpp::tag::element::stop, svgpp::tag::attribute::stop_color>,
             boost::mpl::pair<svgpp::tag::element::stop, svgpp::tag::attribute::stop_opacity>
           >::type
@@ -328,12 +437,18 @@ boost::optional<Gradient> Gradients::get(
       >::load_referenced_element<
         svgpp::expected_elements<svgpp::traits::gradient_elements>
       >::load(node, gradient_context);
-      return gradient_context.gradient_;
+      result.gradient_ = gradient_context.gradient_;
+      result.viewportDependent_ = gradient_context.viewport_dependent_;
+      if (result.gradient_)
+      {
+        if (LinearGradient * linear = boost::get<LinearGradient>(result.gradient_.get_ptr()))
+          linear->key_ = next_key_++;
+        else
+          boost::get<RadialGradient>(*result.gradient_).key_ = next_key_++;
+      }
     } catch (std::exception const & e)
     {
       std::cerr << "Error loading paint \"" << std::string(id.begin(), id.end()) << "\": " << e.what() << "\n";
     }
   }
-
-  return boost::optional<Gradient>();
 }
@@ -4,6 +4,7 @@
 #include <boost/variant.hpp>
 #include <boost/optional.hpp>
 #include <map>
+#include <set>
 #include <vector>
 #include "common.hpp"
 #if defined(RENDERER_SKIA)
@@ -35,6 +36,7 @@ struct GradientBase
     : spreadMethod_(spreadPad)
 #endif
     , useObjectBoundingBox_(true)
+    , key_(0)
   {}
 
   
@@ -47,6 +49,7 @@ struct GradientBase
 #endif
   GradientStops stops_;
   bool useObjectBoundingBox_;
+  unsigned key_; // Unique for each parsed gradient, shared by its copies
 };
 
 struct LinearGradient: GradientBase
@@ -67,18 +70,44 @@ struct RadialGradient: GradientBase
 
 typedef boost::variant<LinearGradient, RadialGradient> Gradient;
 
+inline GradientBase const & getGradientBase(Gradient const & gradient)
+{
+  if (LinearGradient const * linear = boost::get<LinearGradient>(&gradient))
+    return *linear;
+  return boost::get<RadialGradient>(gradient);
+}
+
+// Parses gradients with attributes and stops inherited via xlink:href. 
+// Parsed gradients are cached, so each is parsed once per document, or once per viewport size 
+// if it uses userSpaceOnUse units
 class Gradients
 {
 public:
   Gradients(XMLDocument & xml_document)
     : xml_document_(xml_document)
+    , next_key_(1)
   {}
 
-  boost::optional<Gradient> get(
+  // Returned reference is valid until the next call.
+  // 'viewport_dependent' is set if result depends on the viewport of 'length_factory'
+  boost::optional<Gradient> const & get(
     svg_string_t const & id, 
-    length_factory_t const &/*, 
-    get_bounding_box_func_t const & get_bounding_box*/);
+    length_factory_t const & length_factory/*, 
+    get_bounding_box_func_t const & get_bounding_box*/,
+    bool * viewport_dependent = NULL);
 
 private:
+  struct CachedGradient
+  {
+    boost::optional<Gradient> gradient_;
+    bool viewportDependent_;
+    number_t viewportWidth_, viewportHeight_;
+  };
+
   XMLDocument & xml_document_;
+  std::map<svg_string_t, std::vector<CachedGradient> > cache_;
+  std::set<svg_string_t> loading_; // To detect xlink:href loops
+  unsigned next_key_;
+
+  void load(svg_string_t const & id, length_factory_t const & length_factory, CachedGradient & result);
 };
@@ -0,0 +1,141 @@
+#include "gradient_span.hpp"
+
+#include <svgpp/utility/gil/simd.hpp>
+
+namespace gradient_span
+{
+
+#if defined(SVGPP_GIL_SIMD)
+
+namespace sse2
+{
+  typedef __m128 vec;
+
+  static const unsigned vec_width = 4;
+
+  inline vec vset1(float value) { return _mm_set1_ps(value); }
+  inline vec vramp() { return _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f); }
+  inline vec vadd(vec a, vec b) { return _mm_add_ps(a, b); }
+  inline vec vsub(vec a, vec b) { return _mm_sub_ps(a, b); }
+  inline vec vmul(vec a, vec b) { return _mm_mul_ps(a, b); }
+  inline vec vand(vec a, vec b) { return _mm_and_ps(a, b); }
+  inline vec vmin(vec a, vec b) { return _mm_min_ps(a, b); }
+  inline vec vmax(vec a, vec b) { return _mm_max_ps(a, b); }
+  inline vec vsqrt(vec a) { return _mm_sqrt_ps(a); }
+  inline vec vabs(vec a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+  // All ones in lanes where a > b
+  inline vec vgreater(vec a, vec b) { return _mm_cmpgt_ps(a, b); }
+  // Rounded toward zero, as float(int(a)) does
+  inline vec vtrunc(vec a) { return _mm_cvtepi32_ps(_mm_cvttps_epi32(a)); }
+  inline vec vload(float const * src) { return _mm_loadu_ps(src); }
+  inline void vstore(float * dst, vec a) { _mm_storeu_ps(dst, a); }
+  inline void vstore_trunc(unsigned * dst, vec a)
+  {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst), _mm_cvttps_epi32(a));
+  }
+
+#include "gradient_span_kernels.inc"
+}
+
+#if defined(SVGPP_GIL_SIMD_AVX2)
+
+#if defined(__clang__)
+# pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+# pragma GCC push_options
+# pragma GCC target("avx2")
+#endif
+
+namespace avx2
+{
+  typedef __m256 vec;
+
+  static const unsigned vec_width = 8;
+
+  inline vec vset1(float value) { return _mm256_set1_ps(value); }
+  inline vec vramp() { return _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f); }
+  inline vec vadd(vec a, vec b) { return _mm256_add_ps(a, b); }
+  inline vec vsub(vec a, vec b) { return _mm256_sub_ps(a, b); }
+  inline vec vmul(vec a, vec b) { return _mm256_mul_ps(a, b); }
+  inline vec vand(vec a, vec b) { return _mm256_and_ps(a, b); }
+  inline vec vmin(vec a, vec b) { return _mm256_min_ps(a, b); }
+  inline vec vmax(vec a, vec b) { return _mm256_max_ps(a, b); }
+  inline vec vsqrt(vec a) { return _mm256_sqrt_ps(a); }
+  inline vec vabs(vec a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+  inline vec vgreater(vec a, vec b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+  inline vec vtrunc(vec a) { return _mm256_cvtepi32_ps(_mm256_cvttps_epi32(a)); }
+  inline vec vload(float const * src) { return _mm256_loadu_ps(src); }
+  inline void vstore(float * dst, vec a) { _mm256_storeu_ps(dst, a); }
+  inline void vstore_trunc(unsigned * dst, vec a)
+  {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst), _mm256_cvttps_epi32(a));
+  }
+
+#include "gradient_span_kernels.inc"
+}
+
+#if defined(__clang__)
+# pragma clang attribute pop
+#elif defined(__GNUC__)
+# pragma GCC pop_options
+#endif
+
+#endif // defined(SVGPP_GIL_SIMD_AVX2)
+
+#endif // defined(SVGPP_GIL_SIMD)
+
+void LinearShape::calculate(float x, float /*y*/, float dx, float /*dy*/, unsigned count, float * t) const
+{
+  unsigned i = 0;
+#if defined(SVGPP_GIL_SIMD_AVX2)
+  if (svgpp::gil_detail::simd::use_avx2())
+    i = avx2::linearParameters(x, dx, count, t);
+  else
+#endif
+#if defined(SVGPP_GIL_SIMD)
+    i = sse2::linearParameters(x, dx, count, t);
+#endif
+  for(; i < count; ++i)
+    t[i] = x + dx * float(i);
+}
+
+void RadialShape::calculate(float x, float y, float dx, float dy, unsigned count, float * t) const
+{
+  unsigned i = 0;
+#if defined(SVGPP_GIL_SIMD_AVX2)
+  if (svgpp::gil_detail::simd::use_avx2())
+    i = avx2::radialParameters(coefficients_, x, y, dx, dy, count, t);
+  else
+#endif
+#if defined(SVGPP_GIL_SIMD)
+    i = sse2::radialParameters(coefficients_, x, y, dx, dy, count, t);
+#endif
+  for(; i < count; ++i)
+    t[i] = coefficients_.parameter(x + dx * float(i), y + dy * float(i));
+}
+
+template<class Spread>
+void colorIndices(float const * t, unsigned count, float scale, unsigned * index)
+{
+  unsigned i = 0;
+#if defined(SVGPP_GIL_SIMD_AVX2)
+  if (svgpp::gil_detail::simd::use_avx2())
+    i = avx2::colorIndices<Spread>(t, count, scale, index);
+  else
+#endif
+#if defined(SVGPP_GIL_SIMD)
+    i = sse2::colorIndices<Spread>(t, count, scale, index);
+#endif
+  for(; i < count; ++i)
+  {
+    float const v = Spread::apply(t[i]);
+    // Written so that NaN from degenerate transforms gives 0
+    index[i] = unsigned((v > 0 ? (v < 1 ? v : 1) : 0) * scale + 0.5f);
+  }
+}
+
+template void colorIndices<Pad>(float const *, unsigned, float, unsigned *);
+template void colorIndices<Repeat>(float const *, unsigned, float, unsigned *);
+template void colorIndices<Reflect>(float const *, unsigned, float, unsigned *);
+
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <agg_basics.h>
+#include <agg_color_rgba.h>
+#include <agg_trans_affine.h>
+#include <algorithm>
+#include <cmath>
+
+// Span generators for agg::render_scanlines_aa that paint gradients.
+// Gradient shape and spread method are template parameters, so inner loops have no branches. 
+// Gradient parameter and color table index are calculated for a block of pixels with single
+// precision by SSE2 or AVX2 kernels from gradient_span.cpp (chosen at runtime), then colors
+// are looked up in the table
+namespace gradient_span
+{
+  static const unsigned block_size = 64;
+
+  inline float floorFast(float v)
+  {
+    // Out of range values are clamped, their fractional part is lost anyway
+    v = v > -1e7f ? (v < 1e7f ? v : 1e7f) : -1e7f;
+    float const truncated = float(int(v));
+    return truncated > v ? truncated - 1 : truncated;
+  }
+
+  // Parameter is x coordinate in gradient space
+  class LinearShape
+  {
+  public:
+    // Parameters for 'count' pixels starting at (x, y) with (dx, dy) step in gradient space
+    void calculate(float x, float y, float dx, float dy, unsigned count, float * t) const;
+  };
+
+  // Focus position (fx, fy), 1 - fx^2 - fy^2 and its inverse
+  struct RadialCoefficients
+  {
+    float fx_, fy_, one_minus_f2_, inv_one_minus_f2_;
+
+    float parameter(float x, float y) const
+    {
+      float const px = x - fx_, py = y - fy_;
+      float const fp = fx_ * px + fy_ * py;
+      float const p2 = px * px + py * py;
+      return (fp + std::sqrt(fp * fp + p2 * one_minus_f2_)) * inv_one_minus_f2_;
+    }
+  };
+
+  // Parameter is distance to the focus relative to the distance from focus to the circle in 
+  // the same direction. Circle has center at origin and radius 1
+  class RadialShape
+  {
+  public:
+    RadialShape(double fx, double fy)
+    {
+      double const length = std::sqrt(fx * fx + fy * fy);
+      // Focus must be inside of the circle
+      if (length > 0.99)
+      {
+        fx *= 0.99 / length;
+        fy *= 0.99 / length;
+      }
+      coefficients_.fx_ = float(fx);
+      coefficients_.fy_ = float(fy);
+      coefficients_.one_minus_f2_ = float(1 - fx * fx - fy * fy);
+      coefficients_.inv_one_minus_f2_ = float(1 / (1 - fx * fx - fy * fy));
+    }
+
+    void calculate(float x, float y, float dx, float dy, unsigned count, float * t) const;
+
+  private:
+    RadialCoefficients coefficients_;
+  };
+
+  struct Pad
+  {
+    static float apply(float t) { return t; } // Clamped by generator
+  };
+
+  struct Repeat
+  {
+    static float apply(float t) { return t - floorFast(t); }
+  };
+
+  struct Reflect
+  {
+    static float apply(float t) 
+    { 
+      float const half = t * 0.5f;
+      return 1.0f - std::abs(1.0f - 2.0f * (half - floorFast(half)));
+    }
+  };
+
+  // index[i] = Spread::apply(t[i]) clamped to [0, 1] and multiplied by 'scale', rounded.
+  // Instantiated for Pad, Repeat and Reflect
+  template<class Spread>
+  void colorIndices(float const * t, unsigned count, float scale, unsigned * index);
+
+  // ColorLUT provides static size() and operator[], color at index i corresponds to 
+  // parameter value i / (size() - 1)
+  template<class ColorLUT, class Shape, class Spread>
+  class Generator
+  {
+  public:
+    typedef agg::rgba8 color_type;
+
+    Generator(ColorLUT const & colors, Shape const & shape, agg::trans_affine const & device_to_gradient)
+      : colors_(colors)
+      , shape_(shape)
+      , device_to_gradient_(device_to_gradient)
+    {}
+
+    void prepare() 
+    {}
+
+    void generate(color_type * span, int x, int y, unsigned len)
+    {
+      // Pixel centers are sampled
+      double gx = x + 0.5, gy = y + 0.5;
+      device_to_gradient_.transform(&gx, &gy);
+      double const dx = device_to_gradient_.sx, dy = device_to_gradient_.shy;
+      float const scale = float(ColorLUT::size() - 1);
+      float t[block_size];
+      unsigned index[block_size];
+      for(unsigned start = 0; start < len; start += block_size)
+      {
+        unsigned const count = std::min(len - start, block_size);
+        shape_.calculate(float(gx + dx * start), float(gy + dy * start), float(dx), float(dy), count, t);
+        colorIndices<Spread>(t, count, scale, index);
+        for(unsigned i = 0; i < count; ++i)
+          span[start + i] = colors_[index[i]];
+      }
+    }
+
+  private:
+    ColorLUT const & colors_;
+    Shape const shape_;
+    agg::trans_affine const device_to_gradient_;
+  };
+}
@@ -0,0 +1,67 @@
+#include "layer_pool.hpp"
+
+#include <cstring>
+
+LayerPool::LayerPool(std::size_t max_retained_bytes)
+  : max_retained_bytes_(max_retained_bytes)
+  , retained_bytes_(0)
+{}
+
+// Four classes per power of two, so that no more than 25% of storage is wasted
+std::size_t LayerPool::classIndex(std::size_t size)
+{
+  std::size_t index = 0;
+  while (classSize(index) < size)
+    ++index;
+  return index;
+}
+
+std::size_t LayerPool::classSize(std::size_t index)
+{
+  return (min_class_size << (index / 4)) / 4 * (4 + index % 4);
+}
+
+void LayerPool::acquire(std::size_t size, std::vector<unsigned char> & storage)
+{
+  std::size_t const index = classIndex(size);
+  Entry entry;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index < classes_.size() && !classes_[index].empty())
+    {
+      // Most recently released storage is more likely to be in cache
+      entry.storage.swap(classes_[index].back().storage);
+      entry.dirty = classes_[index].back().dirty;
+      classes_[index].pop_back();
+      retained_bytes_ -= entry.storage.size();
+    }
+  }
+  if (entry.storage.empty())
+  {
+    std::vector<unsigned char>(classSize(index), 0).swap(storage);
+    return;
+  }
+  for(std::size_t row = 0; row < entry.dirty.rows; ++row)
+    std::memset(&entry.storage[entry.dirty.offset + row * entry.dirty.stride], 0, entry.dirty.row_bytes);
+  storage.swap(entry.storage);
+}
+
+void LayerPool::release(std::vector<unsigned char> & storage, DirtyRegion const & dirty)
+{
+  Entry entry;
+  entry.storage.swap(storage);
+  entry.dirty = dirty;
+  std::size_t const index = classIndex(entry.storage.size());
+  // Storage that wasn't allocated by the pool isn't retained
+  if (classSize(index) != entry.storage.size())
+    return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (retained_bytes_ + entry.storage.size() > max_retained_bytes_)
+    return;
+  retained_bytes_ += entry.storage.size();
+  if (classes_.size() <= index)
+    classes_.resize(index + 1);
+  classes_[index].push_back(Entry());
+  classes_[index].back().storage.swap(entry.storage);
+  classes_[index].back().dirty = entry.dirty;
+}
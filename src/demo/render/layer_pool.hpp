@@ -0,0 +1,47 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Recycles pixel storage of layers, so that each group with opacity, mask, clip path or filter
+// doesn't allocate and zero-fill fresh memory.
+// Storage is grouped by size classes. Released storage remembers which bytes were written, 
+// and only those are cleared when the storage is handed out again.
+// May be used from both traversal and rendering threads.
+class LayerPool: boost::noncopyable
+{
+public:
+  // Part of storage that may contain non-zero bytes: 'rows' rows of 'row_bytes' bytes,
+  // first one starting at 'offset', each next 'stride' bytes further
+  struct DirtyRegion
+  {
+    std::size_t offset, stride, row_bytes, rows;
+  };
+
+  // Storage exceeding 'max_retained_bytes' in total is freed on release
+  explicit LayerPool(std::size_t max_retained_bytes = 256 << 20);
+
+  // Replaces content of 'storage' with zero-filled storage at least 'size' bytes long
+  void acquire(std::size_t size, std::vector<unsigned char> & storage);
+  // Takes storage from 'storage', leaving it empty
+  void release(std::vector<unsigned char> & storage, DirtyRegion const & dirty);
+
+private:
+  static const std::size_t min_class_size = 4096;
+
+  struct Entry
+  {
+    std::vector<unsigned char> storage;
+    DirtyRegion dirty;
+  };
+
+  std::size_t const max_retained_bytes_;
+  std::size_t retained_bytes_;
+  std::vector<std::vector<Entry> > classes_; // Released storage by size class index
+  std::mutex mutex_;
+
+  static std::size_t classIndex(std::size_t size);
+  static std::size_t classSize(std::size_t index);
+};
@@ -0,0 +1,90 @@
+#include "render_pipeline.hpp"
+
+RenderPipeline::RenderPipeline(std::size_t capacity)
+  : queue_(capacity)
+  , submitted_(0)
+  , executed_(0)
+  , stop_(false)
+{
+  consumer_ = std::thread(&RenderPipeline::consume, this);
+}
+
+RenderPipeline::~RenderPipeline()
+{
+  wait();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  consumer_wakeup_.notify_one();
+  consumer_.join();
+}
+
+void RenderPipeline::submit(DrawCommandPtr command)
+{
+  for(std::size_t executed = executed_.load(); !queue_.tryPush(command); executed = executed_.load())
+  {
+    // Queue is full. Slot is freed before the consumer increments executed_
+    std::unique_lock<std::mutex> lock(mutex_);
+    producer_wakeup_.wait(lock, [this, executed] { return executed_.load() != executed; });
+  }
+  ++submitted_;
+  if (executed_.load() + 1 == submitted_)
+  {
+    // Queue was empty, consumer may be sleeping
+    std::lock_guard<std::mutex> lock(mutex_);
+    consumer_wakeup_.notify_one();
+  }
+}
+
+void RenderPipeline::flush()
+{
+  wait();
+  if (error_)
+  {
+    std::exception_ptr error = error_;
+    error_ = std::exception_ptr();
+    std::rethrow_exception(error);
+  }
+}
+
+void RenderPipeline::wait()
+{
+  if (executed_.load() == submitted_)
+    return;
+  std::unique_lock<std::mutex> lock(mutex_);
+  producer_wakeup_.wait(lock, [this] { return executed_.load() == submitted_; });
+}
+
+void RenderPipeline::consume()
+{
+  DrawCommandPtr command;
+  for(;;)
+  {
+    if (!queue_.tryPop(command))
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      consumer_wakeup_.wait(lock, [this, &command] { return stop_ || queue_.tryPop(command); });
+      if (!command)
+        return;
+    }
+    // After error remaining commands are skipped until the producer calls flush()
+    if (!error_)
+    {
+      try
+      {
+        command->execute();
+      }
+      catch(...)
+      {
+        error_ = std::current_exception();
+      }
+    }
+    command.reset();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++executed_;
+    }
+    producer_wakeup_.notify_one();
+  }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <boost/noncopyable.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class DrawCommand
+{
+public:
+  virtual ~DrawCommand() {}
+
+  virtual void execute() = 0;
+};
+
+typedef std::unique_ptr<DrawCommand> DrawCommandPtr;
+
+// Bounded lock-free queue for exactly one producer and one consumer thread
+template<class T>
+class SpscRingBuffer: boost::noncopyable
+{
+public:
+  explicit SpscRingBuffer(std::size_t capacity)
+    : slots_(capacity + 1)
+    , head_(0)
+    , tail_(0)
+  {}
+
+  // Returns false if queue is full
+  bool tryPush(T & value)
+  {
+    std::size_t const tail = tail_.load(std::memory_order_relaxed);
+    std::size_t const next = increment(tail);
+    if (next == head_.load(std::memory_order_acquire))
+      return false;
+    slots_[tail] = std::move(value);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Returns false if queue is empty
+  bool tryPop(T & value)
+  {
+    std::size_t const head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+      return false;
+    value = std::move(slots_[head]);
+    head_.store(increment(head), std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::vector<T> slots_;
+  // head_ is written only by consumer, tail_ only by producer
+  alignas(64) std::atomic<std::size_t> head_;
+  alignas(64) std::atomic<std::size_t> tail_;
+
+  std::size_t increment(std::size_t index) const
+  {
+    return index + 1 == slots_.size() ? 0 : index + 1;
+  }
+};
+
+// Executes draw commands in order of submission on a separate thread, so that
+// document traversal and rasterization overlap.
+// Producer must call flush() before accessing pixels that submitted commands may write.
+class RenderPipeline: boost::noncopyable
+{
+public:
+  explicit RenderPipeline(std::size_t capacity = 256);
+  ~RenderPipeline();
+
+  void submit(DrawCommandPtr command);
+
+  // Waits until all submitted commands are executed. Rethrows exception thrown by a command
+  void flush();
+
+  // Same as flush(), but doesn't throw. For use in destructors
+  void wait();
+
+private:
+  SpscRingBuffer<DrawCommandPtr> queue_;
+  std::size_t submitted_; // Accessed by producer only
+  std::atomic<std::size_t> executed_;
+  std::atomic<bool> stop_;
+  std::exception_ptr error_;
+  // Used for sleeping when queue is empty (consumer) or full and when waiting for the queue
+  // to drain (producer)
+  std::mutex mutex_;
+  std::condition_variable consumer_wakeup_, producer_wakeup_;
+  std::thread consumer_;
+
+  void consume();
+};
@@ -17,6 +17,8 @@ struct IRIPaint
 };
 typedef boost::variant<SolidPaint, IRIPaint> Paint;
 
+enum TextAnchor { textAnchorStart, textAnchorMiddle, textAnchorEnd };
+
 struct InheritedStyle
 {
   InheritedStyle()
@@ -38,6 +40,8 @@ struct InheritedStyle
     , miterlimit_(4.0)
     , stroke_dashoffset_(0)
 #endif
+    , font_size_(16)
+    , text_anchor_(textAnchorStart)
   {
 #if defined(RENDERER_SKIA)
     skPaintStroke_.setAntiAlias(true);
@@ -69,6 +73,9 @@ struct InheritedStyle
   std::vector<number_t> stroke_dasharray_;
   number_t stroke_dashoffset_;
   boost::optional<svg_string_t> marker_start_, marker_mid_, marker_end_;
+  number_t font_size_;
+  boost::optional<svg_string_t> font_family_;
+  TextAnchor text_anchor_;
 };
 
 struct NoninheritedStyle
@@ -415,6 +422,56 @@ public:
   void set(svgpp::tag::attribute::overflow, svgpp::tag::value::scroll)
   { style().overflow_clip_ = true; }
 
+  void set(svgpp::tag::attribute::font_size, number_t val)
+  { style().font_size_ = val; }
+
+  void set(svgpp::tag::attribute::font_size, svgpp::tag::value::inherit)
+  {}
+
+  // Absolute size keywords as in CSS for 'medium' = 16px
+  void set(svgpp::tag::attribute::font_size, svgpp::tag::value::xx_small)
+  { style().font_size_ = 9; }
+
+  void set(svgpp::tag::attribute::font_size, svgpp::tag::value::x_small)
+  { style().font_size_ = 10; }
+
+  void set(svgpp::tag::attribute::font_size, svgpp::tag::value::small)
+  { style().font_size_ = 13; }
+
+  void set(svgpp::tag::attribute::font_size, svgpp::tag::value::medium)
+  { style().font_size_ = 16; }
+
+  void set(svgpp::tag::attribute::font_size, svgpp::tag::value::large)
+  { style().font_size_ = 18; }
+
+  void set(svgpp::tag::attribute::font_size, svgpp::tag::value::x_large)
+  { style().font_size_ = 24; }
+
+  void set(svgpp::tag::attribute::font_size, svgpp::tag::value::xx_large)
+  { style().font_size_ = 32; }
+
+  void set(svgpp::tag::attribute::font_size, svgpp::tag::value::larger)
+  { style().font_size_ *= 1.2; }
+
+  void set(svgpp::tag::attribute::font_size, svgpp::tag::value::smaller)
+  { style().font_size_ /= 1.2; }
+
+  template<class Range>
+  void set(svgpp::tag::attribute::font_family, Range const & range)
+  { style().font_family_ = svg_string_t(boost::begin(range), boost::end(range)); }
+
+  void set(svgpp::tag::attribute::text_anchor, svgpp::tag::value::start)
+  { style().text_anchor_ = textAnchorStart; }
+
+  void set(svgpp::tag::attribute::text_anchor, svgpp::tag::value::middle)
+  { style().text_anchor_ = textAnchorMiddle; }
+
+  void set(svgpp::tag::attribute::text_anchor, svgpp::tag::value::end)
+  { style().text_anchor_ = textAnchorEnd; }
+
+  void set(svgpp::tag::attribute::text_anchor, svgpp::tag::value::inherit)
+  {}
+
 private:
   Style style_;
   NoninheritedStyle parentStyle_;
@@ -12,6 +12,7 @@
 #include <boost/mpl/transform_view.hpp>
 #include <boost/optional.hpp>
 #include <boost/scope_exit.hpp>
+#include <boost/type_traits/make_unsigned.hpp>
 
 #if defined(RENDERER_AGG)
 #include <agg_bounding_rect.h>
@@ -29,8 +30,6 @@
 #include <agg_path_storage.h>
 #include <agg_pixfmt_amask_adaptor.h>
 #include <agg_span_allocator.h>
-#include <agg_span_gradient.h>
-#include <agg_span_interpolator_linear.h>
 #include <stb/stb_image_write.h>
 #elif defined(RENDERER_SKIA)
 #include <SkBitmap.h>
@@ -42,6 +41,7 @@
 #include <images/SkForceLinking.h>
 #endif
 
+#include <cstring>
 #include <map>
 #include <set>
 #include <fstream>
@@ -51,12 +51,18 @@
 #include "gradient.hpp"
 #include "clip_buffer.hpp"
 #include "filter.hpp"
+#include "render_pipeline.hpp"
+#if defined(RENDERER_AGG)
+#include "glyph_cache.hpp"
+#include "gradient_span.hpp"
+#include "layer_pool.hpp"
+#endif
 
 namespace boost {
   namespace mpl {
 
 #   define BOOST_PP_ITERATION_PARAMS_1 \
-    (3,(51, 60, <boost/mpl/set/aux_/numbered.hpp>))
+    (3,(51, 61, <boost/mpl/set/aux_/numbered.hpp>))
 #   include BOOST_PP_ITERATE()
 
   }
@@ -71,20 +77,55 @@ class Switch;
 class ReferencedSymbolOrSvg;
 class Mask;
 class Marker;
+class Text;
+#if defined(RENDERER_AGG)
+struct ColorFunctionProfile;
+#endif
 
 struct Document
 {
   class FollowRef;
 
-  Document(XMLDocument & xmlDocument)
+  Document(XMLDocument & xmlDocument, RenderPipeline * pipeline = NULL)
     : xml_document_(xmlDocument)
     , gradients_(xml_document_)
     , filters_(xml_document_)
+    , pipeline_(pipeline)
+#if defined(RENDERER_AGG)
+    , fonts_(NULL)
+    , missing_font_reported_(false)
+#endif
   {}
 
+  // Executes command immediately or passes it to the rendering thread in pipelined mode
+  void draw(DrawCommandPtr command)
+  {
+    if (pipeline_)
+      pipeline_->submit(std::move(command));
+    else
+      command->execute();
+  }
+
+  // Must be called before reading or writing pixels that submitted commands may write
+  void flushDrawing()
+  {
+    if (pipeline_)
+      pipeline_->flush();
+  }
+
   XMLDocument & xml_document_;
   Gradients gradients_;
   Filters filters_;
+  RenderPipeline * const pipeline_;
+#if defined(RENDERER_AGG)
+  FontSet const * fonts_; // Text isn't rendered if NULL or empty
+  bool missing_font_reported_;
+  GlyphCache glyph_cache_; // Used by draw commands only
+  LayerPool layer_pool_;
+  // Color lookup tables by gradient key and opacity. Used by draw commands only
+  typedef std::map<std::pair<unsigned, number_t>, boost::shared_ptr<ColorFunctionProfile const> > gradient_colors_t;
+  gradient_colors_t gradient_colors_;
+#endif
   typedef std::set<XMLElement> followed_refs_t;
   followed_refs_t followed_refs_;
 };
@@ -178,6 +219,21 @@ struct child_context_factories::apply<Canvas, ElementTag, typename boost::enable
   typedef svgpp::factory::context::on_stack<Path> type;
 };
 
+#if defined(RENDERER_AGG)
+template<>
+struct child_context_factories::apply<Canvas, svgpp::tag::element::text, void>
+{
+  typedef svgpp::factory::context::on_stack<Text> type;
+};
+
+// 'tspan' and 'a' inside 'text'
+template<class ElementTag>
+struct child_context_factories::apply<Text, ElementTag, void>
+{
+  typedef svgpp::factory::context::on_stack<Text> type;
+};
+#endif
+
 // Elements referenced by 'use' element
 template<>
 struct child_context_factories::apply<Use, svgpp::tag::element::svg, void>
@@ -223,11 +279,15 @@ struct processed_elements
       svgpp::tag::element::ellipse,
       svgpp::tag::element::polyline,
       svgpp::tag::element::polygon
+#if defined(RENDERER_AGG)
+      , svgpp::tag::element::text
+      , svgpp::tag::element::tspan
+#endif
     >
 {};
 
 struct processed_attributes
-  : boost::mpl::set58<
+  : boost::mpl::set61<
     // svgpp::traits::shapes_attributes_by_element
     boost::mpl::pair<svgpp::tag::element::path, svgpp::tag::attribute::d>,
     boost::mpl::pair<svgpp::tag::element::rect, svgpp::tag::attribute::x>,
@@ -288,6 +348,9 @@ struct processed_attributes
     svgpp::tag::attribute::opacity,
     svgpp::tag::attribute::orient,
     svgpp::tag::attribute::overflow,
+    svgpp::tag::attribute::font_size,
+    svgpp::tag::attribute::font_family,
+    svgpp::tag::attribute::text_anchor,
     boost::mpl::pair<svgpp::tag::element::use_, svgpp::tag::attribute::xlink::href>
   >
 {};
@@ -301,17 +364,64 @@ class ImageBuffer: boost::noncopyable
 {
 public:
   ImageBuffer()
+#if defined(RENDERER_AGG)
+    : x_(0)
+    , y_(0)
+    , limit_(0, 0, -1, -1)
+    , dirty_(0, 0, -1, -1)
+    , pool_(NULL)
+  {
+    pixfmt_.attach(rbuf_);
+  }
+#else
   {}
+#endif
 
   ImageBuffer(int width, int height)
+#if defined(RENDERER_AGG)
+    : pool_(NULL)
+#endif
   {
     setSize(width, height, TransparentBlackColor());
   }
 
 #if defined(RENDERER_AGG)
+  // Layer that initially has no pixels and grows to cover the parts of 'limit' rectangle 
+  // that are drawn to. Pixels are stored in memory taken from 'pool'
+  ImageBuffer(agg::rect_i const & limit, LayerPool & pool)
+    : x_(limit.x1)
+    , y_(limit.y1)
+    , limit_(limit)
+    , dirty_(0, 0, -1, -1)
+    , pool_(&pool)
+  {
+    pixfmt_.attach(rbuf_);
+  }
+
+  ~ImageBuffer()
+  {
+    if (pool_ && !buffer_.empty())
+      pool_->release(buffer_, dirtyRegion());
+  }
+
   int width() const { return pixfmt_.width(); }
   int height() const { return pixfmt_.height(); }
   pixfmt_t & pixfmt() { return pixfmt_; }
+
+  // Position of the buffer relative to the topmost buffer
+  int x() const { return x_; }
+  int y() const { return y_; }
+  agg::rect_i rect() const { return agg::rect_i(x_, y_, x_ + width() - 1, y_ + height() - 1); }
+  agg::rect_i const & limit() const { return limit_; }
+  // Union of rectangles passed to cover(), invalid if there were none
+  agg::rect_i const & dirty() const { return dirty_; }
+
+  // Reallocates the buffer if needed, so that it covers 'rect' clipped by limit. 
+  // Pixels drawn before are preserved. Pixels outside of the rectangles passed to cover()
+  // must not be modified
+  void cover(agg::rect_i const & rect);
+  // Makes all pixels transparent black, keeping the buffer
+  void clear();
 #elif defined(RENDERER_GDIPLUS)
   int width() const { return bitmap_->GetWidth(); }
   int height() const { return bitmap_->GetHeight(); }
@@ -322,6 +432,12 @@ public:
   SkBitmap & bitmap() { return bitmap_; }
 #endif
 
+#if !defined(RENDERER_AGG)
+  // Layers always have size of the topmost buffer
+  int x() const { return 0; }
+  int y() const { return 0; }
+#endif
+
 #if defined(RENDERER_SKIA)
   bool isSizeSet() const { return !bitmap_.empty(); }
 #else
@@ -335,6 +451,9 @@ public:
     buffer_.resize(width * height * pixfmt_t::pix_width);
     rbuf_.attach(&buffer_[0], width, height, width * pixfmt_t::pix_width);
     pixfmt_.attach(rbuf_);
+    x_ = y_ = 0;
+    limit_ = rect();
+    dirty_ = rect();
     agg::renderer_base<pixfmt_t> renderer_base(pixfmt_);
     renderer_base.clear(fill_color);
 #elif defined(RENDERER_GDIPLUS)
@@ -366,6 +485,12 @@ private:
   std::vector<unsigned char> buffer_;
   agg::rendering_buffer rbuf_;
   pixfmt_t pixfmt_;
+  int x_, y_;
+  agg::rect_i limit_;
+  agg::rect_i dirty_; // Union of rectangles passed to cover()
+  LayerPool * const pool_;
+
+  LayerPool::DirtyRegion dirtyRegion() const;
 #elif defined(RENDERER_GDIPLUS)
   std::vector<BYTE> buffer_;
   std::unique_ptr<Gdiplus::Bitmap> bitmap_;
@@ -374,6 +499,80 @@ private:
 #endif
 };
 
+#if defined(RENDERER_AGG)
+void ImageBuffer::cover(agg::rect_i const & rect)
+{
+  agg::rect_i required = agg::intersect_rectangles(rect, limit_);
+  if (!required.is_valid())
+    return;
+  agg::rect_i const drawn = required;
+  if (isSizeSet())
+  {
+    agg::rect_i const current = this->rect();
+    if (required.x1 >= current.x1 && required.y1 >= current.y1 
+      && required.x2 <= current.x2 && required.y2 <= current.y2)
+    {
+      dirty_ = dirty_.is_valid() ? agg::unite_rectangles(dirty_, drawn) : drawn;
+      return;
+    }
+    required = agg::unite_rectangles(required, current);
+    // Reserve space in the direction of growth, so that series of small 
+    // adjacent shapes doesn't reallocate buffer each time
+    int const margin_x = (required.x2 - required.x1) / 2, margin_y = (required.y2 - required.y1) / 2;
+    if (required.x1 < current.x1) required.x1 -= margin_x;
+    if (required.y1 < current.y1) required.y1 -= margin_y;
+    if (required.x2 > current.x2) required.x2 += margin_x;
+    if (required.y2 > current.y2) required.y2 += margin_y;
+    required = agg::intersect_rectangles(required, limit_);
+  }
+
+  int const width = required.x2 - required.x1 + 1, height = required.y2 - required.y1 + 1;
+  int const stride = width * pixfmt_t::pix_width;
+  // Zero bytes are transparent black
+  std::vector<unsigned char> buffer;
+  if (pool_)
+    pool_->acquire(stride * height, buffer);
+  else
+    buffer.assign(stride * height, 0);
+  // Only the dirty part of the old buffer may have non-zero pixels
+  LayerPool::DirtyRegion const old_dirty = dirtyRegion();
+  agg::rect_i const copied = agg::intersect_rectangles(dirty_, this->rect());
+  if (old_dirty.rows != 0)
+    for(int y = copied.y1; y <= copied.y2; ++y)
+      std::memcpy(&buffer[(y - required.y1) * stride + (copied.x1 - required.x1) * pixfmt_t::pix_width],
+        rbuf_.row_ptr(y - y_) + (copied.x1 - x_) * pixfmt_t::pix_width, old_dirty.row_bytes);
+  buffer_.swap(buffer);
+  if (pool_ && !buffer.empty())
+    pool_->release(buffer, old_dirty);
+  x_ = required.x1;
+  y_ = required.y1;
+  rbuf_.attach(&buffer_[0], width, height, stride);
+  pixfmt_.attach(rbuf_);
+  dirty_ = dirty_.is_valid() ? agg::unite_rectangles(dirty_, drawn) : drawn;
+}
+
+void ImageBuffer::clear()
+{
+  LayerPool::DirtyRegion const region = dirtyRegion();
+  for(std::size_t row = 0; row < region.rows; ++row)
+    std::memset(&buffer_[region.offset + row * region.stride], 0, region.row_bytes);
+  dirty_ = agg::rect_i(0, 0, -1, -1);
+}
+
+LayerPool::DirtyRegion ImageBuffer::dirtyRegion() const
+{
+  LayerPool::DirtyRegion region = { 0, std::size_t(pixfmt_.stride()), 0, 0 };
+  agg::rect_i const dirty = agg::intersect_rectangles(dirty_, rect());
+  if (!buffer_.empty() && dirty_.is_valid() && dirty.is_valid())
+  {
+    region.offset = (dirty.y1 - y_) * region.stride + (dirty.x1 - x_) * pixfmt_t::pix_width;
+    region.row_bytes = (dirty.x2 - dirty.x1 + 1) * pixfmt_t::pix_width;
+    region.rows = dirty.y2 - dirty.y1 + 1;
+  }
+  return region;
+}
+#endif
+
 class Transformable
 {
 public:
@@ -482,6 +681,8 @@ namespace
   }
 }
 
+typedef boost::variant<svgpp::tag::value::none, color_t, Gradient> EffectivePaint;
+
 class Canvas: 
   public Stylable,
   public Transformable
@@ -494,9 +695,15 @@ public:
     , parent_buffer_(boost::bind(&Canvas::getPassedImageBuffer, this))
     , image_buffer_(&image_buffer)
     , rendering_disabled_(false)
+#if defined(RENDERER_AGG)
+    , bounds_parent_(NULL)
+    , object_bounds_(0, 0, -1, -1)
+#endif
   {
+    // Clip buffer is in coordinates of the topmost buffer
     if (image_buffer.isSizeSet())
-      clip_buffer_.reset(new ClipBuffer(image_buffer_->width(), image_buffer_->height()));
+      clip_buffer_.reset(new ClipBuffer(image_buffer_->x() + image_buffer_->width(), 
+        image_buffer_->y() + image_buffer_->height()));
   }
 
   Canvas(Canvas & parent)
@@ -508,6 +715,10 @@ public:
     , length_factory_(parent.length_factory_)
     , clip_buffer_(parent.clip_buffer_)
     , rendering_disabled_(false)
+#if defined(RENDERER_AGG)
+    , bounds_parent_(&parent)
+    , object_bounds_(0, 0, -1, -1)
+#endif
   {}
 
   Canvas(Canvas & parent, dontInheritStyle)
@@ -518,12 +729,27 @@ public:
     , length_factory_(parent.length_factory_)
     , clip_buffer_(parent.clip_buffer_)
     , rendering_disabled_(false)
+#if defined(RENDERER_AGG)
+    , bounds_parent_(&parent)
+    , object_bounds_(0, 0, -1, -1)
+#endif
   {}
 
+  ~Canvas()
+  {
+    // Commands drawing to own buffer or to buffer passed to topmost canvas may be still queued
+    // if traversal was interrupted by exception
+    if ((own_buffer_.get() || image_buffer_) && document_.pipeline_)
+      document_.pipeline_->wait();
+  }
+
   void on_exit_element()
   {
     if (!own_buffer_.get())
       return;
+    document_.flushDrawing();
+    if (!own_buffer_->isSizeSet())
+      return; // Nothing was drawn
     applyFilter();
 
     if (style().clip_path_fragment_)
@@ -534,13 +760,20 @@ public:
     }
 
     if (clip_buffer_)
-      blend_image_with_mask(own_buffer_->gilView(), clip_buffer_->gilView());
+      clip_buffer_->apply(own_buffer_->gilView(), own_buffer_->x(), own_buffer_->y());
 
     if (style().mask_fragment_)
     {
+#if defined(RENDERER_AGG)
+      // Mask is needed only where layer has pixels
+      ImageBuffer mask_buffer(own_buffer_->rect(), document_.layer_pool_);
+      mask_buffer.cover(own_buffer_->rect());
+#else
       ImageBuffer & parent_buffer = parent_buffer_();
       ImageBuffer mask_buffer(parent_buffer.width(), parent_buffer.height());
+#endif
       loadMask(mask_buffer);
+      document_.flushDrawing();
       typedef boost::gil::color_converted_view_type<
         boost::gil::rgba8_view_t, 
         boost::gil::gray8_pixel_t, 
@@ -552,8 +785,12 @@ public:
       blend_image_with_mask(own_buffer_->gilView(), mask_view);
     }
 #if defined(RENDERER_AGG)
-    agg::renderer_base<pixfmt_t> renderer_base(parent_buffer_().pixfmt());
-    renderer_base.blend_from(own_buffer_->pixfmt(), NULL, 0, 0, unsigned(style().opacity_ * 255));
+    ImageBuffer & parent_buffer = parent_buffer_();
+    parent_buffer.cover(own_buffer_->rect());
+    agg::renderer_base<pixfmt_t> renderer_base(parent_buffer.pixfmt());
+    renderer_base.blend_from(own_buffer_->pixfmt(), NULL, 
+      own_buffer_->x() - parent_buffer.x(), own_buffer_->y() - parent_buffer.y(), 
+      unsigned(style().opacity_ * 255));
 #elif defined(RENDERER_GDIPLUS)
     {
       Gdiplus::ColorMatrix color_matrix[] = { 
@@ -619,6 +856,29 @@ public:
   length_factory_t const & length_factory() const
   { return length_factory_; }
 
+#if defined(RENDERER_AGG)
+  // Adds bounding box of the shape geometry to each canvas with a filter, from this one 
+  // up to the topmost, in its user space. 'shape_transform' maps shape coordinates to device
+  template<class VertexSource>
+  void addObjectBounds(VertexSource & shape, transform_t const & shape_transform)
+  {
+    for(Canvas * canvas = this; canvas; canvas = canvas->bounds_parent_)
+    {
+      if (!canvas->style().filter_)
+        continue;
+      transform_t to_canvas = shape_transform;
+      to_canvas *= ~canvas->transform();
+      agg::conv_transform<VertexSource> transformed(shape, to_canvas);
+      number_t x1, y1, x2, y2;
+      if (!agg::bounding_rect_single(transformed, 0, &x1, &y1, &x2, &y2))
+        continue;
+      agg::rect_d const bounds(x1, y1, x2, y2);
+      canvas->object_bounds_ = canvas->object_bounds_.is_valid() 
+        ? agg::unite_rectangles(canvas->object_bounds_, bounds) : bounds;
+    }
+  }
+#endif
+
 private:
   Document & document_;
   ImageBuffer * const image_buffer_; // Non-NULL only for topmost SVG element
@@ -627,12 +887,21 @@ private:
   boost::shared_ptr<ClipBuffer> clip_buffer_;
   length_factory_t length_factory_;
   bool rendering_disabled_;
+#if defined(RENDERER_AGG)
+  Canvas * bounds_parent_; // Receives object bounds of this canvas, NULL if they aren't passed up
+  agg::rect_d object_bounds_; // Geometry of descendants in user space, invalid if there were none
+#endif
 
   void loadMask(ImageBuffer &) const;
   void applyFilter();
   ImageBuffer & getPassedImageBuffer() { return *image_buffer_; }
 
 protected:
+#if defined(RENDERER_AGG)
+  // Markers aren't included in bounding box of the element
+  void excludeFromParentBounds() { bounds_parent_ = NULL; }
+#endif
+
   ImageBuffer & getImageBuffer()
   {
     ImageBuffer & parent_buffer = parent_buffer_();
@@ -643,7 +912,14 @@ protected:
       || style().filter_)
     {
       if (!own_buffer_.get())
+      {
+#if defined(RENDERER_AGG)
+        // Layer is allocated only for the area where children draw
+        own_buffer_.reset(new ImageBuffer(parent_buffer.limit(), document_.layer_pool_));
+#else
         own_buffer_.reset(new ImageBuffer(parent_buffer.width(), parent_buffer.height()));
+#endif
+      }
       return *own_buffer_;
     }
     return parent_buffer;
@@ -651,19 +927,23 @@ protected:
 
   Document & document() const { return document_; }
   ClipBuffer const & clipBuffer() const { return *clip_buffer_; }
+  EffectivePaint getEffectivePaint(Paint const &) const;
   virtual bool isSwitchElement() const { return false; }
 };
 
 struct SimpleFilterView: IFilterView
 {
-  SimpleFilterView(boost::gil::rgba8c_view_t const & v)
+  SimpleFilterView(boost::gil::rgba8c_view_t const & v, PixelRect const & region)
     : view_(v)
+    , region_(region)
   {}
 
   virtual boost::gil::rgba8c_view_t view() { return view_; }
+  virtual PixelRect region() const { return region_; }
 
 private:
   boost::gil::rgba8c_view_t view_;
+  PixelRect const region_;
 };
 
 void Canvas::applyFilter()
@@ -672,11 +952,60 @@ void Canvas::applyFilter()
     return;
 
   Filters::Input in;
-  in.sourceGraphic_ = IFilterViewPtr(new SimpleFilterView(own_buffer_->gilView()));
-  in.backgroundImage_ = IFilterViewPtr(new SimpleFilterView(parent_buffer_().gilView()));
+  PixelRect const layer(own_buffer_->x(), own_buffer_->y(), own_buffer_->width(), own_buffer_->height());
+#if defined(RENDERER_AGG)
+  transform().store_to(&in.transform_[0]);
+  agg::rect_i const drawn = own_buffer_->dirty();
+  in.drawn_ = PixelRect(drawn.x1, drawn.y1, drawn.x2 - drawn.x1 + 1, drawn.y2 - drawn.y1 + 1);
+  agg::rect_i const & limit = own_buffer_->limit();
+  in.limit_ = PixelRect(limit.x1, limit.y1, limit.x2 - limit.x1 + 1, limit.y2 - limit.y1 + 1);
+  if (object_bounds_.is_valid())
+  {
+    boost::array<number_t, 4> const bounds = { { object_bounds_.x1, object_bounds_.y1, 
+      object_bounds_.x2 - object_bounds_.x1, object_bounds_.y2 - object_bounds_.y1 } };
+    in.boundingBox_ = bounds;
+  }
+#else
+#if defined(RENDERER_GDIPLUS)
+  transform().GetElements(&in.transform_[0]);
+#elif defined(RENDERER_SKIA)
+  number_t const matrix[6] = { transform().getScaleX(), transform().getSkewY(), 
+    transform().getSkewX(), transform().getScaleY(), transform().getTranslateX(), transform().getTranslateY() };
+  std::copy(matrix, matrix + 6, in.transform_.begin());
+#endif
+  // Drawn area isn't tracked by other renderers
+  in.drawn_ = layer;
+  in.limit_ = layer;
+#endif
+  in.sourceGraphic_ = IFilterViewPtr(new SimpleFilterView(own_buffer_->gilView(), layer));
+  ImageBuffer & parent_buffer = parent_buffer_();
+#if defined(RENDERER_AGG)
+  parent_buffer.cover(own_buffer_->rect());
+#endif
+  in.backgroundImage_ = IFilterViewPtr(new SimpleFilterView(
+    boost::gil::subimage_view(parent_buffer.gilView(), 
+      own_buffer_->x() - parent_buffer.x(), own_buffer_->y() - parent_buffer.y(), 
+      own_buffer_->width(), own_buffer_->height()), layer));
   IFilterViewPtr out = document_.filters_.get(*style().filter_, length_factory_, in);
-  if (out)
-    boost::gil::copy_pixels(out->view(), own_buffer_->gilView());
+  if (out == in.sourceGraphic_)
+    return; // Filter wasn't applied
+
+  // Result is calculated before the layer is changed, as it may be read by the filter
+  PixelRect const region = out ? out->region() : PixelRect();
+  boost::gil::rgba8c_view_t const result = out ? out->view() : boost::gil::rgba8c_view_t();
+  // Layer pixels are replaced with the filter result, that covers only the filter region
+#if defined(RENDERER_AGG)
+  own_buffer_->clear();
+  if (region.empty())
+    return;
+  own_buffer_->cover(agg::rect_i(region.x_, region.y_, region.x_ + region.width_ - 1, region.y_ + region.height_ - 1));
+#else
+  boost::gil::fill_pixels(own_buffer_->gilView(), boost::gil::rgba8_pixel_t(0, 0, 0, 0));
+  if (region.empty())
+    return;
+#endif
+  boost::gil::copy_pixels(result, boost::gil::subimage_view(own_buffer_->gilView(), 
+    region.x_ - own_buffer_->x(), region.y_ - own_buffer_->y(), region.width_, region.height_));
 }
 
 class Switch: public Canvas
@@ -689,6 +1018,99 @@ public:
   virtual bool isSwitchElement() const { return true; }
 };
 
+#if defined(RENDERER_AGG)
+namespace
+{
+  // Pixels that are at least partially inside of the rectangle
+  agg::rect_i pixelBounds(agg::rect_d const & rect)
+  {
+    return agg::rect_i(int(std::floor(rect.x1)), int(std::floor(rect.y1)), 
+      int(std::ceil(rect.x2)) - 1, int(std::ceil(rect.y2)) - 1);
+  }
+
+  // Largest singular value of the linear part of the transform, i.e. the most 
+  // the transform can stretch a vector in any direction
+  double maxScale(agg::trans_affine const & m)
+  {
+    double const sum = m.sx * m.sx + m.shx * m.shx + m.shy * m.shy + m.sy * m.sy;
+    double const det = m.sx * m.sy - m.shx * m.shy;
+    return std::sqrt((sum + std::sqrt(std::max(0.0, sum * sum - 4 * det * det))) / 2);
+  }
+}
+
+// Contains everything needed to rasterize the path, so that it can be done on rendering thread
+class PathDrawCommand: public DrawCommand
+{
+public:
+  PathDrawCommand(agg::path_storage const & path_storage, InheritedStyle const & style, 
+    transform_t const & transform, EffectivePaint const & fill, EffectivePaint const & stroke,
+    agg::rect_d const & clip_box, Document::gradient_colors_t & gradient_colors, ImageBuffer & image_buffer)
+    : path_storage_(path_storage)
+    , style_(style)
+    , transform_(transform)
+    , fill_(fill)
+    , stroke_(stroke)
+    , clip_box_(clip_box)
+    , gradient_colors_(gradient_colors)
+    , image_buffer_(image_buffer)
+  {}
+
+  virtual void execute();
+
+private:
+  agg::path_storage path_storage_;
+  InheritedStyle const style_;
+  transform_t transform_;
+  EffectivePaint const fill_, stroke_;
+  agg::rect_d clip_box_; // Scissor box, rasterized geometry is clipped by it
+  Document::gradient_colors_t & gradient_colors_;
+  ImageBuffer & image_buffer_;
+
+  bool moveToLayer();
+
+  template<class VertexSource>
+  void paintScanlines(EffectivePaint const & paint, number_t opacity, agg::rasterizer_scanline_aa<> & rasterizer,
+    VertexSource & curved);
+  template<class VertexSourceStroked, class VertexSourceCurved>
+  void strokePath(EffectivePaint const & stroke, VertexSourceStroked & curved_stroked, VertexSourceCurved & curved);
+};
+
+// Blits glyph masks from the cache with solid color
+class TextDrawCommand: public DrawCommand
+{
+public:
+  struct Glyph
+  {
+    int index;
+    number_t x, y; // Pen position in pixels
+  };
+
+  TextDrawCommand(GlyphCache & glyph_cache, Font const & font, int size_bucket, 
+    std::vector<Glyph> & glyphs, color_t const & color, agg::rect_d const & clip_box, 
+    ImageBuffer & image_buffer)
+    : glyph_cache_(glyph_cache)
+    , font_(font)
+    , size_bucket_(size_bucket)
+    , color_(color)
+    , clip_box_(clip_box)
+    , image_buffer_(image_buffer)
+  {
+    glyphs_.swap(glyphs);
+  }
+
+  virtual void execute();
+
+private:
+  GlyphCache & glyph_cache_;
+  Font const & font_;
+  int const size_bucket_;
+  std::vector<Glyph> glyphs_;
+  color_t const color_;
+  agg::rect_d const clip_box_; // Glyphs are clipped by pixels that it touches
+  ImageBuffer & image_buffer_;
+};
+#endif
+
 class Path: 
   public Canvas
 #if defined(RENDERER_GDIPLUS)
@@ -851,20 +1273,148 @@ private:
     }
   }
 
-  typedef boost::variant<svgpp::tag::value::none, color_t, Gradient> EffectivePaint;
-#if defined(RENDERER_AGG)
-  template<class VertexSource>
-  void paintScanlines(EffectivePaint const & paint, number_t opacity, agg::rasterizer_scanline_aa<> & rasterizer,
-    VertexSource & curved);
-  template<class VertexSourceStroked, class VertexSourceCurved>
-  void strokePath(EffectivePaint const & stroke, VertexSourceStroked & curved_stroked, VertexSourceCurved & curved);
-#endif
   void drawPath();
   void drawMarkers();
   void drawMarker(svg_string_t const & id, number_t x, number_t y, number_t dir);
-  EffectivePaint getEffectivePaint(Paint const &) const;
 };
 
+#if defined(RENDERER_AGG)
+// 'text' element and 'tspan' and 'a' elements inside it. Glyphs are positioned while content
+// is traversed and are drawn when 'text' element ends, after 'text-anchor' is applied to text chunks.
+// Only first value of 'x' and 'y' lists starts new text chunk, 'dx', 'dy' and 'rotate' aren't supported
+class Text: public Canvas
+{
+public:
+  Text(Canvas & parent)
+    : Canvas(parent)
+    , root_(*this)
+    , span_id_(0)
+    , span_count_(1)
+    , pen_x_(0)
+    , pen_y_(0)
+    , pending_space_(false)
+    , previous_glyph_(-1)
+    , previous_font_(NULL)
+    , glyph_count_(0)
+  {}
+
+  // 'tspan' and 'a'
+  Text(Text & parent)
+    : Canvas(parent)
+    , root_(parent.root_)
+    , span_id_(root_.span_count_++)
+    , span_count_(0)
+    , pen_x_(0)
+    , pen_y_(0)
+    , pending_space_(false)
+    , previous_glyph_(-1)
+    , previous_font_(NULL)
+    , glyph_count_(0)
+  {}
+
+  void on_exit_element()
+  {
+    if (&root_ == this && style().display_)
+      drawText();
+    Canvas::on_exit_element();
+  }
+
+  using Canvas::set;
+
+  template<class Range>
+  void set(svgpp::tag::attribute::x, Range const & range)
+  {
+    if (!boost::empty(range))
+      x_ = *boost::begin(range);
+  }
+
+  template<class Range>
+  void set(svgpp::tag::attribute::y, Range const & range)
+  {
+    if (!boost::empty(range))
+      y_ = *boost::begin(range);
+  }
+
+  template<class Range>
+  void set_text(Range const & text)
+  {
+    Font const * font = findFont();
+    if (!font)
+      return;
+    typedef typename boost::range_iterator<Range const>::type iterator_t;
+    for(iterator_t it = boost::begin(text), end = boost::end(text); it != end; )
+    {
+      int codepoint = nextCodepoint(it, end);
+      if (codepoint == '\n' || codepoint == '\r')
+        continue;
+      // Whitespace is collapsed, leading and trailing spaces are removed
+      if (codepoint == ' ' || codepoint == '\t')
+      {
+        root_.pending_space_ = root_.glyph_count_ != 0;
+        continue;
+      }
+      if (root_.pending_space_)
+      {
+        root_.pending_space_ = false;
+        // Space before new text chunk isn't visible
+        if (!x_ && !y_)
+          addGlyph(*font, ' ');
+      }
+      addGlyph(*font, codepoint);
+    }
+  }
+
+private:
+  struct Run
+  {
+    unsigned span_id;
+    Font const * font;
+    InheritedStyle style;
+    EffectivePaint fill, stroke;
+    std::vector<TextDrawCommand::Glyph> glyphs; // In user coordinates
+  };
+
+  struct Chunk
+  {
+    std::size_t first_glyph;
+    number_t start_x, end_x;
+    TextAnchor anchor;
+  };
+
+  Text & root_;
+  unsigned const span_id_;
+  boost::optional<number_t> x_, y_;
+  // Following members are used in root only
+  unsigned span_count_;
+  number_t pen_x_, pen_y_;
+  bool pending_space_;
+  int previous_glyph_;
+  Font const * previous_font_;
+  std::size_t glyph_count_;
+  std::vector<Run> runs_;
+  std::vector<Chunk> chunks_;
+
+  // UTF-8 for 'char' strings, UTF-16 or UTF-32 code units otherwise
+  template<class Iterator>
+  static int nextCodepoint(Iterator & it, Iterator end)
+  {
+    typedef typename std::iterator_traits<Iterator>::value_type char_t;
+    unsigned codepoint = static_cast<typename boost::make_unsigned<char_t>::type>(*it++);
+    if (sizeof(char_t) != 1 || codepoint < 0x80)
+      return codepoint;
+    int trailing = codepoint >= 0xF0 ? 3 : codepoint >= 0xE0 ? 2 : codepoint >= 0xC0 ? 1 : 0;
+    codepoint &= 0x3F >> trailing;
+    for(; trailing != 0 && it != end; --trailing, ++it)
+      codepoint = (codepoint << 6) | (static_cast<unsigned char>(*it) & 0x3F);
+    return codepoint;
+  }
+
+  Font const * findFont();
+  void addGlyph(Font const & font, int codepoint);
+  void drawText();
+};
+#endif
+
 struct afterMarkerUnitsTag {};
 
 struct attribute_traversal: svgpp::policy::attribute_traversal::default_policy
@@ -892,6 +1442,12 @@ struct DocumentTraversalControl
   {
     return true;
   }
+
+  template<class Context, class XMLElement>
+  static bool process_child(Context &, XMLElement const &)
+  {
+    return true;
+  }
 };
 
 typedef 
@@ -1082,62 +1638,15 @@ struct GradientBase_visitor: boost::static_visitor<>
 };
 
 #if defined(RENDERER_AGG)
-template<class Gradient>
-class GradientRepeatAdapter
-{
-public:
-  GradientRepeatAdapter(Gradient const & gradient, GradientBase::SpreadMethod method)
-    : gradient_(gradient)
-    , method_(method)
-  {}
-
-  int calculate(int x, int y, int d) const
-  {
-    int val = gradient_.calculate(x, y, d);
-    switch(method_)
-    {
-    default:
-      assert(false);
-    case GradientBase::spreadPad:
-    {
-      if (val < 0)
-        return 0;
-      if (val > d)
-        return d;
-      return val;
-    }
-    case GradientBase::spreadReflect:
-    {
-      int d2 = d * 2;
-      int ret = val % d2;
-      if (ret < 0) ret += d2;
-      if (ret >= d) ret = d2 - ret;
-      return ret;
-    }
-    case GradientBase::spreadRepeat:
-    {
-      int ret = val % d;
-      if (ret < 0) ret += d;
-      return ret;
-    }
-    }
-  }
-
-private:
-  Gradient const & gradient_;
-  GradientBase::SpreadMethod const method_;
-};
-
-
 struct ColorFunctionProfile
 {
-  static const unsigned size_ = 256;
+  static const unsigned size_ = 1024;
 
   ColorFunctionProfile(GradientStops const & stops, number_t opacity) 
   {
     assert(stops.size() >= 2);
 
-    static const number_t offset_step = 1.0 / size_;
+    static const number_t offset_step = 1.0 / (size_ - 1);
     number_t offset = 0;
     GradientStops::const_iterator stop1 = stops.begin(), stop2 = stops.begin();
     agg::rgba8 color1 = stopColor(*stop1, opacity), color2 = color1;
@@ -1178,26 +1687,49 @@ private:
   agg::rgba8 colors_[size_];
 };
 
-static const number_t GradientScale = 100.0;
+// Lookup tables are shared by all paths painted with the same gradient and opacity
+ColorFunctionProfile const & getGradientColors(Document::gradient_colors_t & cache, 
+  GradientBase const & gradient, number_t opacity)
+{
+  boost::shared_ptr<ColorFunctionProfile const> & colors = cache[std::make_pair(gradient.key_, opacity)];
+  if (!colors)
+    colors.reset(new ColorFunctionProfile(gradient.stops_, opacity));
+  return *colors;
+}
 
-template<class GradientFunc, class VertexSource>
+template<class Spread, class Shape>
+void RenderGradientSpans(renderer_base_t & renderer, agg::rasterizer_scanline_aa<> & rasterizer,
+  ColorFunctionProfile const & colors, Shape const & shape, transform_t const & device_to_gradient)
+{
+  gradient_span::Generator<ColorFunctionProfile, Shape, Spread> span_generator(colors, shape, device_to_gradient);
+  agg::span_allocator<agg::rgba8> span_allocator;
+  agg::scanline_p8 scanline;
+  agg::render_scanlines_aa(rasterizer, scanline, renderer, span_allocator, span_generator);
+}
+
+// Used when gradient vector has zero length or radius is zero: the area is painted 
+// with the color of the last stop
+void RenderScanlinesLastStop(renderer_base_t & renderer, agg::rasterizer_scanline_aa<> & rasterizer,
+  GradientBase const & gradient_base, number_t opacity)
+{
+  agg::rgba8 color = gradient_base.stops_.back().color_;
+  color.opacity(opacity * color.opacity());
+  agg::renderer_scanline_aa_solid<renderer_base_t> renderer_solid(renderer);
+  renderer_solid.color(color);
+  agg::scanline_p8 scanline;
+  agg::render_scanlines(rasterizer, scanline, renderer_solid);
+}
+
+// 'gradient_geometry_transform' maps gradient space of 'Shape' to gradient coordinates
+template<class Shape, class VertexSource>
 void RenderScanlinesGradient(renderer_base_t & renderer, 
   agg::rasterizer_scanline_aa<> & rasterizer,
-  GradientFunc const & gradient_func, GradientBase const & gradient_base, 
+  Shape const & shape, GradientBase const & gradient_base, 
   transform_t const & user_transform, transform_t const & gradient_geometry_transform,
-  number_t opacity,
+  number_t opacity, Document::gradient_colors_t & gradient_colors,
   VertexSource & curved)
 {
-  typedef agg::span_interpolator_linear<> span_interpolator_t;
-  typedef GradientRepeatAdapter<GradientFunc> gradient_t;
-  typedef agg::span_gradient< 
-    agg::rgba8,
-    span_interpolator_t,
-    gradient_t,
-    ColorFunctionProfile > span_gradient_t;
-  typedef agg::span_allocator<typename span_gradient_t::color_type> span_allocator_t;
-
-  transform_t tr = agg::trans_affine_scaling(1.0/GradientScale) * gradient_geometry_transform;
+  transform_t tr = gradient_geometry_transform;
 
   if (gradient_base.matrix_)
     tr *= transform_t(gradient_base.matrix_->data());
@@ -1214,20 +1746,27 @@ void RenderScanlinesGradient(renderer_base_t & renderer,
 
   tr *= user_transform;
   tr.invert();
-  span_interpolator_t span_interpolator(tr);
-  ColorFunctionProfile color_function(gradient_base.stops_, opacity);
-  gradient_t gradient_repeated(gradient_func, gradient_base.spreadMethod_);
-  span_gradient_t span_gradient(span_interpolator, gradient_repeated, color_function, 0, GradientScale);
-  span_allocator_t span_allocator;
-  agg::scanline_p8 scanline;
-  agg::render_scanlines_aa(rasterizer, scanline, renderer, span_allocator, span_gradient);
+  ColorFunctionProfile const & colors = getGradientColors(gradient_colors, gradient_base, opacity);
+  // Spread method is chosen once per path, not per pixel
+  switch(gradient_base.spreadMethod_)
+  {
+  case GradientBase::spreadReflect:
+    RenderGradientSpans<gradient_span::Reflect>(renderer, rasterizer, colors, shape, tr);
+    break;
+  case GradientBase::spreadRepeat:
+    RenderGradientSpans<gradient_span::Repeat>(renderer, rasterizer, colors, shape, tr);
+    break;
+  default:
+    RenderGradientSpans<gradient_span::Pad>(renderer, rasterizer, colors, shape, tr);
+    break;
+  }
 }
 
 template<class VertexSource>
-void Path::paintScanlines(EffectivePaint const & paint, number_t opacity, agg::rasterizer_scanline_aa<> & rasterizer,
+void PathDrawCommand::paintScanlines(EffectivePaint const & paint, number_t opacity, agg::rasterizer_scanline_aa<> & rasterizer,
   VertexSource & curved) 
 {
-  renderer_base_t renderer_base(getImageBuffer().pixfmt());
+  renderer_base_t renderer_base(image_buffer_.pixfmt());
   // TODO: pass bounding box function instead of curved
   if (agg::rgba8 const * paintColor = boost::get<agg::rgba8>(&paint))
   {
@@ -1244,56 +1783,162 @@ void Path::paintScanlines(EffectivePaint const & paint, number_t opacity, agg::r
     Gradient const & gradient = boost::get<Gradient const>(paint);
     if (LinearGradient const * linearGradient = boost::get<LinearGradient>(&gradient))
     {
-      agg::gradient_x gradient_func;
       number_t dx = linearGradient->x2_ - linearGradient->x1_;
       number_t dy = linearGradient->y2_ - linearGradient->y1_;
+      if (dx == 0 && dy == 0)
+      {
+        RenderScanlinesLastStop(renderer_base, rasterizer, *linearGradient, opacity);
+        return;
+      }
       transform_t gradient_geometry_transform = 
         agg::trans_affine_scaling(std::sqrt(dx * dx + dy * dy))
         * agg::trans_affine_rotation(std::atan2(dy, dx))
         * agg::trans_affine_translation(linearGradient->x1_, linearGradient->y1_);
       RenderScanlinesGradient(renderer_base, rasterizer,
-        gradient_func, *linearGradient, transform(), gradient_geometry_transform, opacity, curved);
+        gradient_span::LinearShape(), *linearGradient, transform_, gradient_geometry_transform, opacity, gradient_colors_, curved);
     }
     else
     {
       RadialGradient const & radialGradient = boost::get<RadialGradient>(gradient);
-      agg::gradient_radial_focus gradient_func(GradientScale, 
-        GradientScale*(radialGradient.fx_ - radialGradient.cx_)/radialGradient.r_, 
-        GradientScale*(radialGradient.fy_ - radialGradient.cy_)/radialGradient.r_);
+      if (radialGradient.r_ <= 0)
+      {
+        RenderScanlinesLastStop(renderer_base, rasterizer, radialGradient, opacity);
+        return;
+      }
+      gradient_span::RadialShape shape(
+        (radialGradient.fx_ - radialGradient.cx_) / radialGradient.r_, 
+        (radialGradient.fy_ - radialGradient.cy_) / radialGradient.r_);
       transform_t gradient_geometry_transform = 
         agg::trans_affine_scaling(radialGradient.r_)
         * agg::trans_affine_translation(radialGradient.cx_, radialGradient.cy_);
       RenderScanlinesGradient(renderer_base, rasterizer,
-        gradient_func, radialGradient, transform(), gradient_geometry_transform, opacity, curved);
+        shape, radialGradient, transform_, gradient_geometry_transform, opacity, gradient_colors_, curved);
     }
   }
 }
 
 template<class VertexSourceStroked, class VertexSourceCurved>
-void Path::strokePath(EffectivePaint const & stroke, 
+void PathDrawCommand::strokePath(EffectivePaint const & stroke, 
   VertexSourceStroked & curved_stroked, VertexSourceCurved & curved) 
 {
-  curved_stroked.width(style().stroke_width_);
-  curved_stroked.line_join(style().line_join_);
-  curved_stroked.line_cap(style().line_cap_);
-  curved_stroked.miter_limit(style().miterlimit_);
+  curved_stroked.width(style_.stroke_width_);
+  curved_stroked.line_join(style_.line_join_);
+  curved_stroked.line_cap(style_.line_cap_);
+  curved_stroked.miter_limit(style_.miterlimit_);
   curved_stroked.inner_join(agg::inner_round);
-  curved_stroked.approximation_scale(transform().scale());
+  curved_stroked.approximation_scale(transform_.scale());
 
   // If the *visual* line width is considerable we 
   // turn on processing of curve cusps.
   //---------------------
-  if(style().stroke_width_ * transform().scale() > 1.0)
+  if(style_.stroke_width_ * transform_.scale() > 1.0)
   {
       curved.angle_tolerance(0.2);
   }
 
   typedef agg::conv_transform<VertexSourceStroked> transformed_t;
-  transformed_t curved_stroked_transformed(curved_stroked, transform());
+  transformed_t curved_stroked_transformed(curved_stroked, transform_);
   agg::rasterizer_scanline_aa<> rasterizer;
+  rasterizer.clip_box(clip_box_.x1, clip_box_.y1, clip_box_.x2, clip_box_.y2);
   rasterizer.filling_rule(agg::fill_non_zero);
   rasterizer.add_path(curved_stroked_transformed);
-  paintScanlines(stroke, style().stroke_opacity_, rasterizer, curved);
+  paintScanlines(stroke, style_.stroke_opacity_, rasterizer, curved);
+}
+// Grows layer to cover visible part of the path with its stroke and translates transform 
+// and clip box to layer coordinates. Returns false if nothing is visible
+bool PathDrawCommand::moveToLayer()
+{
+  agg::conv_transform<agg::path_storage> transformed(path_storage_, transform_);
+  double x1, y1, x2, y2;
+  // Control points of curves are used, their bounds contain the curves
+  if (!clip_box_.is_valid() || !agg::bounding_rect_single(transformed, 0, &x1, &y1, &x2, &y2))
+    return false;
+  double extent = 1; // Antialiased edge
+  if (boost::get<svgpp::tag::value::none>(&stroke_) == NULL)
+  {
+    // Square caps extend for half width multiplied by sqrt(2), miter joins for half width multiplied by miterlimit.
+    // Outline is transformed after stroking, so it is stretched at most by the largest singular value
+    double join_factor = style_.line_cap_ == agg::square_cap ? std::sqrt(2.0) : 1.0;
+    if (style_.line_join_ == agg::miter_join)
+      join_factor = std::max(join_factor, double(style_.miterlimit_));
+    extent += style_.stroke_width_ / 2 * maxScale(transform_) * join_factor;
+  }
+  agg::rect_i const visible = agg::intersect_rectangles(pixelBounds(clip_box_), agg::rect_i(
+    int(std::floor(x1 - extent)), int(std::floor(y1 - extent)), 
+    int(std::ceil(x2 + extent)), int(std::ceil(y2 + extent))));
+  if (!visible.is_valid())
+    return false;
+  image_buffer_.cover(visible);
+  // Rasterizer is clipped to the covered pixels too: recycled layer storage is cleared 
+  // only there, so nothing may be drawn outside even if the extent above is underestimated
+  agg::rect_i const covered = agg::intersect_rectangles(visible, image_buffer_.limit());
+  if (!covered.is_valid())
+    return false;
+  clip_box_ = agg::intersect_rectangles(clip_box_, 
+    agg::rect_d(covered.x1, covered.y1, covered.x2 + 1, covered.y2 + 1));
+  transform_ *= agg::trans_affine_translation(-image_buffer_.x(), -image_buffer_.y());
+  clip_box_ = agg::rect_d(clip_box_.x1 - image_buffer_.x(), clip_box_.y1 - image_buffer_.y(), 
+    clip_box_.x2 - image_buffer_.x(), clip_box_.y2 - image_buffer_.y());
+  return true;
+}
+
+void PathDrawCommand::execute()
+{
+  typedef agg::conv_curve<agg::path_storage> curved_t;
+  typedef agg::conv_transform<curved_t> curved_transformed_t;
+  typedef agg::conv_contour<curved_transformed_t> curved_transformed_contour_t;
+
+  if (!moveToLayer())
+    return;
+  curved_t curved(path_storage_);
+
+  if (boost::get<svgpp::tag::value::none>(&fill_) == NULL)
+  {
+    curved_transformed_t curved_transformed(curved, transform_);
+    agg::rasterizer_scanline_aa<> rasterizer;
+    rasterizer.clip_box(clip_box_.x1, clip_box_.y1, clip_box_.x2, clip_box_.y2);
+    rasterizer.filling_rule(style_.nonzero_fill_rule_ ? agg::fill_non_zero : agg::fill_even_odd);
+    //if(fabs(m_curved_trans_contour.width()) < 0.0001)
+    {
+        rasterizer.add_path(curved_transformed);
+    }
+    /*else
+    {
+        m_curved_trans_contour.miter_limit(attr.miter_limit);
+        ras.add_path(m_curved_trans_contour, attr.index);
+    }*/
+
+    paintScanlines(fill_, style_.fill_opacity_, rasterizer, curved);
+  }
+
+  if (boost::get<svgpp::tag::value::none>(&stroke_) == NULL)
+  {
+    if (std::accumulate(style_.stroke_dasharray_.begin(), style_.stroke_dasharray_.end(), 0.0) <= 0.0)
+    {
+      typedef agg::conv_stroke<curved_t> curved_stroked_t;
+      curved_stroked_t curved_stroked(curved);
+      strokePath(stroke_, curved_stroked, curved);
+    }
+    else
+    {
+      typedef agg::conv_dash<curved_t> curved_dashed_t;
+      curved_dashed_t curved_dashed(curved);
+
+      std::vector<number_t> const & dasharray = style_.stroke_dasharray_;
+      int num_dash_values = 
+        dasharray.size() % 2 == 0
+          ? dasharray.size() 
+          : 2 * dasharray.size();
+      for(int i=0; i<num_dash_values; i+=2)
+        curved_dashed.add_dash(dasharray[i % dasharray.size()], dasharray[(i+1) % dasharray.size()]);
+
+      curved_dashed.dash_start(style_.stroke_dashoffset_);
+
+      typedef agg::conv_stroke<curved_dashed_t> curved_stroked_t;
+      curved_stroked_t curved_stroked(curved_dashed);
+      strokePath(stroke_, curved_stroked, curved);
+    }
+  }
 }
 #elif defined(RENDERER_SKIA)
 void AssignGradientPaint(SkPaint & paint, SkPath const & path, Gradient const & gradient, SkMatrix transform)
@@ -1370,60 +2015,15 @@ void Path::drawPath()
 #if defined(RENDERER_AGG)
   if (path_storage_.total_vertices() == 0)
     return;
-  typedef agg::conv_curve<agg::path_storage> curved_t;
-  typedef agg::conv_transform<curved_t> curved_transformed_t;
-  typedef agg::conv_contour<curved_transformed_t> curved_transformed_contour_t;
-
-  curved_t curved(path_storage_);
-
+  agg::conv_curve<agg::path_storage> curved(path_storage_);
+  addObjectBounds(curved, transform());
   EffectivePaint fill = getEffectivePaint(style().fill_paint_);
-  if (boost::get<svgpp::tag::value::none>(&fill) == NULL)
-  {
-    curved_transformed_t curved_transformed(curved, transform());
-    agg::rasterizer_scanline_aa<> rasterizer;
-    rasterizer.filling_rule(style().nonzero_fill_rule_ ? agg::fill_non_zero : agg::fill_even_odd);
-    //if(fabs(m_curved_trans_contour.width()) < 0.0001)
-    {
-        rasterizer.add_path(curved_transformed);
-    }
-    /*else
-    {
-        m_curved_trans_contour.miter_limit(attr.miter_limit);
-        ras.add_path(m_curved_trans_contour, attr.index);
-    }*/
-
-    paintScanlines(fill, style().fill_opacity_, rasterizer, curved);
-  }
-
   EffectivePaint stroke = getEffectivePaint(style().stroke_paint_);
-  if (boost::get<svgpp::tag::value::none>(&stroke) == NULL)
-  {
-    if (std::accumulate(style().stroke_dasharray_.begin(), style().stroke_dasharray_.end(), 0.0) <= 0.0)
-    {
-      typedef agg::conv_stroke<curved_t> curved_stroked_t;
-      curved_stroked_t curved_stroked(curved);
-      strokePath(stroke, curved_stroked, curved);
-    }
-    else
-    {
-      typedef agg::conv_dash<curved_t> curved_dashed_t;
-      curved_dashed_t curved_dashed(curved);
-
-      std::vector<number_t> const & dasharray = style().stroke_dasharray_;
-      int num_dash_values = 
-        dasharray.size() % 2 == 0
-          ? dasharray.size() 
-          : 2 * dasharray.size();
-      for(int i=0; i<num_dash_values; i+=2)
-        curved_dashed.add_dash(dasharray[i % dasharray.size()], dasharray[(i+1) % dasharray.size()]);
-
-      curved_dashed.dash_start(style().stroke_dashoffset_);
-
-      typedef agg::conv_stroke<curved_dashed_t> curved_stroked_t;
-      curved_stroked_t curved_stroked(curved_dashed);
-      strokePath(stroke, curved_stroked, curved);
-    }
-  }
+  if (boost::get<svgpp::tag::value::none>(&fill) && boost::get<svgpp::tag::value::none>(&stroke))
+    return;
+  document().draw(DrawCommandPtr(
+    new PathDrawCommand(path_storage_, style(), transform(), fill, stroke, clipBuffer().box(), 
+      document().gradient_colors_, getImageBuffer())));
 #elif defined(RENDERER_GDIPLUS)
   if (path_points_.empty())
     return;
@@ -1517,6 +2117,233 @@ void Path::drawPath()
 #endif
 }
 
+#if defined(RENDERER_AGG)
+void TextDrawCommand::execute()
+{
+  if (glyphs_.empty() || !clip_box_.is_valid())
+    return;
+  // Layer must cover font bounding box at each glyph position
+  number_t min_x = glyphs_.front().x, max_x = min_x, min_y = glyphs_.front().y, max_y = min_y;
+  for(std::vector<Glyph>::const_iterator glyph = glyphs_.begin(); glyph != glyphs_.end(); ++glyph)
+  {
+    min_x = std::min(min_x, glyph->x);
+    max_x = std::max(max_x, glyph->x);
+    min_y = std::min(min_y, glyph->y);
+    max_y = std::max(max_y, glyph->y);
+  }
+  int font_x1, font_y1, font_x2, font_y2;
+  stbtt_GetFontBoundingBox(&font_.info(), &font_x1, &font_y1, &font_x2, &font_y2);
+  number_t const scale = font_.scaleForSize(float(size_bucket_) / GlyphCache::size_buckets_per_pixel);
+  agg::rect_i const clip_pixels = pixelBounds(clip_box_);
+  agg::rect_i const visible = agg::intersect_rectangles(clip_pixels, agg::rect_i(
+    int(std::floor(min_x + font_x1 * scale)) - 1, int(std::floor(min_y - font_y2 * scale)) - 1,
+    int(std::ceil(max_x + font_x2 * scale)) + 1, int(std::ceil(max_y - font_y1 * scale)) + 1));
+  if (!visible.is_valid())
+    return;
+  image_buffer_.cover(visible);
+  agg::rect_i const covered = agg::intersect_rectangles(visible, image_buffer_.limit());
+  if (!covered.is_valid())
+    return;
+
+  renderer_base_t renderer_base(image_buffer_.pixfmt());
+  renderer_base.clip_box(covered.x1 - image_buffer_.x(), covered.y1 - image_buffer_.y(),
+    covered.x2 - image_buffer_.x(), covered.y2 - image_buffer_.y());
+  for(std::vector<Glyph>::const_iterator glyph = glyphs_.begin(); glyph != glyphs_.end(); ++glyph)
+  {
+    // Glyphs are positioned with subpixel precision horizontally and snapped to pixel rows vertically
+    number_t const layer_x = glyph->x - image_buffer_.x();
+    number_t const floor_x = std::floor(layer_x);
+    int x = int(floor_x);
+    int subpixel = int((layer_x - floor_x) * GlyphCache::subpixel_positions + 0.5);
+    if (subpixel == GlyphCache::subpixel_positions)
+    {
+      subpixel = 0;
+      ++x;
+    }
+    int const y = int(std::floor(glyph->y - image_buffer_.y() + 0.5));
+    GlyphMask const & mask = glyph_cache_.get(font_, size_bucket_, glyph->index, subpixel);
+    for(int row = 0; row < mask.height; ++row)
+      renderer_base.blend_solid_hspan(x + mask.left, y + mask.top + row, mask.width, color_,
+        mask.covers + row * mask.stride);
+  }
+}
+
+Font const * Text::findFont()
+{
+  Document & doc = document();
+  Font const * font = NULL;
+  if (doc.fonts_)
+    font = doc.fonts_->find(style().font_family_ 
+      ? std::string(style().font_family_->begin(), style().font_family_->end()) 
+      : std::string());
+  if (!font && !doc.missing_font_reported_)
+  {
+    std::cerr << "Text isn't rendered, font file must be passed with --font option\n";
+    doc.missing_font_reported_ = true;
+  }
+  return font;
+}
+
+void Text::addGlyph(Font const & font, int codepoint)
+{
+  Text & root = root_;
+  if (root.chunks_.empty() || x_ || y_)
+  {
+    // Absolute position starts new text chunk
+    if (!root.chunks_.empty())
+      root.chunks_.back().end_x = root.pen_x_;
+    if (x_)
+      root.pen_x_ = *x_;
+    if (y_)
+      root.pen_y_ = *y_;
+    x_.reset();
+    y_.reset();
+    Chunk chunk = { root.glyph_count_, root.pen_x_, root.pen_x_, style().text_anchor_ };
+    root.chunks_.push_back(chunk);
+    root.previous_glyph_ = -1;
+  }
+
+  if (root.runs_.empty() || root.runs_.back().span_id != span_id_)
+  {
+    root.runs_.push_back(Run());
+    Run & run = root.runs_.back();
+    run.span_id = span_id_;
+    run.font = &font;
+    run.style = style();
+    run.fill = getEffectivePaint(style().fill_paint_);
+    run.stroke = getEffectivePaint(style().stroke_paint_);
+  }
+
+  int const glyph_index = font.glyphIndex(codepoint);
+  number_t const scale = font.scaleForSize(style().font_size_);
+  if (root.previous_glyph_ >= 0 && root.previous_font_ == &font)
+    root.pen_x_ += font.kerning(root.previous_glyph_, glyph_index) * scale;
+  TextDrawCommand::Glyph const glyph = { glyph_index, root.pen_x_, root.pen_y_ };
+  root.runs_.back().glyphs.push_back(glyph);
+  root.pen_x_ += font.advance(glyph_index) * scale;
+  root.previous_glyph_ = glyph_index;
+  root.previous_font_ = &font;
+  ++root.glyph_count_;
+}
+
+namespace
+{
+  void appendGlyphOutline(agg::path_storage & path, Font const & font, number_t scale, 
+    TextDrawCommand::Glyph const & glyph)
+  {
+    stbtt_vertex * vertices = NULL;
+    int const count = stbtt_GetGlyphShape(&font.info(), glyph.index, &vertices);
+    for(int i = 0; i < count; ++i)
+    {
+      // Font units have Y axis pointing up
+      number_t const x = glyph.x + vertices[i].x * scale;
+      number_t const y = glyph.y - vertices[i].y * scale;
+      switch(vertices[i].type)
+      {
+      case STBTT_vmove:
+        path.close_polygon();
+        path.move_to(x, y);
+        break;
+      case STBTT_vline:
+        path.line_to(x, y);
+        break;
+      case STBTT_vcurve:
+        path.curve3(glyph.x + vertices[i].cx * scale, glyph.y - vertices[i].cy * scale, x, y);
+        break;
+      }
+    }
+    path.close_polygon();
+    stbtt_FreeShape(&font.info(), vertices);
+  }
+
+  // Rectangle containing font bounding box at each glyph position
+  void appendGlyphsBounds(agg::path_storage & path, Font const & font, number_t scale, 
+    std::vector<TextDrawCommand::Glyph> const & glyphs)
+  {
+    if (glyphs.empty())
+      return;
+    number_t min_x = glyphs.front().x, max_x = min_x, min_y = glyphs.front().y, max_y = min_y;
+    for(std::vector<TextDrawCommand::Glyph>::const_iterator glyph = glyphs.begin(); glyph != glyphs.end(); ++glyph)
+    {
+      min_x = std::min(min_x, glyph->x);
+      max_x = std::max(max_x, glyph->x);
+      min_y = std::min(min_y, glyph->y);
+      max_y = std::max(max_y, glyph->y);
+    }
+    int font_x1, font_y1, font_x2, font_y2;
+    stbtt_GetFontBoundingBox(&font.info(), &font_x1, &font_y1, &font_x2, &font_y2);
+    path.move_to(min_x + font_x1 * scale, min_y - font_y2 * scale);
+    path.line_to(max_x + font_x2 * scale, max_y - font_y1 * scale);
+  }
+}
+
+void Text::drawText()
+{
+  if (chunks_.empty())
+    return;
+  chunks_.back().end_x = pen_x_;
+
+  // Shift glyphs of chunks that aren't aligned to start
+  std::vector<Chunk>::const_iterator chunk = chunks_.begin();
+  std::size_t glyph_index = 0;
+  for(std::vector<Run>::iterator run = runs_.begin(); run != runs_.end(); ++run)
+    for(std::vector<TextDrawCommand::Glyph>::iterator glyph = run->glyphs.begin(); 
+      glyph != run->glyphs.end(); ++glyph, ++glyph_index)
+    {
+      while (chunk + 1 != chunks_.end() && (chunk + 1)->first_glyph <= glyph_index)
+        ++chunk;
+      if (chunk->anchor == textAnchorMiddle)
+        glyph->x -= (chunk->end_x - chunk->start_x) / 2;
+      else if (chunk->anchor == textAnchorEnd)
+        glyph->x -= chunk->end_x - chunk->start_x;
+    }
+
+  // Masks from glyph cache may be used for solid fill without stroke if glyphs
+  // are only scaled uniformly and translated
+  transform_t const & tr = transform();
+  bool const cacheable_transform = tr.shx == 0 && tr.shy == 0 && tr.sx > 0 
+    && std::fabs(tr.sx - tr.sy) <= 1e-6 * tr.sx;
+  for(std::vector<Run>::iterator run = runs_.begin(); run != runs_.end(); ++run)
+  {
+    {
+      agg::path_storage bounds;
+      appendGlyphsBounds(bounds, *run->font, run->font->scaleForSize(run->style.font_size_), run->glyphs);
+      addObjectBounds(bounds, tr);
+    }
+    bool const no_stroke = boost::get<svgpp::tag::value::none>(&run->stroke) != NULL;
+    if (no_stroke && boost::get<svgpp::tag::value::none>(&run->fill))
+      continue;
+    color_t const * fill_color = boost::get<color_t>(&run->fill);
+    if (fill_color && no_stroke && cacheable_transform)
+    {
+      int const size_bucket = GlyphCache::sizeBucket(run->style.font_size_ * tr.sx);
+      if (size_bucket == 0)
+        continue;
+      std::vector<TextDrawCommand::Glyph> & glyphs = run->glyphs;
+      for(std::vector<TextDrawCommand::Glyph>::iterator glyph = glyphs.begin(); glyph != glyphs.end(); ++glyph)
+        tr.transform(&glyph->x, &glyph->y);
+      color_t color(*fill_color);
+      color.opacity(run->style.fill_opacity_);
+      document().draw(DrawCommandPtr(
+        new TextDrawCommand(document().glyph_cache_, *run->font, size_bucket, glyphs, color, 
+          clipBuffer().box(), getImageBuffer())));
+    }
+    else
+    {
+      // Outlines are rasterized like any other path
+      agg::path_storage path_storage;
+      number_t const scale = run->font->scaleForSize(run->style.font_size_);
+      for(std::vector<TextDrawCommand::Glyph>::const_iterator glyph = run->glyphs.begin(); 
+        glyph != run->glyphs.end(); ++glyph)
+        appendGlyphOutline(path_storage, *run->font, scale, *glyph);
+      document().draw(DrawCommandPtr(
+        new PathDrawCommand(path_storage, run->style, tr, run->fill, run->stroke, clipBuffer().box(), 
+          document().gradient_colors_, getImageBuffer())));
+    }
+  }
+}
+#endif
+
 class Marker: 
   public Canvas
 {
@@ -1529,6 +2356,7 @@ public:
     , strokeWidthUnits_(true)
   {
 #if defined(RENDERER_AGG)
+    excludeFromParentBounds();
     transform().premultiply(agg::trans_affine_translation(x, y));
 #elif defined(RENDERER_GDIPLUS)
     transform().Translate(x, y);
@@ -1614,12 +2442,13 @@ void Path::drawMarker(svg_string_t const & id, number_t x, number_t y, number_t
   }
 }
 
-Path::EffectivePaint Path::getEffectivePaint(Paint const & paint) const
+EffectivePaint Canvas::getEffectivePaint(Paint const & paint) const
 {
   SolidPaint const * solidPaint = NULL;
   if (IRIPaint const * iri = boost::get<IRIPaint>(&paint))
   {
-    if (boost::optional<Gradient> const gradient = document().gradients_.get(iri->fragment_, length_factory()))
+    boost::optional<Gradient> const & gradient = document().gradients_.get(iri->fragment_, length_factory());
+    if (gradient)
     {
       GradientBase_visitor gradientBase;
       boost::apply_visitor(gradientBase, *gradient);
@@ -1649,18 +2478,62 @@ Path::EffectivePaint Path::getEffectivePaint(Paint const & paint) const
   return boost::get<color_t>(*solidPaint);
 }
 
-void renderDocument(XMLDocument & xmlDocument, ImageBuffer & buffer)
+#if defined(RENDERER_AGG)
+void renderDocument(XMLDocument & xmlDocument, ImageBuffer & buffer, bool pipelined, FontSet const & fonts)
+#else
+void renderDocument(XMLDocument & xmlDocument, ImageBuffer & buffer, bool pipelined)
+#endif
 {
-  Document document(xmlDocument);
-  Canvas canvas(document, buffer);
-  document_traversal_main::load_document(xmlDocument.getRoot(), canvas);
+  // In pipelined mode paths are rasterized on separate thread while traversal continues
+  std::unique_ptr<RenderPipeline> pipeline(pipelined ? new RenderPipeline : NULL);
+  Document document(xmlDocument, pipeline.get());
+#if defined(RENDERER_AGG)
+  document.fonts_ = &fonts;
+#endif
+  {
+    Canvas canvas(document, buffer);
+    document_traversal_main::load_document(xmlDocument.getRoot(), canvas);
+  }
+  document.flushDrawing();
 }
 
 int main(int argc, char * argv[])
 {
-  if (argc < 2)
+  char const * const program_name = argv[0];
+  bool pipelined = false;
+#if defined(RENDERER_AGG)
+  FontSet fonts;
+#endif
+  for(; argc > 1 && std::strncmp(argv[1], "--", 2) == 0; --argc, ++argv)
+  {
+    if (std::strcmp(argv[1], "--pipelined") == 0)
+      pipelined = true;
+#if defined(RENDERER_AGG)
+    else if (std::strcmp(argv[1], "--font") == 0 && argc > 2)
+    {
+      try
+      {
+        fonts.load(argv[2]);
+      }
+      catch(std::exception const & e)
+      {
+        std::cerr << e.what() << "\n";
+        return 1;
+      }
+      --argc;
+      ++argv;
+    }
+#endif
+    else
+      break;
+  }
+  if (argc < 2 || std::strncmp(argv[1], "--", 2) == 0)
   {
-    std::cout << "Usage: " << argv[0] << " <svg file name> [<output BMP file name>]\n";
+    std::cout << "Usage: " << program_name << " [--pipelined]"
+#if defined(RENDERER_AGG)
+      " [--font [<family>=]<TTF file name>]..."
+#endif
+      " <svg file name> [<output BMP file name>]\n";
     return 1;
   }
 
@@ -1677,7 +2550,11 @@ int main(int argc, char * argv[])
     try
     {
       xmlDoc.load(argv[1]);
-      renderDocument(xmlDoc, buffer);
+#if defined(RENDERER_AGG)
+      renderDocument(xmlDoc, buffer, pipelined, fonts);
+#else
+      renderDocument(xmlDoc, buffer, pipelined);
+#endif
     }
     catch(svgpp::exception_base const & e)
     {
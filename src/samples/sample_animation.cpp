@@ -4,90 +4,71 @@
 #include <rapidxml_ns/rapidxml_ns_utils.hpp>
 #include <svgpp/policy/xml/rapidxml_ns.hpp>
 #include <svgpp/svgpp.hpp>
+#include <svgpp/utility/animation_timeline.hpp>
+#include <iostream>
 
 using namespace svgpp;
 
 struct NotAnimateElementContext
 {
-  void on_enter_element(tag::element::any const &) {}
-  void on_exit_element() {}
+  NotAnimateElementContext(animation_timeline<> & timeline)
+    : timeline_(timeline)
+    , ids_(1)
+  {}
 
-  template<class T>
-  static void set_text(T const & value) {}
-};
+  void on_enter_element(tag::element::any const &) 
+  {
+    ids_.push_back(std::string());
+  }
 
-struct BaseContext
-{
-  void set(tag::attribute::attributeType, tag::value::CSS) {}
-  void set(tag::attribute::attributeType, tag::value::XML) {}
-  void set(tag::attribute::attributeType, tag::value::auto_) {}
+  void on_exit_element() 
+  {
+    ids_.pop_back();
+  }
 
   template<class StringRange>
-  void set(tag::attribute::attributeName, StringRange const & range) 
+  void set(tag::attribute::id, StringRange const & id) 
   {
-    std::string name(boost::begin(range), boost::end(range));
+    ids_.back().assign(boost::begin(id), boost::end(id));
   }
 
-  void set(tag::attribute::dur, tag::value::media) {}
-  void set(tag::attribute::dur, tag::value::indefinite) {}
-  void set(tag::attribute::dur, double clock_seconds) {}
-
-  void set(tag::attribute::repeatDur, tag::value::indefinite) {}
-  void set(tag::attribute::repeatDur, double clock_seconds) {}
-
-  void set(tag::attribute::repeatCount, tag::value::indefinite) {}
-  void set(tag::attribute::repeatCount, double number) {}
-
-  void set(tag::attribute::min, tag::value::media) {}
-  void set(tag::attribute::min, double clock_seconds) {}
-  void set(tag::attribute::max, tag::value::media) {}
-  void set(tag::attribute::max, double clock_seconds) {}
+  template<class T>
+  static void set_text(T const & value) {}
 
-  void set(tag::attribute::restart, tag::value::always) {}
-  void set(tag::attribute::restart, tag::value::whenNotActive) {}
-  void set(tag::attribute::restart, tag::value::never) {}
+  animation_timeline<> & timeline_;
+  std::vector<std::string> ids_;
+};
 
-  void set(tag::attribute::fill, tag::value::freeze) {}
-  void set(tag::attribute::fill, tag::value::remove) {}
+template<animation_element Element>
+struct AnimateContext: collect_animation_attributes<>
+{
+  AnimateContext(NotAnimateElementContext & parent)
+    : collect_animation_attributes<>(Element, parent.ids_.back())
+    , parent_(parent)
+  {}
 
-  void set(tag::attribute::calcMode, tag::value::discrete) {}
-  void set(tag::attribute::calcMode, tag::value::linear) {}
-  void set(tag::attribute::calcMode, tag::value::paced) {}
-  void set(tag::attribute::calcMode, tag::value::spline) {}
+  template<class StringRange>
+  void set(tag::attribute::id, StringRange const &) {}
 
-  void set(tag::attribute::additive, tag::value::replace) {}
-  void set(tag::attribute::additive, tag::value::sum) {}
+  using collect_animation_attributes<>::set;
 
-  void set(tag::attribute::accumulate, tag::value::none) {}
-  void set(tag::attribute::accumulate, tag::value::sum) {}
+  void on_exit_element() 
+  {
+    parent_.timeline_.add(definition());
+  }
 
-  // Not parsed by SVG++
-  template<class StringRange>
-  void set(tag::attribute::begin, StringRange const &) {}
-  template<class StringRange>
-  void set(tag::attribute::keyTimes, StringRange const &) {}
-  template<class StringRange>
-  void set(tag::attribute::keySplines, StringRange const &) {}
-  template<class StringRange>
-  void set(tag::attribute::values, StringRange const &) {}
-  template<class StringRange>
-  void set(tag::attribute::from, StringRange const &) {}
-  template<class StringRange>
-  void set(tag::attribute::to, StringRange const &) {}
-  template<class StringRange>
-  void set(tag::attribute::by, StringRange const &) {}
-  template<class StringRange>
-  void set(tag::attribute::end, StringRange const &) {}
+private:
+  NotAnimateElementContext & parent_;
 };
 
-struct AnimateContext: BaseContext
+namespace svgpp { namespace policy { namespace basic_shapes
 {
-  template<class XMLElement>
-  AnimateContext(NotAnimateElementContext const & parent, XMLElement const & xml_element)
-  {}
-
-  void on_exit_element() {}
-};
+  template<>
+  struct by_context<NotAnimateElementContext>
+  {
+    typedef raw type;
+  };
+}}}
 
 struct ContextFactories
 {
@@ -101,36 +82,36 @@ struct ContextFactories
 template<>
 struct ContextFactories::apply<NotAnimateElementContext, svgpp::tag::element::animate>
 {
-  typedef svgpp::factory::context::on_stack_with_xml_element<AnimateContext> type;
+  typedef svgpp::factory::context::on_stack<AnimateContext<animation_animate> > type;
 };
 
 template<>
 struct ContextFactories::apply<NotAnimateElementContext, svgpp::tag::element::animateColor>
 {
-  typedef svgpp::factory::context::on_stack_with_xml_element<AnimateContext> type;
+  typedef svgpp::factory::context::on_stack<AnimateContext<animation_animate_color> > type;
 };
 
 template<>
 struct ContextFactories::apply<NotAnimateElementContext, svgpp::tag::element::animateMotion>
 {
-  typedef svgpp::factory::context::on_stack_with_xml_element<AnimateContext> type;
+  typedef svgpp::factory::context::on_stack<AnimateContext<animation_animate_motion> > type;
 };
 
 template<>
 struct ContextFactories::apply<NotAnimateElementContext, svgpp::tag::element::animateTransform>
 {
-  typedef svgpp::factory::context::on_stack_with_xml_element<AnimateContext> type;
+  typedef svgpp::factory::context::on_stack<AnimateContext<animation_animate_transform> > type;
 };
 
 template<>
 struct ContextFactories::apply<NotAnimateElementContext, svgpp::tag::element::set>
 {
-  typedef svgpp::factory::context::on_stack_with_xml_element<AnimateContext> type;
+  typedef svgpp::factory::context::on_stack<AnimateContext<animation_set> > type;
 };
 
-void parse(rapidxml_ns::xml_node<char> const * svg_element)
+void parse(rapidxml_ns::xml_node<char> const * svg_element, animation_timeline<> & timeline)
 {
-  NotAnimateElementContext context;
+  NotAnimateElementContext context(timeline);
   document_traversal<
     context_factories<ContextFactories>,
     ignored_elements<
@@ -140,6 +121,13 @@ void parse(rapidxml_ns::xml_node<char> const * svg_element)
       >::type
     >,
     processed_attributes<boost::mpl::set<
+      tag::attribute::id,
+      boost::mpl::pair<tag::element::animate, tag::attribute::xlink::href>,
+      boost::mpl::pair<tag::element::animateColor, tag::attribute::xlink::href>,
+      boost::mpl::pair<tag::element::animateMotion, tag::attribute::xlink::href>,
+      boost::mpl::pair<tag::element::animateTransform, tag::attribute::xlink::href>,
+      boost::mpl::pair<tag::element::set, tag::attribute::xlink::href>,
+      boost::mpl::pair<tag::element::animateTransform, tag::attribute::type>,
       tag::attribute::attributeType, 
       tag::attribute::attributeName,
       tag::attribute::begin, 
@@ -168,8 +156,7 @@ void parse(rapidxml_ns::xml_node<char> const * svg_element)
       tag::attribute::keyTimes, 
       tag::attribute::keySplines, 
       tag::attribute::values
-    >::type>,
-    basic_shapes_policy<policy::basic_shapes::raw>
+    >::type>
   >::load_document(svg_element, context);
 }
 
@@ -177,7 +164,7 @@ int main(int argc, char * argv[])
 {
   if (argc < 2)
   {
-    std::cout << "Usage: " << argv[0] << " <svg file name>\n";
+    std::cout << "Usage: " << argv[0] << " <svg file name> [<time in seconds>...]\n";
     return 1;
   }
 
@@ -187,7 +174,19 @@ int main(int argc, char * argv[])
 
     rapidxml_ns::xml_document<> doc;
     doc.parse<rapidxml_ns::parse_no_string_terminators>(xml_file.data());  
-    parse(doc.first_node());
+    animation_timeline<> timeline;
+    parse(doc.first_node(), timeline);
+
+    std::vector<animated_attribute> values;
+    for(int arg = 2; arg < argc; ++arg)
+    {
+      double const t = std::atof(argv[arg]);
+      timeline.evaluate(t, values);
+      std::cout << t << "s:\n";
+      for(std::vector<animated_attribute>::const_iterator it = values.begin(); it != values.end(); ++it)
+        std::cout << "  #" << *it->target_id << " " << *it->attribute_name
+          << (it->additive ? " += " : " = ") << it->value << "\n";
+    }
   }
   catch (std::exception const & e)
   {
@@ -0,0 +1,361 @@
+#include <svgpp/document_traversal.hpp>
+#include <svgpp/utility/animation_timeline.hpp>
+#include <rapidxml_ns/rapidxml_ns.hpp>
+#include <svgpp/policy/xml/rapidxml_ns.hpp>
+
+#include <gtest/gtest.h>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+
+#define TEXT(x) #x
+
+using namespace svgpp;
+
+namespace
+{
+  typedef animation_definition<> definition_t;
+
+  definition_t from_to(char const * target, char const * from, char const * to, double begin, double dur)
+  {
+    definition_t d;
+    d.target_id = target;
+    d.attribute_name = "x";
+    d.from = std::string(from);
+    d.to = std::string(to);
+    d.begin[0] = begin;
+    d.dur = dur;
+    return d;
+  }
+
+  std::string evaluate(animation_timeline<> const & timeline, double t)
+  {
+    std::vector<animated_attribute> result;
+    timeline.evaluate(t, result);
+    std::string str;
+    for(std::vector<animated_attribute>::const_iterator it = result.begin(); it != result.end(); ++it)
+      str += (str.empty() ? "" : " ") + *it->target_id + "." + *it->attribute_name
+        + (it->additive ? "+=" : "=") + it->value;
+    return str;
+  }
+}
+
+TEST(animation_timeline, linear)
+{
+  animation_timeline<> timeline;
+  timeline.add(from_to("a", "10px", "20px", 1, 2));
+  EXPECT_EQ("", evaluate(timeline, 0.5));
+  EXPECT_EQ("a.x=10px", evaluate(timeline, 1));
+  EXPECT_EQ("a.x=15px", evaluate(timeline, 2));
+  EXPECT_EQ("", evaluate(timeline, 3));
+
+  definition_t d = from_to("b", "0 0", "0 0", 0, 4);
+  d.from = boost::none;
+  d.to = boost::none;
+  d.values.push_back("0,0");
+  d.values.push_back("10,-10");
+  d.values.push_back("30,-30");
+  d.element = animation_animate_motion;
+  d.attribute_name = "transform";
+  d.freeze = true;
+  timeline.add(d);
+  // Paced: first segment is half as long as the second
+  EXPECT_EQ("b.transform+=translate(5,-5)", evaluate(timeline, 2.0 / 3));
+  EXPECT_EQ("b.transform+=translate(30,-30)", evaluate(timeline, 100));
+
+  definition_t rotate = from_to("b", "0", "90", 0, 4);
+  rotate.element = animation_animate_transform;
+  rotate.attribute_name = "transform";
+  rotate.transform_type = "rotate";
+  timeline.add(rotate);
+  // Motion isn't replaced by animateTransform
+  EXPECT_EQ("b.transform+=translate(5,-5) b.transform=rotate(15)", evaluate(timeline, 2.0 / 3));
+}
+
+TEST(animation_timeline, discrete_and_set)
+{
+  animation_timeline<> timeline;
+  definition_t d;
+  d.target_id = "a";
+  d.attribute_name = "visibility";
+  d.values.push_back("hidden");
+  d.values.push_back("visible");
+  d.dur = 2;
+  d.repeat_count = 2.5;
+  timeline.add(d);
+  EXPECT_EQ("a.visibility=hidden", evaluate(timeline, 0.5));
+  EXPECT_EQ("a.visibility=visible", evaluate(timeline, 1.5));
+  EXPECT_EQ("a.visibility=hidden", evaluate(timeline, 2.5));
+  EXPECT_EQ("a.visibility=hidden", evaluate(timeline, 4.5));
+  EXPECT_EQ("", evaluate(timeline, 5));
+
+  definition_t s(animation_set);
+  s.target_id = "a";
+  s.attribute_name = "fill";
+  s.to = std::string("red");
+  s.begin.clear();
+  s.begin.push_back(1);
+  s.begin.push_back(10);
+  s.dur = 1;
+  timeline.add(s);
+  EXPECT_EQ("a.visibility=visible a.fill=rgb(255,0,0)", evaluate(timeline, 1.25));
+  EXPECT_EQ("a.fill=rgb(255,0,0)", evaluate(timeline, 10.5));
+  EXPECT_EQ("", evaluate(timeline, 11));
+}
+
+TEST(animation_timeline, sandwich)
+{
+  animation_timeline<> timeline;
+  timeline.add(from_to("a", "0", "100", 0, 10));
+  definition_t later = from_to("a", "1000", "2000", 2, 10);
+  later.end.push_back(1);
+  later.end.push_back(4);
+  timeline.add(later);
+  definition_t additive = from_to("a", "0", "0", 3, 10);
+  additive.from = boost::none;
+  additive.to = boost::none;
+  additive.by = std::string("10");
+  timeline.add(additive);
+  EXPECT_EQ("a.x=10", evaluate(timeline, 1));
+  // Later animation replaces earlier one
+  EXPECT_EQ("a.x=1100 a.x+=0", evaluate(timeline, 3));
+  EXPECT_EQ("a.x=1150 a.x+=0.5", evaluate(timeline, 3.5));
+  // Ended by end attribute
+  EXPECT_EQ("a.x=50 a.x+=2", evaluate(timeline, 5));
+}
+
+TEST(animation_timeline, restart)
+{
+  animation_timeline<> timeline;
+  definition_t d = from_to("a", "0", "10", 0, 5);
+  d.additive_sum = true;
+  d.freeze = true;
+  d.begin.push_back(1);
+  timeline.add(d);
+  EXPECT_EQ(2, timeline.intervals_count());
+  // Second begin instance restarts the animation, its value is added once
+  EXPECT_EQ("a.x+=1", evaluate(timeline, 0.5));
+  EXPECT_EQ("a.x+=2", evaluate(timeline, 2));
+  EXPECT_EQ("a.x+=10", evaluate(timeline, 7));
+
+  d.target_id = "b";
+  d.begin[0] = 0;
+  d.begin[1] = 3;
+  d.begin.push_back(6);
+  d.restart = animation_restart_when_not_active;
+  timeline.add(d);
+  d.target_id = "c";
+  d.restart = animation_restart_never;
+  timeline.add(d);
+  EXPECT_EQ("a.x+=6 b.x+=8 c.x+=8", evaluate(timeline, 4));
+  // Frozen value of 'b' is replaced when it begins again
+  EXPECT_EQ("a.x+=10 b.x+=2 c.x+=10", evaluate(timeline, 7));
+}
+
+TEST(animation_timeline, color_transform_spline)
+{
+  animation_timeline<> timeline;
+  definition_t color(animation_animate_color);
+  color.target_id = "a";
+  color.attribute_name = "fill";
+  color.from = std::string("red");
+  color.to = std::string("#0000ff");
+  color.dur = 2;
+  timeline.add(color);
+
+  definition_t transform(animation_animate_transform);
+  transform.target_id = "b";
+  transform.attribute_name = "transform";
+  transform.transform_type = "rotate";
+  transform.values.push_back("0 50 50");
+  transform.values.push_back("360 50 50");
+  transform.dur = 2;
+  transform.repeat_count = 2;
+  transform.accumulate_sum = true;
+  transform.freeze = true;
+  timeline.add(transform);
+
+  definition_t spline = from_to("c", "0", "100", 0, 1);
+  spline.calc_mode = animation_calc_mode_spline;
+  boost::array<double, 4> const ease = {{ 0.42, 0, 1, 1 }};
+  spline.key_splines.push_back(ease);
+  timeline.add(spline);
+
+  std::vector<animated_attribute> result;
+  timeline.evaluate(0.5, result);
+  ASSERT_EQ(3, result.size());
+  EXPECT_EQ("rgb(191,0,64)", result[0].value);
+  EXPECT_EQ("rotate(90 50 50)", result[1].value);
+  // Ease-in is slower than linear at start
+  double const eased = std::atof(result[2].value.c_str());
+  EXPECT_LT(eased, 50);
+  EXPECT_GT(eased, 25);
+
+  EXPECT_EQ("b.transform=rotate(540 50 50)", evaluate(timeline, 3));
+  EXPECT_EQ("b.transform=rotate(720 50 50)", evaluate(timeline, 10));
+}
+
+TEST(animation_timeline, to_animation)
+{
+  animation_timeline<> timeline;
+  definition_t d = from_to("a", "", "30", 0, 2);
+  d.from = boost::none;
+  timeline.add(d);
+  EXPECT_EQ("a.x=30", evaluate(timeline, 1));
+  timeline.set_base_value("a", "x", "10");
+  EXPECT_EQ("a.x=20", evaluate(timeline, 1));
+}
+
+TEST(animation_timeline, interval_query)
+{
+  // Compare active intervals with brute force search
+  boost::random::mt19937 gen(1);
+  boost::random::uniform_real_distribution<> position(0, 100), duration(0, 10);
+  animation_timeline<> timeline;
+  std::vector<std::pair<double, double> > intervals;
+  for(int i = 0; i < 1000; ++i)
+  {
+    std::ostringstream target;
+    target << i;
+    definition_t d = from_to(target.str().c_str(), "0", "1", position(gen), duration(gen) + 0.01);
+    intervals.push_back(std::make_pair(d.begin[0], d.begin[0] + *d.dur));
+    timeline.add(d);
+  }
+  EXPECT_EQ(1000, timeline.intervals_count());
+  std::vector<animated_attribute> result;
+  for(double t = -1; t < 111; t += 0.37)
+  {
+    std::size_t expected = 0;
+    for(std::size_t i = 0; i < intervals.size(); ++i)
+      if (intervals[i].first <= t && t < intervals[i].second)
+        ++expected;
+    timeline.evaluate(t, result);
+    EXPECT_EQ(expected, result.size());
+  }
+}
+
+namespace
+{
+  struct DocumentContext
+  {
+    DocumentContext(animation_timeline<> & timeline)
+      : timeline_(timeline)
+      , ids_(1)
+    {}
+
+    void on_enter_element(tag::element::any)
+    {
+      ids_.push_back(std::string());
+    }
+
+    void on_exit_element()
+    {
+      ids_.pop_back();
+    }
+
+    template<class StringRange>
+    void set(tag::attribute::id, StringRange const & id)
+    {
+      ids_.back().assign(boost::begin(id), boost::end(id));
+    }
+
+    animation_timeline<> & timeline_;
+    std::vector<std::string> ids_;
+  };
+
+  template<animation_element Element>
+  struct AnimationContext: collect_animation_attributes<>
+  {
+    AnimationContext(DocumentContext & parent)
+      : collect_animation_attributes<>(Element, parent.ids_.back())
+      , parent_(parent)
+    {}
+
+    void on_exit_element()
+    {
+      parent_.timeline_.add(definition());
+    }
+
+  private:
+    DocumentContext & parent_;
+  };
+
+  struct ContextFactories
+  {
+    template<class ParentContext, class ElementTag>
+    struct apply
+    {
+      typedef factory::context::same<ParentContext, ElementTag> type;
+    };
+  };
+}
+
+template<>
+struct ContextFactories::apply<DocumentContext, tag::element::animate>
+{
+  typedef factory::context::on_stack<AnimationContext<animation_animate> > type;
+};
+
+template<>
+struct ContextFactories::apply<DocumentContext, tag::element::set>
+{
+  typedef factory::context::on_stack<AnimationContext<animation_set> > type;
+};
+
+template<>
+struct ContextFactories::apply<DocumentContext, tag::element::animateTransform>
+{
+  typedef factory::context::on_stack<AnimationContext<animation_animate_transform> > type;
+};
+
+TEST(animation_timeline, document)
+{
+  char const xml[] =
+    TEXT(<svg xmlns="http://www.w3.org/2000/svg" xmlns:xlink="http://www.w3.org/1999/xlink">)
+    TEXT(<g id="r">)
+    TEXT(  <animate attributeName="opacity" from="0" to="1" begin="1s" dur="00:02" fill="freeze"/>)
+    TEXT(  <set attributeName="visibility" to="hidden" begin="indefinite"/>)
+    TEXT(</g>)
+    TEXT(<g id="g"/>)
+    TEXT(<animateTransform xlink:href="#g" attributeName="transform" type="scale" )
+    TEXT(  values="1;2;4" keyTimes="0;0.8;1" begin="-1s; 2s" dur="1s"/>)
+    TEXT(</svg>);
+  std::vector<char> buffer(xml, xml + sizeof(xml));
+  rapidxml_ns::xml_document<char> doc;
+  doc.parse<0>(&buffer[0]);
+
+  animation_timeline<> timeline;
+  DocumentContext context(timeline);
+  EXPECT_TRUE((document_traversal<
+    context_factories<ContextFactories>,
+    processed_elements<boost::mpl::set<
+      tag::element::svg,
+      tag::element::g,
+      tag::element::animate,
+      tag::element::set,
+      tag::element::animateTransform
+    >::type>,
+    processed_attributes<boost::mpl::set<
+      boost::mpl::pair<tag::element::g, tag::attribute::id>,
+      tag::attribute::xlink::href,
+      tag::attribute::attributeName,
+      boost::mpl::pair<tag::element::animateTransform, tag::attribute::type>,
+      tag::attribute::begin,
+      tag::attribute::dur,
+      boost::mpl::pair<tag::element::animate, tag::attribute::fill>,
+      tag::attribute::keyTimes,
+      tag::attribute::from,
+      tag::attribute::to,
+      boost::mpl::pair<tag::element::animateTransform, tag::attribute::values>
+    >::type>,
+    passthrough_attributes<boost::mpl::set<
+      tag::attribute::keyTimes,
+      tag::attribute::values
+    >::type>
+  >::load_document(doc.first_node(), context)));
+
+  EXPECT_EQ(3, timeline.intervals_count());
+  EXPECT_EQ("g.transform=scale(1.5)", evaluate(timeline, -0.6));
+  EXPECT_EQ("r.opacity=0.25", evaluate(timeline, 1.5));
+  EXPECT_EQ("r.opacity=0.95 g.transform=scale(3)", evaluate(timeline, 2.9));
+  EXPECT_EQ("r.opacity=1", evaluate(timeline, 4));
+}
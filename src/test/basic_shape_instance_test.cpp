@@ -0,0 +1,155 @@
+#include <svgpp/document_traversal.hpp>
+#include <svgpp/utility/unit_shape_outline.hpp>
+#include <rapidxml_ns/rapidxml_ns.hpp>
+#include <svgpp/policy/xml/rapidxml_ns.hpp>
+
+#include <gtest/gtest.h>
+#include <sstream>
+
+#include "test_path_context.hpp"
+
+#define TEXT(x) #x
+
+namespace
+{
+  class InstanceContext: public test_path_context
+  {
+  public:
+    void set_unit_shape_instance(svgpp::tag::element::rect, boost::array<double, 6> const & matrix)
+    {
+      add("rect", matrix);
+    }
+
+    void set_unit_shape_instance(svgpp::tag::element::circle, boost::array<double, 6> const & matrix)
+    {
+      add("circle", matrix);
+    }
+
+    void set_unit_shape_instance(svgpp::tag::element::ellipse, boost::array<double, 6> const & matrix)
+    {
+      add("ellipse", matrix);
+    }
+
+    void set_unit_shape_instance(svgpp::tag::element::line, boost::array<double, 6> const & matrix)
+    {
+      add("line", matrix);
+    }
+
+    void on_enter_element(svgpp::tag::element::any) const {}
+    void on_exit_element() const {}
+
+    std::string instances() const { return instances_.str(); }
+
+  private:
+    std::ostringstream instances_;
+
+    void add(char const * shape, boost::array<double, 6> const & matrix)
+    {
+      instances_ << shape << "(";
+      for(int i = 0; i < 6; ++i)
+        instances_ << (i ? "," : "") << matrix[i];
+      instances_ << ")";
+    }
+  };
+
+}
+
+namespace svgpp { namespace policy { namespace basic_shapes
+{
+  template<>
+  struct by_context<InstanceContext>
+  {
+    typedef instance_shapes type;
+  };
+}}}
+
+namespace
+{
+  char const xml1[] =
+    TEXT(<svg xmlns = "http://www.w3.org/2000/svg">)
+    TEXT(<rect x="100" y="150" width="400" height="200"/>)
+    TEXT(<rect x="100" y="150" width="400" height="200" rx="50"/>)
+    TEXT(<ellipse cx="2.5" cy="1.5" rx="2" ry="1"/>)
+    TEXT(<line x1="100" y1="300" x2="350" y2="150"/>)
+    TEXT(<circle cx="600" cy="200" r="100"/>)
+    TEXT(<circle cx="10" cy="20" r="0"/>)
+    TEXT(<polyline points="1 2 3 4"/>)
+    TEXT(</svg>)
+    ;
+
+  template<class Number>
+  void transform_point(boost::array<Number, 6> const & m, Number x, Number y, Number & tx, Number & ty)
+  {
+    tx = m[0] * x + m[2] * y + m[4];
+    ty = m[1] * x + m[3] * y + m[5];
+  }
+}
+
+TEST(basic_shape_instance, document)
+{
+  std::vector<char> xml(xml1, xml1 + strlen(xml1) + 1);
+  rapidxml_ns::xml_document<char> doc;
+  doc.parse<0>(&xml[0]);
+  ASSERT_TRUE(doc.first_node() != NULL);
+
+  InstanceContext context;
+  EXPECT_TRUE((
+    svgpp::document_traversal<
+      svgpp::processed_elements<
+        boost::mpl::set<
+          svgpp::tag::element::svg,
+          svgpp::tag::element::ellipse,
+          svgpp::tag::element::rect,
+          svgpp::tag::element::line,
+          svgpp::tag::element::circle,
+          svgpp::tag::element::polyline
+        >::type
+      >,
+      svgpp::processed_attributes<
+        svgpp::traits::shapes_attributes_by_element
+      >,
+      svgpp::basic_shapes_events_policy<svgpp::policy::basic_shapes_events::instance_of_unit_shape<InstanceContext> >
+    >::load_document(doc.first_node(), context)));
+  EXPECT_EQ(
+    "rect(400,0,0,200,100,150)"
+    "ellipse(2,0,0,1,2.5,1.5)"
+    "line(250,-150,150,250,100,300)"
+    "circle(100,0,0,100,600,200)",
+    context.instances());
+  // Rounded rectangle and polyline are converted to path
+  EXPECT_EQ(
+    "M150,150L450,150A50,50,0,0,1,500,200L500,300A50,50,0,0,1,450,350L150,350A50,50,0,0,1,100,300L100,200A50,50,0,0,1,150,150Z"
+    "M1,2L3,4",
+    context.str());
+}
+
+TEST(basic_shape_instance, outline)
+{
+  typedef svgpp::unit_shape_outline<double> outline;
+  outline::circle_type const & circle = outline::circle();
+  EXPECT_EQ(&circle, &outline::circle());
+  // Every on-curve point and midpoint of every segment lie on unit circle
+  for(int i = 0; i < 4; ++i)
+  {
+    double const * p = &circle[i * 6];
+    EXPECT_NEAR(1, std::sqrt(p[6] * p[6] + p[7] * p[7]), 1e-12);
+    double const mx = (p[0] + 3 * p[2] + 3 * p[4] + p[6]) / 8;
+    double const my = (p[1] + 3 * p[3] + 3 * p[5] + p[7]) / 8;
+    EXPECT_NEAR(1, std::sqrt(mx * mx + my * my), 1e-12);
+  }
+  // Same direction as circle_to_path_adapter: (1, 0) -> (0, 1) -> (-1, 0)
+  EXPECT_EQ(0, circle[6]);
+  EXPECT_EQ(1, circle[7]);
+
+  // Instance matrix maps outline to shape geometry
+  boost::array<double, 6> const line_matrix = {{ 250, -150, 150, 250, 100, 300 }};
+  outline::line_type const & line = outline::line();
+  double x, y;
+  transform_point(line_matrix, line[2], line[3], x, y);
+  EXPECT_EQ(350, x);
+  EXPECT_EQ(150, y);
+  boost::array<double, 6> const rect_matrix = {{ 400, 0, 0, 200, 100, 150 }};
+  transform_point(rect_matrix, outline::square()[4], outline::square()[5], x, y);
+  EXPECT_EQ(500, x);
+  EXPECT_EQ(350, y);
+}
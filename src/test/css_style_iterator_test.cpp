@@ -1,6 +1,7 @@
 #include <svgpp/parser/css_style_iterator.hpp>
 
 #include <gtest/gtest.h>
+#include <list>
 
 void check_single_property(std::string const & style)
 {
@@ -66,4 +67,34 @@ TEST(css_style_iterator, valid2)
   EXPECT_EQ("value2", std::string(it->second.begin(), it->second.end()));
   ++it;
   EXPECT_TRUE(it.eof());
-}
\ No newline at end of file
+}
+
+TEST(css_style_iterator, iterator_types)
+{
+  std::string const style(";; : error; name1 : value1 ;\tname2:\r\nvalue 2\t");
+
+  char const * pointer = style.c_str();
+  svgpp::css_style_iterator<char const *> it1(pointer, pointer + style.size());
+  std::list<char> list(style.begin(), style.end());
+  svgpp::css_style_iterator<std::list<char>::const_iterator> it2(list.begin(), list.end());
+  std::wstring const wstyle(style.begin(), style.end());
+  svgpp::css_style_iterator<wchar_t const *> it3(wstyle.c_str(), wstyle.c_str() + wstyle.size());
+
+  for(int i = 0; i < 2; ++i, ++it1, ++it2, ++it3)
+  {
+    ASSERT_TRUE(!it1.eof());
+    ASSERT_TRUE(!it2.eof());
+    ASSERT_TRUE(!it3.eof());
+    std::string const name(it1->first.begin(), it1->first.end());
+    std::string const value(it1->second.begin(), it1->second.end());
+    EXPECT_EQ(i == 0 ? "name1" : "name2", name);
+    EXPECT_EQ(i == 0 ? "value1" : "value 2", value);
+    EXPECT_EQ(name, std::string(it2->first.begin(), it2->first.end()));
+    EXPECT_EQ(value, std::string(it2->second.begin(), it2->second.end()));
+    EXPECT_TRUE(std::wstring(name.begin(), name.end()) == std::wstring(it3->first.begin(), it3->first.end()));
+    EXPECT_TRUE(std::wstring(value.begin(), value.end()) == std::wstring(it3->second.begin(), it3->second.end()));
+  }
+  EXPECT_TRUE(it1.eof());
+  EXPECT_TRUE(it2.eof());
+  EXPECT_TRUE(it3.eof());
+}
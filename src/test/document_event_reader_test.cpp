@@ -0,0 +1,146 @@
+#include <svgpp/utility/document_event_reader.hpp>
+#include <rapidxml_ns/rapidxml_ns.hpp>
+#include <svgpp/policy/xml/rapidxml_ns.hpp>
+#include "test_event_log_context.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace svgpp;
+
+namespace
+{
+  typedef boost::mpl::set<
+    tag::element::svg,
+    tag::element::g,
+    tag::element::a,
+    tag::element::path,
+    tag::element::rect,
+    tag::element::text
+  >::type processed_elements_t;
+
+  typedef boost::mpl::set<
+    tag::attribute::viewBox,
+    tag::attribute::transform,
+    tag::attribute::d,
+    tag::attribute::x,
+    tag::attribute::width,
+    tag::attribute::height,
+    tag::attribute::fill,
+    tag::attribute::stroke_width
+  >::type processed_attributes_t;
+
+  typedef document_event_reader<
+    rapidxml_ns::xml_node<> const *,
+    processed_elements<processed_elements_t>,
+    processed_attributes<processed_attributes_t>
+  > reader_t;
+
+  char const document[] =
+    "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"0 0 100 200\">"
+      "<g transform=\"translate(10 20)\" fill=\"none\">"
+        "<path d=\"M10 20 l30 40 z\" stroke-width=\"2.5\"/>"
+        "<circle r=\"5\"/>"
+        "<a><rect x=\"1\" width=\"30\" height=\"40\"/></a>"
+        "<text>Hello<a>World</a></text>"
+      "</g>"
+      "<g><path d=\"M1 2\"/></g>"
+    "</svg>";
+
+  struct parsed_document
+  {
+    parsed_document(char const * text)
+      : buffer_(text, text + std::strlen(text) + 1)
+    {
+      doc_.parse<0>(&buffer_[0]);
+    }
+
+    rapidxml_ns::xml_node<> const * root() const { return doc_.first_node(); }
+
+  private:
+    std::vector<char> buffer_;
+    rapidxml_ns::xml_document<> doc_;
+  };
+}
+
+TEST(document_event_reader, same_events_as_document_traversal)
+{
+  parsed_document doc(document);
+  test_event_log_context expected;
+  document_traversal<
+    processed_elements<processed_elements_t>,
+    processed_attributes<processed_attributes_t>
+  >::load_document(doc.root(), expected);
+
+  test_event_log_context pulled;
+  reader_t reader(doc.root());
+  int elements = 0, exits = 0;
+  while (reader.next())
+  {
+    if (reader.type() == document_event_type::enter_element)
+      ++elements;
+    else if (reader.type() == document_event_type::exit_element)
+      ++exits;
+    EXPECT_TRUE(reader.play<processed_attributes_t>(pulled));
+  }
+  EXPECT_EQ(expected.log_.str(), pulled.log_.str());
+  // Root element has no enter/exit events as in document_traversal, 'circle' isn't processed
+  EXPECT_EQ(8, elements);
+  EXPECT_EQ(8, exits);
+  EXPECT_FALSE(reader.next());
+}
+
+TEST(document_event_reader, skipped_events_and_depth)
+{
+  parsed_document doc(document);
+  reader_t reader(doc.root());
+  std::ostringstream types;
+  while (reader.next())
+  {
+    if (reader.depth() > 2)
+      continue;
+    types << reader.depth() << ":" << static_cast<int>(reader.type()) << " ";
+  }
+  EXPECT_EQ("1:2 2:0 2:2 2:5 2:1 2:0 2:1 ", types.str());
+}
+
+TEST(document_event_reader, early_stop)
+{
+  parsed_document doc(document);
+  reader_t reader(doc.root());
+  ASSERT_TRUE(reader.next());
+  ASSERT_TRUE(reader.is_attribute(tag::attribute::viewBox()));
+  test_event_log_context context;
+  EXPECT_TRUE(reader.play<processed_attributes_t>(context));
+  EXPECT_EQ(" a" + boost::lexical_cast<std::string>(detail::attribute_id_viewBox) + "=0;0;100;200;",
+    context.log_.str());
+}
+
+TEST(document_event_reader, skip_element)
+{
+  parsed_document doc(document);
+  reader_t reader(doc.root());
+  test_event_log_context context;
+  bool skipped = false;
+  while (reader.next())
+  {
+    reader.play<processed_attributes_t>(context);
+    if (!skipped && reader.is_element(tag::element::g()))
+    {
+      reader.skip_element();
+      skipped = true;
+    }
+  }
+  std::ostringstream expected;
+  expected << " a" << detail::attribute_id_viewBox << "=0;0;100;200;"
+    << "<" << detail::element_type_id_g << "></>"
+    << "<" << detail::element_type_id_g << "><" << detail::element_type_id_path << ">"
+    << " M1,2 exit</></>";
+  EXPECT_EQ(expected.str(), context.log_.str());
+}
+
+TEST(document_event_reader, unexpected_element)
+{
+  parsed_document doc("<svg xmlns=\"http://www.w3.org/2000/svg\"><a><a/></a></svg>");
+  reader_t reader(doc.root());
+  EXPECT_THROW(while (reader.next()) {}, unexpected_element_error);
+}
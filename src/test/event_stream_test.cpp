@@ -0,0 +1,139 @@
+#include <svgpp/document_traversal.hpp>
+#include <svgpp/utility/event_stream.hpp>
+#include <rapidxml_ns/rapidxml_ns.hpp>
+#include <svgpp/policy/xml/rapidxml_ns.hpp>
+#include "test_event_log_context.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace svgpp;
+
+namespace
+{
+  typedef boost::mpl::set<
+    tag::element::svg,
+    tag::element::g,
+    tag::element::path,
+    tag::element::rect,
+    tag::element::text
+  >::type processed_elements_t;
+
+  typedef boost::mpl::set<
+    tag::attribute::viewBox,
+    tag::attribute::preserveAspectRatio,
+    tag::attribute::transform,
+    tag::attribute::d,
+    tag::attribute::x,
+    tag::attribute::y,
+    tag::attribute::width,
+    tag::attribute::height,
+    tag::attribute::fill,
+    tag::attribute::stroke,
+    tag::attribute::stroke_width,
+    tag::attribute::stroke_dasharray,
+    tag::attribute::display,
+    tag::attribute::text_decoration,
+    tag::attribute::enable_background
+  >::type processed_attributes_t;
+
+  template<class Context>
+  void traverse(std::string const & svg, Context & context)
+  {
+    std::vector<char> buffer(svg.begin(), svg.end());
+    buffer.push_back('\0');
+    rapidxml_ns::xml_document<> doc;
+    doc.parse<0>(&buffer[0]);
+    document_traversal<
+      processed_elements<processed_elements_t>,
+      processed_attributes<processed_attributes_t>
+    >::load_document(doc.first_node(), context);
+  }
+
+  std::string const document(
+    "<svg xmlns=\"http://www.w3.org/2000/svg\" viewBox=\"0 0 100 200\" preserveAspectRatio=\"xMidYMax slice\">"
+      "<g transform=\"translate(10 20) rotate(30)\" style=\"fill: url(#grad) none; stroke: #ff8000\""
+        " enable-background=\"new 1 2 3 4\">"
+        "<path d=\"M10 20 l30 40 C1 2 3 4 5 6 q 1 2 3 4 A 5 6 7 1 0 8 9 z\" stroke-width=\"2.5\""
+          " stroke-dasharray=\"1 2 3.5\"/>"
+        "<rect x=\"1\" y=\"2\" width=\"30\" height=\"40\" display=\"none\" fill=\"currentColor\"/>"
+        "<text text-decoration=\"underline blink\">Hello</text>"
+      "</g>"
+    "</svg>");
+}
+
+TEST(event_stream, replay)
+{
+  test_event_log_context expected;
+  traverse(document, expected);
+
+  event_stream_writer writer;
+  traverse(document, writer);
+
+  // Copy to storage aligned as if it was memory mapped
+  std::vector<double> storage(writer.data().size() / sizeof(double) + 1);
+  std::memcpy(&storage[0], &writer.data()[0], writer.data().size());
+
+  test_event_log_context replayed;
+  EXPECT_EQ(0, event_stream_player<processed_attributes_t>::play(
+    reinterpret_cast<char const *>(&storage[0]), writer.data().size(), replayed));
+  EXPECT_EQ(expected.log_.str(), replayed.log_.str());
+}
+
+TEST(event_stream, unprocessed_attributes_skipped)
+{
+  event_stream_writer writer;
+  traverse(document, writer);
+
+  std::vector<double> storage(writer.data().size() / sizeof(double) + 1);
+  std::memcpy(&storage[0], &writer.data()[0], writer.data().size());
+
+  test_event_log_context replayed;
+  EXPECT_LT(0, event_stream_player<boost::mpl::set<tag::attribute::d>::type>::play(
+    reinterpret_cast<char const *>(&storage[0]), writer.data().size(), replayed));
+  EXPECT_EQ(std::string::npos, replayed.log_.str().find(" a"));
+  EXPECT_NE(std::string::npos, replayed.log_.str().find(" M10,20"));
+}
+
+TEST(event_stream, invalid_stream)
+{
+  std::vector<double> storage(16);
+  char const * data = reinterpret_cast<char const *>(&storage[0]);
+  test_event_log_context context;
+  EXPECT_THROW(event_stream_player<processed_attributes_t>::play(data, 16, context), event_stream_error);
+
+  event_stream_writer writer;
+  traverse(document, writer);
+  std::memcpy(&storage[0], &writer.data()[0], 50);
+  // Truncated stream
+  EXPECT_THROW(event_stream_player<processed_attributes_t>::play(data, 50, context), event_stream_error);
+}
+
+TEST(event_stream, invalid_list_of_points)
+{
+  event_stream_writer writer;
+  std::vector<std::pair<double, double> > points(2, std::make_pair(1.0, 2.0));
+  writer.set(tag::attribute::points(), points);
+
+  std::vector<double> storage(writer.data().size() / sizeof(double) + 1);
+  std::memcpy(&storage[0], &writer.data()[0], writer.data().size());
+  char * data = reinterpret_cast<char *>(&storage[0]);
+  test_event_log_context context;
+  EXPECT_NO_THROW(event_stream_player<processed_attributes_t>::play(data, writer.data().size(), context));
+
+  // Count of numbers follows operation, attribute id and signature
+  boost::uint32_t const odd_count = 3;
+  std::memcpy(data + detail::event_stream_header_size + 4, &odd_count, sizeof(odd_count));
+  EXPECT_THROW(event_stream_player<processed_attributes_t>::play(data, writer.data().size(), context), event_stream_error);
+}
+
+TEST(event_stream, unaligned_stream)
+{
+  event_stream_writer writer;
+  traverse(document, writer);
+
+  std::vector<double> storage(writer.data().size() / sizeof(double) + 2);
+  char * data = reinterpret_cast<char *>(&storage[0]) + 1;
+  std::memcpy(data, &writer.data()[0], writer.data().size());
+  test_event_log_context context;
+  EXPECT_THROW(event_stream_player<processed_attributes_t>::play(data, writer.data().size(), context), event_stream_error);
+}
@@ -0,0 +1,263 @@
+#include <svgpp/utility/gil/blend.hpp>
+#include <svgpp/utility/gil/color_matrix.hpp>
+#include <svgpp/utility/gil/composite.hpp>
+
+#include <gtest/gtest.h>
+#include <boost/gil/image.hpp>
+#include <boost/gil/image_view_factory.hpp>
+#include <boost/random/mersenne_twister.hpp>
+#include <boost/random/uniform_int_distribution.hpp>
+#include <boost/random/uniform_real_distribution.hpp>
+#include <vector>
+
+using namespace svgpp;
+namespace gil = boost::gil;
+
+namespace
+{
+  typedef gil::rgba8_image_t image_t;
+
+  // Widths cover both full SIMD blocks and scalar tails
+  int const widths[] = { 1, 3, 4, 7, 8, 9, 15, 16, 17, 70 };
+  int const height = 5;
+
+  void fill_random(image_t::view_t const & view, boost::random::mt19937 & gen)
+  {
+    // Extreme values are more likely to reveal rounding and clamping differences
+    boost::random::uniform_int_distribution<> value(-64, 255 + 64);
+    for(gil::rgba8_view_t::iterator it = view.begin(); it != view.end(); ++it)
+      for(int c = 0; c < 4; ++c)
+      {
+        int const v = value(gen);
+        (*it)[c] = boost::uint8_t(v < 0 ? 0 : v > 255 ? 255 : v);
+      }
+  }
+
+  ::testing::AssertionResult views_equal(gil::rgba8c_view_t const & expected, gil::rgba8c_view_t const & actual)
+  {
+    for(std::ptrdiff_t y = 0; y < expected.height(); ++y)
+      for(std::ptrdiff_t x = 0; x < expected.width(); ++x)
+        for(int c = 0; c < 4; ++c)
+          if (expected(x, y)[c] != actual(x, y)[c])
+            return ::testing::AssertionFailure() << "pixel (" << x << ", " << y << ") channel " << c
+              << ": expected " << int(expected(x, y)[c]) << ", actual " << int(actual(x, y)[c]);
+    return ::testing::AssertionSuccess();
+  }
+
+  // Runs 'test' for each instruction set supported by CPU
+  template<class Test>
+  void for_each_instruction_set(Test test)
+  {
+#if defined(SVGPP_GIL_SIMD_AVX2)
+    bool const use_avx2 = gil_detail::simd::use_avx2();
+    gil_detail::simd::use_avx2() = false;
+    test();
+    if (gil_detail::simd::cpu_supports_avx2())
+    {
+      gil_detail::simd::use_avx2() = true;
+      test();
+    }
+    gil_detail::simd::use_avx2() = use_avx2;
+#else
+    test();
+#endif
+  }
+
+  template<class ViewsFn, class ScalarFn>
+  struct BinaryOperationTest
+  {
+    BinaryOperationTest(ViewsFn const & views_fn, ScalarFn const & scalar_fn)
+      : views_fn_(views_fn)
+      , scalar_fn_(scalar_fn)
+    {}
+
+    void operator()() const
+    {
+      boost::random::mt19937 gen(1);
+      for(std::size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w)
+      {
+        int const width = widths[w];
+        image_t a(width, height), b(width, height), expected(width, height), actual(width, height);
+        fill_random(gil::view(a), gen);
+        fill_random(gil::view(b), gen);
+        gil::transform_pixels(gil::const_view(a), gil::const_view(b), gil::view(expected), scalar_fn_);
+        views_fn_(gil::const_view(a), gil::const_view(b), gil::view(actual));
+        EXPECT_TRUE(views_equal(gil::const_view(expected), gil::const_view(actual))) << "width " << width;
+
+        if (width > 1)
+        {
+          // In place on subimage, which rows aren't adjacent
+          image_t result(b);
+          gil::rgba8_view_t const sub = gil::subimage_view(gil::view(result), 1, 1, width - 1, height - 2);
+          views_fn_(gil::subimage_view(gil::const_view(a), 1, 1, width - 1, height - 2), sub, sub);
+          EXPECT_TRUE(views_equal(
+            gil::subimage_view(gil::const_view(expected), 1, 1, width - 1, height - 2), sub)) << "width " << width;
+        }
+      }
+    }
+
+  private:
+    ViewsFn const views_fn_;
+    ScalarFn const scalar_fn_;
+  };
+
+  template<class ViewsFn, class ScalarFn>
+  void test_binary_operation(ViewsFn const & views_fn, ScalarFn const & scalar_fn)
+  {
+    for_each_instruction_set(BinaryOperationTest<ViewsFn, ScalarFn>(views_fn, scalar_fn));
+  }
+
+  template<class BlendModeTag>
+  struct BlendPixels
+  {
+    void operator()(gil::rgba8c_view_t const & a, gil::rgba8c_view_t const & b, gil::rgba8_view_t const & dst) const
+    {
+      gil_utility::blend_pixels<BlendModeTag>(a, b, dst);
+    }
+  };
+
+  template<class CompositeModeTag>
+  struct CompositePixels
+  {
+    void operator()(gil::rgba8c_view_t const & a, gil::rgba8c_view_t const & b, gil::rgba8_view_t const & dst) const
+    {
+      gil_utility::composite_pixels<CompositeModeTag>(a, b, dst);
+    }
+  };
+
+  struct CompositePixelsArithmetic
+  {
+    double k1, k2, k3, k4;
+
+    void operator()(gil::rgba8c_view_t const & a, gil::rgba8c_view_t const & b, gil::rgba8_view_t const & dst) const
+    {
+      gil_utility::composite_pixels_arithmetic(a, b, dst, k1, k2, k3, k4);
+    }
+  };
+
+  template<class BlendModeTag>
+  void test_blend()
+  {
+    test_binary_operation(BlendPixels<BlendModeTag>(), gil_utility::blend_pixel<BlendModeTag>());
+  }
+
+  template<class CompositeModeTag>
+  void test_composite()
+  {
+    test_binary_operation(CompositePixels<CompositeModeTag>(), gil_utility::composite_pixel<CompositeModeTag>());
+  }
+
+  typedef gil_utility::color_matrix_transform<gil::rgba8_pixel_t> color_matrix_t;
+
+  struct ColorMatrixTest
+  {
+    ColorMatrixTest(color_matrix_t const & transform, boost::random::mt19937 & gen)
+      : transform_(transform)
+      , gen_(gen)
+    {}
+
+    void operator()() const
+    {
+      for(std::size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w)
+      {
+        image_t src(widths[w], height), expected(widths[w], height), actual(widths[w], height);
+        fill_random(gil::view(src), gen_);
+        gil::transform_pixels(gil::const_view(src), gil::view(expected), transform_);
+        gil_utility::color_matrix_pixels(gil::const_view(src), gil::view(actual), transform_);
+        EXPECT_TRUE(views_equal(gil::const_view(expected), gil::const_view(actual))) << "width " << widths[w];
+      }
+    }
+
+  private:
+    color_matrix_t const & transform_;
+    boost::random::mt19937 & gen_;
+  };
+}
+
+TEST(gil_simd, blend)
+{
+  test_blend<tag::value::normal>();
+  test_blend<tag::value::multiply>();
+  test_blend<tag::value::screen>();
+  test_blend<tag::value::darken>();
+  test_blend<tag::value::lighten>();
+}
+
+TEST(gil_simd, composite)
+{
+  test_composite<tag::value::over>();
+  test_composite<tag::value::in>();
+  test_composite<tag::value::out>();
+  test_composite<tag::value::atop>();
+  test_composite<tag::value::xor_>();
+}
+
+TEST(gil_simd, composite_arithmetic)
+{
+  double const coefficients[][4] = {
+    { 0, 0, 0, 0 },
+    { 1, 0, 0, 0 },
+    { 0, 1, 1, 0 },
+    { 0.5, 0.25, -0.75, 0.1 },
+    { -1, 2, -2, -0.5 },
+    { 4, -3.3, 0.7, 1 },
+  };
+  for(std::size_t i = 0; i < sizeof(coefficients) / sizeof(coefficients[0]); ++i)
+  {
+    double const * k = coefficients[i];
+    CompositePixelsArithmetic const views_fn = { k[0], k[1], k[2], k[3] };
+    test_binary_operation(views_fn, gil_utility::composite_pixel_arithmetic<gil::rgba8_pixel_t>(k[0], k[1], k[2], k[3]));
+  }
+}
+
+TEST(gil_simd, color_matrix)
+{
+  std::vector<color_matrix_t> transforms;
+  transforms.push_back(color_matrix_t(gil_utility::get_saturate_matrix(0.3)));
+  transforms.push_back(color_matrix_t(gil_utility::get_hue_rotate_matrix(2.0)));
+  boost::random::mt19937 gen(1);
+  boost::random::uniform_real_distribution<> coefficient(-2, 2), offset(-300, 300);
+  for(int i = 0; i < 4; ++i)
+  {
+    color_matrix_t::matrix_t m(boost::extents[4][5]);
+    for(int r = 0; r < 4; ++r)
+    {
+      for(int c = 0; c < 4; ++c)
+        m[r][c] = coefficient(gen);
+      m[r][4] = offset(gen);
+    }
+    transforms.push_back(color_matrix_t(m));
+  }
+
+  for(std::size_t t = 0; t < transforms.size(); ++t)
+    for_each_instruction_set(ColorMatrixTest(transforms[t], gen));
+}
+
+#if defined(SVGPP_GIL_SIMD)
+TEST(gil_simd, division)
+{
+  boost::random::mt19937 gen(1);
+  boost::random::uniform_int_distribution<boost::uint32_t> value;
+  std::vector<boost::uint32_t> values;
+  for(boost::uint32_t k = 0; k < 70000; ++k)
+  {
+    values.push_back(k * 255);
+    values.push_back(k * 255 - 1);
+    values.push_back(k * 65535 - 1);
+    values.push_back(value(gen));
+  }
+  values.push_back(0xffffffffu);
+  for(std::size_t i = 0; i + 4 <= values.size(); i += 4)
+  {
+    __m128i const x = _mm_loadu_si128(reinterpret_cast<__m128i const *>(&values[i]));
+    boost::uint32_t q255[4], q65535[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(q255), gil_detail::simd::sse2::vdiv255(x));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(q65535), gil_detail::simd::sse2::vdiv65535(x));
+    for(int j = 0; j < 4; ++j)
+    {
+      ASSERT_EQ(values[i + j] / 255, q255[j]);
+      ASSERT_EQ(values[i + j] / 65535, q65535[j]);
+    }
+  }
+}
+#endif
@@ -0,0 +1,237 @@
+#include <svgpp/utility/fixed_point.hpp>
+#include <svgpp/factory/unitless_length.hpp>
+#include <svgpp/parser/path_data.hpp>
+#include <svgpp/parser/transform_list.hpp>
+
+#include <gtest/gtest.h>
+
+using namespace svgpp;
+
+namespace
+{
+  template<class Number>
+  struct path_log_context
+  {
+    void path_move_to(Number x, Number y, tag::coordinate::absolute)
+    {
+      add('M', x, y);
+    }
+
+    void path_line_to(Number x, Number y, tag::coordinate::absolute)
+    {
+      add('L', x, y);
+    }
+
+    void path_cubic_bezier_to(Number x1, Number y1, Number x2, Number y2, Number x, Number y,
+      tag::coordinate::absolute)
+    {
+      add('C', x1, y1);
+      add(',', x2, y2);
+      add(',', x, y);
+    }
+
+    void path_quadratic_bezier_to(Number x1, Number y1, Number x, Number y,
+      tag::coordinate::absolute)
+    {
+      add('Q', x1, y1);
+      add(',', x, y);
+    }
+
+    void path_elliptical_arc_to(Number, Number, Number, bool, bool, Number, Number,
+      tag::coordinate::absolute)
+    {
+      ADD_FAILURE();
+    }
+
+    void path_close_subpath()
+    {
+      commands_ += 'Z';
+    }
+
+    void path_exit()
+    {}
+
+    void marker(marker_vertex, Number x, Number y, double directionality, unsigned)
+    {
+      add('*', x, y);
+      directions_.push_back(directionality);
+    }
+
+    std::string commands_;
+    std::vector<double> coordinates_;
+    std::vector<double> directions_;
+
+  private:
+    void add(char command, Number x, Number y)
+    {
+      commands_ += command;
+      coordinates_.push_back(static_cast<double>(x));
+      coordinates_.push_back(static_cast<double>(y));
+    }
+  };
+
+  template<class Number>
+  struct transform_log_context
+  {
+    void transform_matrix(boost::array<Number, 6> const & matrix)
+    {
+      for(int i = 0; i < 6; ++i)
+        matrix_[i] = static_cast<double>(matrix[i]);
+    }
+
+    boost::array<double, 6> matrix_;
+  };
+}
+
+namespace svgpp
+{
+  template<class Number>
+  struct number_type_by_context<path_log_context<Number> >
+  {
+    typedef Number type;
+  };
+
+  template<class Number>
+  struct number_type_by_context<transform_log_context<Number> >
+  {
+    typedef Number type;
+  };
+}
+
+namespace
+{
+  char const path_data[] =
+    "M 12.5 700.25 L 913.125 20.0625 h -100.3 v 250.75 l 10.1 -20.2 10.1 -20.2 10.1 -20.2 z"
+    "m 300 300 c 10 -50 90 -50 100 0 s 90 50 100 0 S 650 250 700 300"
+    "Q 750.5 400.5 800 300 q 25.25 -50.75 50 0 t 50 0 T 1000 300"
+    "M 100 900 A 80 40 30 1 0 300 850 a 100.5 100.5 0 0 1 100 100 a 50 25 -45 0 1 -60.125 10.0625"
+    "M 0.001 0.9999 L 3.14159265 2.71828183e0 L 1e3 2.5e-2";
+
+  template<class Number>
+  path_log_context<Number> parse_path()
+  {
+    path_log_context<Number> context;
+    EXPECT_TRUE((value_parser<tag::type::path_data, path_policy<policy::path::minimal> >::parse(
+      tag::attribute::d(), context, std::string(path_data), tag::source::attribute())));
+    return context;
+  }
+
+  template<class Number>
+  path_log_context<Number> parse_path_markers()
+  {
+    path_log_context<Number> context;
+    path_markers_adapter<path_log_context<Number>, policy::markers::calculate_always> markers(context);
+    EXPECT_TRUE((value_parser<tag::type::path_data, number_type<Number> >::parse(
+      tag::attribute::d(), markers, std::string(path_data), tag::source::attribute())));
+    return context;
+  }
+
+  double max_difference(std::vector<double> const & expected, std::vector<double> const & actual)
+  {
+    EXPECT_EQ(expected.size(), actual.size());
+    double result = 0;
+    for(std::size_t i = 0; i < expected.size() && i < actual.size(); ++i)
+      result = std::max(result, std::fabs(expected[i] - actual[i]));
+    return result;
+  }
+
+  double const fixed_24_8_epsilon = 1. / 256;
+}
+
+TEST(number_type_precision, fixed_point_arithmetic)
+{
+  EXPECT_EQ(3 * 256, fixed_24_8(3).raw());
+  EXPECT_EQ(-3 * 256 - 128, fixed_24_8(-3.5).raw());
+  EXPECT_EQ(1, fixed_24_8(0.002).raw());
+  EXPECT_EQ(-1, fixed_24_8(-0.002).raw());
+  EXPECT_EQ(0, fixed_24_8(0.001).raw());
+  EXPECT_EQ(7.5, static_cast<double>(fixed_24_8(2.5) * 3));
+  EXPECT_EQ(-0.75, static_cast<double>(fixed_24_8(1.5) * -0.5));
+  EXPECT_EQ(-1.25, static_cast<double>(fixed_24_8(-2.5) / 2));
+  EXPECT_NEAR(1. / 3, static_cast<double>(fixed_24_8(1) / 3), fixed_24_8_epsilon / 2);
+  EXPECT_NEAR(-2. / 3, static_cast<double>(fixed_24_8(2) / -3), fixed_24_8_epsilon / 2);
+  EXPECT_TRUE(fixed_24_8(0.5) < 1);
+  EXPECT_TRUE(fixed_24_8(-0.5) == -fixed_24_8(0.5));
+  EXPECT_EQ(1000000.5f, static_cast<float>(fixed_24_8(1000000) + 0.5));
+}
+
+TEST(number_type_precision, fixed_point_grammar)
+{
+  // Digits beyond fixed-point precision don't overflow accumulator
+  path_log_context<fixed_24_8> context;
+  EXPECT_TRUE(value_parser<tag::type::path_data>::parse(tag::attribute::d(), context,
+    std::string("M0.123456789012345 -12345.678901234567 L1e-5 5E3"), tag::source::attribute()));
+  ASSERT_EQ(4, context.coordinates_.size());
+  EXPECT_EQ(32. / 256, context.coordinates_[0]);
+  EXPECT_EQ(-12345 - 174. / 256, context.coordinates_[1]);
+  EXPECT_EQ(0, context.coordinates_[2]);
+  EXPECT_EQ(5000, context.coordinates_[3]);
+}
+
+TEST(number_type_precision, path_float)
+{
+  path_log_context<double> expected = parse_path<double>();
+  path_log_context<float> actual = parse_path<float>();
+  EXPECT_EQ(expected.commands_, actual.commands_);
+  // Relative error of float is about 6e-8, coordinates are below 2000 and
+  // relative segments accumulate rounding errors
+  EXPECT_LT(max_difference(expected.coordinates_, actual.coordinates_), 5e-4);
+}
+
+TEST(number_type_precision, path_fixed_point)
+{
+  path_log_context<double> expected = parse_path<double>();
+  path_log_context<fixed_24_8> actual = parse_path<fixed_24_8>();
+  EXPECT_EQ(expected.commands_, actual.commands_);
+  // Each parsed or calculated value is rounded to half of epsilon. Current point
+  // accumulates error of every relative coordinate in a row (up to 3 in test path),
+  // values derived from it (bezier control points, arc segments) add one more rounding
+  EXPECT_LT(max_difference(expected.coordinates_, actual.coordinates_), 5 * fixed_24_8_epsilon / 2);
+}
+
+TEST(number_type_precision, path_markers)
+{
+  path_log_context<double> expected = parse_path_markers<double>();
+  path_log_context<float> actual_float = parse_path_markers<float>();
+  path_log_context<fixed_24_8> actual_fixed = parse_path_markers<fixed_24_8>();
+  EXPECT_EQ(expected.commands_, actual_float.commands_);
+  EXPECT_EQ(expected.commands_, actual_fixed.commands_);
+  EXPECT_LT(max_difference(expected.coordinates_, actual_float.coordinates_), 5e-4);
+  EXPECT_LT(max_difference(expected.coordinates_, actual_fixed.coordinates_), 3 * fixed_24_8_epsilon / 2);
+  EXPECT_LT(max_difference(expected.directions_, actual_float.directions_), 1e-5);
+  // Shortest segment in test path is about 1 unit long
+  EXPECT_LT(max_difference(expected.directions_, actual_fixed.directions_), 4 * fixed_24_8_epsilon);
+}
+
+TEST(number_type_precision, transform)
+{
+  transform_log_context<double> expected;
+  transform_log_context<float> actual;
+  std::string const transform("translate(-10.5 20.25) rotate(30.5 100 50) skewX(15) scale(1.5 -0.25)");
+  EXPECT_TRUE(value_parser<tag::type::transform_list>::parse(
+    tag::attribute::transform(), expected, transform, tag::source::attribute()));
+  EXPECT_TRUE(value_parser<tag::type::transform_list>::parse(
+    tag::attribute::transform(), actual, transform, tag::source::attribute()));
+  for(int i = 0; i < 6; ++i)
+    EXPECT_NEAR(expected.matrix_[i], actual.matrix_[i], 1e-5 * std::max(1., std::fabs(expected.matrix_[i])));
+}
+
+TEST(number_type_precision, length_factory_fixed_point)
+{
+  factory::length::unitless<fixed_24_8, fixed_24_8> factory;
+  // Coefficients are kept in double, only result is rounded
+  EXPECT_EQ(480, static_cast<double>(factory.create_length(127, tag::length_units::mm())));
+  EXPECT_NEAR(1000 * 96 / 72.,
+    static_cast<double>(factory.create_length(1000, tag::length_units::pt())), fixed_24_8_epsilon / 2);
+  // Squared viewport size doesn't fit into 24.8
+  factory.set_viewport_size(4000, 3000);
+  EXPECT_NEAR(std::sqrt((4000. * 4000 + 3000 * 3000) / 2) * 0.3325,
+    static_cast<double>(factory.create_length(33.25, tag::length_units::percent(),
+      tag::length_dimension::not_width_nor_height())),
+    fixed_24_8_epsilon);
+  EXPECT_EQ(1330, static_cast<double>(factory.create_length(33.25, tag::length_units::percent(),
+      tag::length_dimension::width())));
+  factory.set_user_units_coefficient(1. / 3);
+  EXPECT_NEAR(1000. / 3,
+    static_cast<double>(factory.create_length(1000, tag::length_units::px())), fixed_24_8_epsilon / 2);
+}
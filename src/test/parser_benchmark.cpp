@@ -0,0 +1,462 @@
+// Measures throughput of SVG++ value parsers and of full document traversal
+// on deterministic synthetic input. Results are written as JSON.
+//
+// Usage: ParserBenchmark [--elements N] [--depth N] [--path-length N] [--style-mix X]
+//          [--style-repeat X] [--seed N] [--values N] [--iterations N] [--output file.json]
+
+#include <svgpp/svgpp.hpp>
+#include <rapidxml_ns/rapidxml_ns.hpp>
+#include <svgpp/policy/xml/rapidxml_ns.hpp>
+#include <svgpp/utility/event_stream.hpp>
+#include <svgpp/utility/value_cache.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/timer/timer.hpp>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "synthetic_svg.hpp"
+
+using namespace svgpp;
+
+namespace
+{
+
+// Counts every event it receives, so that the optimizer can't drop parsing
+struct CountingContext
+{
+  CountingContext()
+    : items_(0)
+  {}
+
+  void path_move_to(double, double, tag::coordinate::absolute) { ++items_; }
+  void path_line_to(double, double, tag::coordinate::absolute) { ++items_; }
+  void path_cubic_bezier_to(double, double, double, double, double, double, tag::coordinate::absolute) { ++items_; }
+  void path_quadratic_bezier_to(double, double, double, double, tag::coordinate::absolute) { ++items_; }
+  void path_elliptical_arc_to(double, double, double, bool, bool, double, double, tag::coordinate::absolute) { ++items_; }
+  void path_close_subpath() { ++items_; }
+  void path_exit() {}
+
+  void transform_matrix(boost::array<double, 6> const &) { ++items_; }
+
+  template<class Range>
+  void set(tag::attribute::points, Range const & r)
+  {
+    for(typename boost::range_const_iterator<Range>::type it = boost::begin(r); it != boost::end(r); ++it)
+      ++items_;
+  }
+
+  template<class AttributeTag>
+  void set(AttributeTag, tag::value::none) { ++items_; }
+
+  template<class AttributeTag, class T1>
+  void set(AttributeTag, T1 const &) { ++items_; }
+
+  template<class AttributeTag, class T1, class T2>
+  void set(AttributeTag, T1 const &, T2 const &) { ++items_; }
+
+  template<class AttributeTag, class T1, class T2, class T3>
+  void set(AttributeTag, T1 const &, T2 const &, T3 const &) { ++items_; }
+
+  template<class AttributeTag, class T1, class T2, class T3, class T4>
+  void set(AttributeTag, T1 const &, T2 const &, T3 const &, T4 const &) { ++items_; }
+
+  template<class AttributeTag, class T1, class T2, class T3, class T4, class T5>
+  void set(AttributeTag, T1 const &, T2 const &, T3 const &, T4 const &, T5 const &) { ++items_; }
+
+  void on_enter_element(tag::element::any) { ++items_; }
+  void on_exit_element() {}
+
+  unsigned long long items_;
+};
+
+struct CachingContext: CountingContext
+{
+  typedef svgpp::value_cache<> value_cache_type;
+
+  CachingContext()
+    : cache_(16 * 1024 * 1024)
+  {}
+
+  value_cache_type * value_cache() { return &cache_; }
+
+private:
+  value_cache_type cache_;
+};
+
+typedef policy::value_cache::forward_to_method<CachingContext> cache_forwarding_t;
+typedef value_cache_policy<cache_forwarding_t> caching_policy_t;
+
+typedef std::vector<std::string> strings_t;
+
+struct result
+{
+  std::string name_;
+  unsigned long long bytes_, items_;
+  double seconds_;
+};
+
+size_t total_size(strings_t const & values)
+{
+  size_t size = 0;
+  for(strings_t::const_iterator it = values.begin(); it != values.end(); ++it)
+    size += it->size();
+  return size;
+}
+
+struct path_data_parser
+{
+  typedef CountingContext context_type;
+
+  static bool parse(CountingContext & context, std::string const & value)
+  {
+    return value_parser<tag::type::path_data>::parse(tag::attribute::d(), context, value, tag::source::attribute());
+  }
+};
+
+struct transform_parser
+{
+  typedef CountingContext context_type;
+
+  static bool parse(CountingContext & context, std::string const & value)
+  {
+    return value_parser<tag::type::transform_list>::parse(tag::attribute::transform(), context, value, tag::source::attribute());
+  }
+};
+
+struct color_parser
+{
+  typedef CountingContext context_type;
+
+  static bool parse(CountingContext & context, std::string const & value)
+  {
+    return value_parser<tag::type::color>::parse(tag::attribute::flood_color(), context, value, tag::source::attribute());
+  }
+};
+
+struct length_parser
+{
+  typedef CountingContext context_type;
+
+  static bool parse(CountingContext & context, std::string const & value)
+  {
+    return value_parser<tag::type::length>::parse(tag::attribute::width(), context, value, tag::source::attribute());
+  }
+};
+
+struct points_parser
+{
+  typedef CountingContext context_type;
+
+  static bool parse(CountingContext & context, std::string const & value)
+  {
+    return value_parser<tag::attribute::points>::parse(tag::attribute::points(), context, value, tag::source::attribute());
+  }
+};
+
+struct clock_value_parser
+{
+  typedef CountingContext context_type;
+
+  static bool parse(CountingContext & context, std::string const & value)
+  {
+    return value_parser<tag::type::clock_value>::parse(tag::attribute::dur(), context, value, tag::source::attribute());
+  }
+};
+
+struct css_style_parser
+{
+  typedef CountingContext context_type;
+
+  static bool parse(CountingContext & context, std::string const & value)
+  {
+    typedef css_style_iterator<std::string::const_iterator> css_iterator;
+    for(css_iterator it(value.begin(), value.end()); !it.eof(); ++it)
+      if (policy::css_name_to_id::default_policy::find(it->first) != detail::unknown_attribute_id)
+        ++context.items_;
+    return true;
+  }
+};
+
+struct css_style_counter
+{
+  css_style_counter(CachingContext & context)
+    : context_(context)
+  {}
+
+  template<class Range>
+  bool operator()(detail::attribute_id id, Range const &, Range const &)
+  {
+    if (id != detail::unknown_attribute_id)
+      ++context_.items_;
+    return true;
+  }
+
+  CachingContext & context_;
+};
+
+// Each value is parsed 'iterations' times, so all but first parses are cache hits
+struct path_data_cached_parser
+{
+  typedef CachingContext context_type;
+
+  static bool parse(CachingContext & context, std::string const & value)
+  {
+    return value_parser<tag::type::path_data, caching_policy_t>::parse(tag::attribute::d(), context, value, tag::source::attribute());
+  }
+};
+
+struct transform_cached_parser
+{
+  typedef CachingContext context_type;
+
+  static bool parse(CachingContext & context, std::string const & value)
+  {
+    return value_parser<tag::type::transform_list, caching_policy_t>::parse(tag::attribute::transform(), context, value, tag::source::attribute());
+  }
+};
+
+struct css_style_cached_parser
+{
+  typedef CachingContext context_type;
+
+  static bool parse(CachingContext & context, std::string const & value)
+  {
+    css_style_counter counter(context);
+    return detail::load_css_declarations_with_value_cache<cache_forwarding_t>
+      ::load<policy::css_name_to_id::default_policy>(context, value, counter);
+  }
+};
+
+template<class Parser>
+result run_value_benchmark(char const * name, strings_t const & values, int iterations)
+{
+  result res;
+  res.name_ = name;
+  res.bytes_ = static_cast<unsigned long long>(total_size(values)) * iterations;
+
+  typename Parser::context_type context;
+  boost::timer::cpu_timer timer;
+  for(int i = 0; i < iterations; ++i)
+    for(strings_t::const_iterator it = values.begin(); it != values.end(); ++it)
+      if (!Parser::parse(context, *it))
+        throw std::runtime_error(std::string("Failed to parse ") + name + " value \"" + *it + "\"");
+  timer.stop();
+
+  res.seconds_ = timer.elapsed().wall * 1e-9;
+  res.items_ = context.items_;
+  return res;
+}
+
+typedef boost::mpl::set<
+  tag::element::svg,
+  tag::element::g,
+  tag::element::path,
+  tag::element::rect,
+  tag::element::circle,
+  tag::element::ellipse,
+  tag::element::polyline
+>::type processed_elements_t;
+
+typedef boost::mpl::fold<
+  traits::shapes_attributes_by_element,
+  boost::mpl::set<
+    tag::attribute::transform,
+    tag::attribute::fill,
+    tag::attribute::fill_opacity,
+    tag::attribute::fill_rule,
+    tag::attribute::stroke,
+    tag::attribute::stroke_width,
+    tag::attribute::stroke_linecap,
+    tag::attribute::stroke_linejoin,
+    tag::attribute::stroke_miterlimit,
+    tag::attribute::stroke_dasharray,
+    tag::attribute::stroke_opacity,
+    tag::attribute::opacity,
+    tag::attribute::display
+  >::type,
+  boost::mpl::insert<boost::mpl::_1, boost::mpl::_2>
+>::type processed_attributes_t;
+
+template<class Context, class ValueCachePolicy>
+result run_document_benchmark(char const * name, std::string const & document, int iterations)
+{
+  result res;
+  res.name_ = name;
+  res.bytes_ = static_cast<unsigned long long>(document.size()) * iterations;
+
+  std::vector<char> buffer(document.begin(), document.end());
+  buffer.push_back('\0');
+  rapidxml_ns::xml_document<> xml_doc;
+  xml_doc.parse<rapidxml_ns::parse_no_string_terminators>(&buffer[0]);
+
+  Context context;
+  boost::timer::cpu_timer timer;
+  for(int i = 0; i < iterations; ++i)
+    if (!document_traversal<
+        value_cache_policy<ValueCachePolicy>,
+        processed_elements<processed_elements_t>,
+        processed_attributes<processed_attributes_t>
+      >::load_document(xml_doc.first_node(), context))
+      throw std::runtime_error("Document traversal failed");
+  timer.stop();
+
+  res.seconds_ = timer.elapsed().wall * 1e-9;
+  res.items_ = context.items_;
+  return res;
+}
+
+// Throughput is relative to the XML document size, to be comparable with document_traversal
+result run_event_stream_benchmark(std::string const & document, int iterations)
+{
+  result res;
+  res.name_ = "event_stream_replay";
+  res.bytes_ = static_cast<unsigned long long>(document.size()) * iterations;
+
+  std::vector<char> buffer(document.begin(), document.end());
+  buffer.push_back('\0');
+  rapidxml_ns::xml_document<> xml_doc;
+  xml_doc.parse<rapidxml_ns::parse_no_string_terminators>(&buffer[0]);
+
+  event_stream_writer writer;
+  document_traversal<
+    processed_elements<processed_elements_t>,
+    processed_attributes<processed_attributes_t>
+  >::load_document(xml_doc.first_node(), writer);
+  std::vector<double> stream(writer.data().size() / sizeof(double) + 1);
+  std::memcpy(&stream[0], &writer.data()[0], writer.data().size());
+
+  CountingContext context;
+  boost::timer::cpu_timer timer;
+  for(int i = 0; i < iterations; ++i)
+    event_stream_player<processed_attributes_t>::play(
+      reinterpret_cast<char const *>(&stream[0]), writer.data().size(), context);
+  timer.stop();
+
+  res.seconds_ = timer.elapsed().wall * 1e-9;
+  res.items_ = context.items_;
+  return res;
+}
+
+void write_json(std::ostream & out, synthetic_svg::parameters const & params, int values, int iterations,
+  std::vector<result> const & results)
+{
+  out << "{\n"
+    << "  \"parameters\": {\n"
+    << "    \"elements\": " << params.element_count << ",\n"
+    << "    \"depth\": " << params.nesting_depth << ",\n"
+    << "    \"path_length\": " << params.path_length << ",\n"
+    << "    \"style_mix\": " << params.style_mix << ",\n"
+    << "    \"style_repeat\": " << params.style_repeat << ",\n"
+    << "    \"seed\": " << params.seed << ",\n"
+    << "    \"values\": " << values << ",\n"
+    << "    \"iterations\": " << iterations << "\n"
+    << "  },\n"
+    << "  \"results\": [\n";
+  for(std::vector<result>::const_iterator it = results.begin(); it != results.end(); ++it)
+  {
+    double seconds = it->seconds_ > 0 ? it->seconds_ : 1e-9;
+    out << "    { \"name\": \"" << it->name_ << "\""
+      << ", \"bytes\": " << it->bytes_
+      << ", \"items\": " << it->items_
+      << ", \"seconds\": " << it->seconds_
+      << ", \"mb_per_s\": " << it->bytes_ / seconds / (1024 * 1024)
+      << ", \"items_per_s\": " << it->items_ / seconds
+      << " }" << (it + 1 == results.end() ? "\n" : ",\n");
+  }
+  out << "  ]\n}\n";
+}
+
+template<class T>
+T option_value(int & i, int argc, char * argv[])
+{
+  if (++i >= argc)
+    throw std::runtime_error(std::string("Missing value for ") + argv[i - 1]);
+  return boost::lexical_cast<T>(argv[i]);
+}
+
+}
+
+int main(int argc, char * argv[])
+{
+  try
+  {
+    synthetic_svg::parameters params;
+    int values = 1000, iterations = 20;
+    std::string output;
+    for(int i = 1; i < argc; ++i)
+    {
+      if (std::strcmp(argv[i], "--elements") == 0)
+        params.element_count = option_value<int>(i, argc, argv);
+      else if (std::strcmp(argv[i], "--depth") == 0)
+        params.nesting_depth = option_value<int>(i, argc, argv);
+      else if (std::strcmp(argv[i], "--path-length") == 0)
+        params.path_length = option_value<int>(i, argc, argv);
+      else if (std::strcmp(argv[i], "--style-mix") == 0)
+        params.style_mix = option_value<double>(i, argc, argv);
+      else if (std::strcmp(argv[i], "--style-repeat") == 0)
+        params.style_repeat = option_value<double>(i, argc, argv);
+      else if (std::strcmp(argv[i], "--seed") == 0)
+        params.seed = option_value<boost::uint32_t>(i, argc, argv);
+      else if (std::strcmp(argv[i], "--values") == 0)
+        values = option_value<int>(i, argc, argv);
+      else if (std::strcmp(argv[i], "--iterations") == 0)
+        iterations = option_value<int>(i, argc, argv);
+      else if (std::strcmp(argv[i], "--output") == 0)
+        output = option_value<std::string>(i, argc, argv);
+      else
+      {
+        std::cerr << "Usage: " << argv[0] << " [--elements N] [--depth N] [--path-length N] [--style-mix X]"
+          " [--style-repeat X] [--seed N] [--values N] [--iterations N] [--output file.json]\n";
+        return 1;
+      }
+    }
+
+    synthetic_svg::generator generator(params);
+    strings_t path_data, transforms, colors, lengths, points, clock_values, styles;
+    for(int i = 0; i < values; ++i)
+    {
+      path_data.push_back(generator.path_data());
+      transforms.push_back(generator.transform_list());
+      colors.push_back(generator.color());
+      lengths.push_back(generator.length());
+      points.push_back(generator.points());
+      clock_values.push_back(generator.clock_value());
+      styles.push_back(generator.style());
+    }
+    std::string const document = generator.document();
+
+    std::vector<result> results;
+    results.push_back(run_value_benchmark<path_data_parser>  ("path_data",   path_data,    iterations));
+    results.push_back(run_value_benchmark<path_data_cached_parser>("path_data_cached", path_data, iterations));
+    results.push_back(run_value_benchmark<transform_parser>  ("transform",   transforms,   iterations));
+    results.push_back(run_value_benchmark<transform_cached_parser>("transform_cached", transforms, iterations));
+    results.push_back(run_value_benchmark<color_parser>      ("color",       colors,       iterations));
+    results.push_back(run_value_benchmark<length_parser>     ("length",      lengths,      iterations));
+    results.push_back(run_value_benchmark<points_parser>     ("points",      points,       iterations));
+    results.push_back(run_value_benchmark<clock_value_parser>("clock_value", clock_values, iterations));
+    results.push_back(run_value_benchmark<css_style_parser>  ("css_style",   styles,       iterations));
+    results.push_back(run_value_benchmark<css_style_cached_parser>("css_style_cached", styles, iterations));
+    results.push_back(run_document_benchmark<CountingContext, policy::value_cache::disabled>(
+      "document_traversal", document, iterations));
+    results.push_back(run_document_benchmark<CachingContext, cache_forwarding_t>(
+      "document_traversal_cached", document, iterations));
+    results.push_back(run_event_stream_benchmark(document, iterations));
+
+    if (output.empty())
+      write_json(std::cout, params, values, iterations, results);
+    else
+    {
+      std::ofstream out(output.c_str());
+      write_json(out, params, values, iterations, results);
+      if (!out)
+        throw std::runtime_error("Error writing " + output);
+    }
+  }
+  catch (std::exception const & e)
+  {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
+  }
+  return 0;
+}
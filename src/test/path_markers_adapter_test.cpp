@@ -1,6 +1,7 @@
 #include <svgpp/adapter/path.hpp>
 #include <svgpp/adapter/path_markers.hpp>
 #include <svgpp/parser/path_data.hpp>
+#include <svgpp/utility/marker_batch.hpp>
 
 #include <gtest/gtest.h>
 #include <boost/tuple/tuple_comparison.hpp>
@@ -213,3 +214,94 @@ TEST(path_markers_adapter, test6)
     (MarkerInstance(svgpp::marker_end, 10, 10, 0.0))
     );
 }
+
+TEST(path_markers_adapter, arc)
+{
+  DoConfigTests("M0 0 A 10 10 0 0 1 20 0 L 20 10", list_of
+    (MarkerInstance(svgpp::marker_start, 0, 0, -90.0 * deg))
+    (MarkerInstance(svgpp::marker_mid, 20, 0, 90.0 * deg))
+    (MarkerInstance(svgpp::marker_end, 20, 10, 90.0 * deg))
+    );
+  DoConfigTests("M0 0 A 10 10 0 0 0 20 0", list_of
+    (MarkerInstance(svgpp::marker_start, 0, 0, 90.0 * deg))
+    (MarkerInstance(svgpp::marker_end, 20, 0, -90.0 * deg))
+    );
+}
+
+namespace
+{
+  char const * const batch_test_paths[] = {
+    "M0 0 L 10 10",
+    "M0 0 h 10 v 10 h -10 z M20 20 h 10 v 10 h -10 z",
+    "M0 0 h 10 h 0 h 0 v 10 h -10 z",
+    "M0 0 h 0 h 0 h 10 v 10 h -10 z",
+    "M0 0 Z M 10 10 Z",
+    "M0 0 h 10 h -10 l 5 5",
+    "M10 20 C 30 -10 50 50 70 20 S 110 0 120 40 Q 140 60 160 20 T 200 0",
+    "M0 0 A 20 10 30 1 0 40 10 a 10 30 -60 0 1 -20 -5 A 5 5 0 0 1 10 10 z"
+  };
+}
+
+TEST(marker_batch, same_as_radians)
+{
+  for(std::size_t i = 0; i < sizeof(batch_test_paths) / sizeof(batch_test_paths[0]); ++i)
+  {
+    SCOPED_TRACE(batch_test_paths[i]);
+    std::string const path_string(batch_test_paths[i]);
+
+    Context expected;
+    expected.config_start_ = expected.config_mid_ = expected.config_end_ = svgpp::marker_orient_auto;
+    {
+      svgpp::path_markers_adapter<Context> markers_adapter(expected);
+      svgpp::value_parser<svgpp::tag::type::path_data>::parse(
+        svgpp::tag::attribute::d(), markers_adapter, path_string, svgpp::tag::source::attribute());
+    }
+
+    svgpp::marker_batch<> batch;
+    {
+      svgpp::path_markers_adapter<svgpp::marker_batch<>, svgpp::policy::markers::calculate_tangents> 
+        markers_adapter(batch);
+      svgpp::value_parser<svgpp::tag::type::path_data>::parse(
+        svgpp::tag::attribute::d(), markers_adapter, path_string, svgpp::tag::source::attribute());
+    }
+
+    MarkerSequence const & expected_markers = expected.log();
+    ASSERT_EQ(expected_markers.size(), batch.size());
+    for(std::size_t m = 0; m < batch.size(); ++m)
+    {
+      EXPECT_EQ(expected_markers[m].get<0>(), batch.vertex(m));
+      EXPECT_TRUE(batch.orient_auto(m));
+      EXPECT_EQ(expected_markers[m].get<1>(), batch.x()[m]);
+      EXPECT_EQ(expected_markers[m].get<2>(), batch.y()[m]);
+      double const angle = *expected_markers[m].get<3>();
+      EXPECT_NEAR(std::cos(angle), batch.direction_x()[m], 1e-8);
+      EXPECT_NEAR(std::sin(angle), batch.direction_y()[m], 1e-8);
+      EXPECT_NEAR(std::sin(angle), std::sin(batch.angle(m)), 1e-8);
+      EXPECT_NEAR(std::cos(angle), std::cos(batch.angle(m)), 1e-8);
+    }
+  }
+}
+
+TEST(marker_batch, orient_fixed)
+{
+  svgpp::marker_batch<float> batch;
+  batch.set_config(svgpp::marker_orient_fixed, svgpp::marker_none, svgpp::marker_orient_auto);
+  {
+    svgpp::path_markers_adapter<svgpp::marker_batch<float>, svgpp::policy::markers::calculate_tangents> 
+      markers_adapter(batch);
+    svgpp::value_parser<svgpp::tag::type::path_data>::parse(
+      svgpp::tag::attribute::d(), markers_adapter, std::string("M0 0 h 10 v 10 l -10 10"), svgpp::tag::source::attribute());
+  }
+  ASSERT_EQ(2, batch.size());
+  EXPECT_EQ(svgpp::marker_start, batch.vertex(0));
+  EXPECT_FALSE(batch.orient_auto(0));
+  EXPECT_EQ(1, batch.direction_x()[0]);
+  EXPECT_EQ(0, batch.direction_y()[0]);
+  EXPECT_EQ(svgpp::marker_end, batch.vertex(1));
+  EXPECT_TRUE(batch.orient_auto(1));
+  EXPECT_EQ(0, batch.x()[1]);
+  EXPECT_EQ(20, batch.y()[1]);
+  EXPECT_NEAR(135 * deg, batch.angle(1), 1e-6);
+  batch.clear();
+  EXPECT_EQ(0, batch.size());
+}
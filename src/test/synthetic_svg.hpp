@@ -0,0 +1,281 @@
+#pragma once
+
+// Deterministic generator of synthetic SVG documents and attribute values
+// used by ParserBenchmark. Same parameters always produce the same output.
+
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/cstdint.hpp>
+
+namespace synthetic_svg
+{
+
+// Park-Miller "minimal standard" generator. Used instead of std::rand
+// to get the same corpus on every platform
+class random
+{
+public:
+  explicit random(boost::uint32_t seed = 1)
+    : state_(seed % 2147483647u == 0 ? 1 : seed % 2147483647u)
+  {}
+
+  boost::uint32_t next()
+  {
+    state_ = static_cast<boost::uint32_t>((static_cast<boost::uint64_t>(state_) * 48271u) % 2147483647u);
+    return state_;
+  }
+
+  // Integer in [0, n)
+  int uniform(int n)
+  {
+    return static_cast<int>(next() % static_cast<boost::uint32_t>(n));
+  }
+
+  // Number in [lo, hi) with at most 'decimals' fractional digits
+  double number(double lo, double hi, int decimals = 2)
+  {
+    double scale = 1;
+    for(int i = 0; i < decimals; ++i)
+      scale *= 10;
+    return lo + static_cast<double>(uniform(static_cast<int>((hi - lo) * scale))) / scale;
+  }
+
+  bool chance(double probability)
+  {
+    return next() < probability * 2147483647.0;
+  }
+
+private:
+  boost::uint32_t state_;
+};
+
+struct parameters
+{
+  parameters()
+    : element_count(1000)
+    , nesting_depth(4)
+    , path_length(16)
+    , style_mix(0.5)
+    , style_repeat(0.5)
+    , seed(1)
+  {}
+
+  int element_count;  // Number of shape elements in document
+  int nesting_depth;  // Maximum depth of nested 'g' elements
+  int path_length;    // Number of segments in each 'd' and 'points' value
+  double style_mix;   // Share of elements using 'style' attribute instead of presentation attributes
+  double style_repeat; // Share of 'style' values taken from small set of repeating strings (as in Inkscape output)
+  boost::uint32_t seed;
+};
+
+class generator
+{
+public:
+  explicit generator(parameters const & p = parameters())
+    : params_(p)
+    , random_(p.seed)
+  {}
+
+  std::string path_data()
+  {
+    std::ostringstream out;
+    out << "M" << random_.number(0, 1000) << "," << random_.number(0, 1000);
+    for(int i = 0; i < params_.path_length; ++i)
+    {
+      switch (random_.uniform(8))
+      {
+      case 0: out << "L" << random_.number(0, 1000) << " " << random_.number(0, 1000); break;
+      case 1: out << "l" << random_.number(-50, 50) << "," << random_.number(-50, 50); break;
+      case 2: out << "h" << random_.number(-50, 50); break;
+      case 3: out << "V" << random_.number(0, 1000); break;
+      case 4:
+        out << "c" << random_.number(-50, 50) << "," << random_.number(-50, 50)
+          << " " << random_.number(-50, 50) << "," << random_.number(-50, 50)
+          << " " << random_.number(-50, 50) << "," << random_.number(-50, 50);
+        break;
+      case 5:
+        out << "S" << random_.number(0, 1000) << "," << random_.number(0, 1000)
+          << " " << random_.number(0, 1000) << "," << random_.number(0, 1000);
+        break;
+      case 6:
+        out << "q" << random_.number(-50, 50) << "," << random_.number(-50, 50)
+          << " " << random_.number(-50, 50) << "," << random_.number(-50, 50);
+        break;
+      case 7:
+        out << "a" << random_.number(1, 50) << "," << random_.number(1, 50)
+          << " " << random_.uniform(360) << " " << random_.uniform(2) << "," << random_.uniform(2)
+          << " " << random_.number(-50, 50) << "," << random_.number(-50, 50);
+        break;
+      }
+    }
+    if (random_.chance(0.5))
+      out << "z";
+    return out.str();
+  }
+
+  std::string transform_list()
+  {
+    std::ostringstream out;
+    int count = 1 + random_.uniform(3);
+    for(int i = 0; i < count; ++i)
+    {
+      if (i != 0)
+        out << " ";
+      switch (random_.uniform(5))
+      {
+      case 0: out << "translate(" << random_.number(-100, 100) << "," << random_.number(-100, 100) << ")"; break;
+      case 1: out << "scale(" << random_.number(0.1, 4) << ")"; break;
+      case 2: out << "rotate(" << random_.number(-180, 180) << " " << random_.number(0, 100) << " " << random_.number(0, 100) << ")"; break;
+      case 3: out << "skewX(" << random_.number(-45, 45) << ")"; break;
+      case 4:
+        out << "matrix(" << random_.number(-1, 1, 4) << "," << random_.number(-1, 1, 4)
+          << "," << random_.number(-1, 1, 4) << "," << random_.number(-1, 1, 4)
+          << "," << random_.number(-100, 100) << "," << random_.number(-100, 100) << ")";
+        break;
+      }
+    }
+    return out.str();
+  }
+
+  std::string color()
+  {
+    static char const * const names[] = { "red", "navy", "black", "white", "lightgoldenrodyellow", "steelblue" };
+    static char const hex[] = "0123456789abcdef";
+    std::ostringstream out;
+    switch (random_.uniform(4))
+    {
+    case 0:
+      out << "#";
+      for(int i = 0; i < 6; ++i)
+        out << hex[random_.uniform(16)];
+      break;
+    case 1:
+      out << "#" << hex[random_.uniform(16)] << hex[random_.uniform(16)] << hex[random_.uniform(16)];
+      break;
+    case 2:
+      out << "rgb(" << random_.uniform(256) << "," << random_.uniform(256) << "," << random_.uniform(256) << ")";
+      break;
+    case 3:
+      out << names[random_.uniform(sizeof(names) / sizeof(names[0]))];
+      break;
+    }
+    return out.str();
+  }
+
+  std::string length()
+  {
+    static char const * const units[] = { "", "", "px", "%", "em", "pt", "mm", "in" };
+    std::ostringstream out;
+    out << random_.number(0, 500) << units[random_.uniform(sizeof(units) / sizeof(units[0]))];
+    return out.str();
+  }
+
+  std::string points()
+  {
+    std::ostringstream out;
+    for(int i = 0; i <= params_.path_length; ++i)
+      out << (i == 0 ? "" : " ") << random_.number(0, 1000) << "," << random_.number(0, 1000);
+    return out.str();
+  }
+
+  std::string clock_value()
+  {
+    std::ostringstream out;
+    switch (random_.uniform(4))
+    {
+    case 0: out << "0" << random_.uniform(10) << ":" << 10 + random_.uniform(50) << ":" << 10 + random_.uniform(50); break;
+    case 1: out << 10 + random_.uniform(50) << ":" << 10 + random_.uniform(50) << "." << random_.uniform(100); break;
+    case 2: out << random_.number(0, 100) << "s"; break;
+    case 3: out << random_.uniform(2000) << "ms"; break;
+    }
+    return out.str();
+  }
+
+  std::string style()
+  {
+    if (random_.chance(params_.style_repeat))
+    {
+      // Same few strings as produced by editors for similar objects
+      static char const * const repeated[] = {
+        "fill:#ff0000;fill-opacity:1;fill-rule:nonzero;stroke:#000000;stroke-width:1.5;"
+          "stroke-linecap:butt;stroke-linejoin:miter;stroke-miterlimit:4;stroke-dasharray:none;stroke-opacity:1",
+        "fill:none;stroke:#1f77b4;stroke-width:2px;stroke-linejoin:round;opacity:0.8",
+        "fill:steelblue;stroke:none;display:inline"
+      };
+      return repeated[random_.uniform(sizeof(repeated) / sizeof(repeated[0]))];
+    }
+    std::ostringstream out;
+    out << "fill:" << color() << ";stroke:" << color()
+      << ";stroke-width:" << length() << ";opacity:" << random_.number(0, 1);
+    if (random_.chance(0.3))
+      out << ";fill-rule:evenodd";
+    return out.str();
+  }
+
+  std::string document()
+  {
+    std::ostringstream out;
+    out << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"1000\" height=\"1000\" viewBox=\"0 0 1000 1000\">\n";
+    int remaining = params_.element_count;
+    while (remaining > 0)
+      group(out, 1, remaining);
+    out << "</svg>\n";
+    return out.str();
+  }
+
+private:
+  parameters const params_;
+  random random_;
+
+  void group(std::ostream & out, int depth, int & remaining)
+  {
+    if (depth <= params_.nesting_depth && random_.chance(0.3))
+    {
+      out << "<g transform=\"" << transform_list() << "\"";
+      presentation(out);
+      out << ">\n";
+      int children = 1 + random_.uniform(8);
+      for(int i = 0; i < children && remaining > 0; ++i)
+        group(out, depth + 1, remaining);
+      out << "</g>\n";
+      return;
+    }
+    --remaining;
+    switch (random_.uniform(5))
+    {
+    case 0:
+      out << "<path d=\"" << path_data() << "\"";
+      break;
+    case 1:
+      out << "<rect x=\"" << length() << "\" y=\"" << length() << "\" width=\"" << length() << "\" height=\"" << length() << "\"";
+      if (random_.chance(0.3))
+        out << " rx=\"" << random_.number(0, 10) << "\"";
+      break;
+    case 2:
+      out << "<circle cx=\"" << length() << "\" cy=\"" << length() << "\" r=\"" << random_.number(0, 50) << "\"";
+      break;
+    case 3:
+      out << "<polyline points=\"" << points() << "\"";
+      break;
+    case 4:
+      out << "<ellipse cx=\"" << length() << "\" cy=\"" << length()
+        << "\" rx=\"" << random_.number(0, 50) << "\" ry=\"" << random_.number(0, 50) << "\"";
+      break;
+    }
+    if (random_.chance(0.2))
+      out << " transform=\"" << transform_list() << "\"";
+    presentation(out);
+    out << "/>\n";
+  }
+
+  void presentation(std::ostream & out)
+  {
+    if (random_.chance(params_.style_mix))
+      out << " style=\"" << style() << "\"";
+    else
+      out << " fill=\"" << color() << "\" stroke=\"" << color() << "\" stroke-width=\"" << length() << "\"";
+  }
+};
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <svgpp/utility/event_stream.hpp>
+#include <sstream>
+#include <string>
+#include <utility>
+
+// Logs all events in the same form, independently of argument types
+struct test_event_log_context
+{
+  template<class ElementTag>
+  void on_enter_element(ElementTag) { log_ << "<" << ElementTag::element_id << ">"; }
+  void on_exit_element() { log_ << "</>"; }
+
+  template<class AttributeTag, class... Args>
+  void set(AttributeTag, Args const &... args)
+  {
+    log_ << " a" << AttributeTag::attribute_id << "=";
+    log_args(args...);
+  }
+
+  template<class Range>
+  void set_text(Range const & text) { log_ << "text:" << std::string(boost::begin(text), boost::end(text)); }
+
+  template<class AbsoluteOrRelative>
+  void path_move_to(double x, double y, AbsoluteOrRelative) { log_ << " M" << x << "," << y; }
+  template<class AbsoluteOrRelative>
+  void path_line_to(double x, double y, AbsoluteOrRelative) { log_ << " L" << x << "," << y; }
+  template<class AbsoluteOrRelative>
+  void path_cubic_bezier_to(double x1, double y1, double x2, double y2, double x, double y, AbsoluteOrRelative)
+  { log_ << " C" << x1 << "," << y1 << "," << x2 << "," << y2 << "," << x << "," << y; }
+  template<class AbsoluteOrRelative>
+  void path_quadratic_bezier_to(double x1, double y1, double x, double y, AbsoluteOrRelative)
+  { log_ << " Q" << x1 << "," << y1 << "," << x << "," << y; }
+  template<class AbsoluteOrRelative>
+  void path_elliptical_arc_to(double rx, double ry, double rotation, bool large_arc, bool sweep,
+    double x, double y, AbsoluteOrRelative)
+  { log_ << " A" << rx << "," << ry << "," << rotation << "," << large_arc << "," << sweep << "," << x << "," << y; }
+  void path_close_subpath() { log_ << " Z"; }
+  void path_exit() { log_ << " exit"; }
+
+  void transform_matrix(const boost::array<double, 6> & m)
+  {
+    log_ << " matrix(" << m[0] << "," << m[1] << "," << m[2] << "," << m[3] << "," << m[4] << "," << m[5] << ")";
+  }
+
+  std::ostringstream log_;
+
+private:
+  void log_args() {}
+
+  template<class Arg, class... Args>
+  void log_args(Arg const & arg, Args const &... args)
+  {
+    log_arg(arg);
+    log_ << ";";
+    log_args(args...);
+  }
+
+  void log_arg(double value) { log_ << value; }
+  void log_arg(int value) { log_ << "#" << std::hex << value << std::dec; }
+  void log_arg(bool value) { log_ << (value ? "true" : "false"); }
+  void log_arg(svgpp::tag::iri_fragment) { log_ << "fragment"; }
+  void log_arg(svgpp::tag::skip_icc_color) { log_ << "icc"; }
+
+  template<class T>
+  void log_arg(T const & value)
+  {
+    log_value(value, boost::mpl::bool_<svgpp::detail::event_stream_literal<T>::is_literal>());
+  }
+
+  template<class Literal>
+  void log_value(Literal, boost::mpl::true_)
+  {
+    log_ << "literal" << svgpp::detail::event_stream_literal<Literal>::id;
+  }
+
+  template<class Range>
+  void log_value(Range const & range, boost::mpl::false_)
+  {
+    log_range(range, boost::is_same<typename boost::range_value<Range>::type, char>());
+  }
+
+  template<class Range>
+  void log_range(Range const & range, boost::mpl::true_)
+  {
+    log_ << "'" << std::string(boost::begin(range), boost::end(range)) << "'";
+  }
+
+  template<class Range>
+  void log_range(Range const & range, boost::mpl::false_)
+  {
+    log_ << "[";
+    for(typename boost::range_iterator<Range const>::type it = boost::begin(range); it != boost::end(range); ++it)
+    {
+      log_item(*it);
+      log_ << " ";
+    }
+    log_ << "]";
+  }
+
+  void log_item(double value) { log_ << value; }
+  void log_item(std::pair<double, double> const & value) { log_ << value.first << "," << value.second; }
+};
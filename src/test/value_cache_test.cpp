@@ -0,0 +1,279 @@
+#include <svgpp/parser/path_data.hpp>
+#include <svgpp/parser/transform_list.hpp>
+#include <svgpp/utility/value_cache.hpp>
+#include <svgpp/document_traversal.hpp>
+#include <rapidxml_ns/rapidxml_ns.hpp>
+#include <svgpp/policy/xml/rapidxml_ns.hpp>
+
+#include "test_path_context.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace svgpp;
+
+namespace
+{
+  typedef svgpp::value_cache<> cache_t;
+
+  struct CachedContext: test_path_context
+  {
+    typedef cache_t value_cache_type;
+
+    CachedContext(cache_t * cache)
+      : cache_(cache)
+    {}
+
+    cache_t * value_cache() { return cache_; }
+
+    void transform_matrix(const boost::array<double, 6> & matrix)
+    {
+      transform_log_ << "[" << matrix[0] << "," << matrix[1] << "," << matrix[2]
+        << "," << matrix[3] << "," << matrix[4] << "," << matrix[5] << "]";
+    }
+
+    std::string transform_str() const { return transform_log_.str(); }
+
+  private:
+    cache_t * cache_;
+    std::ostringstream transform_log_;
+  };
+
+  typedef value_cache_policy<policy::value_cache::forward_to_method<CachedContext> > cache_policy_t;
+
+  template<class String>
+  void parse_path(CachedContext & context, String const & value)
+  {
+    value_parser<tag::type::path_data, cache_policy_t>::parse(
+      tag::attribute::d(), context, value, tag::source::attribute());
+  }
+
+  template<class String>
+  void parse_transform(CachedContext & context, String const & value)
+  {
+    value_parser<tag::type::transform_list, cache_policy_t>::parse(
+      tag::attribute::transform(), context, value, tag::source::attribute());
+  }
+}
+
+TEST(value_cache, path_replay)
+{
+  std::string const d("M300,200 100 200 h-150za150,151 0 1,0 150,-150z"
+    "M100,200 C100,100 250,100 250,200S400,300 400-200q1 2 3 4t5 6V7");
+
+  CachedContext expected(NULL);
+  parse_path(expected, d);
+
+  cache_t cache;
+  CachedContext first(&cache), second(&cache);
+  parse_path(first, d);
+  EXPECT_EQ(0, cache.hits());
+  EXPECT_EQ(1, cache.misses());
+  parse_path(second, d);
+  EXPECT_EQ(1, cache.hits());
+  EXPECT_EQ(1, cache.misses());
+
+  EXPECT_EQ(expected.str(), first.str());
+  EXPECT_EQ(expected.str(), second.str());
+}
+
+TEST(value_cache, transform_replay)
+{
+  std::string const transform("translate(10,20) scale(2) rotate(45 5 5) skewX(10) matrix(1 2 3 4 5 6)");
+
+  CachedContext expected(NULL);
+  parse_transform(expected, transform);
+
+  cache_t cache;
+  CachedContext first(&cache), second(&cache);
+  parse_transform(first, transform);
+  parse_transform(second, transform);
+  EXPECT_EQ(1, cache.hits());
+  EXPECT_EQ(expected.transform_str(), first.transform_str());
+  EXPECT_EQ(expected.transform_str(), second.transform_str());
+}
+
+TEST(value_cache, key_includes_attribute)
+{
+  cache_t cache;
+  CachedContext context(&cache);
+  std::string const transform("scale(2)");
+  parse_transform(context, transform);
+  value_parser<tag::type::transform_list, cache_policy_t>::parse(
+    tag::attribute::gradientTransform(), context, transform, tag::source::attribute());
+  EXPECT_EQ(0, cache.hits());
+  EXPECT_EQ(2, cache.misses());
+}
+
+TEST(value_cache, invalid_value_not_cached)
+{
+  cache_t cache;
+  CachedContext context(&cache);
+  std::string const d("M10 20 L30");
+  EXPECT_THROW(parse_path(context, d), std::exception);
+  EXPECT_THROW(parse_path(context, d), std::exception);
+  EXPECT_EQ(0, cache.hits());
+  EXPECT_EQ(0, cache.size());
+  // Events preceding error are passed
+  EXPECT_EQ("M10,20M10,20", context.str());
+}
+
+TEST(value_cache, bounded_size)
+{
+  cache_t cache(1024);
+  CachedContext context(&cache);
+  for(int i = 0; i < 100; ++i)
+  {
+    std::ostringstream d;
+    d << "M" << i << " 0 L 10 10 20 20 30 30";
+    parse_path(context, d.str());
+    EXPECT_LE(cache.size(), cache.max_size());
+  }
+  EXPECT_EQ(100, cache.misses());
+
+  // Most recently used values are kept
+  parse_path(context, std::string("M99 0 L 10 10 20 20 30 30"));
+  EXPECT_EQ(1, cache.hits());
+  parse_path(context, std::string("M0 0 L 10 10 20 20 30 30"));
+  EXPECT_EQ(1, cache.hits());
+
+  cache.clear();
+  EXPECT_EQ(0, cache.size());
+}
+
+namespace
+{
+  struct DocumentContext
+  {
+    typedef cache_t value_cache_type;
+
+    DocumentContext(cache_t & cache)
+      : cache_(cache)
+      , segments_(0)
+      , matrices_(0)
+    {}
+
+    cache_t * value_cache() { return &cache_; }
+
+    void on_enter_element(tag::element::any) {}
+    void on_exit_element() {}
+
+    void path_move_to(double, double, tag::coordinate::absolute) { ++segments_; }
+    void path_line_to(double, double, tag::coordinate::absolute) { ++segments_; }
+    void path_cubic_bezier_to(double, double, double, double, double, double, tag::coordinate::absolute) { ++segments_; }
+    void path_quadratic_bezier_to(double, double, double, double, tag::coordinate::absolute) { ++segments_; }
+    void path_elliptical_arc_to(double, double, double, bool, bool, double, double, tag::coordinate::absolute) { ++segments_; }
+    void path_close_subpath() { ++segments_; }
+    void path_exit() {}
+
+    void transform_matrix(const boost::array<double, 6> &) { ++matrices_; }
+
+    cache_t & cache_;
+    int segments_, matrices_;
+  };
+}
+
+TEST(value_cache, document_traversal)
+{
+  char xml[] = "<svg xmlns=\"http://www.w3.org/2000/svg\">"
+    "<path d=\"M0 0 h10 v10 z\" transform=\"rotate(30)\"/>"
+    "<path d=\"M0 0 h10 v10 z\" transform=\"rotate(30)\"/>"
+    "<path d=\"M0 0 h10 v10 z\" transform=\"rotate(30)\"/>"
+    "</svg>";
+  rapidxml_ns::xml_document<> doc;
+  doc.parse<0>(xml);
+
+  cache_t cache;
+  DocumentContext context(cache);
+  document_traversal<
+    value_cache_policy<policy::value_cache::forward_to_method<DocumentContext> >,
+    processed_elements<boost::mpl::set<tag::element::svg, tag::element::path>::type>,
+    processed_attributes<boost::mpl::set<tag::attribute::d, tag::attribute::transform>::type>
+  >::load_document(doc.first_node(), context);
+
+  EXPECT_EQ(3 * 4, context.segments_);
+  EXPECT_EQ(3, context.matrices_);
+  EXPECT_EQ(4, cache.hits());
+  EXPECT_EQ(2, cache.misses());
+}
+
+namespace
+{
+  struct StyleContext
+  {
+    typedef cache_t value_cache_type;
+
+    StyleContext(cache_t & cache)
+      : cache_(cache)
+    {}
+
+    cache_t * value_cache() { return &cache_; }
+
+    void on_enter_element(tag::element::any) {}
+    void on_exit_element() {}
+
+    void set(tag::attribute::opacity, double value) { log_ << "opacity=" << value << ";"; }
+    void set(tag::attribute::stroke_width, double value) { log_ << "stroke-width=" << value << ";"; }
+    template<class AttributeTag>
+    void set(AttributeTag, tag::value::inherit) { log_ << "inherit;"; }
+
+    cache_t & cache_;
+    std::ostringstream log_;
+  };
+
+  template<class Policy>
+  void load_styled_document(char * xml, StyleContext & context)
+  {
+    rapidxml_ns::xml_document<> doc;
+    doc.parse<0>(xml);
+    document_traversal<
+      Policy,
+      processed_elements<boost::mpl::set<tag::element::svg, tag::element::g>::type>,
+      processed_attributes<boost::mpl::set<tag::attribute::opacity, tag::attribute::stroke_width>::type>
+    >::load_document(doc.first_node(), context);
+  }
+}
+
+TEST(value_cache, style_declarations)
+{
+  char xml[] = "<svg xmlns=\"http://www.w3.org/2000/svg\">"
+    "<g style=\" opacity : 0.5;;stroke-width:2\" opacity=\"0.1\"/>"
+    "<g style=\" opacity : 0.5;;stroke-width:2\"/>"
+    "<g style=\"stroke-width:3\"/>"
+    "</svg>";
+  std::string const xml_copy(xml);
+
+  cache_t cache;
+  StyleContext context(cache);
+  load_styled_document<value_cache_policy<policy::value_cache::forward_to_method<StyleContext> > >(xml, context);
+  EXPECT_EQ(1, cache.hits());
+  EXPECT_EQ(2, cache.misses());
+
+  cache_t unused_cache;
+  StyleContext expected(unused_cache);
+  std::vector<char> xml2(xml_copy.begin(), xml_copy.end());
+  xml2.push_back('\0');
+  load_styled_document<value_cache_policy<policy::value_cache::disabled> >(&xml2[0], expected);
+  EXPECT_EQ(0, unused_cache.misses());
+  EXPECT_EQ(expected.log_.str(), context.log_.str());
+  EXPECT_EQ("opacity=0.5;stroke-width=2;opacity=0.5;stroke-width=2;stroke-width=3;", context.log_.str());
+}
+
+TEST(value_cache, style_unknown_property_not_cached)
+{
+  char xml[] = "<svg xmlns=\"http://www.w3.org/2000/svg\">"
+    "<g style=\"opacity:0.5;unknown-property:1\"/>"
+    "</svg>";
+  std::string const xml_copy(xml);
+
+  cache_t cache;
+  for(int i = 0; i < 2; ++i)
+  {
+    StyleContext context(cache);
+    std::vector<char> buffer(xml_copy.begin(), xml_copy.end());
+    buffer.push_back('\0');
+    EXPECT_THROW(load_styled_document<value_cache_policy<policy::value_cache::forward_to_method<StyleContext> > >(
+      &buffer[0], context), std::exception);
+  }
+  EXPECT_EQ(0, cache.hits());
+  EXPECT_EQ(0, cache.size());
+}
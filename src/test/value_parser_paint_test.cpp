@@ -1,4 +1,6 @@
 #include <svgpp/parser/paint.hpp>
+#include <svgpp/parser/value_parser.hpp>
+#include <svgpp/traits/attribute_type.hpp>
 
 #include <gtest/gtest.h>
 #include <sstream>
@@ -108,4 +110,61 @@ TEST_P(ValidPaintCSS, Valid)
 
 INSTANTIATE_TEST_CASE_P(value_parser,
                         ValidPaintCSS,
-                        ::testing::ValuesIn(ValidTestsCSS));
\ No newline at end of file
+                        ::testing::ValuesIn(ValidTestsCSS));
+namespace
+{
+  // Filter primitive properties aren't inherited, 'inherit' value is passed to the context
+  class FilterColorContext
+  {
+  public:
+    std::string str() const { return str_.str(); }
+
+    template<class AttributeTag>
+    void set(AttributeTag, tag::value::inherit)
+    {
+      str_ << "[inherit]";
+    }
+
+    template<class AttributeTag>
+    void set(AttributeTag, tag::value::currentColor)
+    {
+      str_ << "[currentColor]";
+    }
+
+    template<class AttributeTag>
+    void set(AttributeTag, int rgb, tag::skip_icc_color = tag::skip_icc_color())
+    {
+      str_ << "[rgb:" << std::hex << std::setw(6) << std::setfill('0') << rgb << "]";
+    }
+
+    template<class AttributeTag>
+    void set(AttributeTag, double value)
+    {
+      str_ << "[" << value << "]";
+    }
+
+  private:
+    std::ostringstream str_;
+  };
+
+  template<class ElementTag, class AttributeTag>
+  std::string parseFilterColor(std::string const & value)
+  {
+    FilterColorContext ctx;
+    EXPECT_TRUE((value_parser<typename traits::attribute_type<ElementTag, AttributeTag>::type>::parse(
+      AttributeTag(), ctx, value, tag::source::attribute())));
+    return ctx.str();
+  }
+}
+
+TEST(value_parser, filter_primitive_colors)
+{
+  EXPECT_EQ("[inherit]", (parseFilterColor<tag::element::feFlood, tag::attribute::flood_color>("inherit")));
+  EXPECT_EQ("[currentColor]", (parseFilterColor<tag::element::feFlood, tag::attribute::flood_color>("currentColor")));
+  EXPECT_EQ("[rgb:ff0000]", (parseFilterColor<tag::element::feFlood, tag::attribute::flood_color>("red")));
+  EXPECT_EQ("[inherit]", (parseFilterColor<tag::element::feFlood, tag::attribute::flood_opacity>("inherit")));
+  EXPECT_EQ("[0.5]", (parseFilterColor<tag::element::feFlood, tag::attribute::flood_opacity>("0.5")));
+  EXPECT_EQ("[inherit]", (parseFilterColor<tag::element::feDiffuseLighting, tag::attribute::lighting_color>("inherit")));
+  EXPECT_EQ("[inherit]", (parseFilterColor<tag::element::feSpecularLighting, tag::attribute::lighting_color>("inherit")));
+  EXPECT_EQ("[currentColor]", (parseFilterColor<tag::element::feSpecularLighting, tag::attribute::lighting_color>("currentColor")));
+}